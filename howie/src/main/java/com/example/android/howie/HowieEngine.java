@@ -20,6 +20,8 @@ package com.example.android.howie;
 import android.content.Context;
 import android.media.AudioManager;
 
+import java.nio.ByteBuffer;
+
 public class HowieEngine {
 
     public static long init(Context ctx) {
@@ -39,6 +41,72 @@ public class HowieEngine {
                 framesPerBufferInt);
     }
 
+    /** Must match HOWIE_STATISTICS_BUCKET_COUNT in howie.h. */
+    public static final int STATISTICS_BUCKET_COUNT = 16;
+
+    /**
+     * Callback timing for one stream; see HowieStreamStatistics in howie.h.
+     * Each histogram bucket is one eighth of a period wide, and the last
+     * bucket counts everything longer.
+     */
+    public static class StreamStatistics {
+        public long periodNs;
+        public long lastCallbackTimeNs;
+        public long callbackCount;
+        public long maxCallbackDurationNs;
+        public int underrunCount;
+        public int missedRecordBufferCount;
+        public int parameterContentionCount;
+        public int captureOverflowCount;
+        public int inputDriftPpm;
+        public int inputResyncCount;
+        public int reportOverflowCount;
+        public int playbackQueueDepth;
+        public long idlePeriodCount;
+        public final int[] callbackDurationHistogram =
+                new int[STATISTICS_BUCKET_COUNT];
+        public final int[] callbackIntervalHistogram =
+                new int[STATISTICS_BUCKET_COUNT];
+    }
+
+    /**
+     * Read the statistics for the native HowieStream* stream, or return
+     * null if the stream isn't valid.
+     */
+    public static StreamStatistics getStreamStatistics(long stream) {
+        StreamStatistics stats = new StreamStatistics();
+        long[] scalars = new long[13];
+        if (!getStreamStatistics(stream, scalars,
+                stats.callbackDurationHistogram,
+                stats.callbackIntervalHistogram)) {
+            return null;
+        }
+        stats.periodNs = scalars[0];
+        stats.lastCallbackTimeNs = scalars[1];
+        stats.callbackCount = scalars[2];
+        stats.maxCallbackDurationNs = scalars[3];
+        stats.underrunCount = (int) scalars[4];
+        stats.missedRecordBufferCount = (int) scalars[5];
+        stats.parameterContentionCount = (int) scalars[6];
+        stats.captureOverflowCount = (int) scalars[7];
+        stats.inputDriftPpm = (int) scalars[8];
+        stats.inputResyncCount = (int) scalars[9];
+        stats.reportOverflowCount = (int) scalars[10];
+        stats.playbackQueueDepth = (int) scalars[11];
+        stats.idlePeriodCount = scalars[12];
+        return stats;
+    }
+
+    /**
+     * Copy as many reports from the native HowieStream* stream as fit into
+     * dest, back to back from the start of the buffer, and return how many
+     * were copied. dest must be a direct buffer, allocated once and reused;
+     * reports are in native byte order. Returns -1 if the stream or buffer
+     * isn't valid. See HowieStreamReceiveReports in howie.h.
+     */
+    public static native int receiveReports(long stream,
+                                            ByteBuffer dest);
+
     private static native long create(
             int sampleRate,
             int bitsPerSample,      // not including padding
@@ -51,4 +119,9 @@ public class HowieEngine {
             int framesPerBuffer     // determines granularity of callbacks
     );
     private static native void destroy(long engine);
+    private static native boolean getStreamStatistics(
+            long stream,
+            long[] scalars,
+            int[] callbackDurationHistogram,
+            int[] callbackIntervalHistogram);
 }
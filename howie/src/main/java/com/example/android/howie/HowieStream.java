@@ -0,0 +1,184 @@
+/*
+ * Copyright 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+package com.example.android.howie;
+
+import android.os.Build;
+
+import java.nio.ByteBuffer;
+import java.nio.ByteOrder;
+
+import dalvik.annotation.optimization.CriticalNative;
+
+/**
+ * Builds a native stream's parameter blocks in place from Java.
+ *
+ * The stream's parameter slots are mapped once, as direct ByteBuffers in
+ * native byte order, so acquireParameters() hands back the slot itself:
+ * whatever the app puts into it is what the process callback reads, with
+ * no copy on the way. Acquiring without a timeout, and committing, are
+ * @CriticalNative calls on Android 9 and later, and a Batch commits the
+ * slots of several streams in a single call, so per-frame updates from UI
+ * controls or sensors cost a fraction of an ordinary JNI call each.
+ *
+ * A slot holds an older parameter block, so write all of it. The layout is
+ * the native parameter struct's; mind its alignment and padding. Like the
+ * native slot API, only one slot per stream can be outstanding, and each
+ * HowieStream should be used from one thread at a time.
+ */
+public final class HowieStream {
+
+    static {
+        System.loadLibrary("howie");
+        // Android 8.x only honors @CriticalNative in boot classes, and
+        // still passes a JNIEnv and jclass to an app's methods, so they
+        // must get the ordinary versions there.
+        registerNatives(Build.VERSION.SDK_INT >= 28);
+    }
+
+    private final long stream;
+    private final ByteBuffer[] slots;
+    private int acquired = -1;
+
+    /**
+     * Wraps the native HowieStream* stream, which must have a parameter
+     * block, and must outlive this object.
+     */
+    public HowieStream(long stream) {
+        ByteBuffer storage = parameterStorage(stream);
+        if (storage == null) {
+            throw new IllegalArgumentException(
+                    "Not a stream with a parameter block");
+        }
+        int stride = parameterStride(stream);
+        int size = parameterBlockSize(stream);
+        slots = new ByteBuffer[storage.capacity() / stride];
+        for (int i = 0; i < slots.length; ++i) {
+            storage.limit(i * stride + size).position(i * stride);
+            slots[i] = storage.slice().order(ByteOrder.nativeOrder());
+            storage.clear();
+        }
+        this.stream = stream;
+    }
+
+    /** The native HowieStream* this wraps. */
+    public long nativeStream() {
+        return stream;
+    }
+
+    /**
+     * Acquire the writable parameter slot, waiting up to timeoutMs for
+     * another thread that holds it. Returns null if that timed out or the
+     * slot is already acquired through this object. The returned buffer is
+     * sizeofParameterBlock bytes, positioned at zero, and the same object
+     * is handed out again for the same slot, so nothing is allocated.
+     * With a timeoutMs of zero this is a @CriticalNative call that never
+     * waits; a longer timeout takes an ordinary JNI call, so the garbage
+     * collector isn't held off while it waits.
+     */
+    public ByteBuffer acquireParameters(int timeoutMs) {
+        if (acquired >= 0) {
+            return null;
+        }
+        int index = timeoutMs > 0 ? acquireSlot(stream, timeoutMs)
+                                  : tryAcquireSlot(stream);
+        if (index < 0 || index >= slots.length) {
+            return null;
+        }
+        acquired = index;
+        ByteBuffer slot = slots[index];
+        slot.clear();
+        return slot;
+    }
+
+    /**
+     * Publish the acquired slot to the audio thread. Returns false if no
+     * slot was acquired.
+     */
+    public boolean commitParameters() {
+        if (acquired < 0) {
+            return false;
+        }
+        boolean result = commitSlot(stream, acquired);
+        acquired = -1;
+        return result;
+    }
+
+    /**
+     * Commits the acquired slots of several streams in one native call,
+     * such as once per UI frame. Add each stream after filling its slot;
+     * commit() publishes them all, in the order they were added, and
+     * leaves the batch empty for the next frame.
+     */
+    public static final class Batch {
+        // Must match BatchEntry in HowieStreamJni.cpp.
+        private static final int ENTRY_SIZE = 16;
+
+        private final ByteBuffer entries;
+        private final long address;
+        private final HowieStream[] streams;
+        private int count;
+
+        public Batch(int capacity) {
+            entries = ByteBuffer.allocateDirect(capacity * ENTRY_SIZE)
+                    .order(ByteOrder.nativeOrder());
+            address = bufferAddress(entries);
+            streams = new HowieStream[capacity];
+        }
+
+        /**
+         * Queue stream's acquired slot. Returns false if the stream has no
+         * slot acquired, or the batch is full.
+         */
+        public boolean add(HowieStream stream) {
+            if (stream.acquired < 0 || count == streams.length) {
+                return false;
+            }
+            entries.putLong(count * ENTRY_SIZE, stream.stream);
+            entries.putInt(count * ENTRY_SIZE + 8, stream.acquired);
+            streams[count++] = stream;
+            return true;
+        }
+
+        /** Returns the number of slots committed. */
+        public int commit() {
+            int committed = commitSlots(address, count);
+            for (int i = 0; i < count; ++i) {
+                streams[i].acquired = -1;
+                streams[i] = null;
+            }
+            count = 0;
+            return committed;
+        }
+    }
+
+    private static native boolean registerNatives(boolean critical);
+    private static native ByteBuffer parameterStorage(long stream);
+    private static native int parameterStride(long stream);
+    private static native int parameterBlockSize(long stream);
+    private static native long bufferAddress(ByteBuffer buffer);
+
+    // Registered by registerNatives rather than looked up by name. A
+    // waiting acquire can't be @CriticalNative.
+    private static native int acquireSlot(long stream, int timeoutMs);
+    @CriticalNative
+    private static native int tryAcquireSlot(long stream);
+    @CriticalNative
+    private static native boolean commitSlot(long stream, int index);
+    @CriticalNative
+    private static native int commitSlots(long entries, int count);
+}
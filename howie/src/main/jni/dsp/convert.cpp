@@ -0,0 +1,146 @@
+/*
+ * Copyright 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#include "dsp-private.h"
+
+using namespace howie::dsp;
+
+void HowieDspInt16ToFloat(const int16_t *src, float *dest, size_t count) {
+  size_t i = 0;
+#ifdef HOWIE_DSP_NEON
+  for (; i + kVectorWidth <= count; i += kVectorWidth) {
+    int16x8_t s = vld1q_s16(src + i);
+    // Treat the samples as Q15 fixed point
+    vst1q_f32(dest + i, vcvtq_n_f32_s32(vmovl_s16(vget_low_s16(s)), 15));
+    vst1q_f32(dest + i + 4, vcvtq_n_f32_s32(vmovl_s16(vget_high_s16(s)), 15));
+  }
+#endif
+  for (; i < count; ++i) {
+    dest[i] = src[i] * (1.f / kInt16Scale);
+  }
+}
+
+void HowieDspFloatToInt16(const float *src, int16_t *dest, size_t count) {
+  size_t i = 0;
+#ifdef HOWIE_DSP_NEON
+  // vcvtq_n_s32_f32 saturates to the int32 range and vqmovn_s32 to the
+  // int16 range, so no explicit clamp is needed.
+  for (; i + kVectorWidth <= count; i += kVectorWidth) {
+    int32x4_t lo = vcvtq_n_s32_f32(vld1q_f32(src + i), 15);
+    int32x4_t hi = vcvtq_n_s32_f32(vld1q_f32(src + i + 4), 15);
+    vst1q_s16(dest + i, vcombine_s16(vqmovn_s32(lo), vqmovn_s32(hi)));
+  }
+#endif
+  for (; i < count; ++i) {
+    dest[i] = static_cast<int16_t>(
+        clamp(src[i] * kInt16Scale, -kInt16Scale, kInt16Scale - 1.f));
+  }
+}
+
+void HowieDspInt24ToFloat(const uint8_t *src, float *dest, size_t count) {
+  size_t i = 0;
+#ifdef HOWIE_DSP_NEON
+  // Load eight packed samples, split into their three bytes, and reassemble
+  // each as the top 24 bits of a Q31 value.
+  for (; i + kVectorWidth <= count; i += kVectorWidth) {
+    uint8x8x3_t b = vld3_u8(src + i * 3);
+    uint16x8_t b0 = vmovl_u8(b.val[0]);
+    uint16x8_t b1 = vmovl_u8(b.val[1]);
+    uint16x8_t b2 = vmovl_u8(b.val[2]);
+    uint32x4_t lo = vorrq_u32(
+        vorrq_u32(vshll_n_u16(vget_low_u16(b0), 8),
+                  vshlq_n_u32(vmovl_u16(vget_low_u16(b1)), 16)),
+        vshlq_n_u32(vmovl_u16(vget_low_u16(b2)), 24));
+    uint32x4_t hi = vorrq_u32(
+        vorrq_u32(vshll_n_u16(vget_high_u16(b0), 8),
+                  vshlq_n_u32(vmovl_u16(vget_high_u16(b1)), 16)),
+        vshlq_n_u32(vmovl_u16(vget_high_u16(b2)), 24));
+    vst1q_f32(dest + i, vcvtq_n_f32_s32(vreinterpretq_s32_u32(lo), 31));
+    vst1q_f32(dest + i + 4, vcvtq_n_f32_s32(vreinterpretq_s32_u32(hi), 31));
+  }
+#endif
+  for (; i < count; ++i) {
+    const uint8_t *s = src + i * 3;
+    int32_t q31 = static_cast<int32_t>((uint32_t(s[0]) << 8)
+                                       | (uint32_t(s[1]) << 16)
+                                       | (uint32_t(s[2]) << 24));
+    dest[i] = q31 * (1.f / kInt32Scale);
+  }
+}
+
+void HowieDspFloatToInt24(const float *src, uint8_t *dest, size_t count) {
+  size_t i = 0;
+#ifdef HOWIE_DSP_NEON
+  // Convert to saturated Q31, then store the top three bytes of each.
+  for (; i + kVectorWidth <= count; i += kVectorWidth) {
+    uint32x4_t lo = vreinterpretq_u32_s32(
+        vcvtq_n_s32_f32(vld1q_f32(src + i), 31));
+    uint32x4_t hi = vreinterpretq_u32_s32(
+        vcvtq_n_s32_f32(vld1q_f32(src + i + 4), 31));
+    uint8x8x3_t b;
+    b.val[0] = vmovn_u16(vcombine_u16(vshrn_n_u32(lo, 8),
+                                      vshrn_n_u32(hi, 8)));
+    b.val[1] = vmovn_u16(vcombine_u16(vshrn_n_u32(lo, 16),
+                                      vshrn_n_u32(hi, 16)));
+    b.val[2] = vmovn_u16(vcombine_u16(vmovn_u32(vshrq_n_u32(lo, 24)),
+                                      vmovn_u32(vshrq_n_u32(hi, 24))));
+    vst3_u8(dest + i * 3, b);
+  }
+#endif
+  for (; i < count; ++i) {
+    int32_t s = static_cast<int32_t>(
+        clamp(src[i] * kInt24Scale, -kInt24Scale, kInt24Scale - 1.f));
+    uint8_t *d = dest + i * 3;
+    d[0] = static_cast<uint8_t>(s);
+    d[1] = static_cast<uint8_t>(s >> 8);
+    d[2] = static_cast<uint8_t>(s >> 16);
+  }
+}
+
+void HowieDspInt32ToFloat(const int32_t *src, float *dest, size_t count) {
+  size_t i = 0;
+#ifdef HOWIE_DSP_NEON
+  for (; i + kVectorWidth <= count; i += kVectorWidth) {
+    vst1q_f32(dest + i, vcvtq_n_f32_s32(vld1q_s32(src + i), 31));
+    vst1q_f32(dest + i + 4, vcvtq_n_f32_s32(vld1q_s32(src + i + 4), 31));
+  }
+#endif
+  for (; i < count; ++i) {
+    dest[i] = src[i] * (1.f / kInt32Scale);
+  }
+}
+
+void HowieDspFloatToInt32(const float *src, int32_t *dest, size_t count) {
+  size_t i = 0;
+#ifdef HOWIE_DSP_NEON
+  for (; i + kVectorWidth <= count; i += kVectorWidth) {
+    vst1q_s32(dest + i, vcvtq_n_s32_f32(vld1q_f32(src + i), 31));
+    vst1q_s32(dest + i + 4, vcvtq_n_s32_f32(vld1q_f32(src + i + 4), 31));
+  }
+#endif
+  for (; i < count; ++i) {
+    // The largest int32 isn't representable as a float, so test against
+    // full scale rather than clamping to it.
+    float s = src[i] * kInt32Scale;
+    if (s >= kInt32Scale) {
+      dest[i] = INT32_MAX;
+    } else if (s <= -kInt32Scale) {
+      dest[i] = INT32_MIN;
+    } else {
+      dest[i] = static_cast<int32_t>(s);
+    }
+  }
+}
@@ -0,0 +1,74 @@
+/*
+ * Copyright 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#include "dsp-private.h"
+#include <cfloat>
+#include <cmath>
+
+#if defined(__i386__) || defined(__x86_64__)
+#include <xmmintrin.h>
+#endif
+
+using namespace howie::dsp;
+
+void HowieDspFlushDenormals(float *buffer, size_t count) {
+  size_t i = 0;
+#ifdef HOWIE_DSP_NEON
+  // Keep every sample whose magnitude is at least FLT_MIN; zero the rest.
+  const float32x4_t smallest = vdupq_n_f32(FLT_MIN);
+  for (; i + 4 <= count; i += 4) {
+    float32x4_t x = vld1q_f32(buffer + i);
+    uint32x4_t keep = vcgeq_f32(vabsq_f32(x), smallest);
+    vst1q_f32(buffer + i, vreinterpretq_f32_u32(
+        vandq_u32(vreinterpretq_u32_f32(x), keep)));
+  }
+#endif
+  for (; i < count; ++i) {
+    if (std::fabs(buffer[i]) < FLT_MIN) {
+      buffer[i] = 0.f;
+    }
+  }
+}
+
+bool HowieDspSetFlushToZero(bool enable) {
+  bool previous = false;
+#if defined(__aarch64__)
+  // FPCR.FZ is bit 24
+  constexpr uint64_t kFlushToZero = 1 << 24;
+  uint64_t fpcr;
+  asm volatile("mrs %0, fpcr" : "=r"(fpcr));
+  previous = (fpcr & kFlushToZero) != 0;
+  fpcr = enable ? (fpcr | kFlushToZero) : (fpcr & ~kFlushToZero);
+  asm volatile("msr fpcr, %0" : : "r"(fpcr));
+#elif defined(__arm__) && !defined(__SOFTFP__)
+  // FPSCR.FZ is bit 24. NEON instructions always flush to zero; this only
+  // affects VFP (scalar) arithmetic.
+  constexpr uint32_t kFlushToZero = 1 << 24;
+  uint32_t fpscr;
+  asm volatile("vmrs %0, fpscr" : "=r"(fpscr));
+  previous = (fpscr & kFlushToZero) != 0;
+  fpscr = enable ? (fpscr | kFlushToZero) : (fpscr & ~kFlushToZero);
+  asm volatile("vmsr fpscr, %0" : : "r"(fpscr));
+#elif defined(__i386__) || defined(__x86_64__)
+  // FTZ flushes denormal results, DAZ treats denormal inputs as zero.
+  constexpr unsigned int kFlushToZero = 0x8040;
+  unsigned int mxcsr = _mm_getcsr();
+  previous = (mxcsr & kFlushToZero) == kFlushToZero;
+  mxcsr = enable ? (mxcsr | kFlushToZero) : (mxcsr & ~kFlushToZero);
+  _mm_setcsr(mxcsr);
+#endif
+  return previous;
+}
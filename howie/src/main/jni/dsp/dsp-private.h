@@ -0,0 +1,43 @@
+/*
+ * Copyright 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#ifndef HOWIE_DSP_PRIVATE_H
+#define HOWIE_DSP_PRIVATE_H
+
+#include "../howie_dsp.h"
+
+#if defined(__ARM_NEON__) || defined(__ARM_NEON)
+#include <arm_neon.h>
+#define HOWIE_DSP_NEON 1
+#endif
+
+namespace howie {
+namespace dsp {
+  // Number of floats processed per iteration of the vector loops. The
+  // scalar tail loops handle whatever is left over.
+  constexpr size_t kVectorWidth = 8;
+
+  constexpr float kInt16Scale = 32768.f;
+  constexpr float kInt24Scale = 8388608.f;
+  constexpr float kInt32Scale = 2147483648.f;
+
+  inline float clamp(float x, float lo, float hi) {
+    return x < lo ? lo : (x > hi ? hi : x);
+  }
+} // namespace dsp
+} // namespace howie
+
+#endif // HOWIE_DSP_PRIVATE_H
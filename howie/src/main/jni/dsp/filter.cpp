@@ -0,0 +1,41 @@
+/*
+ * Copyright 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#include "dsp-private.h"
+
+using namespace howie::dsp;
+
+float HowieDspDotProduct(const float *a, const float *b, size_t count) {
+  size_t i = 0;
+  float sum = 0.f;
+#ifdef HOWIE_DSP_NEON
+  // Two accumulators, so consecutive multiply-adds don't wait on each
+  // other.
+  float32x4_t acc0 = vdupq_n_f32(0.f);
+  float32x4_t acc1 = vdupq_n_f32(0.f);
+  for (; i + kVectorWidth <= count; i += kVectorWidth) {
+    acc0 = vmlaq_f32(acc0, vld1q_f32(a + i), vld1q_f32(b + i));
+    acc1 = vmlaq_f32(acc1, vld1q_f32(a + i + 4), vld1q_f32(b + i + 4));
+  }
+  float32x4_t acc = vaddq_f32(acc0, acc1);
+  float32x2_t pair = vadd_f32(vget_low_f32(acc), vget_high_f32(acc));
+  sum = vget_lane_f32(vpadd_f32(pair, pair), 0);
+#endif
+  for (; i < count; ++i) {
+    sum += a[i] * b[i];
+  }
+  return sum;
+}
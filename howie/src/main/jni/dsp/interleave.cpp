@@ -0,0 +1,67 @@
+/*
+ * Copyright 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#include "dsp-private.h"
+
+using namespace howie::dsp;
+
+void HowieDspInterleave(const float * const *channels,
+                        float *dest,
+                        size_t channelCount,
+                        size_t frameCount) {
+  size_t i = 0;
+#ifdef HOWIE_DSP_NEON
+  // Stereo is by far the most common layout, and maps directly onto vst2.
+  if (channelCount == 2) {
+    const float *left = channels[0];
+    const float *right = channels[1];
+    for (; i + 4 <= frameCount; i += 4) {
+      float32x4x2_t frames;
+      frames.val[0] = vld1q_f32(left + i);
+      frames.val[1] = vld1q_f32(right + i);
+      vst2q_f32(dest + i * 2, frames);
+    }
+  }
+#endif
+  for (; i < frameCount; ++i) {
+    for (size_t c = 0; c < channelCount; ++c) {
+      dest[i * channelCount + c] = channels[c][i];
+    }
+  }
+}
+
+void HowieDspDeinterleave(const float *src,
+                          float * const *channels,
+                          size_t channelCount,
+                          size_t frameCount) {
+  size_t i = 0;
+#ifdef HOWIE_DSP_NEON
+  if (channelCount == 2) {
+    float *left = channels[0];
+    float *right = channels[1];
+    for (; i + 4 <= frameCount; i += 4) {
+      float32x4x2_t frames = vld2q_f32(src + i * 2);
+      vst1q_f32(left + i, frames.val[0]);
+      vst1q_f32(right + i, frames.val[1]);
+    }
+  }
+#endif
+  for (; i < frameCount; ++i) {
+    for (size_t c = 0; c < channelCount; ++c) {
+      channels[c][i] = src[i * channelCount + c];
+    }
+  }
+}
@@ -0,0 +1,63 @@
+/*
+ * Copyright 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#include "dsp-private.h"
+#include <algorithm>
+#include <cmath>
+
+using namespace howie::dsp;
+
+float HowieDspPeak(const float *src, size_t count) {
+  size_t i = 0;
+  float peak = 0.f;
+#ifdef HOWIE_DSP_NEON
+  float32x4_t max0 = vdupq_n_f32(0.f);
+  float32x4_t max1 = vdupq_n_f32(0.f);
+  for (; i + kVectorWidth <= count; i += kVectorWidth) {
+    max0 = vmaxq_f32(max0, vabsq_f32(vld1q_f32(src + i)));
+    max1 = vmaxq_f32(max1, vabsq_f32(vld1q_f32(src + i + 4)));
+  }
+  float32x4_t max = vmaxq_f32(max0, max1);
+  float32x2_t pair = vpmax_f32(vget_low_f32(max), vget_high_f32(max));
+  peak = vget_lane_f32(vpmax_f32(pair, pair), 0);
+#endif
+  for (; i < count; ++i) {
+    peak = std::max(peak, std::fabs(src[i]));
+  }
+  return peak;
+}
+
+bool HowieDspIsZero(const void *data, size_t byteCount) {
+  const uint8_t *bytes = static_cast<const uint8_t *>(data);
+  size_t i = 0;
+  uint8_t bits = 0;
+#ifdef HOWIE_DSP_NEON
+  // OR everything together and look once at the end; silence is the case
+  // that has to be cheap, and it has to read every byte anyway.
+  uint8x16_t acc0 = vdupq_n_u8(0);
+  uint8x16_t acc1 = vdupq_n_u8(0);
+  for (; i + 32 <= byteCount; i += 32) {
+    acc0 = vorrq_u8(acc0, vld1q_u8(bytes + i));
+    acc1 = vorrq_u8(acc1, vld1q_u8(bytes + i + 16));
+  }
+  uint64x2_t acc = vreinterpretq_u64_u8(vorrq_u8(acc0, acc1));
+  bits = (vgetq_lane_u64(acc, 0) | vgetq_lane_u64(acc, 1)) != 0;
+#endif
+  for (; i < byteCount; ++i) {
+    bits |= bytes[i];
+  }
+  return bits == 0;
+}
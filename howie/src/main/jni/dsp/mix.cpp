@@ -0,0 +1,54 @@
+/*
+ * Copyright 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#include "dsp-private.h"
+
+using namespace howie::dsp;
+
+void HowieDspGain(const float *src, float *dest, float gain, size_t count) {
+  size_t i = 0;
+#ifdef HOWIE_DSP_NEON
+  const float32x4_t lo = vdupq_n_f32(-1.f);
+  const float32x4_t hi = vdupq_n_f32(1.f);
+  for (; i + kVectorWidth <= count; i += kVectorWidth) {
+    float32x4_t a = vmulq_n_f32(vld1q_f32(src + i), gain);
+    float32x4_t b = vmulq_n_f32(vld1q_f32(src + i + 4), gain);
+    vst1q_f32(dest + i, vminq_f32(vmaxq_f32(a, lo), hi));
+    vst1q_f32(dest + i + 4, vminq_f32(vmaxq_f32(b, lo), hi));
+  }
+#endif
+  for (; i < count; ++i) {
+    dest[i] = clamp(src[i] * gain, -1.f, 1.f);
+  }
+}
+
+void HowieDspMixAccumulate(const float *src,
+                           float *dest,
+                           float gain,
+                           size_t count) {
+  size_t i = 0;
+#ifdef HOWIE_DSP_NEON
+  for (; i + kVectorWidth <= count; i += kVectorWidth) {
+    vst1q_f32(dest + i, vmlaq_n_f32(vld1q_f32(dest + i),
+                                    vld1q_f32(src + i), gain));
+    vst1q_f32(dest + i + 4, vmlaq_n_f32(vld1q_f32(dest + i + 4),
+                                        vld1q_f32(src + i + 4), gain));
+  }
+#endif
+  for (; i < count; ++i) {
+    dest[i] += src[i] * gain;
+  }
+}
@@ -0,0 +1,76 @@
+/*
+ * Copyright 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#include "dsp-private.h"
+
+using namespace howie::dsp;
+
+namespace {
+  // Catmull-Rom weights for the four frames around a position that is t
+  // of the way from frame 1 to frame 2.
+  inline void cubicWeights(float t, float w[4]) {
+    float t2 = t * t;
+    float t3 = t2 * t;
+    w[0] = -0.5f * t3 + t2 - 0.5f * t;
+    w[1] = 1.5f * t3 - 2.5f * t2 + 1.f;
+    w[2] = -1.5f * t3 + 2.f * t2 + 0.5f * t;
+    w[3] = 0.5f * t3 - 0.5f * t2;
+  }
+} // namespace
+
+void HowieDspResampleCubic(const float *src,
+                           float *dest,
+                           size_t channelCount,
+                           size_t frameCount,
+                           double phase,
+                           double step) {
+  for (size_t i = 0; i < frameCount; ++i) {
+    // Recompute the position from scratch each frame rather than
+    // accumulating, so rounding error doesn't build up over a period.
+    double position = phase + i * step;
+    size_t index = static_cast<size_t>(position);
+    float w[4];
+    cubicWeights(static_cast<float>(position - index), w);
+
+    const float *x = src + (index - 1) * channelCount;
+    float *y = dest + i * channelCount;
+    size_t c = 0;
+#ifdef HOWIE_DSP_NEON
+    // The weights are the same for every channel of a frame, so vectorize
+    // across channels.
+    for (; c + 4 <= channelCount; c += 4) {
+      float32x4_t acc = vmulq_n_f32(vld1q_f32(x + c), w[0]);
+      acc = vmlaq_n_f32(acc, vld1q_f32(x + channelCount + c), w[1]);
+      acc = vmlaq_n_f32(acc, vld1q_f32(x + 2 * channelCount + c), w[2]);
+      acc = vmlaq_n_f32(acc, vld1q_f32(x + 3 * channelCount + c), w[3]);
+      vst1q_f32(y + c, acc);
+    }
+    for (; c + 2 <= channelCount; c += 2) {
+      float32x2_t acc = vmul_n_f32(vld1_f32(x + c), w[0]);
+      acc = vmla_n_f32(acc, vld1_f32(x + channelCount + c), w[1]);
+      acc = vmla_n_f32(acc, vld1_f32(x + 2 * channelCount + c), w[2]);
+      acc = vmla_n_f32(acc, vld1_f32(x + 3 * channelCount + c), w[3]);
+      vst1_f32(y + c, acc);
+    }
+#endif
+    for (; c < channelCount; ++c) {
+      y[c] = w[0] * x[c]
+             + w[1] * x[channelCount + c]
+             + w[2] * x[2 * channelCount + c]
+             + w[3] * x[3 * channelCount + c];
+    }
+  }
+}
@@ -20,6 +20,7 @@
 
 
 #include <stddef.h>
+#include <stdint.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -36,6 +37,7 @@ typedef enum HowieError_t {
   HOWIE_ERROR_INVALID_OBJECT,
   HOWIE_ERROR_ENGINE_NOT_INITIALIZED,
   HOWIE_ERROR_AGAIN, // the current operation would block
+  HOWIE_ERROR_UNSUPPORTED, // not available on this device
 } HowieError;
 #define HOWIE_SUCCEEDED(result) (result == HOWIE_SUCCESS)
 
@@ -50,6 +52,14 @@ typedef enum HowieStreamState_t {
   HOWIE_STREAM_STATE_PLAYING
 } HowieStreamState;
 
+typedef enum HowieSampleFormat_t {
+  // Samples are presented in the device's native format, as described by
+  // HowieDeviceCharacteristics.
+  HOWIE_SAMPLE_FORMAT_DEVICE = 0,
+  // Samples are presented as 32 bit IEEE floats in [-1, 1).
+  HOWIE_SAMPLE_FORMAT_FLOAT,
+} HowieSampleFormat;
+
 typedef struct AudioDeviceCharacteristics_t {
   size_t version;
 
@@ -99,6 +109,95 @@ typedef struct HowieBuffer_t {
   size_t byteCount;
 } HowieBuffer;
 
+#define HOWIE_MAX_CHANNELS 8
+
+// Planar streams (see HowieStreamCreationParams::planar) pass their input
+// and output to the process callback as HowieMultiBuffers: each channel
+// is frameCount contiguous floats, starting on a 64 byte boundary. The
+// callback still receives HowieBuffer pointers; buffer.version is
+// sizeof(HowieMultiBuffer), and the pointer can be cast to one. buffer
+// spans all the channels, gaps included.
+typedef struct HowieMultiBuffer_t {
+  HowieBuffer buffer;
+  size_t channelCount;
+  size_t frameCount;
+  float *channels[HOWIE_MAX_CHANNELS];
+} HowieMultiBuffer;
+
+// Histograms in HowieStreamStatistics divide each period into this many
+// buckets. The last bucket also counts everything beyond the range of the
+// others, so the histograms cover just under two periods.
+#define HOWIE_STATISTICS_BUCKETS_PER_PERIOD 8
+#define HOWIE_STATISTICS_BUCKET_COUNT (2 * HOWIE_STATISTICS_BUCKETS_PER_PERIOD)
+
+typedef struct HowieStreamStatistics_t {
+  size_t version;
+
+  // The nominal duration of one period, in nanoseconds.
+  int64_t periodNs;
+
+  // CLOCK_MONOTONIC time at which the most recent process callback
+  // started, in nanoseconds. Zero if it has not run since the stream
+  // was last started.
+  int64_t lastCallbackTimeNs;
+
+  // Total number of process callbacks, and the longest any of them took.
+  uint64_t callbackCount;
+  int64_t maxCallbackDurationNs;
+
+  // Bucket i counts callbacks whose duration, or the interval between
+  // their start and the previous callback's start, was in
+  // [i, i + 1) * periodNs / HOWIE_STATISTICS_BUCKETS_PER_PERIOD.
+  uint32_t callbackDurationHistogram[HOWIE_STATISTICS_BUCKET_COUNT];
+  uint32_t callbackIntervalHistogram[HOWIE_STATISTICS_BUCKET_COUNT];
+
+  // Number of callbacks that came too late for the playback queue, which
+  // means the output ran dry.
+  uint32_t underrunCount;
+
+  // Number of callbacks for which no complete record buffer was ready.
+  uint32_t missedRecordBufferCount;
+
+  // Number of times a parameter sender had to wait for another sender.
+  uint32_t parameterContentionCount;
+
+  // Number of periods dropped because the capture ring was full.
+  uint32_t captureOverflowCount;
+
+  // Full duplex streams only: the rate correction currently applied to the
+  // input to keep it locked to the output, in parts per million (positive
+  // when the recorder's clock runs fast), and the number of times the
+  // input had to be realigned because the correction couldn't keep up.
+  int32_t inputDriftPpm;
+  uint32_t inputResyncCount;
+
+  // Number of reports refused because the report ring was full.
+  uint32_t reportOverflowCount;
+
+  // Number of periods the playback queue currently aims to hold, which
+  // only changes for streams with maxPlaybackBufferCount set.
+  uint32_t playbackQueueDepth;
+
+  // Number of periods that skipped the process callback because the stream
+  // was idle; see idleWhenSilent. They aren't counted in callbackCount.
+  uint64_t idlePeriodCount;
+} HowieStreamStatistics;
+
+// Largest payload a scheduled event can carry.
+#define HOWIE_EVENT_MAX_SIZE 52
+
+// An event scheduled with HowieStreamScheduleEvent(), as seen by the
+// process callback.
+typedef struct HowieEvent_t {
+  // Where the event falls in the current period, in frames from its start.
+  // Events scheduled for a time that has already passed arrive at offset 0.
+  int frameOffset;
+  // The time it was scheduled for.
+  int64_t frameTime;
+  const void *data;
+  size_t size;
+} HowieEvent;
+
 // Called by the Howie system when the device a stream is assigned to
 // is changed. This callback will always be called at least once per
 // stream, and the first call to this callback will always occur before
@@ -140,6 +239,20 @@ typedef HowieError (*HowieCleanupCallback)(
     const HowieStream *stream,
     const HowieBuffer *state );
 
+// Called by the Howie system when a command for a stream has finished:
+// creating the stream, or a change of state requested with
+// HowieStreamSetState(). state is the stream's state afterwards, and result
+// says whether the command succeeded.
+//
+// This call runs on a user thread, the one Howie runs all such commands on.
+// It is safe to call blocking operations, including memory
+// allocation/deallocation, within this function, but commands for other
+// streams wait for it, and it must not call HowieWaitForCompletion().
+typedef void (*HowieStreamCommandCallback)(
+    const HowieStream *stream,
+    HowieStreamState state,
+    HowieError result);
+
 // Create a stream
 typedef struct HowieStreamCreationParams_ {
   size_t version;
@@ -175,10 +288,179 @@ typedef struct HowieStreamCreationParams_ {
   // Initial state that the stream should be in after the creation function
   // returns.
   HowieStreamState initialState;
+
+  // Number of period-sized buffers kept in the playback queue. One buffer
+  // gives the lowest latency; each additional buffer adds one period of
+  // latency and one period of tolerance to scheduling jitter on the audio
+  // thread. Zero selects the default of one buffer.
+  size_t playbackBufferCount;
+
+  // Format of the samples presented to the process callback. For
+  // HOWIE_SAMPLE_FORMAT_FLOAT, the stream runs OpenSL in float if the
+  // platform accepts it, and otherwise converts to and from the device
+  // format around the process callback. In either case the characteristics
+  // passed to the device changed callback describe the float format.
+  HowieSampleFormat sampleFormat;
+
+  // If true, the stream doesn't get an OpenSL player of its own. Instead it
+  // is attached to an output shared by every such stream in the engine:
+  // one player, one audio thread and one wake-up per period, with the
+  // process callbacks of all attached streams called in turn and their
+  // output summed. Only HOWIE_STREAM_DIRECTION_PLAYBACK streams can share
+  // the output. The shared output uses the default playback buffer count,
+  // so playbackBufferCount is ignored.
+  bool sharedOutput;
+
+  // For streams that record: if nonzero, each period of input is also
+  // copied, after the process callback has seen it, into a ring this many
+  // periods deep. Another thread drains it with HowieStreamReadCaptured(),
+  // which keeps slow consumers such as encoders and file I/O off the audio
+  // thread. Record-only streams may then leave processCallback NULL.
+  size_t captureBufferPeriods;
+
+  // Optional; see HowieStreamCommandCallback.
+  HowieStreamCommandCallback commandCallback;
+
+  // If nonzero, the stream accepts events from HowieStreamScheduleEvent(),
+  // up to this many at a time waiting to be delivered.
+  size_t eventQueueLength;
+
+  // If both are nonzero, the process callback can send reports of
+  // sizeofReport bytes, such as meter levels or analysis frames, back to
+  // user threads through a ring of reportQueueLength slots; see
+  // HowieStreamAcquireReport() and HowieStreamReceiveReports().
+  size_t sizeofReport;
+  size_t reportQueueLength;
+
+  // Playback-only streams: if this is more than playbackBufferCount, the
+  // playback queue adapts its depth between the two. Each underrun adds a
+  // period of latency; after latencyStableWindowMs (zero selects ten
+  // seconds) without underruns or callbacks that came close to one, a
+  // period is taken away again. The depth changes at period boundaries,
+  // by queuing an extra period of silence or skipping a callback, without
+  // recreating the player.
+  size_t maxPlaybackBufferCount;
+  int latencyStableWindowMs;
+
+  // If true, the stream isn't connected to a device. Its periods only run
+  // when the app calls HowieStreamRender(), on the calling thread and as
+  // fast as the process callback allows, so the same callbacks can bounce
+  // audio to a file or run under test. The callbacks see the device's
+  // characteristics, or float samples if sampleFormat asks for them, just
+  // as they would on a device. The stream is ready, and the command
+  // callback has run, by the time HowieStreamCreate() returns; its state
+  // has no effect. Offline streams can't use the shared output.
+  bool offline;
+
+  // Playback streams in HOWIE_SAMPLE_FORMAT_FLOAT only: the rate, from
+  // 8 kHz to 192 kHz and at most four times the device's, that the
+  // process callback renders at. Zero, or the device's own rate, runs the
+  // callback at the device rate. Otherwise Howie resamples the output, so
+  // the device stays on its fast path. The callbacks then see this rate,
+  // frame times count frames at it, and each callback renders however
+  // many frames the next device period takes, which varies by a frame or
+  // so from one to the next: out->byteCount says how many, and the
+  // characteristics give the most it can be as framesPerPeriod. Offline
+  // streams can't be resampled.
+  int sampleRate;
+
+  // HOWIE_SAMPLE_FORMAT_FLOAT streams with up to HOWIE_MAX_CHANNELS
+  // channels only: deliver the process callback's input and output one
+  // channel at a time, as HowieMultiBuffers, rather than interleaved.
+  // Howie deinterleaves the input and interleaves the output around the
+  // callback. Capture and the shared output still see interleaved frames.
+  bool planar;
+
+  // If true, the stream can go idle while it has nothing to play: idle
+  // periods output silence without calling the process callback, which
+  // saves its work without stopping the device. The stream goes idle after
+  // a callback that calls HowieStreamSetIdle(), or after idleSilentPeriods
+  // periods in a row of silent input and output (zero leaves it to the
+  // callback). Integer samples are silent when they're zero, and float
+  // samples when none exceeds idleThreshold in magnitude. The callback runs
+  // again from the first period in which a parameter block or patch
+  // arrives, an event falls due, the input isn't silent, or the stream is
+  // started. Frame time runs on while the stream is idle.
+  bool idleWhenSilent;
+  size_t idleSilentPeriods;
+  float idleThreshold;
 } HowieStreamCreationParams;
 
 HowieError HowieGetDeviceCharacteristics(HowieDeviceCharacteristics *dest);
 
+// Opts in to running the process callbacks of streams that share the output
+// (see HowieStreamCreationParams::sharedOutput) in parallel. threadCount
+// extra threads, running at the same priority as the audio thread, share
+// the work each period with the audio thread itself. Zero, the default,
+// runs every callback on the audio thread. Takes effect asynchronously.
+HowieError HowieSetSharedOutputThreadCount(int threadCount);
+
+typedef struct HowieStreamPoolParams_t {
+  size_t version;
+
+  // Number of idle OpenSL players and recorders to keep realized. A full
+  // duplex stream takes one of each.
+  size_t playerCount;
+  size_t recorderCount;
+
+  // Pooled objects only serve streams created with the same sample format
+  // and playback buffer count as these.
+  HowieSampleFormat sampleFormat;
+  size_t playbackBufferCount;
+} HowieStreamPoolParams;
+
+// Keeps OpenSL players and recorders realized ahead of time, so that
+// HowieStreamCreate can hand one out instead of spending tens of
+// milliseconds creating it. Destroyed streams give their objects back
+// while the pool is below the configured size. Shared output streams have
+// no player of their own and don't use the pool.
+//
+// Each pooled player holds an AudioTrack, and usually one of the few fast
+// tracks, so keep the counts small. Recorders need the RECORD_AUDIO
+// permission. Counts of zero, the default, empty the pool. Takes effect
+// asynchronously.
+//
+// Only streams on OpenSL use the pool. Where Howie opens streams on AAudio
+// instead, from Android 8.1 on, this returns HOWIE_ERROR_UNSUPPORTED and
+// keeps no pool, whose players would hold fast tracks the AAudio streams
+// need.
+HowieError HowieConfigureStreamPool(const HowieStreamPoolParams *params);
+
+typedef struct HowieAudioThreadParams_t {
+  size_t version;
+
+  // Restrict each stream's audio thread to the CPUs with the highest
+  // maximum clock, so that the callback can't be scheduled onto a little
+  // core. The shared output's pool threads are pinned among the same CPUs.
+  // Has no effect on devices whose cores are all the same.
+  bool pinToPerformanceCores;
+
+  // Open an APerformanceHint session for each stream's audio thread, and
+  // the shared output's pool threads, targeting one period, and report how
+  // long the process callback actually took after every period. This lets
+  // the CPU governor raise clocks before the callback runs out of time.
+  // Needs API 33; ignored on older devices.
+  bool usePerformanceHint;
+} HowieAudioThreadParams;
+
+// Sets how the audio threads of streams opened from now on are scheduled.
+// Streams that already exist keep their settings. Both options are off by
+// default. Takes effect asynchronously.
+HowieError HowieConfigureAudioThreads(const HowieAudioThreadParams *params);
+
+typedef enum HowieTraceBackend_t {
+  HOWIE_TRACE_BACKEND_NONE = 0,
+  // Systrace/Perfetto sections for Howie's internal calls, including the
+  // audio callback, plus counters for the callback budget and buffer queue
+  // depths (counters need API 29).
+  HOWIE_TRACE_BACKEND_ATRACE,
+} HowieTraceBackend;
+
+// Selects where Howie sends its trace points. This can be called at any
+// time, including before HowieEngine is initialized. Returns
+// HOWIE_ERROR_UNSUPPORTED if the backend isn't available on this device.
+HowieError HowieSetTraceBackend(HowieTraceBackend backend);
+
 HowieError HowieStreamCreate(
     const HowieStreamCreationParams *params,
     HowieStream **out_stream);
@@ -190,19 +472,295 @@ HowieError HowieStreamDestroy(HowieStream *stream);
 HowieError HowieStreamSetState(HowieStream *stream, HowieStreamState newState);
 HowieError HowieStreamGetState(HowieStream *stream, HowieStreamState *state);
 
+// Changes the state of count streams in a single request, so that they
+// start or stop together. Either every change is queued or none is.
+HowieError HowieStreamSetStates(HowieStream *const *streams,
+                                const HowieStreamState *states,
+                                size_t count);
+
+// Offline streams only: runs frameCount frames, which must be a whole
+// number of periods, through the process callback one period at a time on
+// the calling thread. For streams that record, in holds the input; for
+// streams that play, out receives the output. Each must have room for
+// frameCount frames, and the other may be NULL. Parameters, events and
+// reports behave as they do on a device, with the period boundaries
+// falling at every framesPerPeriod frames rendered. Only one thread may
+// render a stream at a time. Returns the first error from the process
+// callback, if any, after which the remaining periods aren't rendered.
+HowieError HowieStreamRender(HowieStream *stream,
+                             size_t frameCount,
+                             const HowieBuffer *in,
+                             const HowieBuffer *out);
+
+// Stream creation, destruction and state changes run in order on a worker
+// thread, so the calls above return before they take effect. A completion
+// token stands for everything requested so far, from any thread, and
+// HowieWaitForCompletion() blocks until all of it has finished. It returns
+// HOWIE_ERROR_AGAIN on timeout; a negative timeout waits forever.
+typedef uint64_t HowieCompletionToken;
+HowieError HowieGetCompletionToken(HowieCompletionToken *token);
+HowieError HowieWaitForCompletion(HowieCompletionToken token, int timeoutMs);
+
+// Copies the stream's callback timing and glitch counters into *dest. The
+// counters are maintained all the time, without locking or allocating on
+// the audio thread.
+HowieError HowieStreamGetStatistics(
+    HowieStream *stream,
+    HowieStreamStatistics *dest);
+
+// Copies up to size bytes of captured input into dest, and sets *bytesRead
+// to the amount copied, which is always a whole number of frames. Waits up
+// to timeoutMs for input if none is ready (zero doesn't wait; negative
+// waits until input arrives or the stream stops), then returns
+// HOWIE_ERROR_AGAIN if there still isn't any. Only one thread may read
+// from a stream at a time, and the stream must have been created with
+// captureBufferPeriods.
+HowieError HowieStreamReadCaptured(
+    HowieStream *stream,
+    void *dest,
+    size_t size,
+    size_t *bytesRead,
+    int timeoutMs);
+
+// A stream's frame time is the number of frames its process callback has
+// been called for since the stream was created. It stands still while the
+// stream is stopped. This returns the frame time at the start of the next
+// period to be processed.
+HowieError HowieStreamGetFrameTime(HowieStream *stream, int64_t *frameTime);
+
+// Queues an event of up to HOWIE_EVENT_MAX_SIZE bytes for the process
+// callback, to take effect at the given frame time. Unlike parameter
+// blocks, events don't have to wait for a period boundary: the callback
+// sees each event in the period it falls in, along with its offset into
+// that period, and can split its work at that point. Any thread may call
+// this. Returns HOWIE_ERROR_AGAIN if the queue is full.
+HowieError HowieStreamScheduleEvent(HowieStream *stream,
+                                    int64_t frameTime,
+                                    const void *data,
+                                    size_t size);
+
+// Only for use within the process callback: the events that fall in the
+// current period, ordered by frame time (events for the same frame keep
+// the order they were scheduled in). They remain valid until the callback
+// returns.
+HowieError HowieStreamGetEvents(const HowieStream *stream,
+                                const HowieEvent **events,
+                                size_t *count);
+
+// Only for use within the process callback: sets *report to a writable
+// slot of sizeofReport bytes, to be filled in and passed to
+// HowieStreamCommitReport() before the callback returns. The slot's
+// previous contents are an older report. Returns HOWIE_ERROR_AGAIN, and
+// counts an overflow, if user threads have let every slot fill up.
+HowieError HowieStreamAcquireReport(const HowieStream *stream, void **report);
+
+// Only for use within the process callback: publishes the slot returned by
+// HowieStreamAcquireReport().
+HowieError HowieStreamCommitReport(const HowieStream *stream,
+                                   const void *report);
+
+// Only for use within the process callback, for streams created with
+// idleWhenSilent: the output this callback returns is the last until
+// something wakes the stream, so it should end in silence. Returns
+// HOWIE_ERROR_INVALID_PARAMETER for streams that can't go idle.
+HowieError HowieStreamSetIdle(const HowieStream *stream);
+
+// Copies as many of the oldest published reports as fit into size bytes,
+// back to back, into dest, and sets *reportCount to the number copied.
+// Never waits; returns HOWIE_ERROR_AGAIN if there are none. Only one thread
+// may receive from a stream at a time, and the stream must have been
+// created with sizeofReport and reportQueueLength.
+HowieError HowieStreamReceiveReports(HowieStream *stream,
+                                     void *dest,
+                                     size_t size,
+                                     size_t *reportCount);
+
 // Enqueues a parameter block for the next processing cycle. The stream
 // guarantees that the parameter block will be available to the process
 // callback at the beginning of the next processing cycle. It also guarantees
 // thread safety for the parameter block. If the processing cycle is currently
 // running, the new parameter block will not become visible to the audio
 // thread until the current cycle finishes and a new cycle begins.
+//
+// The audio thread never waits for this call. Concurrent senders on the
+// same stream wait for each other for up to timeoutMs; if the wait times
+// out, HOWIE_ERROR_AGAIN is returned and the block is not sent.
 HowieError HowieStreamSendParameters(
     HowieStream* stream,
     const void *parameters,
     size_t size,
     int timeoutMs);
 
+// Enqueues a change to part of the parameter block: size bytes at the given
+// byte offset are overwritten with the contents of data. Patches are applied
+// in the order they were sent, at the beginning of the next processing
+// cycle, on top of the most recent full parameter block. A full block sent
+// with HowieStreamSendParameters replaces every patch sent before it.
+//
+// Returns HOWIE_ERROR_INVALID_PARAMETER if the range falls outside the
+// parameter block, and HOWIE_ERROR_AGAIN if the patch queue is full or
+// another sender held the stream for longer than timeoutMs.
+HowieError HowieStreamPatchParameters(
+    HowieStream *stream,
+    size_t offset,
+    const void *data,
+    size_t size,
+    int timeoutMs);
+
+// Acquires the stream's writable parameter slot, so that a parameter block
+// can be built in place instead of being copied by
+// HowieStreamSendParameters. On success *slot points at
+// sizeofParameterBlock bytes owned by the caller until the slot is passed to
+// HowieStreamCommitParameters. The slot holds an older parameter block, so
+// the caller should overwrite all of it.
+//
+// Only one slot per stream can be outstanding. If another thread holds it
+// for longer than timeoutMs, HOWIE_ERROR_AGAIN is returned.
+HowieError HowieStreamAcquireParameterSlot(
+    HowieStream *stream,
+    void **slot,
+    size_t *size,
+    int timeoutMs);
+
+// Publishes a slot obtained from HowieStreamAcquireParameterSlot. The audio
+// thread picks up the slot itself at the start of its next processing cycle,
+// without copying it.
+HowieError HowieStreamCommitParameters(
+    HowieStream *stream,
+    void *slot);
+
+// A streaming source plays long sample data from storage without loading
+// it into memory. A thread of the source's own reads ahead of the process
+// callback into a ring, and the process callback takes frames out of the
+// ring with HowieSourceRead(), which never does I/O, never blocks and
+// never allocates.
+typedef struct HowieSource_t {
+  size_t version;
+} HowieSource;
+
+typedef struct HowieSourceParams_t {
+  size_t version;
+
+  // The sample data is length bytes starting at offset in fd, which the
+  // source dups, so the caller can close its own copy. For an asset, use
+  // AAsset_openFileDescriptor64(); it only works for assets stored
+  // uncompressed. For a WAV file, point offset and length at the data
+  // chunk. The source delivers the bytes as they are, so they must
+  // already be in the format the process callback works in.
+  int fd;
+  int64_t offset;
+  int64_t length;
+  size_t bytesPerFrame;
+
+  // How many frames the ring holds. Zero selects 32768. It should cover
+  // the longest stall storage is likely to have.
+  size_t prefetchFrames;
+
+  // Once created, and after a seek, HowieSourceRead() delivers nothing
+  // until this many frames are ready, or the end of the data is, so that
+  // playback starts with a cushion. Zero selects a quarter of the ring.
+  size_t seekPrefetchFrames;
+
+  // Map the data instead of reading it. The prefetch thread still copies
+  // it into the ring, so page faults happen there rather than on the
+  // audio thread. Falls back to reading if the data can't be mapped.
+  bool useMmap;
+} HowieSourceParams;
+
+typedef struct HowieSourceStatus_t {
+  size_t version;
+
+  // The next frame HowieSourceRead() will deliver, and the number of
+  // frames in the data.
+  int64_t position;
+  int64_t frameCount;
+
+  // Reads that came up short because the prefetch thread fell behind.
+  // Reads during a seek, and at the end of the data, aren't counted.
+  uint32_t underrunCount;
+
+  // Set once a read has hit the end of the data, until the next seek.
+  bool endOfSource;
+
+  // Set if reading from storage failed. The source then behaves as if
+  // the data ended there.
+  bool ioError;
+} HowieSourceStatus;
+
+HowieError HowieSourceCreate(const HowieSourceParams *params,
+                             HowieSource **source);
+
+// Stops the prefetch thread and closes the data. The process callback
+// must have stopped reading from the source first.
+HowieError HowieSourceDestroy(HowieSource *source);
 
+// Process callback only, from one stream at a time. Copies up to
+// frameCount frames into dest and sets *framesRead to the number copied.
+// The rest of dest is filled with zeros. Returns HOWIE_ERROR_AGAIN if it
+// couldn't deliver all frameCount frames: the prefetch thread fell
+// behind, a seek is still filling the ring, or the data has ended.
+HowieError HowieSourceRead(HowieSource *source,
+                           void *dest,
+                           size_t frameCount,
+                           size_t *framesRead);
+
+// Starts reading from frame instead, from any thread. Reads return silence
+// until the prefetch window after frame has been read in.
+HowieError HowieSourceSeek(HowieSource *source, int64_t frame);
+
+HowieError HowieSourceGetStatus(const HowieSource *source,
+                                HowieSourceStatus *status);
+
+
+
+typedef struct HowieLatencyBenchmarkParams_t {
+  size_t version;
+
+  // How long to measure for. Zero selects ten seconds.
+  int durationMs;
+
+  // Time between test pulses, which is also the longest round trip that
+  // can be measured. Zero selects 500ms.
+  int pulseIntervalMs;
+
+  // Peak level of the test pulses. Zero selects 0.5.
+  float amplitude;
+
+  // Passed through to HowieStreamCreationParams.
+  size_t playbackBufferCount;
+} HowieLatencyBenchmarkParams;
+
+typedef struct HowieLatencyBenchmarkResult_t {
+  size_t version;
+
+  // Number of test pulses sent, and the number found in the input.
+  int pulseCount;
+  int detectedCount;
+
+  // Round trip latency from the output buffer to the input buffer as seen
+  // by a process callback, over every detected pulse.
+  float minLatencyMs;
+  float meanLatencyMs;
+  float maxLatencyMs;
+  // Standard deviation of the latency.
+  float jitterMs;
+
+  // Glitches during the run, as counted by HowieStreamStatistics.
+  uint32_t underrunCount;
+  uint32_t missedRecordBufferCount;
+  uint32_t inputResyncCount;
+} HowieLatencyBenchmarkResult;
+
+// Measures the round trip latency of a full duplex stream on this device.
+// It plays a maximum length sequence pulse from the output at regular
+// intervals and locates each pulse in the input by cross-correlation. The
+// device needs a path from speaker to microphone, or a loopback plug.
+//
+// This blocks the calling thread for the length of the run, so don't call
+// it from the UI thread. The app needs the RECORD_AUDIO permission.
+HowieError HowieRunLatencyBenchmark(
+    const HowieLatencyBenchmarkParams *params,
+    HowieLatencyBenchmarkResult *result);
 
 #ifdef __cplusplus
 } // extern "C"
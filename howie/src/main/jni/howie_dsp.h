@@ -0,0 +1,130 @@
+/*
+ * Copyright 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#pragma once
+#ifndef HOWIE_DSP_H
+#define HOWIE_DSP_H
+
+// Sample processing kernels for use in process callbacks. None of these
+// functions allocate, lock or block, so all of them are safe to call on
+// the audio thread. Each has a NEON implementation on arm64 (and on
+// armeabi-v7a when built with -mfpu=neon) and a scalar fallback elsewhere.
+//
+// Float samples are nominally in [-1, 1). Integer samples are signed and
+// full scale, so 1.0f corresponds to 2^15 for int16, 2^23 for int24 and
+// 2^31 for int32. Conversions to integer formats saturate.
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#else
+#include <stdbool.h>
+#endif // CPLUSPLUS
+
+//
+// Format conversion. count is the number of samples, not bytes. int24
+// samples are packed, three bytes each, little endian.
+//
+void HowieDspInt16ToFloat(const int16_t *src, float *dest, size_t count);
+void HowieDspFloatToInt16(const float *src, int16_t *dest, size_t count);
+void HowieDspInt24ToFloat(const uint8_t *src, float *dest, size_t count);
+void HowieDspFloatToInt24(const float *src, uint8_t *dest, size_t count);
+void HowieDspInt32ToFloat(const int32_t *src, float *dest, size_t count);
+void HowieDspFloatToInt32(const float *src, int32_t *dest, size_t count);
+
+//
+// Gain and mixing. src and dest may be the same buffer.
+//
+
+// dest[i] = clamp(src[i] * gain, -1, 1)
+void HowieDspGain(const float *src, float *dest, float gain, size_t count);
+
+// dest[i] += src[i] * gain
+void HowieDspMixAccumulate(const float *src,
+                           float *dest,
+                           float gain,
+                           size_t count);
+
+//
+// Levels.
+//
+
+// Returns the largest magnitude of any sample, or zero if count is zero.
+float HowieDspPeak(const float *src, size_t count);
+
+// Returns true if every byte is zero: digital silence, in any integer
+// format. Float buffers can hold negative zeros, so use HowieDspPeak().
+bool HowieDspIsZero(const void *data, size_t byteCount);
+
+//
+// Channel layout. src and dest must not overlap. channels[c] points at
+// frameCount samples for channel c.
+//
+void HowieDspInterleave(const float * const *channels,
+                        float *dest,
+                        size_t channelCount,
+                        size_t frameCount);
+void HowieDspDeinterleave(const float *src,
+                          float * const *channels,
+                          size_t channelCount,
+                          size_t frameCount);
+
+//
+// Resampling.
+//
+
+// Reads interleaved frames from src at positions phase, phase + step,
+// phase + 2 * step and so on, measured in frames from src[0], and writes
+// frameCount interpolated frames to dest. Cubic (Catmull-Rom)
+// interpolation uses the frame before and the two frames after each
+// position, so phase must be at least 1 and src must extend to frame
+// floor(phase + (frameCount - 1) * step) + 2. Intended for small, slowly
+// varying rate corrections, such as clock drift.
+void HowieDspResampleCubic(const float *src,
+                           float *dest,
+                           size_t channelCount,
+                           size_t frameCount,
+                           double phase,
+                           double step);
+
+//
+// Filtering.
+//
+
+// Returns the sum of a[i] * b[i]: one output of an FIR filter, with a
+// holding the taps and b the input under them.
+float HowieDspDotProduct(const float *a, const float *b, size_t count);
+
+//
+// Denormals.
+//
+
+// Replaces every denormal sample in the buffer with zero.
+void HowieDspFlushDenormals(float *buffer, size_t count);
+
+// Enables or disables flush-to-zero mode for the calling thread's floating
+// point unit, and returns the previous setting. Call this at the start of
+// the process callback to keep decaying filters and reverbs out of the
+// slow denormal path.
+bool HowieDspSetFlushToZero(bool enable);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif // CPLUSPLUS
+
+#endif //HOWIE_DSP_H
@@ -0,0 +1,472 @@
+/*
+ * Copyright 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#include "AAudioBackend.h"
+#include "howie-private.h"
+#include "RealtimeLog.h"
+#include "StreamStatistics.h"
+#include <dlfcn.h>
+#include <mutex>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/system_properties.h>
+
+namespace {
+  // From <aaudio/AAudio.h>, which the NDK only has from API 26 on.
+  typedef struct AAudioStreamBuilderStruct AAudioStreamBuilder;
+  typedef int32_t aaudio_result_t;
+  typedef int32_t (*DataCallback)(AAudioStream *, void *, void *, int32_t);
+  typedef void (*ErrorCallback)(AAudioStream *, void *, aaudio_result_t);
+
+  constexpr aaudio_result_t AAUDIO_OK = 0;
+  constexpr int32_t AAUDIO_DIRECTION_OUTPUT = 0;
+  constexpr int32_t AAUDIO_DIRECTION_INPUT = 1;
+  constexpr int32_t AAUDIO_FORMAT_PCM_I16 = 1;
+  constexpr int32_t AAUDIO_FORMAT_PCM_FLOAT = 2;
+  constexpr int32_t AAUDIO_SHARING_MODE_EXCLUSIVE = 0;
+  constexpr int32_t AAUDIO_PERFORMANCE_MODE_LOW_LATENCY = 12;
+  constexpr int32_t AAUDIO_CALLBACK_RESULT_CONTINUE = 0;
+  constexpr int32_t AAUDIO_CALLBACK_RESULT_STOP = 1;
+  constexpr int32_t AAUDIO_STREAM_STATE_STOPPING = 9;
+  constexpr int32_t AAUDIO_STREAM_STATE_STOPPED = 10;
+
+  // AAudio went in with API 26, but the MMAP path and most of the low
+  // latency fixes came with 27.
+  constexpr int kMinApiLevel = 27;
+
+  // Long enough for any device to stop a stream.
+  constexpr int64_t kStopTimeoutNs = 2000000000LL;
+
+  int apiLevel() {
+    char value[PROP_VALUE_MAX] = {};
+    __system_property_get("ro.build.version.sdk", value);
+    return atoi(value);
+  }
+} // namespace
+
+namespace howie {
+
+  struct AAudioBackend::Api {
+    aaudio_result_t (*createStreamBuilder)(AAudioStreamBuilder **);
+    void (*setDirection)(AAudioStreamBuilder *, int32_t);
+    void (*setSampleRate)(AAudioStreamBuilder *, int32_t);
+    void (*setChannelCount)(AAudioStreamBuilder *, int32_t);
+    void (*setFormat)(AAudioStreamBuilder *, int32_t);
+    void (*setSharingMode)(AAudioStreamBuilder *, int32_t);
+    void (*setPerformanceMode)(AAudioStreamBuilder *, int32_t);
+    void (*setFramesPerDataCallback)(AAudioStreamBuilder *, int32_t);
+    void (*setDataCallback)(AAudioStreamBuilder *, DataCallback, void *);
+    void (*setErrorCallback)(AAudioStreamBuilder *, ErrorCallback, void *);
+    aaudio_result_t (*openStream)(AAudioStreamBuilder *, AAudioStream **);
+    aaudio_result_t (*deleteBuilder)(AAudioStreamBuilder *);
+
+    aaudio_result_t (*requestStart)(AAudioStream *);
+    aaudio_result_t (*requestStop)(AAudioStream *);
+    aaudio_result_t (*waitForStateChange)(AAudioStream *, int32_t, int32_t *,
+                                          int64_t);
+    aaudio_result_t (*close)(AAudioStream *);
+    int32_t (*getSampleRate)(AAudioStream *);
+    int32_t (*getChannelCount)(AAudioStream *);
+    int32_t (*getFormat)(AAudioStream *);
+    int32_t (*getSharingMode)(AAudioStream *);
+    int32_t (*getPerformanceMode)(AAudioStream *);
+    int32_t (*getFramesPerBurst)(AAudioStream *);
+    int32_t (*getBufferCapacityInFrames)(AAudioStream *);
+    aaudio_result_t (*setBufferSizeInFrames)(AAudioStream *, int32_t);
+    int32_t (*getXRunCount)(AAudioStream *);
+    aaudio_result_t (*read)(AAudioStream *, void *, int32_t, int64_t);
+    const char *(*convertResultToText)(aaudio_result_t);
+  };
+
+  const AAudioBackend::Api *AAudioBackend::api_ = nullptr;
+
+  /**
+   * Look up the AAudio entry points. libaaudio is never closed, so the
+   * pointers stay valid for the life of the process once they're set.
+   */
+  bool AAudioBackend::available() {
+    static std::once_flag once;
+    std::call_once(once, [] {
+      if (apiLevel() < kMinApiLevel) {
+        return;
+      }
+      void *lib = dlopen("libaaudio.so", RTLD_NOW | RTLD_LOCAL);
+      if (!lib) {
+        __android_log_print(ANDROID_LOG_WARN, kLibName,
+                            "AAudio unavailable: %s", dlerror());
+        return;
+      }
+
+      static Api api;
+      bool complete = true;
+      auto bind = [&](const char *symbol, void *fn) {
+        void *address = dlsym(lib, symbol);
+        complete = complete && address;
+        memcpy(fn, &address, sizeof(address));
+      };
+      bind("AAudio_createStreamBuilder", &api.createStreamBuilder);
+      bind("AAudioStreamBuilder_setDirection", &api.setDirection);
+      bind("AAudioStreamBuilder_setSampleRate", &api.setSampleRate);
+      bind("AAudioStreamBuilder_setChannelCount", &api.setChannelCount);
+      bind("AAudioStreamBuilder_setFormat", &api.setFormat);
+      bind("AAudioStreamBuilder_setSharingMode", &api.setSharingMode);
+      bind("AAudioStreamBuilder_setPerformanceMode", &api.setPerformanceMode);
+      bind("AAudioStreamBuilder_setFramesPerDataCallback",
+           &api.setFramesPerDataCallback);
+      bind("AAudioStreamBuilder_setDataCallback", &api.setDataCallback);
+      bind("AAudioStreamBuilder_setErrorCallback", &api.setErrorCallback);
+      bind("AAudioStreamBuilder_openStream", &api.openStream);
+      bind("AAudioStreamBuilder_delete", &api.deleteBuilder);
+      bind("AAudioStream_requestStart", &api.requestStart);
+      bind("AAudioStream_requestStop", &api.requestStop);
+      bind("AAudioStream_waitForStateChange", &api.waitForStateChange);
+      bind("AAudioStream_close", &api.close);
+      bind("AAudioStream_getSampleRate", &api.getSampleRate);
+      bind("AAudioStream_getChannelCount", &api.getChannelCount);
+      bind("AAudioStream_getFormat", &api.getFormat);
+      bind("AAudioStream_getSharingMode", &api.getSharingMode);
+      bind("AAudioStream_getPerformanceMode", &api.getPerformanceMode);
+      bind("AAudioStream_getFramesPerBurst", &api.getFramesPerBurst);
+      bind("AAudioStream_getBufferCapacityInFrames",
+           &api.getBufferCapacityInFrames);
+      bind("AAudioStream_setBufferSizeInFrames", &api.setBufferSizeInFrames);
+      bind("AAudioStream_getXRunCount", &api.getXRunCount);
+      bind("AAudioStream_read", &api.read);
+      bind("AAudio_convertResultToText", &api.convertResultToText);
+      if (complete) {
+        api_ = &api;
+      } else {
+        __android_log_write(ANDROID_LOG_WARN, kLibName,
+                            "AAudio is missing entry points");
+      }
+    });
+    return api_ != nullptr;
+  }
+
+  AAudioBackend::~AAudioBackend() {
+    HOWIE_TRACE_FN(HOWIE_TRACE_LEVEL_CALLS)
+    closeStream(&output_);
+    closeStream(&input_);
+  }
+
+  HowieError AAudioBackend::open(const Config &config,
+                                 Client *client,
+                                 HowieDeviceCharacteristics *characteristics) {
+    HOWIE_TRACE_FN(HOWIE_TRACE_LEVEL_CALLS)
+    HOWIE_CHECK_NOT_NULL(client);
+    HOWIE_CHECK_NOT_NULL(characteristics);
+    if (!available()) {
+      return HOWIE_ERROR_UNSUPPORTED;
+    }
+
+    // AAudio converts to and from the device format itself, but only
+    // offers 16 bit and float.
+    bool floatSamples = config.sampleFormat == HOWIE_SAMPLE_FORMAT_FLOAT;
+    if (!floatSamples && characteristics->bytesPerSample != sizeof(int16_t)) {
+      return HOWIE_ERROR_UNSUPPORTED;
+    }
+
+    client_ = client;
+    stats_ = &client->statistics();
+    log_ = &client->realtimeLog();
+    direction_ = config.direction;
+    framesPerPeriod_ = characteristics->framesPerPeriod;
+    bytesPerFrame_ = (floatSamples ? sizeof(float) : sizeof(int16_t))
+                     * characteristics->samplesPerFrame;
+
+    if (direction_ & HOWIE_STREAM_DIRECTION_PLAYBACK) {
+      HOWIE_CHECK(openStream(true, *characteristics, floatSamples, true,
+                             &output_));
+    }
+    if (direction_ & HOWIE_STREAM_DIRECTION_RECORD) {
+      // A full duplex stream pulls its input from the output's callback.
+      bool duplex = direction_ == HOWIE_STREAM_DIRECTION_BOTH;
+      HOWIE_CHECK(openStream(false, *characteristics, floatSamples, !duplex,
+                             &input_));
+      if (duplex) {
+        client_->useBuffer(&inputBuffer_, kInputBuffer,
+                           bytesPerFrame_ * framesPerPeriod_);
+      }
+    }
+
+    if (output_) {
+      if (config.maxPlaybackBufferCount > config.playbackBufferCount) {
+        latency_.reset(new LatencyController(
+            config.playbackBufferCount, config.maxPlaybackBufferCount,
+            periodNs(*characteristics),
+            static_cast<int64_t>(config.latencyStableWindowMs) * 1000000));
+      }
+      setBufferPeriods(config.playbackBufferCount);
+    }
+    stats_->configure(periodNs(*characteristics),
+                      output_ ? config.playbackBufferCount : 1);
+
+    if (floatSamples) {
+      useFloatCharacteristics(characteristics);
+    }
+    return HOWIE_SUCCESS;
+  }
+
+  /**
+   * Open one AAudio stream in the device's rate and channel count. AAudio
+   * can resample and remix, but that would cost latency and change what
+   * the app was told, so anything else is refused.
+   */
+  HowieError AAudioBackend::openStream(bool output,
+                                       const HowieDeviceCharacteristics &device,
+                                       bool floatSamples,
+                                       bool dataCallback,
+                                       AAudioStream **stream) {
+    HOWIE_TRACE_FN(HOWIE_TRACE_LEVEL_CALLS)
+    AAudioStreamBuilder *builder = nullptr;
+    aaudio_result_t result = api_->createStreamBuilder(&builder);
+    if (result != AAUDIO_OK) {
+      return HOWIE_ERROR_UNKNOWN;
+    }
+
+    int32_t format = floatSamples ? AAUDIO_FORMAT_PCM_FLOAT
+                                  : AAUDIO_FORMAT_PCM_I16;
+    api_->setDirection(builder, output ? AAUDIO_DIRECTION_OUTPUT
+                                       : AAUDIO_DIRECTION_INPUT);
+    api_->setSampleRate(builder, device.sampleRate);
+    api_->setChannelCount(builder, device.samplesPerFrame);
+    api_->setFormat(builder, format);
+    api_->setSharingMode(builder, AAUDIO_SHARING_MODE_EXCLUSIVE);
+    api_->setPerformanceMode(builder, AAUDIO_PERFORMANCE_MODE_LOW_LATENCY);
+    api_->setErrorCallback(builder, errorCallback, this);
+    if (dataCallback) {
+      api_->setFramesPerDataCallback(builder, device.framesPerPeriod);
+      api_->setDataCallback(builder, AAudioBackend::dataCallback, this);
+    }
+    result = api_->openStream(builder, stream);
+    api_->deleteBuilder(builder);
+    if (result != AAUDIO_OK) {
+      __android_log_print(ANDROID_LOG_INFO, kLibName,
+                          "AAudio %s stream failed to open: %s",
+                          output ? "output" : "input",
+                          api_->convertResultToText(result));
+      *stream = nullptr;
+      return HOWIE_ERROR_IO;
+    }
+
+    if (api_->getSampleRate(*stream) != device.sampleRate
+        || api_->getChannelCount(*stream) != device.samplesPerFrame
+        || api_->getFormat(*stream) != format) {
+      __android_log_print(ANDROID_LOG_INFO, kLibName,
+                          "AAudio %s stream opened at %d Hz, %d channels",
+                          output ? "output" : "input",
+                          api_->getSampleRate(*stream),
+                          api_->getChannelCount(*stream));
+      closeStream(stream);
+      return HOWIE_ERROR_UNSUPPORTED;
+    }
+
+    __android_log_print(ANDROID_LOG_INFO, kLibName,
+                        "AAudio %s stream: %s, performance mode %d, "
+                        "burst %d frames",
+                        output ? "output" : "input",
+                        api_->getSharingMode(*stream)
+                        == AAUDIO_SHARING_MODE_EXCLUSIVE
+                        ? "exclusive" : "shared",
+                        api_->getPerformanceMode(*stream),
+                        api_->getFramesPerBurst(*stream));
+    return HOWIE_SUCCESS;
+  }
+
+  void AAudioBackend::closeStream(AAudioStream **stream) {
+    if (*stream) {
+      // Closing a running stream is undefined, so stop it, which also
+      // waits for its callback to return.
+      stopStream(*stream);
+      api_->close(*stream);
+      *stream = nullptr;
+    }
+  }
+
+  /**
+   * Stop a stream and wait until it has. AAudio stops asynchronously, and
+   * the data callback can run until then.
+   */
+  HowieError AAudioBackend::stopStream(AAudioStream *stream) {
+    if (api_->requestStop(stream) != AAUDIO_OK) {
+      return HOWIE_ERROR_IO;
+    }
+    int32_t state = AAUDIO_STREAM_STATE_STOPPING;
+    while (state == AAUDIO_STREAM_STATE_STOPPING) {
+      if (api_->waitForStateChange(stream, state, &state, kStopTimeoutNs)
+          != AAUDIO_OK) {
+        return HOWIE_ERROR_IO;
+      }
+    }
+    return state == AAUDIO_STREAM_STATE_STOPPED ? HOWIE_SUCCESS
+                                                : HOWIE_ERROR_IO;
+  }
+
+  /**
+   * Set how much of the output's buffer AAudio keeps full, in periods.
+   * This is AAudio's equivalent of the number of buffers queued to an
+   * OpenSL player, and can be changed while the stream runs.
+   */
+  void AAudioBackend::setBufferPeriods(unsigned int periods) {
+    int32_t frames = static_cast<int32_t>(periods) * framesPerPeriod_;
+    int32_t capacity = api_->getBufferCapacityInFrames(output_);
+    if (capacity > 0 && frames > capacity) {
+      frames = capacity;
+    }
+    api_->setBufferSizeInFrames(output_, frames);
+    bufferPeriods_ = periods;
+  }
+
+  HowieError AAudioBackend::start() {
+    HOWIE_TRACE_FN(HOWIE_TRACE_LEVEL_CALLS)
+    if (input_) {
+      // Start the input first, so a full duplex stream's first period has
+      // something to read.
+      drainInput_ = output_ != nullptr;
+      if (api_->requestStart(input_) != AAUDIO_OK) {
+        return HOWIE_ERROR_IO;
+      }
+    }
+    if (output_ && api_->requestStart(output_) != AAUDIO_OK) {
+      return HOWIE_ERROR_IO;
+    }
+    return HOWIE_SUCCESS;
+  }
+
+  HowieError AAudioBackend::stop() {
+    HOWIE_TRACE_FN(HOWIE_TRACE_LEVEL_CALLS)
+    if (output_) {
+      HOWIE_CHECK(stopStream(output_));
+    }
+    if (input_) {
+      HOWIE_CHECK(stopStream(input_));
+    }
+    return HOWIE_SUCCESS;
+  }
+
+  void AAudioBackend::getStatistics(HowieStreamStatistics *dest) const {
+    dest->inputDriftPpm = 0;
+    dest->inputResyncCount = 0;
+    dest->playbackQueueDepth = output_ ? bufferPeriods_ : 0;
+  }
+
+  int32_t AAudioBackend::dataCallback(AAudioStream * /* stream */,
+                                      void *userData,
+                                      void *audioData,
+                                      int32_t numFrames) {
+    HOWIE_TRACE_FN(HOWIE_TRACE_LEVEL_ALL);
+    AAudioBackend *backend = static_cast<AAudioBackend *>(userData);
+    return HOWIE_SUCCEEDED(backend->process(audioData, numFrames))
+           ? AAUDIO_CALLBACK_RESULT_CONTINUE
+           : AAUDIO_CALLBACK_RESULT_STOP;
+  }
+
+  /**
+   * Not on the audio thread, so this may log. Recovering would mean
+   * reopening on the new device, which streams on OpenSL can't do either;
+   * the stream just stops producing callbacks.
+   */
+  void AAudioBackend::errorCallback(AAudioStream * /* stream */,
+                                    void *userData,
+                                    int32_t error) {
+    AAudioBackend *backend = static_cast<AAudioBackend *>(userData);
+    backend->disconnected_.store(true, std::memory_order_relaxed);
+    __android_log_print(ANDROID_LOG_WARN, kLibName,
+                        "AAudio stream error: %s",
+                        api_->convertResultToText(error));
+  }
+
+  /**
+   * Read this period's input without blocking. The first period after
+   * starting drops anything older than one period, so that the input
+   * starts out as closely aligned with the output as it can be.
+   */
+  HowieBuffer AAudioBackend::readInput() {
+    aaudio_result_t frames = 0;
+    if (drainInput_) {
+      drainInput_ = false;
+      do {
+        frames = api_->read(input_, inputBuffer_.get(), framesPerPeriod_, 0);
+      } while (frames == framesPerPeriod_);
+    }
+    if (frames != framesPerPeriod_) {
+      int32_t have = frames > 0 ? frames : 0;
+      int32_t more = api_->read(input_,
+                                inputBuffer_.get() + have * bytesPerFrame_,
+                                framesPerPeriod_ - have, 0);
+      frames = have + (more > 0 ? more : 0);
+    }
+    if (frames < framesPerPeriod_) {
+      memset(inputBuffer_.get() + frames * bytesPerFrame_, 0,
+             (framesPerPeriod_ - frames) * bytesPerFrame_);
+      stats_->missedRecordBuffer();
+    }
+    return HowieBuffer { sizeof(HowieBuffer), inputBuffer_.get(),
+                         inputBuffer_.size() };
+  }
+
+  HowieError AAudioBackend::process(void *audioData, int32_t numFrames) {
+    HOWIE_CHECK_NOT_NULL_RT(*log_, audioData);
+    HOWIE_TRACE_FN(HOWIE_TRACE_LEVEL_REALTIME);
+    size_t byteCount = numFrames * bytesPerFrame_;
+    if (numFrames != framesPerPeriod_) {
+      // setFramesPerDataCallback should make this impossible.
+      log_->write(ANDROID_LOG_WARN, "%s: GLITCH: callback for %lld frames",
+                  __func__, numFrames);
+      if (output_) {
+        memset(audioData, 0, byteCount);
+      }
+      return HOWIE_SUCCESS;
+    }
+
+    HowieBuffer in { sizeof(HowieBuffer), nullptr, 0 };
+    HowieBuffer out { sizeof(HowieBuffer), nullptr, 0 };
+    if (output_) {
+      out.data = static_cast<unsigned char *>(audioData);
+      out.byteCount = byteCount;
+      if (input_) {
+        in = readInput();
+      }
+    } else {
+      in.data = static_cast<unsigned char *>(audioData);
+      in.byteCount = byteCount;
+    }
+
+    HowieError result = client_->onPeriod(&in, &out);
+    if (!HOWIE_SUCCEEDED(result)) {
+      if (output_) {
+        memset(audioData, 0, byteCount);
+      }
+      log_->write(ANDROID_LOG_VERBOSE, "%s failed with code %lld", __func__,
+                  result);
+      return result;
+    }
+
+    if (latency_) {
+      latency_->update(stats_->underrunCount(), stats_->lastIntervalNs(),
+                       StreamStatistics::now());
+      unsigned int depth = latency_->depth();
+      if (depth != bufferPeriods_) {
+        log_->write(ANDROID_LOG_INFO, "%s: playback buffer now %lld periods",
+                    __func__, depth);
+        setBufferPeriods(depth);
+        stats_->setQueuedPeriods(depth);
+      }
+    }
+    return HOWIE_SUCCESS;
+  }
+
+} // namespace howie
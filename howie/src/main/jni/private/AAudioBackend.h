@@ -0,0 +1,112 @@
+/*
+ * Copyright 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#ifndef HOWIE_AAUDIOBACKEND_H
+#define HOWIE_AAUDIOBACKEND_H
+
+#include <atomic>
+#include <memory>
+#include <stdint.h>
+#include "StreamBackend.h"
+#include "LatencyController.h"
+
+// Opaque AAudio types, as declared by <aaudio/AAudio.h>. The library is
+// loaded at run time, so that Howie still runs where it doesn't exist.
+struct AAudioStreamStruct;
+typedef struct AAudioStreamStruct AAudioStream;
+
+namespace howie {
+
+  /**
+   * Runs a stream on AAudio, asking for the low latency performance mode
+   * and exclusive sharing, which gets the MMAP path where the device has
+   * one.
+   *
+   * Playback and full duplex streams run their periods on the output
+   * stream's data callback; a full duplex stream reads its input there
+   * without blocking, from an input stream that has no callback of its
+   * own. Record-only streams run on the input stream's data callback.
+   * Every data callback is exactly one period.
+   */
+  class AAudioBackend : public StreamBackend {
+  public:
+    // True if the device's API level is one where AAudio's low latency
+    // path is dependable, and libaaudio can be loaded. Not realtime safe.
+    static bool available();
+
+    AAudioBackend() {}
+    ~AAudioBackend();
+
+    HowieError open(const Config &config,
+                    Client *client,
+                    HowieDeviceCharacteristics *characteristics) override;
+    HowieError start() override;
+    HowieError stop() override;
+    void getStatistics(HowieStreamStatistics *dest) const override;
+    const char *name() const override { return "AAudio"; }
+
+  private:
+    struct Api;
+    static const Api *api_;
+
+    Client *client_ = nullptr;
+    StreamStatistics *stats_ = nullptr;
+    RealtimeLog *log_ = nullptr;
+    HowieDirection direction_ = HOWIE_STREAM_DIRECTION_PLAYBACK;
+    int32_t framesPerPeriod_ = 0;
+    size_t bytesPerFrame_ = 0;
+
+    AAudioStream *output_ = nullptr;
+    AAudioStream *input_ = nullptr;
+
+    // Full duplex streams only: one period of input, and whether the next
+    // callback should first drop whatever input built up before the
+    // output started.
+    unique_buffer inputBuffer_;
+    bool drainInput_ = false;
+
+    // Set by the error callback, which AAudio calls on a thread of its
+    // own when the device goes away.
+    std::atomic<bool> disconnected_ {false};
+
+    // With an adaptive queue, the depth the output's buffer size is set
+    // to, in periods.
+    std::unique_ptr<LatencyController> latency_;
+    unsigned int bufferPeriods_ = 0;
+
+    HowieError openStream(bool output,
+                          const HowieDeviceCharacteristics &device,
+                          bool floatSamples,
+                          bool dataCallback,
+                          AAudioStream **stream);
+    static void closeStream(AAudioStream **stream);
+    static HowieError stopStream(AAudioStream *stream);
+    void setBufferPeriods(unsigned int periods);
+
+    static int32_t dataCallback(AAudioStream *stream,
+                                void *userData,
+                                void *audioData,
+                                int32_t numFrames);
+    static void errorCallback(AAudioStream *stream,
+                              void *userData,
+                              int32_t error);
+    HowieError process(void *audioData, int32_t numFrames);
+    HowieBuffer readInput();
+  };
+
+} // namespace howie
+
+#endif // HOWIE_AAUDIOBACKEND_H
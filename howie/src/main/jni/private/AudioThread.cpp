@@ -0,0 +1,274 @@
+/*
+ * Copyright 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#include "AudioThread.h"
+#include "howie-private.h"
+#include <algorithm>
+#include <chrono>
+#include <climits>
+#include <dlfcn.h>
+#include <stdio.h>
+#include <thread>
+#include <vector>
+
+// Opaque NDK type from <android/performance_hint.h>.
+struct APerformanceHintManager;
+
+namespace howie {
+
+  constexpr size_t AudioThread::kMaxHelperThreads;
+
+  namespace {
+
+    constexpr int kUpdateIntervalMs = 100;
+
+    /**
+     * The thread that keeps every stream's hint session up to date. Like
+     * the realtime log's drain thread, it's created on first use and never
+     * destroyed.
+     */
+    class SessionUpdater {
+    public:
+      static SessionUpdater &get() {
+        static SessionUpdater *instance = new SessionUpdater();
+        return *instance;
+      }
+
+      void add(AudioThread *thread) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        threads_.push_back(thread);
+      }
+
+      // Once this returns the updater won't touch the thread again.
+      void remove(AudioThread *thread) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        threads_.erase(std::remove(threads_.begin(), threads_.end(), thread),
+                       threads_.end());
+      }
+
+    private:
+      std::mutex mutex_;
+      std::vector<AudioThread *> threads_;
+
+      SessionUpdater() {
+        std::thread([this] { threadFn(); }).detach();
+      }
+
+      void threadFn() {
+        while (true) {
+          std::this_thread::sleep_for(
+              std::chrono::milliseconds(kUpdateIntervalMs));
+          std::lock_guard<std::mutex> lock(mutex_);
+          for (AudioThread *thread : threads_) {
+            thread->updateSession();
+          }
+        }
+      }
+    };
+
+  } // namespace
+
+  struct AudioThread::Api {
+    APerformanceHintManager *manager;
+    APerformanceHintSession *(*createSession)(APerformanceHintManager *,
+                                              const int32_t *, size_t,
+                                              int64_t);
+    int (*reportActualWorkDuration)(APerformanceHintSession *, int64_t);
+    void (*closeSession)(APerformanceHintSession *);
+    // Only present from API 34 on.
+    int (*setThreads)(APerformanceHintSession *, const pid_t *, size_t);
+  };
+
+  /**
+   * Look up the APerformanceHint entry points. libandroid is never closed,
+   * so the pointers stay valid for the life of the process once they're
+   * set. Returns null if hints aren't supported.
+   */
+  const AudioThread::Api *AudioThread::loadApi() {
+    static std::once_flag once;
+    static Api api;
+    static bool loaded = false;
+    std::call_once(once, [] {
+      void *lib = dlopen("libandroid.so", RTLD_NOW | RTLD_LOCAL);
+      if (!lib) {
+        return;
+      }
+      auto getManager = reinterpret_cast<APerformanceHintManager *(*)()>(
+          dlsym(lib, "APerformanceHint_getManager"));
+      api.createSession =
+          reinterpret_cast<APerformanceHintSession *(*)(
+              APerformanceHintManager *, const int32_t *, size_t, int64_t)>(
+              dlsym(lib, "APerformanceHint_createSession"));
+      api.reportActualWorkDuration =
+          reinterpret_cast<int (*)(APerformanceHintSession *, int64_t)>(
+              dlsym(lib, "APerformanceHint_reportActualWorkDuration"));
+      api.closeSession =
+          reinterpret_cast<void (*)(APerformanceHintSession *)>(
+              dlsym(lib, "APerformanceHint_closeSession"));
+      api.setThreads =
+          reinterpret_cast<int (*)(APerformanceHintSession *, const pid_t *,
+                                   size_t)>(
+              dlsym(lib, "APerformanceHint_setThreads"));
+      // The manager is null on devices whose kernel doesn't support hints.
+      api.manager = getManager ? getManager() : nullptr;
+      loaded = api.manager && api.createSession
+               && api.reportActualWorkDuration && api.closeSession;
+    });
+    return loaded ? &api : nullptr;
+  }
+
+  const cpu_set_t &AudioThread::performanceCpus() {
+    static std::once_flag once;
+    static cpu_set_t cpus;
+    std::call_once(once, [] {
+      long cpuCount = std::min<long>(sysconf(_SC_NPROCESSORS_CONF),
+                                     CPU_SETSIZE);
+      std::vector<long> maxFreq(std::max<long>(cpuCount, 0), 0);
+      long lowest = LONG_MAX;
+      long highest = 0;
+      for (long i = 0; i < cpuCount; ++i) {
+        char path[96];
+        snprintf(path, sizeof(path),
+                 "/sys/devices/system/cpu/cpu%ld/cpufreq/cpuinfo_max_freq", i);
+        FILE *file = fopen(path, "r");
+        if (file) {
+          if (fscanf(file, "%ld", &maxFreq[i]) == 1 && maxFreq[i] > 0) {
+            lowest = std::min(lowest, maxFreq[i]);
+            highest = std::max(highest, maxFreq[i]);
+          }
+          fclose(file);
+        }
+      }
+
+      // Everything above the slowest cluster. On a three cluster SoC that's
+      // the middle cores as well as the prime core, which leaves the
+      // scheduler some choice.
+      CPU_ZERO(&cpus);
+      int chosen = 0;
+      for (long i = 0; i < cpuCount; ++i) {
+        if (highest <= lowest || maxFreq[i] > lowest) {
+          CPU_SET(static_cast<int>(i), &cpus);
+          ++chosen;
+        }
+      }
+      __android_log_print(ANDROID_LOG_DEBUG, kLibName,
+                          "%d of %ld CPUs are performance cores", chosen,
+                          cpuCount);
+    });
+    return cpus;
+  }
+
+  AudioThread::~AudioThread() {
+    if (registered_) {
+      SessionUpdater::get().remove(this);
+    }
+    APerformanceHintSession *session = session_.load();
+    if (session) {
+      api_->closeSession(session);
+    }
+  }
+
+  void AudioThread::configure(const HowieAudioThreadParams &params,
+                              int64_t targetNs) {
+    HOWIE_TRACE_FN(HOWIE_TRACE_LEVEL_CALLS)
+    pin_ = params.pinToPerformanceCores;
+    targetNs_ = targetNs;
+    api_ = nullptr;
+    if (params.usePerformanceHint) {
+      api_ = loadApi();
+      if (!api_) {
+        __android_log_write(ANDROID_LOG_INFO, kLibName,
+                            "APerformanceHint unavailable on this device");
+      }
+    }
+    if (pin_) {
+      performanceCpus();
+    }
+    enabled_ = pin_ || api_;
+    if (api_ && !registered_) {
+      SessionUpdater::get().add(this);
+      registered_ = true;
+    }
+  }
+
+  void AudioThread::setHelperThreads(const pid_t *tids, size_t count) {
+    std::lock_guard<std::mutex> lock(mu_);
+    helperCount_ = std::min(count, kMaxHelperThreads);
+    std::copy(tids, tids + helperCount_, helpers_);
+    helpersChanged_ = true;
+  }
+
+  /**
+   * Runs on the audio thread, on the first period on a new thread. The
+   * updater does the rest.
+   */
+  void AudioThread::threadChanged() {
+    tid_ = gettid();
+    if (pin_) {
+      // Best effort; if it fails the thread just stays where it was.
+      sched_setaffinity(0, sizeof(cpu_set_t), &performanceCpus());
+    }
+    audioTid_.store(tid_, std::memory_order_relaxed);
+  }
+
+  void AudioThread::updateSession() {
+    pid_t tid = audioTid_.load(std::memory_order_relaxed);
+    if (tid == 0) {
+      return;
+    }
+    std::lock_guard<std::mutex> lock(mu_);
+    if (tid == sessionTid_ && !helpersChanged_) {
+      return;
+    }
+    sessionTid_ = tid;
+    helpersChanged_ = false;
+    pid_t tids[kMaxHelperThreads + 1];
+    tids[0] = tid;
+    std::copy(helpers_, helpers_ + helperCount_, tids + 1);
+    replaceSession(tids, helperCount_ + 1);
+  }
+
+  void AudioThread::replaceSession(const pid_t *tids, size_t count) {
+    APerformanceHintSession *old = session_.load();
+    if (old && api_->setThreads && api_->setThreads(old, tids, count) == 0) {
+      return;
+    }
+    // Before API 34 a session's threads are fixed, so start a new one.
+    session_.store(api_->createSession(api_->manager, tids, count,
+                                       targetNs_));
+    if (old) {
+      // Everything here is sequentially consistent, so once reporting_
+      // reads false the audio thread can only see the new session.
+      while (reporting_.load()) {
+        std::this_thread::yield();
+      }
+      api_->closeSession(old);
+    }
+  }
+
+  void AudioThread::periodFinished(int64_t durationNs) {
+    if (!registered_) {
+      return;
+    }
+    reporting_.store(true);
+    APerformanceHintSession *session = session_.load();
+    if (session) {
+      api_->reportActualWorkDuration(session, durationNs);
+    }
+    reporting_.store(false);
+  }
+
+} // namespace howie
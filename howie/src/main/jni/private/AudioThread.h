@@ -0,0 +1,117 @@
+/*
+ * Copyright 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#ifndef HOWIE_AUDIOTHREAD_H
+#define HOWIE_AUDIOTHREAD_H
+
+#include <atomic>
+#include <mutex>
+#include <sched.h>
+#include <stdint.h>
+#include <sys/types.h>
+#include <unistd.h>
+#include "../howie.h"
+
+// Opaque NDK type from <android/performance_hint.h>, which is API 33.
+struct APerformanceHintSession;
+
+namespace howie {
+
+  /**
+   * Looks after the thread a stream's backend calls it on: pins it to the
+   * performance cores and keeps an APerformanceHint session for it, as
+   * HowieAudioThreadParams asks.
+   *
+   * The backend owns that thread and may replace it, for instance when
+   * the stream is restarted, so the thread is picked up from the period
+   * callbacks themselves. On the first period on a new thread, the audio
+   * thread pins itself, which is one system call, and publishes its tid.
+   * Creating and updating the session are binder calls into the system
+   * server, which can take any amount of time, so a shared updater thread
+   * does those, polling a few times a second. Every period costs a gettid()
+   * and, once there's a session, one duration report, which the platform
+   * designed to be called from the audio thread.
+   */
+  class AudioThread {
+  public:
+    // Most helper threads a session can include.
+    static constexpr size_t kMaxHelperThreads = 15;
+
+    AudioThread() {}
+    ~AudioThread();
+
+    // Call on the worker thread, before the stream starts. targetNs is the
+    // time the callback has to do a period's work in.
+    void configure(const HowieAudioThreadParams &params, int64_t targetNs);
+
+    // Audio thread, at the start and end of every period.
+    void periodStarted() {
+      if (enabled_ && gettid() != tid_) {
+        threadChanged();
+      }
+    }
+    void periodFinished(int64_t durationNs);
+
+    // Other threads that do part of each period's work, and so belong in
+    // the same session. Call on the worker thread; the session picks them
+    // up on the updater's next pass.
+    void setHelperThreads(const pid_t *tids, size_t count);
+
+    // Updater thread only: bring the session up to date with the audio
+    // thread and the helpers.
+    void updateSession();
+
+    // The CPUs with the highest maximum clock, or every CPU if they all
+    // have the same. Reads sysfs the first time, so call it off the audio
+    // thread before relying on it there.
+    static const cpu_set_t &performanceCpus();
+
+  private:
+    struct Api;
+    static const Api *loadApi();
+
+    bool enabled_ = false;
+    bool pin_ = false;
+    const Api *api_ = nullptr;
+    int64_t targetNs_ = 0;
+
+    // Audio thread only. It publishes tid_ in audioTid_ for the updater.
+    pid_t tid_ = 0;
+    std::atomic<pid_t> audioTid_ {0};
+
+    // Written by the updater and read by the audio thread, which sets
+    // reporting_ while it uses the session, so the updater knows when an
+    // old one can be closed.
+    std::atomic<APerformanceHintSession *> session_ {nullptr};
+    std::atomic<bool> reporting_ {false};
+    bool registered_ = false;
+
+    // The helpers are written on the worker thread and read by the
+    // updater; the audio thread never takes mu_. sessionTid_ is the audio
+    // thread the session was made for.
+    std::mutex mu_;
+    pid_t helpers_[kMaxHelperThreads];
+    size_t helperCount_ = 0;
+    bool helpersChanged_ = false;
+    pid_t sessionTid_ = 0;
+
+    void threadChanged();
+    void replaceSession(const pid_t *tids, size_t count);
+  };
+
+} // namespace howie
+
+#endif // HOWIE_AUDIOTHREAD_H
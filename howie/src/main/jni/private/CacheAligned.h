@@ -0,0 +1,49 @@
+/*
+ * Copyright 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#ifndef HOWIE_CACHEALIGNED_H
+#define HOWIE_CACHEALIGNED_H
+
+#include <stdlib.h>
+
+#ifndef CACHE_ALIGN
+#define CACHE_ALIGN 64
+#endif
+
+namespace howie {
+
+  /**
+   * Base for classes with alignas(CACHE_ALIGN) members that are allocated
+   * with new. Before C++17, operator new only guarantees the alignment of
+   * std::max_align_t, which would put those members on whatever cache
+   * lines the allocation happened to cover, so derived classes are
+   * allocated with posix_memalign instead, and freed to match. Like the
+   * rest of the library, which is built without exceptions, a failed
+   * allocation makes new return nullptr.
+   */
+  struct CacheAligned {
+    static void *operator new(size_t size) noexcept {
+      void *ptr = nullptr;
+      return posix_memalign(&ptr, CACHE_ALIGN, size) == 0 ? ptr : nullptr;
+    }
+    static void operator delete(void *ptr) noexcept {
+      free(ptr);
+    }
+  };
+
+} // namespace howie
+
+#endif // HOWIE_CACHEALIGNED_H
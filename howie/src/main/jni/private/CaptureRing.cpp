@@ -0,0 +1,123 @@
+/*
+ * Copyright 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#include "CaptureRing.h"
+#include "futex.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+namespace {
+  size_t roundUpToPowerOfTwo(size_t n) {
+    size_t result = 1;
+    while (result < n) {
+      result <<= 1;
+    }
+    return result;
+  }
+} // namespace
+
+namespace howie {
+
+  CaptureRing::CaptureRing(size_t capacity)
+      : data_(roundUpToPowerOfTwo(capacity)),
+        mask_(roundUpToPowerOfTwo(capacity) - 1) {
+    data_.clear();
+  }
+
+  bool CaptureRing::write(const void *src, size_t size) {
+    size_t writePos = writePos_.load(std::memory_order_relaxed);
+    size_t readPos = readPos_.load(std::memory_order_acquire);
+    if (size > data_.size() - (writePos - readPos)) {
+      return false;
+    }
+
+    // Copy in two pieces if the write wraps around the end of the ring.
+    size_t offset = writePos & mask_;
+    size_t first = std::min(size, data_.size() - offset);
+    const unsigned char *bytes = static_cast<const unsigned char *>(src);
+    memcpy(data_.get() + offset, bytes, first);
+    memcpy(data_.get(), bytes + first, size - first);
+
+    // seq_cst, so that either the reader sees the data before it sleeps or
+    // we see readerWaiting_ below.
+    writePos_.store(writePos + size, std::memory_order_seq_cst);
+    if (readerWaiting_.load(std::memory_order_seq_cst)) {
+      wakeReader();
+    }
+    return true;
+  }
+
+  size_t CaptureRing::read(void *dest, size_t size, int timeoutMs) {
+    auto deadline = std::chrono::steady_clock::now()
+                    + std::chrono::milliseconds(std::max(timeoutMs, 0));
+    size_t readPos = readPos_.load(std::memory_order_relaxed);
+    size_t available = 0;
+
+    while (true) {
+      int wakeups = wakeups_.load(std::memory_order_relaxed);
+      available = writePos_.load(std::memory_order_acquire) - readPos;
+      if (available > 0 || timeoutMs == 0
+          || interrupted_.load(std::memory_order_relaxed)) {
+        break;
+      }
+
+      timespec timeout;
+      timespec *pTimeout = nullptr;
+      if (timeoutMs > 0) {
+        auto remaining = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            deadline - std::chrono::steady_clock::now()).count();
+        if (remaining <= 0) {
+          break;
+        }
+        timeout.tv_sec = remaining / 1000000000;
+        timeout.tv_nsec = remaining % 1000000000;
+        pTimeout = &timeout;
+      }
+
+      readerWaiting_.store(true, std::memory_order_seq_cst);
+      available = writePos_.load(std::memory_order_seq_cst) - readPos;
+      if (available == 0 && !interrupted_.load(std::memory_order_seq_cst)) {
+        futexWait(&wakeups_, wakeups, pTimeout);
+      }
+      readerWaiting_.store(false, std::memory_order_relaxed);
+    }
+
+    size = std::min(size, available);
+    size_t offset = readPos & mask_;
+    size_t first = std::min(size, data_.size() - offset);
+    unsigned char *bytes = static_cast<unsigned char *>(dest);
+    memcpy(bytes, data_.get() + offset, first);
+    memcpy(bytes + first, data_.get(), size - first);
+    readPos_.store(readPos + size, std::memory_order_release);
+    return size;
+  }
+
+  void CaptureRing::interrupt() {
+    interrupted_.store(true, std::memory_order_seq_cst);
+    wakeReader();
+  }
+
+  void CaptureRing::resume() {
+    interrupted_.store(false, std::memory_order_relaxed);
+  }
+
+  void CaptureRing::wakeReader() {
+    wakeups_.fetch_add(1, std::memory_order_relaxed);
+    futexWake(&wakeups_, 1);
+  }
+
+} // namespace howie
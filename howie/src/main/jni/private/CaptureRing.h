@@ -0,0 +1,78 @@
+/*
+ * Copyright 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#ifndef HOWIE_CAPTURERING_H
+#define HOWIE_CAPTURERING_H
+
+#include <atomic>
+#include <stddef.h>
+#include "CacheAligned.h"
+#include "unique_buffer.h"
+
+#ifndef CACHE_ALIGN
+#define CACHE_ALIGN 64
+#endif
+
+namespace howie {
+
+  /**
+   * A byte ring that carries captured audio from the audio thread to a
+   * single consumer thread.
+   *
+   * The audio thread writes whole periods and never waits: if a period
+   * doesn't fit, it's dropped. The consumer can block in read() until data
+   * arrives. It sleeps on a futex, and the writer only makes the wake-up
+   * syscall when the consumer is actually asleep.
+   */
+  class CaptureRing : public CacheAligned {
+  public:
+    // The capacity is rounded up to a power of two.
+    explicit CaptureRing(size_t capacity);
+
+    // Audio thread only. Returns false, having written nothing, if there
+    // isn't room for all of src.
+    bool write(const void *src, size_t size);
+
+    // Consumer thread only. Returns the number of bytes copied to dest,
+    // which is at most size and is zero if nothing arrived before the
+    // timeout. timeoutMs of zero doesn't wait, and a negative timeoutMs
+    // waits indefinitely.
+    size_t read(void *dest, size_t size, int timeoutMs);
+
+    // Until resume(), read() returns whatever is left without waiting,
+    // including any read() that is already blocked.
+    void interrupt();
+    void resume();
+
+  private:
+    unique_buffer data_;
+    const size_t mask_;
+
+    alignas(CACHE_ALIGN) std::atomic<size_t> readPos_ {0};
+    alignas(CACHE_ALIGN) std::atomic<size_t> writePos_ {0};
+
+    // The futex word, bumped for every wake-up, and whether the reader is
+    // (about to be) asleep on it.
+    alignas(CACHE_ALIGN) std::atomic<int> wakeups_ {0};
+    std::atomic<bool> readerWaiting_ {false};
+    std::atomic<bool> interrupted_ {false};
+
+    void wakeReader();
+  };
+
+} // namespace howie
+
+#endif // HOWIE_CAPTURERING_H
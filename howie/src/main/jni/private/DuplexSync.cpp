@@ -0,0 +1,208 @@
+/*
+ * Copyright 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#include "DuplexSync.h"
+#include "../howie_dsp.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace {
+  // Enough ring for the player to stall for several periods without the
+  // recorder having to drop input.
+  constexpr size_t kRingPeriods = 8;
+
+  // The largest rate correction we will apply. Real clocks are within a
+  // few hundred ppm of each other.
+  constexpr double kMaxCorrection = 0.002;
+
+  // Weight of each new fill level in the running average, which smooths
+  // out callback jitter over roughly 100 periods.
+  constexpr double kAverageWeight = 0.01;
+
+  // PI loop gains, in ratio per period of fill error. With kIntegralGain
+  // a little under kProportionalGain^2 / 4 the loop is overdamped, and it
+  // settles within a few thousand periods.
+  constexpr double kProportionalGain = 1e-3;
+  constexpr double kIntegralGain = 2e-7;
+
+  uint32_t roundUpToPowerOfTwo(size_t n) {
+    uint32_t result = 1;
+    while (result < n) {
+      result <<= 1;
+    }
+    return result;
+  }
+
+  double clamp(double x, double limit) {
+    return std::max(-limit, std::min(x, limit));
+  }
+
+  uint32_t toMicros(int64_t ns) {
+    return static_cast<uint32_t>(ns / 1000);
+  }
+} // namespace
+
+namespace howie {
+
+  constexpr size_t DuplexSync::kInterpolationFrames;
+
+  DuplexSync::DuplexSync(size_t channelCount,
+                         size_t framesPerPeriod,
+                         int sampleRate)
+      : channelCount_(channelCount),
+        framesPerPeriod_(framesPerPeriod),
+        periodUs_(framesPerPeriod * 1e6 / sampleRate),
+        capacity_(roundUpToPowerOfTwo(framesPerPeriod * kRingPeriods)),
+        // Right before a write, the raw level is a period below the
+        // continuous one, and it still has to hold a period plus the
+        // interpolation frames. Add a quarter period for jitter.
+        targetFill_(framesPerPeriod * 2.25 + kInterpolationFrames) {
+    ring_.reset(capacity_ * channelCount * sizeof(float));
+    ring_.clear();
+    // History, a period at the fastest ratio, and the interpolation frames.
+    window_.reset((2 * framesPerPeriod + kInterpolationFrames + 1)
+                  * channelCount * sizeof(float));
+    window_.clear();
+  }
+
+  bool DuplexSync::write(const float *frames,
+                         size_t frameCount,
+                         int64_t nowNs) {
+    uint32_t readPos = readPos_.load(std::memory_order_acquire);
+    if (frameCount > capacity_ - (writePos_ - readPos)) {
+      return false;
+    }
+
+    size_t offset = writePos_ & (capacity_ - 1);
+    size_t first = std::min<size_t>(frameCount, capacity_ - offset);
+    size_t frameSize = channelCount_ * sizeof(float);
+    memcpy(frame(ring_.get(), offset), frames, first * frameSize);
+    memcpy(ring_.get(), frames + first * channelCount_,
+           (frameCount - first) * frameSize);
+
+    writePos_ += frameCount;
+    lastWrite_.store((static_cast<uint64_t>(writePos_) << 32)
+                     | toMicros(nowNs),
+                     std::memory_order_release);
+    return true;
+  }
+
+  uint32_t DuplexSync::fill() const {
+    return static_cast<uint32_t>(
+        lastWrite_.load(std::memory_order_acquire) >> 32)
+           - readPos_.load(std::memory_order_relaxed);
+  }
+
+  void DuplexSync::peek(float *dest, size_t frameCount) const {
+    uint32_t readPos = readPos_.load(std::memory_order_relaxed);
+    size_t offset = readPos & (capacity_ - 1);
+    size_t first = std::min<size_t>(frameCount, capacity_ - offset);
+    size_t frameSize = channelCount_ * sizeof(float);
+    memcpy(dest, frame(ring_.get(), offset), first * frameSize);
+    memcpy(dest + first * channelCount_, ring_.get(),
+           (frameCount - first) * frameSize);
+  }
+
+  void DuplexSync::skip(size_t frameCount) {
+    readPos_.store(readPos_.load(std::memory_order_relaxed) + frameCount,
+                   std::memory_order_release);
+  }
+
+  double DuplexSync::updateRatio(double fill) {
+    averageFill_ += (fill - averageFill_) * kAverageWeight;
+    double error = (averageFill_ - targetFill_) / framesPerPeriod_;
+    integral_ = clamp(integral_ + error * kIntegralGain, kMaxCorrection);
+    double correction = clamp(error * kProportionalGain + integral_,
+                              kMaxCorrection);
+    driftPpm_.store(static_cast<int32_t>(std::lround(correction * 1e6)),
+                    std::memory_order_relaxed);
+    // Read faster when there's too much input queued.
+    return 1. + correction;
+  }
+
+  void DuplexSync::resync() {
+    primed_ = false;
+    phase_ = 0;
+    resyncs_.store(resyncs_.load(std::memory_order_relaxed) + 1,
+                   std::memory_order_relaxed);
+  }
+
+  bool DuplexSync::read(float *dest, int64_t nowNs) {
+    uint64_t lastWrite = lastWrite_.load(std::memory_order_acquire);
+    uint32_t fill = static_cast<uint32_t>(lastWrite >> 32)
+                    - readPos_.load(std::memory_order_relaxed);
+    size_t periodSamples = framesPerPeriod_ * channelCount_;
+
+    // Work out how much input there would be if it arrived continuously.
+    // If the recorder is late, don't count more than a period of it.
+    uint32_t sinceWriteUs = toMicros(nowNs) - static_cast<uint32_t>(lastWrite);
+    double continuousFill = fill + framesPerPeriod_
+                                   * std::min(sinceWriteUs / periodUs_, 1.);
+
+    if (!primed_ || fill > capacity_ - framesPerPeriod_) {
+      if (continuousFill < targetFill_) {
+        memset(dest, 0, periodSamples * sizeof(float));
+        return false;
+      }
+      if (primed_) {
+        // The recorder is about to start dropping input; catch up.
+        resync();
+      } else {
+        memset(window_.get(), 0, channelCount_ * sizeof(float));
+      }
+      // Start again from the target level.
+      uint32_t excess = static_cast<uint32_t>(continuousFill - targetFill_);
+      skip(excess);
+      fill -= excess;
+      continuousFill -= excess;
+      averageFill_ = continuousFill;
+      primed_ = true;
+    }
+
+    double ratio = updateRatio(continuousFill);
+    size_t needed = static_cast<size_t>(phase_ + (framesPerPeriod_ - 1) * ratio)
+                    + kInterpolationFrames;
+    if (fill < needed) {
+      resync();
+      memset(dest, 0, periodSamples * sizeof(float));
+      return false;
+    }
+
+    // The window starts with the last frame consumed last time, which is
+    // the frame before the first one we can interpolate from.
+    float *window = reinterpret_cast<float *>(window_.get());
+    peek(window + channelCount_, needed);
+    HowieDspResampleCubic(window, dest, channelCount_, framesPerPeriod_,
+                          1. + phase_, ratio);
+
+    double end = phase_ + framesPerPeriod_ * ratio;
+    size_t advance = static_cast<size_t>(end);
+    phase_ = end - advance;
+    memcpy(window, window + advance * channelCount_,
+           channelCount_ * sizeof(float));
+    skip(advance);
+    return true;
+  }
+
+  void DuplexSync::reset() {
+    skip(fill());
+    primed_ = false;
+    phase_ = 0;
+    // Keep integral_: the clocks will drift at the same rate next time.
+  }
+
+} // namespace howie
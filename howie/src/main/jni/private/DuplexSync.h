@@ -0,0 +1,122 @@
+/*
+ * Copyright 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#ifndef HOWIE_DUPLEXSYNC_H
+#define HOWIE_DUPLEXSYNC_H
+
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+#include "CacheAligned.h"
+#include "unique_buffer.h"
+
+#ifndef CACHE_ALIGN
+#define CACHE_ALIGN 64
+#endif
+
+namespace howie {
+
+  /**
+   * Carries input from the recorder's thread to the player's thread for a
+   * full duplex stream, and keeps the two phase-locked.
+   *
+   * The recorder and player run off separate clocks, so over a long
+   * session one of them delivers slightly more periods than the other.
+   * Rather than eventually dropping or repeating a whole period, the
+   * player side reads the input at a ratio of very nearly one, and steers
+   * that ratio with a PI loop on the ring's average fill level. The
+   * target level is the smallest that always has a period ready, so the
+   * round trip latency stays constant and minimal.
+   *
+   * Input arrives a period at a time, so the raw fill level jumps by a
+   * period whenever the slowly drifting phase between the two callbacks
+   * wraps around. The loop therefore works on the fill level the ring
+   * would have if input arrived continuously: the raw level plus however
+   * much input has been captured since the last write.
+   *
+   * If the fill level gets badly out of range anyway (the input stalls,
+   * or the stream starts up), the ring is resynchronized: the player gets
+   * silence until the fill level is back at the target, or the excess
+   * input is discarded.
+   */
+  class DuplexSync : public CacheAligned {
+  public:
+    DuplexSync(size_t channelCount, size_t framesPerPeriod, int sampleRate);
+
+    // Recorder thread. nowNs is the CLOCK_MONOTONIC time of the recorder
+    // callback. Drops the input, and returns false, if the ring is full.
+    bool write(const float *frames, size_t frameCount, int64_t nowNs);
+
+    // Player thread. Always fills dest with framesPerPeriod frames; returns
+    // false if some or all of them had to be silence.
+    bool read(float *dest, int64_t nowNs);
+
+    // Player thread, while the stream isn't running.
+    void reset();
+
+    // Any thread.
+    int32_t driftPpm() const {
+      return driftPpm_.load(std::memory_order_relaxed);
+    }
+    uint32_t resyncCount() const {
+      return resyncs_.load(std::memory_order_relaxed);
+    }
+
+  private:
+    // Frames of input either side of the interpolated position.
+    static constexpr size_t kInterpolationFrames = 3;
+
+    const size_t channelCount_;
+    const size_t framesPerPeriod_;
+    const double periodUs_;
+
+    // The ring holds float frames; its capacity is a power of two so that
+    // the positions can wrap freely.
+    unique_buffer ring_;
+    const uint32_t capacity_;
+    alignas(CACHE_ALIGN) std::atomic<uint32_t> readPos_ {0};
+
+    // The write position in the high half and the time of that write, in
+    // microseconds modulo 2^32, in the low half, so the reader always sees
+    // a matching pair.
+    alignas(CACHE_ALIGN) std::atomic<uint64_t> lastWrite_ {0};
+    uint32_t writePos_ = 0;
+
+    // Player thread state. window_ holds one frame of history followed by
+    // the frames peeked from the ring for the current period.
+    alignas(CACHE_ALIGN) unique_buffer window_;
+    double phase_ = 0;
+    double averageFill_ = 0;
+    double integral_ = 0;
+    double targetFill_;
+    bool primed_ = false;
+
+    std::atomic<int32_t> driftPpm_ {0};
+    std::atomic<uint32_t> resyncs_ {0};
+
+    float *frame(unsigned char *base, size_t index) const {
+      return reinterpret_cast<float *>(base) + index * channelCount_;
+    }
+    void peek(float *dest, size_t frameCount) const;
+    void skip(size_t frameCount);
+    void resync();
+    uint32_t fill() const;
+    double updateRatio(double fill);
+  };
+
+} // namespace howie
+
+#endif // HOWIE_DUPLEXSYNC_H
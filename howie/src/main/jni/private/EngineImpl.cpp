@@ -20,6 +20,11 @@
 #include "EngineImpl.h"
 #include "howie_jni.h"
 #include "StreamImpl.h"
+#include "Mixer.h"
+#include "StreamPool.h"
+#include "OpenSLBackend.h"
+#include "AAudioBackend.h"
+#include "OfflineBackend.h"
 
 
 
@@ -61,6 +66,77 @@ Java_com_example_android_howie_HowieEngine_destroy(JNIEnv *env,
   delete pEngine;
 }
 
+JNIEXPORT jboolean JNICALL
+Java_com_example_android_howie_HowieEngine_getStreamStatistics(
+    JNIEnv *env,
+    jclass type,
+    jlong stream,
+    jlongArray scalars,
+    jintArray durationHistogram,
+    jintArray intervalHistogram) {
+  HOWIE_TRACE_FN(HOWIE_TRACE_LEVEL_CALLS)
+  HowieStreamStatistics stats;
+  stats.version = sizeof(stats);
+  if (!HOWIE_SUCCEEDED(HowieStreamGetStatistics(
+      reinterpret_cast<HowieStream *>(stream), &stats))) {
+    return JNI_FALSE;
+  }
+
+  const jlong values[] = {
+      stats.periodNs,
+      stats.lastCallbackTimeNs,
+      static_cast<jlong>(stats.callbackCount),
+      stats.maxCallbackDurationNs,
+      stats.underrunCount,
+      stats.missedRecordBufferCount,
+      stats.parameterContentionCount,
+      stats.captureOverflowCount,
+      stats.inputDriftPpm,
+      stats.inputResyncCount,
+      stats.reportOverflowCount,
+      stats.playbackQueueDepth,
+      static_cast<jlong>(stats.idlePeriodCount) };
+  const jint valueCount = sizeof(values) / sizeof(values[0]);
+  if (env->GetArrayLength(scalars) < valueCount
+      || env->GetArrayLength(durationHistogram) < HOWIE_STATISTICS_BUCKET_COUNT
+      || env->GetArrayLength(intervalHistogram) < HOWIE_STATISTICS_BUCKET_COUNT) {
+    return JNI_FALSE;
+  }
+  env->SetLongArrayRegion(scalars, 0, valueCount, values);
+  env->SetIntArrayRegion(
+      durationHistogram, 0, HOWIE_STATISTICS_BUCKET_COUNT,
+      reinterpret_cast<const jint *>(stats.callbackDurationHistogram));
+  env->SetIntArrayRegion(
+      intervalHistogram, 0, HOWIE_STATISTICS_BUCKET_COUNT,
+      reinterpret_cast<const jint *>(stats.callbackIntervalHistogram));
+  return JNI_TRUE;
+}
+
+JNIEXPORT jint JNICALL
+Java_com_example_android_howie_HowieEngine_receiveReports(
+    JNIEnv *env,
+    jclass type,
+    jlong stream,
+    jobject dest) {
+  HOWIE_TRACE_FN(HOWIE_TRACE_LEVEL_CALLS)
+  // Copy straight into the Java buffer's memory, so that polling for
+  // reports every frame doesn't allocate or copy through a Java array.
+  void *address = env->GetDirectBufferAddress(dest);
+  jlong capacity = env->GetDirectBufferCapacity(dest);
+  if (!address || capacity < 0) {
+    return -1;
+  }
+
+  size_t count = 0;
+  HowieError result = HowieStreamReceiveReports(
+      reinterpret_cast<HowieStream *>(stream), address,
+      static_cast<size_t>(capacity), &count);
+  if (result == HOWIE_ERROR_AGAIN) {
+    return 0;
+  }
+  return HOWIE_SUCCEEDED(result) ? static_cast<jint>(count) : -1;
+}
+
 namespace howie {
   EngineImpl* EngineImpl::instance_ = nullptr;
 
@@ -87,6 +163,19 @@ namespace howie {
 
   EngineImpl::~EngineImpl() {
     HOWIE_TRACE_FN(HOWIE_TRACE_LEVEL_CALLS)
+    // Queued commands can still detach streams from the shared output, and
+    // destroyed backends hand their OpenSL objects back to the pool, so let
+    // every one of them run before either goes. A command can queue
+    // another, hence the loop.
+    Worker::ticket_t ticket;
+    do {
+      ticket = openSLIsSlow_.lastTicket();
+      openSLIsSlow_.wait(ticket, -1);
+    } while (openSLIsSlow_.lastTicket() != ticket);
+    // The shared output's own backend also returns its objects to the
+    // pool, so the pool goes last.
+    delete mixer_;
+    delete streamPool_;
     instance_ = NULL;
   }
 
@@ -124,9 +213,47 @@ namespace howie {
       *out_stream = nullptr;
     }
 
+    if (params.sharedOutput
+        && (params.direction != HOWIE_STREAM_DIRECTION_PLAYBACK
+            || params.offline)) {
+      return HOWIE_ERROR_INVALID_PARAMETER;
+    }
+    if (params.sampleRate != 0
+        && params.sampleRate != deviceCharacteristics_.sampleRate
+        && (params.direction != HOWIE_STREAM_DIRECTION_PLAYBACK
+            || params.sampleFormat != HOWIE_SAMPLE_FORMAT_FLOAT
+            || params.offline
+            || !Resampler::supported(params.sampleRate,
+                                     deviceCharacteristics_.sampleRate))) {
+      return HOWIE_ERROR_INVALID_PARAMETER;
+    }
+    if (params.planar
+        && (params.sampleFormat != HOWIE_SAMPLE_FORMAT_FLOAT
+            || deviceCharacteristics_.samplesPerFrame > HOWIE_MAX_CHANNELS)) {
+      return HOWIE_ERROR_INVALID_PARAMETER;
+    }
+    if (params.idleWhenSilent && !(params.idleThreshold >= 0.f)) {
+      return HOWIE_ERROR_INVALID_PARAMETER;
+    }
+
     StreamImpl *stream = new StreamImpl(deviceCharacteristics_, params);
-    if (stream) {
-      result = DoAsync([=]{stream->init(engineItf_, outputMixObject_, params);});
+    if (stream && params.offline) {
+      // There's no device to wait for, so open it here and now.
+      result = stream->init(new OfflineBackend(), params);
+      if (!HOWIE_SUCCEEDED(result)) {
+        delete stream;
+        HOWIE_CHECK(result);
+      }
+      stream->commandCompleted(result);
+    } else if (stream && params.sharedOutput) {
+      result = DoAsync([=]{
+        stream->commandCompleted(stream->initShared(getMixer(), params));
+      });
+      HOWIE_CHECK(result);
+    } else if (stream) {
+      result = DoAsync([=]{
+        stream->commandCompleted(initStream(stream, params));
+      });
       HOWIE_CHECK(result);
     }
 
@@ -136,17 +263,117 @@ namespace howie {
     return result;
   }
 
+  /**
+   * Open a stream on AAudio where the device has a dependable low latency
+   * path, and on OpenSL otherwise, or if AAudio won't give the stream the
+   * device's native rate and channel count. Only call this on the worker
+   * thread.
+   */
+  HowieError EngineImpl::initStream(StreamImpl *stream,
+                                    const HowieStreamCreationParams &params) {
+    HOWIE_TRACE_FN(HOWIE_TRACE_LEVEL_CALLS)
+    stream->configureAudioThread(audioThreadParams_);
+    if (AAudioBackend::available()) {
+      HowieError result = stream->init(new AAudioBackend(), params);
+      if (HOWIE_SUCCEEDED(result)) {
+        return result;
+      }
+      __android_log_print(ANDROID_LOG_INFO, kLibName,
+                          "AAudio failed with code %d, using OpenSL", result);
+    }
+    return stream->init(
+        new OpenSLBackend(engineItf_, outputMixObject_, streamPool_), params);
+  }
+
+  /**
+   * Get the shared output, creating and starting it if this is the first
+   * stream to use it. Only call this on the worker thread.
+   */
+  Mixer *EngineImpl::getMixer() {
+    HOWIE_TRACE_FN(HOWIE_TRACE_LEVEL_CALLS)
+    if (!mixer_) {
+      Mixer *mixer = new Mixer(deviceCharacteristics_);
+      if (HOWIE_SUCCEEDED(initStream(mixer, Mixer::kCreationParams))) {
+        mixer->setThreadCount(sharedOutputThreadCount_);
+        mixer_ = mixer;
+      } else {
+        delete mixer;
+      }
+    }
+    return mixer_;
+  }
+
+  HowieError EngineImpl::setSharedOutputThreadCount(int threadCount) {
+    HOWIE_TRACE_FN(HOWIE_TRACE_LEVEL_CALLS)
+    if (threadCount < 0) {
+      return HOWIE_ERROR_INVALID_PARAMETER;
+    }
+    return DoAsync([=] {
+      sharedOutputThreadCount_ = threadCount;
+      if (mixer_) {
+        mixer_->setThreadCount(threadCount);
+      }
+    });
+  }
+
+  /**
+   * Only OpenSL streams can take from the pool, so there's none where
+   * streams open on AAudio: idle pooled players would just hold on to
+   * fast tracks the AAudio streams need.
+   */
+  HowieError EngineImpl::configureStreamPool(
+      const HowieStreamPoolParams &params) {
+    HOWIE_TRACE_FN(HOWIE_TRACE_LEVEL_CALLS)
+    if (AAudioBackend::available()) {
+      return HOWIE_ERROR_UNSUPPORTED;
+    }
+    return DoAsync([=] {
+      if (!streamPool_) {
+        streamPool_ = new StreamPool(deviceCharacteristics_);
+      }
+      streamPool_->configure(engineItf_, outputMixObject_, params);
+    });
+  }
+
+  HowieError EngineImpl::configureAudioThreads(
+      const HowieAudioThreadParams &params) {
+    HOWIE_TRACE_FN(HOWIE_TRACE_LEVEL_CALLS)
+    return DoAsync([=] {
+      audioThreadParams_ = params;
+    });
+  }
+
   const HowieDeviceCharacteristics * EngineImpl::getDeviceCharacteristics() const {
     HOWIE_TRACE_FN(HOWIE_TRACE_LEVEL_CALLS)
     return &deviceCharacteristics_;
   }
 
-  HowieError EngineImpl::DoAsync(const Worker::work_item_t &fn) {
+  HowieError EngineImpl::DoAsync(Worker::work_item_t fn) {
+    HOWIE_TRACE_FN(HOWIE_TRACE_LEVEL_CALLS)
+    HowieError result = HOWIE_ERROR_AGAIN;
+    if (openSLIsSlow_.push_work(std::move(fn))) {
+      result = HOWIE_SUCCESS;
+    }
+    return result;
+  }
+
+  HowieError EngineImpl::DoAsync(Worker::work_item_t *fns, size_t count) {
     HOWIE_TRACE_FN(HOWIE_TRACE_LEVEL_CALLS)
     HowieError result = HOWIE_ERROR_AGAIN;
-    if (openSLIsSlow_.push_work(fn)) {
+    if (openSLIsSlow_.push_work(fns, count)) {
       result = HOWIE_SUCCESS;
     }
     return result;
   }
+
+  HowieError EngineImpl::waitForCompletion(Worker::ticket_t ticket,
+                                           int timeoutMs) {
+    HOWIE_TRACE_FN(HOWIE_TRACE_LEVEL_CALLS)
+    if (openSLIsSlow_.isWorkerThread()) {
+      // The ticket can't complete while we're blocking its thread.
+      return HOWIE_ERROR_INVALID_PARAMETER;
+    }
+    return openSLIsSlow_.wait(ticket, timeoutMs) ? HOWIE_SUCCESS
+                                                 : HOWIE_ERROR_AGAIN;
+  }
 } // namespace howie
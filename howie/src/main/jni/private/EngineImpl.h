@@ -21,7 +21,9 @@
 #include "Worker.h"
 
 namespace howie {
-
+  class Mixer;
+  class StreamImpl;
+  class StreamPool;
 
   class EngineImpl {
   public:
@@ -48,20 +50,52 @@ namespace howie {
 
     const HowieDeviceCharacteristics *getDeviceCharacteristics() const;
 
-    HowieError DoAsync(const Worker::work_item_t& fn);
+    HowieError setSharedOutputThreadCount(int threadCount);
+    HowieError configureStreamPool(const HowieStreamPoolParams &params);
+    HowieError configureAudioThreads(const HowieAudioThreadParams &params);
+
+    HowieError DoAsync(Worker::work_item_t fn);
+    // Queues every item at once, or none of them.
+    HowieError DoAsync(Worker::work_item_t *fns, size_t count);
+
+    // See HowieGetCompletionToken and HowieWaitForCompletion.
+    Worker::ticket_t lastTicket() { return openSLIsSlow_.lastTicket(); }
+    HowieError waitForCompletion(Worker::ticket_t ticket, int timeoutMs);
   private:
+    // The output shared by streams created with sharedOutput set. Created
+    // on first use, on the worker thread.
+    Mixer *mixer_ = nullptr;
+    int sharedOutputThreadCount_ = 0;
+    Mixer *getMixer();
+
+    // Pick a backend for a stream that has its own, and open it.
+    HowieError initStream(StreamImpl *stream,
+                          const HowieStreamCreationParams &params);
+
+    // Idle OpenSL objects for new streams. Created on first use, on the
+    // worker thread. Destroyed streams hand their objects back to it, so the
+    // engine only deletes it once the worker has run everything queued.
+    StreamPool *streamPool_ = nullptr;
+
     HowieDeviceCharacteristics deviceCharacteristics_;
 
+    // Applied to each stream as it opens. Only touched on the worker
+    // thread.
+    HowieAudioThreadParams audioThreadParams_ {
+        sizeof(HowieAudioThreadParams), false, false };
+
     SLObjectItf engineObject_ = NULL;
     SLEngineItf engineItf_ = NULL;
     SLObjectItf outputMixObject_ = NULL;
     static EngineImpl *instance_;
 
-    // This number is arbitrary; it needs to be set large enough to
-    // hold the maximum number of OpenSL calls outstanding at any given
-    // time. Hopefully that won't be large.
-    static constexpr int workerQueueLen_ = 5;
-    Worker openSLIsSlow_ {workerQueueLen_};
+    // The queue grows on demand, so the initial length only needs to cover
+    // the usual number of OpenSL calls outstanding at once. The limit is
+    // there to turn a runaway caller into HOWIE_ERROR_AGAIN rather than
+    // unbounded memory.
+    static constexpr size_t workerQueueLen_ = 16;
+    static constexpr size_t maxWorkerQueueLen_ = 1024;
+    Worker openSLIsSlow_ {workerQueueLen_, maxWorkerQueueLen_};
   };
 
 } // namespace howie
@@ -0,0 +1,104 @@
+/*
+ * Copyright 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#include "EventQueue.h"
+#include <algorithm>
+#include <cstring>
+#include <thread>
+
+namespace howie {
+
+  EventQueue::EventQueue(size_t length)
+      : length_(std::max<size_t>(length, 1)),
+        incoming_(static_cast<int>(length_)),
+        pending_(new Record[length_]),
+        due_(new HowieEvent[length_]) {
+  }
+
+  bool EventQueue::schedule(int64_t frameTime, const void *data, size_t size) {
+    if (size > HOWIE_EVENT_MAX_SIZE || (size > 0 && !data)) {
+      return false;
+    }
+    // Writers only hold the lock for a memcpy, so just yield until it's free.
+    while (writing_.exchange(true, std::memory_order_acquire)) {
+      std::this_thread::yield();
+    }
+    bool result = incoming_.push([&](Record *record) -> bool {
+      record->frameTime = frameTime;
+      record->size = static_cast<uint32_t>(size);
+      if (size > 0) {
+        memcpy(record->data, data, size);
+      }
+      return true;
+    });
+    writing_.store(false, std::memory_order_release);
+    return result;
+  }
+
+  /**
+   * Insert after any events at the same time, so events scheduled for the
+   * same frame arrive in the order they were sent.
+   */
+  void EventQueue::insert(const Record &record) {
+    size_t position = pendingCount_;
+    while (position > 0 && pending_[position - 1].frameTime > record.frameTime) {
+      pending_[position] = pending_[position - 1];
+      --position;
+    }
+    pending_[position] = record;
+    ++pendingCount_;
+  }
+
+  void EventQueue::beginPeriod(int64_t periodStart, size_t frameCount) {
+    // Anything that doesn't fit in the pending list waits in the ring.
+    incoming_.pop_n(length_ - pendingCount_,
+                    [this](Record *first, size_t firstCount,
+                           Record *second, size_t secondCount) -> size_t {
+      for (size_t i = 0; i < firstCount; ++i) {
+        insert(first[i]);
+      }
+      for (size_t i = 0; i < secondCount; ++i) {
+        insert(second[i]);
+      }
+      return firstCount + secondCount;
+    });
+
+    const int64_t periodEnd = periodStart + static_cast<int64_t>(frameCount);
+    dueCount_ = 0;
+    while (dueCount_ < pendingCount_
+           && pending_[dueCount_].frameTime < periodEnd) {
+      const Record &record = pending_[dueCount_];
+      HowieEvent &event = due_[dueCount_];
+      // Late events are delivered at the start of the period.
+      event.frameOffset = static_cast<int>(
+          std::max<int64_t>(record.frameTime - periodStart, 0));
+      event.frameTime = record.frameTime;
+      event.data = record.data;
+      event.size = record.size;
+      ++dueCount_;
+    }
+  }
+
+  void EventQueue::endPeriod() {
+    if (dueCount_ > 0) {
+      std::move(pending_.get() + dueCount_, pending_.get() + pendingCount_,
+                pending_.get());
+      pendingCount_ -= dueCount_;
+      dueCount_ = 0;
+    }
+  }
+
+} // namespace howie
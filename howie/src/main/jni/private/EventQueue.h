@@ -0,0 +1,80 @@
+/*
+ * Copyright 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#ifndef HOWIE_EVENTQUEUE_H
+#define HOWIE_EVENTQUEUE_H
+
+#include <atomic>
+#include <memory>
+#include <stdint.h>
+#include "../howie.h"
+#include "CacheAligned.h"
+#include "Ringbuffer.h"
+
+namespace howie {
+
+  /**
+   * Timestamped events for one stream, delivered to the process callback
+   * in the period they fall in.
+   *
+   * User threads schedule events into a ringbuffer of fixed-size records;
+   * concurrent writers take turns on a spin lock, as with the parameter
+   * pipe. Each period the audio thread moves whatever has arrived into a
+   * list sorted by frame time, and hands the events that fall before the
+   * end of the period to the callback. Neither side allocates once the
+   * queue exists.
+   */
+  class EventQueue : public CacheAligned {
+  public:
+    // Holds up to length events in flight and length waiting for their
+    // period.
+    explicit EventQueue(size_t length);
+
+    // Any user thread. Returns false if the queue is full.
+    bool schedule(int64_t frameTime, const void *data, size_t size);
+
+    // Audio thread only. beginPeriod() collects the events that fall
+    // before periodStart + frameCount, which events() then returns, in
+    // frame order, until endPeriod() discards them.
+    void beginPeriod(int64_t periodStart, size_t frameCount);
+    const HowieEvent *events() const { return due_.get(); }
+    size_t eventCount() const { return dueCount_; }
+    void endPeriod();
+
+  private:
+    // Sized to make each record a single cache line.
+    struct Record {
+      int64_t frameTime;
+      uint32_t size;
+      unsigned char data[HOWIE_EVENT_MAX_SIZE];
+    };
+
+    size_t length_;
+    Ringbuffer<Record> incoming_;
+    std::atomic<bool> writing_ {false};
+
+    // Sorted by frame time. Audio thread only.
+    std::unique_ptr<Record[]> pending_;
+    size_t pendingCount_ = 0;
+    std::unique_ptr<HowieEvent[]> due_;
+    size_t dueCount_ = 0;
+
+    void insert(const Record &record);
+  };
+
+} // namespace howie
+
+#endif // HOWIE_EVENTQUEUE_H
@@ -0,0 +1,192 @@
+/*
+ * Copyright 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#include "howie_jni.h"
+#include "howie-private.h"
+#include "StreamImpl.h"
+
+/**
+ * Native side of HowieStream.java.
+ *
+ * The Java side maps all of a stream's parameter slots once, as one
+ * direct ByteBuffer, and thereafter only passes slot indices back and
+ * forth, so acquiring and committing a slot needs nothing but primitives.
+ * That lets those calls be @CriticalNative, which skips most of the cost
+ * of a JNI transition. @CriticalNative methods get no JNIEnv or jclass, so
+ * each one has a twin with the ordinary signature for devices where app
+ * classes can't use the annotation, which is everything before Android 9;
+ * registerNatives() picks the set to use. Registering the critical set
+ * where the runtime ignores the annotation would hand them a JNIEnv as
+ * the stream.
+ *
+ * A @CriticalNative call holds off the garbage collector for every thread
+ * until it returns, so the critical methods never wait or log: they call
+ * the stream directly rather than through the C API, whose checks log
+ * failures. Only acquiring with a timeout can wait, and that always goes
+ * through an ordinary JNI method.
+ */
+namespace {
+
+  // One entry of a HowieStream.Batch; the Java side writes these into a
+  // direct ByteBuffer in native byte order.
+  struct BatchEntry {
+    int64_t stream;
+    int32_t slot;
+    int32_t reserved;
+  };
+  static_assert(sizeof(BatchEntry) == 16, "Must match HowieStream.Batch");
+
+  howie::StreamImpl *toStream(jlong stream) {
+    HowieStream *pStream = reinterpret_cast<HowieStream *>(stream);
+    if (!HOWIE_SUCCEEDED(
+        howie::checkCast<const howie::StreamImpl*>(pStream))) {
+      return nullptr;
+    }
+    return static_cast<howie::StreamImpl *>(pStream);
+  }
+
+  jint slotIndex(howie::StreamImpl *pStream, const void *slot) {
+    size_t offset = static_cast<const unsigned char *>(slot)
+                    - pStream->parameterStorage();
+    return static_cast<jint>(offset / pStream->parameterStride());
+  }
+
+  // Returns the index of the acquired slot, or -1 if another thread holds
+  // it. Never waits.
+  jint tryAcquireSlot(jlong stream) {
+    howie::StreamImpl *pStream = toStream(stream);
+    unsigned char *slot = pStream ? pStream->AcquireParameterSlot(0)
+                                  : nullptr;
+    return slot ? slotIndex(pStream, slot) : -1;
+  }
+
+  jboolean commitSlot(jlong stream, jint index) {
+    howie::StreamImpl *pStream = toStream(stream);
+    if (!pStream || index < 0) {
+      return JNI_FALSE;
+    }
+    size_t offset = static_cast<size_t>(index) * pStream->parameterStride();
+    if (offset >= pStream->parameterStorageSize()) {
+      return JNI_FALSE;
+    }
+    // The pipe itself rejects anything but the slot that was acquired.
+    return pStream->CommitParameterSlot(pStream->parameterStorage() + offset)
+           ? JNI_TRUE : JNI_FALSE;
+  }
+
+  // Returns the number of entries committed.
+  jint commitSlots(jlong entries, jint count) {
+    const BatchEntry *entry = reinterpret_cast<const BatchEntry *>(entries);
+    jint committed = 0;
+    for (jint i = 0; entry && i < count; ++i) {
+      if (commitSlot(entry[i].stream, entry[i].slot)) {
+        ++committed;
+      }
+    }
+    return committed;
+  }
+
+  // Returns the index of the acquired slot, or -1. Can wait for up to
+  // timeoutMs, so this one is never @CriticalNative.
+  jint acquireSlotJni(JNIEnv *, jclass, jlong stream, jint timeoutMs) {
+    howie::StreamImpl *pStream = toStream(stream);
+    void *slot = nullptr;
+    if (!pStream
+        || !HOWIE_SUCCEEDED(HowieStreamAcquireParameterSlot(
+            pStream, &slot, nullptr, timeoutMs))) {
+      return -1;
+    }
+    return slotIndex(pStream, slot);
+  }
+
+  jint tryAcquireSlotJni(JNIEnv *, jclass, jlong stream) {
+    return tryAcquireSlot(stream);
+  }
+
+  jboolean commitSlotJni(JNIEnv *, jclass, jlong stream, jint index) {
+    return commitSlot(stream, index);
+  }
+
+  jint commitSlotsJni(JNIEnv *, jclass, jlong entries, jint count) {
+    return commitSlots(entries, count);
+  }
+
+} // namespace
+
+JNIEXPORT jboolean JNICALL
+Java_com_example_android_howie_HowieStream_registerNatives(
+    JNIEnv *env,
+    jclass type,
+    jboolean critical) {
+  HOWIE_TRACE_FN(HOWIE_TRACE_LEVEL_CALLS)
+  const JNINativeMethod criticalMethods[] = {
+      { "acquireSlot", "(JI)I", reinterpret_cast<void *>(acquireSlotJni) },
+      { "tryAcquireSlot", "(J)I", reinterpret_cast<void *>(tryAcquireSlot) },
+      { "commitSlot", "(JI)Z", reinterpret_cast<void *>(commitSlot) },
+      { "commitSlots", "(JI)I", reinterpret_cast<void *>(commitSlots) },
+  };
+  const JNINativeMethod methods[] = {
+      { "acquireSlot", "(JI)I", reinterpret_cast<void *>(acquireSlotJni) },
+      { "tryAcquireSlot", "(J)I",
+        reinterpret_cast<void *>(tryAcquireSlotJni) },
+      { "commitSlot", "(JI)Z", reinterpret_cast<void *>(commitSlotJni) },
+      { "commitSlots", "(JI)I", reinterpret_cast<void *>(commitSlotsJni) },
+  };
+  const jint methodCount = sizeof(methods) / sizeof(methods[0]);
+  return env->RegisterNatives(type, critical ? criticalMethods : methods,
+                              methodCount) == JNI_OK ? JNI_TRUE : JNI_FALSE;
+}
+
+JNIEXPORT jobject JNICALL
+Java_com_example_android_howie_HowieStream_parameterStorage(
+    JNIEnv *env,
+    jclass type,
+    jlong stream) {
+  HOWIE_TRACE_FN(HOWIE_TRACE_LEVEL_CALLS)
+  howie::StreamImpl *pStream = toStream(stream);
+  if (!pStream || pStream->parameterBlockSize() == 0) {
+    return nullptr;
+  }
+  return env->NewDirectByteBuffer(
+      pStream->parameterStorage(),
+      static_cast<jlong>(pStream->parameterStorageSize()));
+}
+
+JNIEXPORT jint JNICALL
+Java_com_example_android_howie_HowieStream_parameterStride(
+    JNIEnv *env,
+    jclass type,
+    jlong stream) {
+  howie::StreamImpl *pStream = toStream(stream);
+  return pStream ? static_cast<jint>(pStream->parameterStride()) : 0;
+}
+
+JNIEXPORT jint JNICALL
+Java_com_example_android_howie_HowieStream_parameterBlockSize(
+    JNIEnv *env,
+    jclass type,
+    jlong stream) {
+  howie::StreamImpl *pStream = toStream(stream);
+  return pStream ? static_cast<jint>(pStream->parameterBlockSize()) : 0;
+}
+
+JNIEXPORT jlong JNICALL
+Java_com_example_android_howie_HowieStream_bufferAddress(
+    JNIEnv *env,
+    jclass type,
+    jobject buffer) {
+  return reinterpret_cast<jlong>(env->GetDirectBufferAddress(buffer));
+}
@@ -0,0 +1,281 @@
+/*
+ * Copyright 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#include "howie-private.h"
+#include "EngineImpl.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+namespace {
+  // The test pulse is one period of a 9 bit maximum length sequence.
+  constexpr int kMlsLength = 511;
+  constexpr uint32_t kMlsSeed = 1;
+
+  // A pulse counts as detected if its correlation peak stands this far
+  // above the average correlation over the search window. A clean
+  // loopback gives about sqrt(kMlsLength), or 22.
+  constexpr float kDetectionRatio = 6.f;
+
+  constexpr int kDefaultDurationMs = 10000;
+  constexpr int kDefaultPulseIntervalMs = 500;
+  constexpr float kDefaultAmplitude = 0.5f;
+
+  // Galois LFSR for x^9 + x^5 + 1, which has period 511.
+  inline float nextMlsSample(uint32_t *lfsr, float amplitude) {
+    bool bit = *lfsr & 1;
+    *lfsr >>= 1;
+    if (bit) {
+      *lfsr ^= 0x110;
+    }
+    return bit ? amplitude : -amplitude;
+  }
+
+  struct PulseParams {
+    int intervalFrames;
+    float amplitude;
+    int channelCount;
+  };
+
+  struct PulseState {
+    int64_t frame;
+    uint32_t lfsr;
+  };
+
+  /**
+   * Plays a pulse at the start of every interval but the first, on every
+   * channel. Counting from the first callback, pulse k starts at output
+   * frame k * intervalFrames.
+   */
+  HowieError onProcess(const HowieStream * /* stream */,
+                       const HowieBuffer * /* in */,
+                       const HowieBuffer *out,
+                       const HowieBuffer *state,
+                       const HowieBuffer *params) {
+    const PulseParams *pulse = reinterpret_cast<const PulseParams *>(params->data);
+    PulseState *pulseState = reinterpret_cast<PulseState *>(state->data);
+    float *dest = reinterpret_cast<float *>(out->data);
+    int channelCount = std::max(pulse->channelCount, 1);
+    size_t frameCount = out->byteCount / (sizeof(float) * channelCount);
+
+    for (size_t i = 0; i < frameCount; ++i, ++pulseState->frame) {
+      float sample = 0.f;
+      if (pulse->intervalFrames > 0
+          && pulseState->frame >= pulse->intervalFrames) {
+        int64_t position = pulseState->frame % pulse->intervalFrames;
+        if (position == 0) {
+          pulseState->lfsr = kMlsSeed;
+        }
+        if (position < kMlsLength) {
+          sample = nextMlsSample(&pulseState->lfsr, pulse->amplitude);
+        }
+      }
+      for (int c = 0; c < channelCount; ++c) {
+        dest[i * channelCount + c] = sample;
+      }
+    }
+    return HOWIE_SUCCESS;
+  }
+
+  /**
+   * Finds the pulse in a window of input that starts where the pulse
+   * started in the output, and returns its offset in frames, or -1 if
+   * there's no clear peak.
+   */
+  int findPulse(const std::vector<float> &window,
+                const std::vector<float> &reference,
+                int searchFrames) {
+    float peak = 0.f;
+    int peakOffset = -1;
+    double total = 0.;
+    for (int offset = 0; offset < searchFrames; ++offset) {
+      float sum = 0.f;
+      for (int j = 0; j < kMlsLength; ++j) {
+        sum += window[offset + j] * reference[j];
+      }
+      // The path to the microphone may invert the signal.
+      sum = std::fabs(sum);
+      total += sum;
+      if (sum > peak) {
+        peak = sum;
+        peakOffset = offset;
+      }
+    }
+    float mean = static_cast<float>(total / searchFrames);
+    return (peak > 0.f && peak > kDetectionRatio * mean) ? peakOffset : -1;
+  }
+} // namespace
+
+/**
+ * Implements the C interface for the latency benchmark
+ */
+HowieError HowieRunLatencyBenchmark(
+    const HowieLatencyBenchmarkParams *params,
+    HowieLatencyBenchmarkResult *result) {
+  HOWIE_TRACE_FN(HOWIE_TRACE_LEVEL_CALLS)
+  HOWIE_CHECK_ENGINE_INITIALIZED();
+  HOWIE_CHECK_NOT_NULL(params);
+  HOWIE_CHECK_NOT_NULL(result);
+  HOWIE_CHECK(howie::checkCast<const HowieLatencyBenchmarkParams*>(params));
+  HOWIE_CHECK(howie::checkCast<const HowieLatencyBenchmarkResult*>(result));
+
+  HowieDeviceCharacteristics device;
+  device.version = sizeof(device);
+  HOWIE_CHECK(HowieGetDeviceCharacteristics(&device));
+
+  int durationMs = params->durationMs > 0 ? params->durationMs
+                                          : kDefaultDurationMs;
+  int intervalMs = params->pulseIntervalMs > 0 ? params->pulseIntervalMs
+                                               : kDefaultPulseIntervalMs;
+  PulseParams pulse;
+  pulse.intervalFrames = static_cast<int>(
+      static_cast<int64_t>(intervalMs) * device.sampleRate / 1000);
+  pulse.amplitude = params->amplitude > 0.f ? params->amplitude
+                                            : kDefaultAmplitude;
+  pulse.channelCount = device.samplesPerFrame;
+  if (pulse.intervalFrames < 2 * kMlsLength) {
+    HOWIE_CHECK(HOWIE_ERROR_INVALID_PARAMETER);
+  }
+
+  // Give the capture ring a second of slack, which is far more than this
+  // thread should ever fall behind by.
+  size_t captureBufferPeriods = device.sampleRate / device.framesPerPeriod + 1;
+  HowieStreamCreationParams creationParams = {
+      sizeof(HowieStreamCreationParams),
+      HOWIE_STREAM_DIRECTION_BOTH,
+      nullptr,
+      onProcess,
+      nullptr,
+      sizeof(PulseState),
+      sizeof(PulseParams),
+      HOWIE_STREAM_STATE_STOPPED,
+      params->playbackBufferCount,
+      HOWIE_SAMPLE_FORMAT_FLOAT,
+      false,
+      captureBufferPeriods,
+      nullptr,
+      0,
+      0,
+      0,
+      0,
+      0,
+      false,
+      0,
+      false,
+      false,
+      0,
+      0.f
+  };
+  HowieStream *stream = nullptr;
+  HOWIE_CHECK(HowieStreamCreate(&creationParams, &stream));
+  HOWIE_CHECK(HowieStreamSendParameters(stream, &pulse, sizeof(pulse), 100));
+  HOWIE_CHECK(HowieStreamSetState(stream, HOWIE_STREAM_STATE_PLAYING));
+
+  // reference holds the pulse as emitted. window holds the input from
+  // where the current pulse started in the output to where the next pulse
+  // started, plus enough to correlate against the end of the interval.
+  std::vector<float> reference(kMlsLength);
+  uint32_t lfsr = kMlsSeed;
+  for (auto &sample : reference) {
+    sample = nextMlsSample(&lfsr, 1.f);
+  }
+  std::vector<float> window(pulse.intervalFrames + kMlsLength);
+  size_t windowFill = 0;
+  int64_t windowStart = pulse.intervalFrames;
+
+  std::vector<float> chunk(device.framesPerPeriod * pulse.channelCount * 4);
+  std::vector<int> latencies;
+  int pulseCount = 0;
+
+  const int64_t totalFrames =
+      static_cast<int64_t>(durationMs) * device.sampleRate / 1000;
+  auto deadline = std::chrono::steady_clock::now()
+                  + std::chrono::milliseconds(durationMs + 2000);
+  int64_t inputFrame = 0;
+  HowieError error = HOWIE_SUCCESS;
+  while (inputFrame < totalFrames
+         && std::chrono::steady_clock::now() < deadline) {
+    size_t bytesRead = 0;
+    HowieError readResult = HowieStreamReadCaptured(
+        stream, chunk.data(), chunk.size() * sizeof(float), &bytesRead, 100);
+    if (readResult == HOWIE_ERROR_AGAIN) {
+      continue;
+    } else if (!HOWIE_SUCCEEDED(readResult)) {
+      error = readResult;
+      break;
+    }
+
+    size_t frameCount = bytesRead / (sizeof(float) * pulse.channelCount);
+    for (size_t i = 0; i < frameCount; ++i, ++inputFrame) {
+      if (inputFrame < windowStart) {
+        continue;
+      }
+      window[windowFill++] = chunk[i * pulse.channelCount];
+      if (windowFill == window.size()) {
+        int latency = findPulse(window, reference, pulse.intervalFrames);
+        if (latency >= 0) {
+          latencies.push_back(latency);
+        }
+        ++pulseCount;
+        // The tail of this window is the start of the next one.
+        std::copy(window.end() - kMlsLength, window.end(), window.begin());
+        windowFill = kMlsLength;
+        windowStart += pulse.intervalFrames;
+      }
+    }
+  }
+
+  HowieStreamStatistics stats;
+  stats.version = sizeof(stats);
+  HowieError statsResult = HowieStreamGetStatistics(stream, &stats);
+  HowieStreamSetState(stream, HOWIE_STREAM_STATE_STOPPED);
+  HowieStreamDestroy(stream);
+  HOWIE_CHECK(error);
+  HOWIE_CHECK(statsResult);
+  if (stats.captureOverflowCount > 0) {
+    // Input went missing, so the pulse positions can't be trusted.
+    HOWIE_CHECK(HOWIE_ERROR_IO);
+  }
+
+  memset(result, 0, sizeof(*result));
+  result->version = sizeof(*result);
+  result->pulseCount = pulseCount;
+  result->detectedCount = static_cast<int>(latencies.size());
+  if (!latencies.empty()) {
+    double msPerFrame = 1000. / device.sampleRate;
+    double sum = 0.;
+    double sumOfSquares = 0.;
+    for (int latency : latencies) {
+      sum += latency;
+      sumOfSquares += static_cast<double>(latency) * latency;
+    }
+    double mean = sum / latencies.size();
+    double variance = std::max(0., sumOfSquares / latencies.size()
+                                   - mean * mean);
+    result->minLatencyMs = static_cast<float>(
+        *std::min_element(latencies.begin(), latencies.end()) * msPerFrame);
+    result->maxLatencyMs = static_cast<float>(
+        *std::max_element(latencies.begin(), latencies.end()) * msPerFrame);
+    result->meanLatencyMs = static_cast<float>(mean * msPerFrame);
+    result->jitterMs = static_cast<float>(std::sqrt(variance) * msPerFrame);
+  }
+  result->underrunCount = stats.underrunCount;
+  result->missedRecordBufferCount = stats.missedRecordBufferCount;
+  result->inputResyncCount = stats.inputResyncCount;
+  return HOWIE_SUCCESS;
+}
@@ -0,0 +1,59 @@
+/*
+ * Copyright 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#include "LatencyController.h"
+
+namespace howie {
+
+  LatencyController::LatencyController(unsigned int minDepth,
+                                       unsigned int maxDepth,
+                                       int64_t periodNs,
+                                       int64_t stableWindowNs)
+      : minDepth_(minDepth),
+        maxDepth_(maxDepth > minDepth ? maxDepth : minDepth),
+        periodNs_(periodNs),
+        stableWindowNs_(stableWindowNs),
+        depth_(minDepth) {
+  }
+
+  void LatencyController::update(uint32_t underrunCount,
+                                 int64_t intervalNs,
+                                 int64_t nowNs) {
+    unsigned int depth = depth_.load(std::memory_order_relaxed);
+
+    // StreamStatistics calls it an underrun when the interval is more than
+    // half a period longer than the queue, so this is the interval that
+    // would have been an underrun with one period less queued.
+    int64_t nearMissNs = periodNs_ * (depth - 1) + periodNs_ / 2;
+
+    if (underrunCount != underrunCount_) {
+      underrunCount_ = underrunCount;
+      lastTroubleNs_ = nowNs;
+      if (depth < maxDepth_) {
+        ++depth;
+      }
+    } else if (intervalNs > nearMissNs && depth > minDepth_) {
+      lastTroubleNs_ = nowNs;
+    } else if (nowNs - lastTroubleNs_ >= stableWindowNs_
+               && depth > minDepth_) {
+      // Start a new window, so that each step down has to earn its keep.
+      lastTroubleNs_ = nowNs;
+      --depth;
+    }
+    depth_.store(depth, std::memory_order_relaxed);
+  }
+
+} // namespace howie
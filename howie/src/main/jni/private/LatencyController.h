@@ -0,0 +1,64 @@
+/*
+ * Copyright 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#ifndef HOWIE_LATENCYCONTROLLER_H
+#define HOWIE_LATENCYCONTROLLER_H
+
+#include <atomic>
+#include <stdint.h>
+
+namespace howie {
+
+  /**
+   * Chooses how many periods of output to keep queued, between a minimum
+   * and a maximum, from one callback to the next.
+   *
+   * Every underrun adds a period. A callback that came late enough to have
+   * underrun with one period less counts as a near miss, and a period is
+   * only taken away again once a whole stable window has gone by without
+   * underruns or near misses.
+   */
+  class LatencyController {
+  public:
+    LatencyController(unsigned int minDepth,
+                      unsigned int maxDepth,
+                      int64_t periodNs,
+                      int64_t stableWindowNs);
+
+    // Audio thread only. Call after each callback with the stream's
+    // underrun count so far and the interval between that callback and the
+    // one before, or zero if there wasn't one.
+    void update(uint32_t underrunCount, int64_t intervalNs, int64_t nowNs);
+
+    // The queue depth to aim for. Any thread may read it.
+    unsigned int depth() const {
+      return depth_.load(std::memory_order_relaxed);
+    }
+
+  private:
+    const unsigned int minDepth_;
+    const unsigned int maxDepth_;
+    const int64_t periodNs_;
+    const int64_t stableWindowNs_;
+
+    std::atomic<unsigned int> depth_;
+    uint32_t underrunCount_ = 0;
+    int64_t lastTroubleNs_ = 0;
+  };
+
+} // namespace howie
+
+#endif // HOWIE_LATENCYCONTROLLER_H
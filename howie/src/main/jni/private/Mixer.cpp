@@ -0,0 +1,178 @@
+/*
+ * Copyright 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#include "Mixer.h"
+#include "howie-private.h"
+#include "../howie_dsp.h"
+#include <algorithm>
+#include <cstring>
+#include <thread>
+
+namespace howie {
+
+  const HowieStreamCreationParams Mixer::kCreationParams = {
+      sizeof(HowieStreamCreationParams),
+      HOWIE_STREAM_DIRECTION_PLAYBACK,
+      nullptr, // deviceChangedCallback
+      nullptr, // processCallback; render() is overridden instead
+      nullptr, // cleanupCallback
+      0,       // sizeofStateBlock
+      0,       // sizeofParameterBlock
+      HOWIE_STREAM_STATE_PLAYING,
+      0,       // default playback buffer count
+      HOWIE_SAMPLE_FORMAT_FLOAT,
+      false,   // sharedOutput
+      0,       // captureBufferPeriods
+      nullptr, // commandCallback
+      0,       // eventQueueLength
+      0,       // sizeofReport
+      0,       // reportQueueLength
+      0,       // maxPlaybackBufferCount: a fixed queue depth
+      0,       // latencyStableWindowMs
+      false,   // offline
+      0,       // sampleRate: the device's
+      false,   // planar
+      false,   // idleWhenSilent
+      0,       // idleSilentPeriods
+      0.f,     // idleThreshold
+  };
+
+  Mixer::Mixer(const HowieDeviceCharacteristics &deviceCharacteristics)
+      : StreamImpl(deviceCharacteristics, kCreationParams),
+        scratch_(deviceCharacteristics.framesPerPeriod
+                 * deviceCharacteristics.samplesPerFrame * sizeof(float)) {
+    for (auto &voice : voices_) {
+      voice.store(nullptr, std::memory_order_relaxed);
+    }
+  }
+
+  Mixer::~Mixer() {
+    // Closing the backend waits for any callback in progress, so after
+    // this nobody can be using the pool.
+    closeBackend();
+    delete pool_.exchange(nullptr);
+  }
+
+
+  HowieError Mixer::attach(StreamImpl *stream) {
+    HOWIE_TRACE_FN(HOWIE_TRACE_LEVEL_CALLS)
+    for (auto &voice : voices_) {
+      StreamImpl *expected = nullptr;
+      if (voice.compare_exchange_strong(expected, stream)) {
+        return HOWIE_SUCCESS;
+      }
+    }
+    __android_log_print(ANDROID_LOG_WARN, kLibName,
+                        "The shared output is full (%d streams)", kMaxVoices);
+    return HOWIE_ERROR_AGAIN;
+  }
+
+  void Mixer::detach(StreamImpl *stream) {
+    HOWIE_TRACE_FN(HOWIE_TRACE_LEVEL_CALLS)
+    for (auto &voice : voices_) {
+      StreamImpl *expected = stream;
+      voice.compare_exchange_strong(expected, nullptr);
+    }
+    waitForMixCycle();
+  }
+
+  void Mixer::setThreadCount(int threadCount) {
+    HOWIE_TRACE_FN(HOWIE_TRACE_LEVEL_CALLS)
+    RealtimePool *pool = threadCount > 0 ? new RealtimePool(threadCount)
+                                         : nullptr;
+    RealtimePool *old = pool_.exchange(pool);
+    audioThread().setHelperThreads(pool ? pool->threadIds() : nullptr,
+                                   pool ? pool->threadCount() : 0);
+    waitForMixCycle();
+    delete old;
+  }
+
+  /**
+   * Wait until the audio thread can no longer be using anything that was
+   * unpublished (from voices_ or pool_) before this call.
+   */
+  void Mixer::waitForMixCycle() {
+    // render() sets mixing_ before loading any voice or the pool, and the
+    // caller cleared those before we load mixing_. Both are sequentially
+    // consistent, so if the audio thread isn't mixing now, it will see the
+    // cleared value next time. If it is mixing, wait for that cycle to end.
+    unsigned int cycle = cycles_.load();
+    while (mixing_.load() && cycles_.load() == cycle) {
+      std::this_thread::yield();
+    }
+  }
+
+  HowieError Mixer::render(const HowieBuffer *in,
+                           const HowieBuffer *out,
+                           const HowieBuffer *state,
+                           const HowieBuffer *params) {
+    HOWIE_TRACE_FN(HOWIE_TRACE_LEVEL_REALTIME);
+    float *mix = reinterpret_cast<float *>(out->data);
+    size_t count = out->byteCount / sizeof(float);
+    memset(out->data, 0, out->byteCount);
+
+    mixing_.store(true);
+    int activeCount = 0;
+    for (auto &voice : voices_) {
+      StreamImpl *stream = voice.load();
+      if (stream && stream->getState() == HOWIE_STREAM_STATE_PLAYING) {
+        active_[activeCount++] = stream;
+      }
+    }
+
+    RealtimePool *pool = pool_.load();
+    if (pool && activeCount > 1) {
+      pool->run(renderVoice, this, activeCount);
+    } else {
+      for (int i = 0; i < activeCount; ++i) {
+        renderVoice(this, i);
+      }
+    }
+
+    // A failing stream just drops out of this period's mix; it shouldn't
+    // silence everybody else. Idle streams have nothing to add.
+    for (int i = 0; i < activeCount; ++i) {
+      if (rendered_[i] && !active_[i]->idle()) {
+        accumulate(active_[i], mix, count);
+      }
+    }
+    cycles_.fetch_add(1);
+    mixing_.store(false);
+    return HOWIE_SUCCESS;
+  }
+
+  void Mixer::renderVoice(void *context, int index) {
+    Mixer *mixer = static_cast<Mixer *>(context);
+    mixer->rendered_[index] =
+        HOWIE_SUCCEEDED(mixer->active_[index]->processShared());
+  }
+
+  void Mixer::accumulate(StreamImpl *voice, float *mix, size_t count) {
+    HowieBuffer output = voice->sharedOutputBuffer();
+    if (voice->sampleFormat() == HOWIE_SAMPLE_FORMAT_FLOAT) {
+      count = std::min(count, output.byteCount / sizeof(float));
+      HowieDspMixAccumulate(reinterpret_cast<const float *>(output.data),
+                            mix, 1.f, count);
+    } else {
+      count = std::min(count, output.byteCount / sizeof(int16_t));
+      float *converted = reinterpret_cast<float *>(scratch_.get());
+      HowieDspInt16ToFloat(reinterpret_cast<const int16_t *>(output.data),
+                           converted, count);
+      HowieDspMixAccumulate(converted, mix, 1.f, count);
+    }
+  }
+
+} // namespace howie
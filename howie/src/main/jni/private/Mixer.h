@@ -0,0 +1,91 @@
+/*
+ * Copyright 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#ifndef HOWIE_MIXER_H
+#define HOWIE_MIXER_H
+
+#include <atomic>
+#include "RealtimePool.h"
+#include "StreamImpl.h"
+
+namespace howie {
+
+  /**
+   * The shared output. A Mixer is a float playback stream whose render()
+   * runs the process callbacks of every attached stream, one after the
+   * other on its own audio thread, and sums their output.
+   *
+   * Streams are attached and detached on the worker thread. The audio
+   * thread only ever reads the voice table, so neither side locks.
+   *
+   * With a RealtimePool installed, the attached streams' callbacks run in
+   * parallel, each into its own output buffer. The audio thread waits for
+   * all of them at the end of the period and then sums the buffers in
+   * voice order, so the mix is the same however the work was split.
+   */
+  class Mixer : public StreamImpl {
+  public:
+    // Maximum number of streams that can share the output at once.
+    static constexpr int kMaxVoices = 32;
+
+    explicit Mixer(const HowieDeviceCharacteristics &deviceCharacteristics);
+    ~Mixer();
+
+    // What the shared output passes to StreamImpl::init().
+    static const HowieStreamCreationParams kCreationParams;
+
+    HowieError attach(StreamImpl *stream);
+
+    // Removes the stream from the voice table and waits until the audio
+    // thread is guaranteed not to touch it again.
+    void detach(StreamImpl *stream);
+
+    // Replaces the pool used to process streams in parallel. Zero threads
+    // processes everything on the audio thread. Call on the worker thread.
+    void setThreadCount(int threadCount);
+
+  protected:
+    HowieError render(const HowieBuffer *in,
+                      const HowieBuffer *out,
+                      const HowieBuffer *state,
+                      const HowieBuffer *params) override;
+
+  private:
+    std::atomic<StreamImpl *> voices_[kMaxVoices];
+
+    std::atomic<RealtimePool *> pool_ {nullptr};
+
+    // The playing streams of the current period and whether each rendered
+    // successfully. Only touched during render().
+    StreamImpl *active_[kMaxVoices];
+    bool rendered_[kMaxVoices];
+
+    // Used by detach() to tell whether the audio thread might still be
+    // holding a pointer it loaded from voices_.
+    std::atomic<bool> mixing_ {false};
+    std::atomic<unsigned int> cycles_ {0};
+
+    // Conversion buffer for streams that render 16 bit samples.
+    unique_buffer scratch_;
+
+    void accumulate(StreamImpl *voice, float *mix, size_t count);
+    void waitForMixCycle();
+    static void renderVoice(void *context, int index);
+  };
+
+} // namespace howie
+
+#endif // HOWIE_MIXER_H
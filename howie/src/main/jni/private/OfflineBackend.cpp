@@ -0,0 +1,80 @@
+/*
+ * Copyright 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#include "OfflineBackend.h"
+#include "howie-private.h"
+#include "StreamStatistics.h"
+
+namespace howie {
+
+  HowieError OfflineBackend::open(const Config &config,
+                                  Client *client,
+                                  HowieDeviceCharacteristics *characteristics) {
+    HOWIE_TRACE_FN(HOWIE_TRACE_LEVEL_CALLS)
+    HOWIE_CHECK_NOT_NULL(client);
+    HOWIE_CHECK_NOT_NULL(characteristics);
+
+    // With no device to convert for, the callback gets exactly the format
+    // it asked for.
+    if (config.sampleFormat == HOWIE_SAMPLE_FORMAT_FLOAT) {
+      useFloatCharacteristics(characteristics);
+    }
+    client_ = client;
+    direction_ = config.direction;
+    framesPerPeriod_ = characteristics->framesPerPeriod;
+    bytesPerFrame_ = characteristics->bytesPerSample
+                     * characteristics->samplesPerFrame;
+    client->statistics().configure(periodNs(*characteristics), 1);
+    return HOWIE_SUCCESS;
+  }
+
+  HowieError OfflineBackend::render(size_t frameCount,
+                                    const HowieBuffer *in,
+                                    const HowieBuffer *out) {
+    HOWIE_TRACE_FN(HOWIE_TRACE_LEVEL_CALLS)
+    bool record = (direction_ & HOWIE_STREAM_DIRECTION_RECORD) != 0;
+    bool play = (direction_ & HOWIE_STREAM_DIRECTION_PLAYBACK) != 0;
+    size_t byteCount = frameCount * bytesPerFrame_;
+    if (frameCount % framesPerPeriod_ != 0) {
+      HOWIE_CHECK(HOWIE_ERROR_INVALID_PARAMETER);
+    }
+    if (record) {
+      HOWIE_CHECK_NOT_NULL(in);
+      if (in->byteCount < byteCount) {
+        HOWIE_CHECK(HOWIE_ERROR_INVALID_PARAMETER);
+      }
+    }
+    if (play) {
+      HOWIE_CHECK_NOT_NULL(out);
+      if (out->byteCount < byteCount) {
+        HOWIE_CHECK(HOWIE_ERROR_INVALID_PARAMETER);
+      }
+    }
+
+    size_t periodBytes = framesPerPeriod_ * bytesPerFrame_;
+    for (size_t offset = 0; offset < byteCount; offset += periodBytes) {
+      HowieBuffer periodIn { sizeof(HowieBuffer),
+                             record ? in->data + offset : nullptr,
+                             record ? periodBytes : 0 };
+      HowieBuffer periodOut { sizeof(HowieBuffer),
+                              play ? out->data + offset : nullptr,
+                              play ? periodBytes : 0 };
+      HOWIE_CHECK(client_->onPeriod(&periodIn, &periodOut));
+    }
+    return HOWIE_SUCCESS;
+  }
+
+} // namespace howie
@@ -0,0 +1,54 @@
+/*
+ * Copyright 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#ifndef HOWIE_OFFLINEBACKEND_H
+#define HOWIE_OFFLINEBACKEND_H
+
+#include "StreamBackend.h"
+
+namespace howie {
+
+  /**
+   * Runs a stream without a device. There's no audio thread: the app
+   * renders the stream's periods itself with HowieStreamRender, which
+   * cuts its buffers into periods and hands them to the stream one after
+   * the other, as fast as the process callback gets through them.
+   */
+  class OfflineBackend : public StreamBackend {
+  public:
+    OfflineBackend() {}
+
+    HowieError open(const Config &config,
+                    Client *client,
+                    HowieDeviceCharacteristics *characteristics) override;
+    HowieError start() override { return HOWIE_SUCCESS; }
+    HowieError stop() override { return HOWIE_SUCCESS; }
+    HowieError render(size_t frameCount,
+                      const HowieBuffer *in,
+                      const HowieBuffer *out) override;
+    void getStatistics(HowieStreamStatistics * /* dest */) const override {}
+    const char *name() const override { return "offline"; }
+
+  private:
+    Client *client_ = nullptr;
+    HowieDirection direction_ = HOWIE_STREAM_DIRECTION_PLAYBACK;
+    size_t framesPerPeriod_ = 0;
+    size_t bytesPerFrame_ = 0;
+  };
+
+} // namespace howie
+
+#endif // HOWIE_OFFLINEBACKEND_H
@@ -0,0 +1,603 @@
+/*
+ * Copyright 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#include "OpenSLBackend.h"
+#include "howie-private.h"
+#include "RealtimeLog.h"
+#include "StreamStatistics.h"
+#include "../howie_dsp.h"
+#include <cstring>
+
+namespace howie {
+  HowieError OpenSLBackend::lastPlaybackError_ = HOWIE_SUCCESS;
+  HowieError OpenSLBackend::lastRecordError_ = HOWIE_SUCCESS;
+
+  OpenSLBackend::OpenSLBackend(SLEngineItf engineItf,
+                               SLObjectItf outputMixObject,
+                               StreamPool *streamPool)
+      : engineItf_(engineItf),
+        outputMixObject_(outputMixObject),
+        streamPool_(streamPool) {
+  }
+
+  OpenSLBackend::~OpenSLBackend() {
+    HOWIE_TRACE_FN(HOWIE_TRACE_LEVEL_CALLS)
+    destroyObjects();
+  }
+
+  /**
+   * Release the SL recorder and player, back to the pool if it wants them.
+   */
+  void OpenSLBackend::destroyObjects() {
+    HOWIE_TRACE_FN(HOWIE_TRACE_LEVEL_CALLS)
+    if (recorderObject_) {
+      StreamPool::Recorder recorder { recorderObject_, recorderItf_,
+                                      recorderBufferQueueItf_, recorderSlot_ };
+      recorderSlot_->unbind();
+      if (!streamPool_ || !streamPool_->recycleRecorder(floatObjects_,
+                                                        kRecordBufferCount,
+                                                        recorder)) {
+        StreamPool::destroy(recorder);
+      }
+      recorderObject_ = nullptr;
+      recorderItf_ = nullptr;
+      recorderBufferQueueItf_ = nullptr;
+      recorderSlot_ = nullptr;
+    }
+    if (playerObject_) {
+      StreamPool::Player player { playerObject_, playerItf_,
+                                  playerBufferQueueItf_, playerSlot_ };
+      playerSlot_->unbind();
+      if (!streamPool_ || !streamPool_->recyclePlayer(floatObjects_,
+                                                      playbackBufferCount_,
+                                                      player)) {
+        StreamPool::destroy(player);
+      }
+      playerObject_ = nullptr;
+      playerItf_ = nullptr;
+      playerBufferQueueItf_ = nullptr;
+      playerSlot_ = nullptr;
+    }
+  }
+
+  /**
+   * Initialize the OpenSL inputs and outputs for the stream.
+   */
+  HowieError OpenSLBackend::open(const Config &config,
+                                 Client *client,
+                                 HowieDeviceCharacteristics *characteristics) {
+    HOWIE_TRACE_FN(HOWIE_TRACE_LEVEL_CALLS)
+    HOWIE_CHECK_NOT_NULL(client);
+    HOWIE_CHECK_NOT_NULL(characteristics);
+    HowieError result = HOWIE_ERROR_UNKNOWN;
+    client_ = client;
+    stats_ = &client->statistics();
+    log_ = &client->realtimeLog();
+    direction_ = config.direction;
+    deviceCharacteristics_ = *characteristics;
+    playbackBufferCount_ = config.maxPlaybackBufferCount;
+
+    // configure the audio source (supply data through a buffer queue in PCM format)
+    SLDataFormat_PCM format_pcm;
+    StreamPool::makePcmFormat(deviceCharacteristics_, &format_pcm);
+
+    // The device's own sample size, which may be replaced below
+    size_t bytesPerSample = deviceCharacteristics_.bytesPerSample;
+
+    if (config.sampleFormat == HOWIE_SAMPLE_FORMAT_FLOAT) {
+      // Ask OpenSL for float first. Older devices reject it, in which
+      // case we run OpenSL in the device format and convert.
+      SLAndroidDataFormat_PCM_EX format_float;
+      StreamPool::makeFloatFormat(format_pcm, &format_float);
+
+      result = createObjects(&format_float);
+      if (HOWIE_SUCCEEDED(result)) {
+        bytesPerSample = sizeof(float);
+      } else if (deviceCharacteristics_.bytesPerSample != sizeof(int16_t)) {
+        // The conversion stage only understands 16 bit devices.
+        destroyObjects();
+        HOWIE_CHECK(result);
+      } else {
+        __android_log_print(ANDROID_LOG_INFO, kLibName,
+                            "Float PCM not supported (error %d); "
+                            "converting from %d bit samples instead",
+                            result, deviceCharacteristics_.bitsPerSample);
+        destroyObjects();
+        convertSamples_ = true;
+      }
+
+      useFloatCharacteristics(&deviceCharacteristics_);
+    }
+
+    if (!HOWIE_SUCCEEDED(result)) {
+      HOWIE_CHECK(createObjects(&format_pcm));
+    }
+
+    // Compute the buffer quantum
+    bufferQuantum_ = deviceCharacteristics_.framesPerPeriod
+                     * bytesPerSample
+                     * deviceCharacteristics_.samplesPerFrame;
+    if (playbackBufferCount_ > config.playbackBufferCount) {
+      latency_.reset(new LatencyController(
+          config.playbackBufferCount, playbackBufferCount_,
+          periodNs(deviceCharacteristics_),
+          static_cast<int64_t>(config.latencyStableWindowMs) * 1000000));
+    }
+    stats_->configure(periodNs(deviceCharacteristics_),
+                      direction_ == HOWIE_STREAM_DIRECTION_RECORD
+                      ? kRecordBufferCount
+                      : config.playbackBufferCount);
+
+    // Create the recording and playback buffers
+    if (direction_ & HOWIE_STREAM_DIRECTION_RECORD) {
+      client_->useBuffer(&input_, kInputBuffer,
+                         bufferQuantum_ * kRecordBufferCount);
+    }
+    if (direction_ & HOWIE_STREAM_DIRECTION_PLAYBACK) {
+      client_->useBuffer(&output_, kOutputBuffer,
+                         bufferQuantum_ * playbackBufferCount_);
+    }
+    size_t floatQuantum = deviceCharacteristics_.framesPerPeriod
+                          * sizeof(float)
+                          * deviceCharacteristics_.samplesPerFrame;
+    if (direction_ == HOWIE_STREAM_DIRECTION_BOTH
+        && (config.sampleFormat == HOWIE_SAMPLE_FORMAT_FLOAT
+            || bytesPerSample == sizeof(int16_t))) {
+      duplex_.reset(new DuplexSync(deviceCharacteristics_.samplesPerFrame,
+                                   deviceCharacteristics_.framesPerPeriod,
+                                   deviceCharacteristics_.sampleRate));
+      if (bytesPerSample == sizeof(int16_t)) {
+        client_->useBuffer(&recordFloat_, kRecordFloatBuffer, floatQuantum);
+      }
+      if (config.sampleFormat != HOWIE_SAMPLE_FORMAT_FLOAT) {
+        client_->useBuffer(&syncedInput_, kSyncedInputBuffer, bufferQuantum_);
+      }
+    }
+    if (convertSamples_ || duplex_) {
+      if (direction_ & HOWIE_STREAM_DIRECTION_RECORD) {
+        client_->useBuffer(&floatInput_, kFloatInputBuffer, floatQuantum);
+      }
+    }
+    if (convertSamples_) {
+      client_->useBuffer(&floatOutput_, kFloatOutputBuffer, floatQuantum);
+    }
+
+    if (direction_ & HOWIE_STREAM_DIRECTION_RECORD) {
+      // submit the first chunk
+      HOWIE_CHECK(submitRecordBuffer(*log_));
+      HOWIE_CHECK((*recorderItf_)->SetRecordState(recorderItf_,
+                                                  SL_RECORDSTATE_PAUSED));
+    }
+
+    if (direction_ & HOWIE_STREAM_DIRECTION_PLAYBACK) {
+      // fill the queue with silence
+      HOWIE_CHECK(submitPlaybackBuffers());
+      HOWIE_CHECK((*playerItf_)->SetPlayState(playerItf_,
+                                              SL_PLAYSTATE_PAUSED));
+    }
+
+    *characteristics = deviceCharacteristics_;
+    return HOWIE_SUCCESS;
+  }
+
+  /**
+   * Create the OpenSL recorder and/or player in the given format.
+   */
+  HowieError OpenSLBackend::createObjects(void *format) {
+    HOWIE_TRACE_FN(HOWIE_TRACE_LEVEL_CALLS)
+    floatObjects_ = *static_cast<SLuint32 *>(format)
+                    == SL_ANDROID_DATAFORMAT_PCM_EX;
+    if (direction_ & HOWIE_STREAM_DIRECTION_RECORD) {
+      HOWIE_CHECK(initRecording(format));
+    }
+
+    if (direction_ & HOWIE_STREAM_DIRECTION_PLAYBACK) {
+      HOWIE_CHECK(initPlayback(format));
+    }
+    return HOWIE_SUCCESS;
+  }
+
+  HowieError OpenSLBackend::initRecording(void *format) {
+    HOWIE_TRACE_FN(HOWIE_TRACE_LEVEL_CALLS)
+    StreamPool::Recorder recorder = {};
+    if (!streamPool_ || !streamPool_->takeRecorder(floatObjects_,
+                                                   kRecordBufferCount,
+                                                   &recorder)) {
+      HOWIE_CHECK(StreamPool::createRecorder(engineItf_, format,
+                                             kRecordBufferCount, &recorder));
+    }
+    recorderObject_ = recorder.object;
+    recorderItf_ = recorder.record;
+    recorderBufferQueueItf_ = recorder.queue;
+    recorderSlot_ = recorder.slot;
+    recorderSlot_->bind(bqRecorderCallback, this);
+    return HOWIE_SUCCESS;
+  }
+
+  HowieError OpenSLBackend::initPlayback(void *format) {
+    HOWIE_TRACE_FN(HOWIE_TRACE_LEVEL_CALLS)
+    StreamPool::Player player = {};
+    if (!streamPool_ || !streamPool_->takePlayer(floatObjects_,
+                                                 playbackBufferCount_,
+                                                 &player)) {
+      HOWIE_CHECK(StreamPool::createPlayer(engineItf_, outputMixObject_,
+                                           format, playbackBufferCount_,
+                                           &player));
+    }
+    playerObject_ = player.object;
+    playerItf_ = player.play;
+    playerBufferQueueItf_ = player.queue;
+    playerSlot_ = player.slot;
+    playerSlot_->bind(bqPlayerCallback, this);
+    return HOWIE_SUCCESS;
+  }
+
+  HowieError OpenSLBackend::submitRecordBuffer(RealtimeLog &log) {
+    HOWIE_TRACE_FN(HOWIE_TRACE_LEVEL_REALTIME);
+    while(countFreeBuffers() < kRecordBufferCount) {
+      size_t offset = (recordBuffersSubmitted_ % kRecordBufferCount) * bufferQuantum_;
+      ++recordBuffersSubmitted_;
+      HOWIE_CHECK_RT(log, (*recorderBufferQueueItf_)->Enqueue(
+          recorderBufferQueueItf_, input_.get() + offset, bufferQuantum_));
+    }
+    return HOWIE_SUCCESS;
+  }
+
+  /**
+   * Enqueue every playback slot, or as many as an adaptive queue starts
+   * with. Only used to prime the queue before the player starts; after
+   * that, process() resubmits one slot per callback.
+   */
+  HowieError OpenSLBackend::submitPlaybackBuffers() {
+    HOWIE_TRACE_FN(HOWIE_TRACE_LEVEL_CALLS);
+    unsigned int depth = latency_ ? latency_->depth() : playbackBufferCount_;
+    for (unsigned int i = 0; i < depth; ++i) {
+      size_t offset = (playBuffersSubmitted_ % playbackBufferCount_)
+                      * bufferQuantum_;
+      ++playBuffersSubmitted_;
+      ++playBuffersQueued_;
+      HOWIE_CHECK((*playerBufferQueueItf_)->Enqueue(playerBufferQueueItf_,
+                                                    output_.get() + offset,
+                                                    bufferQuantum_));
+    }
+    return HOWIE_SUCCESS;
+  }
+
+  HowieError OpenSLBackend::enqueuePlaybackSlot(unsigned char *slot) {
+    HOWIE_CHECK_RT(*log_, (*playerBufferQueueItf_)->Enqueue(
+        playerBufferQueueItf_, slot, bufferQuantum_));
+    ++playBuffersSubmitted_;
+    ++playBuffersQueued_;
+    return HOWIE_SUCCESS;
+  }
+
+  /**
+   * The queue only gets deeper by queuing silence, and only gets shallower
+   * by not refilling the buffer that just finished, so no rendered audio
+   * is ever dropped. The silence goes in ahead of this period's output,
+   * right after the underrun that called for it.
+   */
+  bool OpenSLBackend::adaptQueueDepth() {
+    unsigned int depth = latency_->depth();
+    if (playBuffersQueued_ >= depth && playBuffersQueued_ > 0) {
+      log_->write(ANDROID_LOG_INFO, "%s: playback queue down to %lld periods",
+                  __func__, playBuffersQueued_);
+      stats_->setQueuedPeriods(playBuffersQueued_);
+      stats_->callbackSkipped(StreamStatistics::now());
+      return false;
+    }
+    if (playBuffersQueued_ + 1 < depth) {
+      log_->write(ANDROID_LOG_INFO, "%s: playback queue up to %lld periods",
+                  __func__, depth);
+      stats_->setQueuedPeriods(depth);
+    }
+    while (playBuffersQueued_ + 1 < depth) {
+      unsigned char *slot = output_.get()
+          + (playBuffersSubmitted_ % playbackBufferCount_) * bufferQuantum_;
+      memset(slot, 0, bufferQuantum_);
+      if (!HOWIE_SUCCEEDED(enqueuePlaybackSlot(slot))) {
+        break;
+      }
+    }
+    return true;
+  }
+
+  // this callback handler is called every time a buffer finishes recording
+  void OpenSLBackend::bqRecorderCallback(SLAndroidSimpleBufferQueueItf itf,
+                                         void *context) {
+    HOWIE_TRACE_FN(HOWIE_TRACE_LEVEL_ALL);
+    if (HOWIE_SUCCEEDED(lastRecordError_) && !context) {
+      lastRecordError_ = HOWIE_ERROR_NULL;
+    }
+
+    OpenSLBackend *backend = static_cast<OpenSLBackend *>(context);
+    if (HOWIE_SUCCEEDED(lastRecordError_)) {
+      if (backend->direction_ == HOWIE_STREAM_DIRECTION_RECORD) {
+        // Nothing else will run this stream, so process on this thread.
+        lastRecordError_ = backend->processRecord(itf);
+      } else if (backend->duplex_) {
+        lastRecordError_ = backend->processDuplexInput(itf);
+      } else {
+        // process() picks the buffer up on the playback thread.
+        backend->recordBuffersFinished_.fetch_add(1,
+                                                  std::memory_order_release);
+      }
+    }
+  }
+
+
+  // this callback handler is called every time a buffer finishes playing
+  void OpenSLBackend::bqPlayerCallback(SLAndroidSimpleBufferQueueItf bq, void
+      *context) {
+    HOWIE_TRACE_FN(HOWIE_TRACE_LEVEL_ALL);
+
+    if (HOWIE_SUCCEEDED(lastPlaybackError_) && !context) {
+      lastPlaybackError_ = HOWIE_ERROR_NULL;
+    }
+
+    if(HOWIE_SUCCEEDED(lastPlaybackError_)) {
+      lastPlaybackError_ = static_cast<OpenSLBackend *>(context)->process(bq);
+    }
+  }
+
+
+  HowieError OpenSLBackend::process(SLAndroidSimpleBufferQueueItf bq) {
+    HOWIE_CHECK_NOT_NULL_RT(*log_, bq);
+    HOWIE_TRACE_FN(HOWIE_TRACE_LEVEL_REALTIME);
+
+    if (bq != playerBufferQueueItf_) {
+      return HOWIE_ERROR_INVALID_OBJECT;
+    }
+
+    // The buffer that finished playing is no longer queued.
+    --playBuffersQueued_;
+    if (latency_ && !adaptQueueDepth()) {
+      return HOWIE_SUCCESS;
+    }
+
+    HowieBuffer in { sizeof(HowieBuffer), nullptr, 0 };
+    if (duplex_) {
+      in = syncedInputBuffer();
+    } else if (direction_ & HOWIE_STREAM_DIRECTION_RECORD) {
+      size_t inputOffset = 0;
+      int recordBuffersFinished = recordBuffersFinished_.load(
+          std::memory_order_acquire);
+
+      int nBuffersAvailable = countFreeBuffers();
+      if (nBuffersAvailable <= 0) {
+        log_->write(ANDROID_LOG_WARN, "%s: GLITCH: missed a record buffer",
+                    __func__);
+        stats_->missedRecordBuffer();
+      }
+      inputOffset = (recordBuffersFinished % kRecordBufferCount) * bufferQuantum_;
+      in.data = input_.get() + inputOffset;
+      in.byteCount = bufferQuantum_;
+
+      if (convertSamples_) {
+        HowieDspInt16ToFloat(reinterpret_cast<const int16_t *>(in.data),
+                             reinterpret_cast<float *>(floatInput_.get()),
+                             in.byteCount / sizeof(int16_t));
+        in.data = floatInput_.get();
+        in.byteCount = floatInput_.size();
+      }
+    }
+
+    // The slot after the newest one queued. Unless the queue is adapting,
+    // that's the one that just finished playing.
+    size_t outputOffset =
+        (playBuffersSubmitted_ % playbackBufferCount_) * bufferQuantum_;
+    HowieBuffer out { sizeof(HowieBuffer), output_.get() + outputOffset,
+                      bufferQuantum_ };
+    if (convertSamples_) {
+      out.data = floatOutput_.get();
+      out.byteCount = floatOutput_.size();
+    }
+
+    HOWIE_CHECK_RT(*log_, client_->onPeriod(&in, &out));
+
+    unsigned char *outputSlot = output_.get() + outputOffset;
+    if (convertSamples_) {
+      HowieDspFloatToInt16(reinterpret_cast<const float *>(out.data),
+                           reinterpret_cast<int16_t *>(outputSlot),
+                           bufferQuantum_ / sizeof(int16_t));
+    }
+    HOWIE_CHECK_RT(*log_, enqueuePlaybackSlot(outputSlot));
+
+    if (latency_) {
+      latency_->update(stats_->underrunCount(), stats_->lastIntervalNs(),
+                       StreamStatistics::now());
+    }
+
+    if ((direction_ & HOWIE_STREAM_DIRECTION_RECORD) && !duplex_) {
+      HOWIE_CHECK_RT(*log_, submitRecordBuffer(*log_));
+    }
+
+    if (Trace::capturing()) {
+      traceQueueDepths();
+    }
+
+    return HOWIE_SUCCESS;
+  }
+
+  /**
+   * Take the input for this period from the duplex synchronizer. On the
+   * player's thread.
+   */
+  HowieBuffer OpenSLBackend::syncedInputBuffer() {
+    float *input = reinterpret_cast<float *>(floatInput_.get());
+    if (!duplex_->read(input, StreamStatistics::now())) {
+      stats_->missedRecordBuffer();
+    }
+    if (syncedInput_.get()) {
+      HowieDspFloatToInt16(input,
+                           reinterpret_cast<int16_t *>(syncedInput_.get()),
+                           syncedInput_.size() / sizeof(int16_t));
+      return HowieBuffer { sizeof(HowieBuffer), syncedInput_.get(),
+                           syncedInput_.size() };
+    }
+    return HowieBuffer { sizeof(HowieBuffer), floatInput_.get(),
+                         floatInput_.size() };
+  }
+
+  /**
+   * Count off the recorder buffer that just finished, and return it. Only
+   * for streams whose record buffers are handled on the recorder's thread.
+   */
+  HowieBuffer OpenSLBackend::finishedRecordBuffer() {
+    // Buffers complete in the order they were submitted, and only this
+    // thread counts them, so the one that just finished is the oldest.
+    unsigned int finished = recordBuffersFinished_.load(
+        std::memory_order_relaxed);
+    size_t inputOffset = (finished % kRecordBufferCount) * bufferQuantum_;
+    recordBuffersFinished_.store(finished + 1, std::memory_order_release);
+    return HowieBuffer { sizeof(HowieBuffer), input_.get() + inputOffset,
+                         bufferQuantum_ };
+  }
+
+  /**
+   * Pass the recorder buffer that just finished to the duplex synchronizer,
+   * on the recorder's thread.
+   */
+  HowieError OpenSLBackend::processDuplexInput(
+      SLAndroidSimpleBufferQueueItf bq) {
+    HOWIE_CHECK_NOT_NULL_RT(recorderLog_, bq);
+    HOWIE_TRACE_FN(HOWIE_TRACE_LEVEL_REALTIME);
+
+    if (bq != recorderBufferQueueItf_) {
+      return HOWIE_ERROR_INVALID_OBJECT;
+    }
+
+    HowieBuffer in = finishedRecordBuffer();
+    const float *frames = reinterpret_cast<const float *>(in.data);
+    if (recordFloat_.get()) {
+      HowieDspInt16ToFloat(reinterpret_cast<const int16_t *>(in.data),
+                           reinterpret_cast<float *>(recordFloat_.get()),
+                           in.byteCount / sizeof(int16_t));
+      frames = reinterpret_cast<const float *>(recordFloat_.get());
+    }
+    if (!duplex_->write(frames, deviceCharacteristics_.framesPerPeriod,
+                        StreamStatistics::now())) {
+      recorderLog_.write(ANDROID_LOG_WARN,
+                         "%s: GLITCH: duplex input overflow", __func__);
+    }
+
+    HOWIE_CHECK_RT(recorderLog_, submitRecordBuffer(recorderLog_));
+    return HOWIE_SUCCESS;
+  }
+
+  /**
+   * Run one period of a record-only stream, on the recorder's thread.
+   */
+  HowieError OpenSLBackend::processRecord(SLAndroidSimpleBufferQueueItf bq) {
+    HOWIE_CHECK_NOT_NULL_RT(*log_, bq);
+    HOWIE_TRACE_FN(HOWIE_TRACE_LEVEL_REALTIME);
+
+    if (bq != recorderBufferQueueItf_) {
+      return HOWIE_ERROR_INVALID_OBJECT;
+    }
+
+    HowieBuffer in = finishedRecordBuffer();
+    if (convertSamples_) {
+      HowieDspInt16ToFloat(reinterpret_cast<const int16_t *>(in.data),
+                           reinterpret_cast<float *>(floatInput_.get()),
+                           in.byteCount / sizeof(int16_t));
+      in.data = floatInput_.get();
+      in.byteCount = floatInput_.size();
+    }
+    HowieBuffer out { sizeof(HowieBuffer), nullptr, 0 };
+
+    HOWIE_CHECK_RT(*log_, client_->onPeriod(&in, &out));
+
+    // Hand the buffer we just read back to the recorder.
+    HOWIE_CHECK_RT(*log_, submitRecordBuffer(*log_));
+
+    if (Trace::capturing()) {
+      traceQueueDepths();
+    }
+
+    return HOWIE_SUCCESS;
+  }
+
+  /**
+   * Report how many buffers each OpenSL queue holds, so that the trace
+   * shows how close the stream came to running dry.
+   */
+  void OpenSLBackend::traceQueueDepths() {
+    SLAndroidSimpleBufferQueueState state;
+    if (playerBufferQueueItf_
+        && (*playerBufferQueueItf_)->GetState(playerBufferQueueItf_, &state)
+           == SL_RESULT_SUCCESS) {
+      Trace::setCounter("howie.playbackQueued", state.count);
+    }
+    if (recorderBufferQueueItf_
+        && (*recorderBufferQueueItf_)->GetState(recorderBufferQueueItf_,
+                                                &state)
+           == SL_RESULT_SUCCESS) {
+      Trace::setCounter("howie.recordQueued", state.count);
+    }
+  }
+
+  /**
+   * Count the number of free (readable) recording buffers.
+   *
+   * NB: this function is only safe to call from the playback thread.
+   *     If called from another thread it will likely give erroneous
+   *     results, because recordBuffersSubmitted_ is not synchronized.
+   */
+  const unsigned int OpenSLBackend::countFreeBuffers() const {
+    HOWIE_TRACE_FN(HOWIE_TRACE_LEVEL_REALTIME)
+    unsigned int finished = recordBuffersFinished_.load(std::memory_order_acquire);
+    unsigned int result = recordBuffersSubmitted_ - finished;
+    return result;
+  }
+
+  void OpenSLBackend::getStatistics(HowieStreamStatistics *dest) const {
+    dest->inputDriftPpm = duplex_ ? duplex_->driftPpm() : 0;
+    dest->inputResyncCount = duplex_ ? duplex_->resyncCount() : 0;
+    dest->playbackQueueDepth = latency_ ? latency_->depth()
+                               : playerObject_ ? playbackBufferCount_ : 0;
+  }
+
+  HowieError OpenSLBackend::start() {
+    HOWIE_TRACE_FN(HOWIE_TRACE_LEVEL_CALLS)
+    if (duplex_) {
+      duplex_->reset();
+    }
+    if (recorderItf_) {
+      HOWIE_CHECK((*recorderItf_)->SetRecordState(
+          recorderItf_, SL_RECORDSTATE_RECORDING));
+    }
+    if (playerItf_) {
+      HOWIE_CHECK((*playerItf_)->SetPlayState(
+          playerItf_, SL_PLAYSTATE_PLAYING));
+    }
+    return HOWIE_SUCCESS;
+  }
+
+  HowieError OpenSLBackend::stop() {
+    HOWIE_TRACE_FN(HOWIE_TRACE_LEVEL_CALLS)
+    if (recorderItf_) {
+      HOWIE_CHECK((*recorderItf_)->SetRecordState(
+          recorderItf_, SL_RECORDSTATE_PAUSED));
+    }
+    if (playerItf_) {
+      HOWIE_CHECK((*playerItf_)->SetPlayState(
+          playerItf_, SL_PLAYSTATE_PAUSED));
+    }
+    return HOWIE_SUCCESS;
+  }
+
+} // namespace howie
@@ -0,0 +1,166 @@
+/*
+ * Copyright 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#ifndef HOWIE_OPENSLBACKEND_H
+#define HOWIE_OPENSLBACKEND_H
+
+#include <SLES/OpenSLES_Android.h>
+#include <atomic>
+#include <memory>
+#include "CacheAligned.h"
+#include "RealtimeLog.h"
+#include "StreamBackend.h"
+#include "DuplexSync.h"
+#include "LatencyController.h"
+#include "StreamPool.h"
+
+namespace howie {
+
+  /**
+   * Runs a stream on an OpenSL ES player and/or recorder, through their
+   * Android simple buffer queues.
+   *
+   * Playback streams run their periods on the player's callback thread,
+   * and record-only streams on the recorder's. Full duplex streams either
+   * keep the recorder's buffers phase-locked to the player's with a
+   * DuplexSync or, when that isn't possible, pick up whatever the recorder
+   * has finished on the player's thread.
+   */
+  class OpenSLBackend : public StreamBackend, public CacheAligned {
+  public:
+    // Defines the number of buffers used for recording. In the absence of
+    // predictably ordered, synchronized I/O, we use three:
+    // one to write, one to read, and one to compensate for i/o
+    // being out of phase.
+    static constexpr unsigned int kRecordBufferCount = 3;
+
+    // If a pool is given, the backend takes its OpenSL objects from there
+    // when it can, and offers them back when it's destroyed.
+    OpenSLBackend(SLEngineItf engineItf,
+                  SLObjectItf outputMixObject,
+                  StreamPool *streamPool = nullptr);
+    ~OpenSLBackend();
+
+    HowieError open(const Config &config,
+                    Client *client,
+                    HowieDeviceCharacteristics *characteristics) override;
+    HowieError start() override;
+    HowieError stop() override;
+    void getStatistics(HowieStreamStatistics *dest) const override;
+    const char *name() const override { return "OpenSL ES"; }
+
+  private:
+    SLEngineItf engineItf_;
+    SLObjectItf outputMixObject_;
+
+    Client *client_ = nullptr;
+    StreamStatistics *stats_ = nullptr;
+    RealtimeLog *log_ = nullptr;
+
+    // For the recorder's thread in a full duplex stream. log_ belongs to
+    // the player's thread, and a log can only have one writer, so the
+    // recorder gets one of its own.
+    RealtimeLog recorderLog_;
+    HowieDirection direction_ = HOWIE_STREAM_DIRECTION_PLAYBACK;
+
+    // The characteristics presented to the client, which differ from the
+    // device's when the stream runs in float.
+    HowieDeviceCharacteristics deviceCharacteristics_ = {};
+
+    // True if OpenSL runs in 16 bit and the client in float. In that case
+    // the client sees the float scratch buffers below, and process()
+    // converts between them and input_/output_.
+    bool convertSamples_ = false;
+    unique_buffer floatInput_;
+    unique_buffer floatOutput_;
+
+    // Full duplex streams normally pass their input through a DuplexSync,
+    // which keeps it phase-locked to the output. recordFloat_ holds the
+    // recorder's buffer converted to float, if OpenSL runs in 16 bit, and
+    // syncedInput_ holds the synchronized input converted back to 16 bit,
+    // if that's what the client wants.
+    std::unique_ptr<DuplexSync> duplex_;
+    unique_buffer recordFloat_;
+    unique_buffer syncedInput_;
+
+    // The smallest size a buffer can be. All of the buffers need to be
+    // multiples of this number.
+    size_t bufferQuantum_ = 0;
+
+    unique_buffer input_;
+    unsigned int recordBuffersSubmitted_ = 0;
+    std::atomic<unsigned int> recordBuffersFinished_ = {0};
+
+    // The output buffer is split into playbackBufferCount_ slots of
+    // bufferQuantum_ bytes each, which is also the capacity of the player's
+    // queue. The process callback fills the slot after the newest one
+    // queued. Normally every slot is queued; with an adaptive queue,
+    // latency_ decides how many are.
+    unique_buffer output_;
+    unsigned int playbackBufferCount_ = 0;
+    unsigned int playBuffersSubmitted_ = 0;
+    unsigned int playBuffersQueued_ = 0;
+    std::unique_ptr<LatencyController> latency_;
+
+    SLObjectItf playerObject_ = nullptr;
+    SLPlayItf playerItf_ = nullptr;
+    SLAndroidSimpleBufferQueueItf playerBufferQueueItf_ = nullptr;
+    CallbackSlot *playerSlot_ = nullptr;
+    static void bqPlayerCallback(SLAndroidSimpleBufferQueueItf, void *);
+
+    SLObjectItf recorderObject_ = nullptr;
+    SLRecordItf recorderItf_ = nullptr;
+    SLAndroidSimpleBufferQueueItf recorderBufferQueueItf_ = nullptr;
+    CallbackSlot *recorderSlot_ = nullptr;
+    static void bqRecorderCallback(SLAndroidSimpleBufferQueueItf, void*);
+
+    // Where the OpenSL objects came from and go back to, if anywhere, and
+    // whether they were created in float.
+    StreamPool *streamPool_ = nullptr;
+    bool floatObjects_ = false;
+
+    static HowieError lastPlaybackError_;
+    static HowieError lastRecordError_;
+
+    HowieError process(SLAndroidSimpleBufferQueueItf bq);
+    HowieError processRecord(SLAndroidSimpleBufferQueueItf bq);
+    HowieError processDuplexInput(SLAndroidSimpleBufferQueueItf bq);
+    HowieBuffer syncedInputBuffer();
+    HowieBuffer finishedRecordBuffer();
+    void traceQueueDepths();
+
+    HowieError createObjects(void *format);
+    HowieError initPlayback(void *format);
+    HowieError initRecording(void *format);
+    void destroyObjects();
+
+    // Refill the recorder's queue, logging any failure to log, which
+    // belongs to whichever thread calls this.
+    HowieError submitRecordBuffer(RealtimeLog &log);
+    HowieError submitPlaybackBuffers();
+
+    // Bring the playback queue towards latency_'s depth, on the player's
+    // thread. Returns false if this callback should be skipped to make
+    // the queue shallower.
+    bool adaptQueueDepth();
+    HowieError enqueuePlaybackSlot(unsigned char *slot);
+
+    const unsigned int countFreeBuffers() const;
+  };
+
+} // namespace howie
+
+#endif // HOWIE_OPENSLBACKEND_H
@@ -18,101 +18,219 @@
 #include <algorithm>
 #include <chrono>
 #include <cstring>
+#include <thread>
 
 namespace howie {
 
-  ParameterPipe::ParameterPipe(size_t maxElement, size_t margin)
-      : elementSize_(maxElement), margin_(margin), locks_(margin) {
-    data_.reset(new unsigned char[maxElement * margin]);
-    cache_.reset(new unsigned char[maxElement]);
-    temp_.reset(new unsigned char[maxElement]);
+  // Out of line because std::min binds it by reference.
+  constexpr size_t ParameterPipe::kPatchPayloadSize;
+
+  namespace {
+    size_t strideFor(size_t maxElement) {
+      return (maxElement + CACHE_ALIGN - 1)
+             & ~static_cast<size_t>(CACHE_ALIGN - 1);
+    }
+  } // namespace
+
+  ParameterPipe::ParameterPipe(size_t maxElement)
+      : elementSize_(maxElement), stride_(strideFor(maxElement)),
+        data_(storageSize(maxElement)),
+        patches_(maxElement > 0 ? kPatchQueueLength : 1) {
+    data_.clear();
   }
 
+  ParameterPipe::ParameterPipe(size_t maxElement, unsigned char *storage)
+      : elementSize_(maxElement), stride_(strideFor(maxElement)),
+        data_(storage, storageSize(maxElement)),
+        patches_(maxElement > 0 ? kPatchQueueLength : 1) {
+    if (!storage) {
+      data_.reset(storageSize(maxElement));
+    }
+    data_.clear();
+  }
+
+  size_t ParameterPipe::storageSize(size_t maxElement) {
+    return strideFor(maxElement) * kBufferCount;
+  }
+
+  unsigned char *ParameterPipe::buffer(int index) const {
+    return data_.get() + index * stride_;
+  }
 
   /**
-   * Compute the ringbuffer byte offset of the given logical position.
-   *
-   * The logical positions (read position, write position) are written as if
-   * the buffer extends to infinity (or at least to MAX_UINT) in the forward
-   * direction. This makes it easier to reason about their relative positions
-   * and prevents ambiguity. We allow the positions to wrap around at MAX_UINT.
-   * Due to the magic of 2's complement arithmetic, the difference between
-   * the two positions is correct even if the write pointer wraps before the
-   * read pointer. (Assuming that the difference never exceeds MAX_INT, which
-   * it won't if we maintain the positions correctly.)
+   * Take ownership of the back buffer. Writers are expected to be rare
+   * and short, so waiting writers just yield until the owner is done or
+   * the timeout expires.
    */
-  size_t ParameterPipe::logicalPosToByteOffset(size_t current) const {
-    size_t offset = (current % margin_) * elementSize_;
-    return offset;
+  bool ParameterPipe::lockWriter(int timeoutMs) {
+    auto deadline = std::chrono::steady_clock::now()
+                    + std::chrono::milliseconds(std::max(timeoutMs, 0));
+    bool expected = false;
+    bool contended = false;
+    while (!writing_.compare_exchange_weak(expected, true,
+                                           std::memory_order_acquire,
+                                           std::memory_order_relaxed)) {
+      if (!expected) {
+        // spurious failure
+        continue;
+      }
+      if (!contended) {
+        contentions_.fetch_add(1, std::memory_order_relaxed);
+        contended = true;
+      }
+      if (std::chrono::steady_clock::now() >= deadline) {
+        return false;
+      }
+      std::this_thread::yield();
+      expected = false;
+    }
+    return true;
   }
 
+  void ParameterPipe::unlockWriter() {
+    writing_.store(false, std::memory_order_release);
+  }
 
-
-  size_t ParameterPipe::push(const void *src, size_t srcSize) {
+  size_t ParameterPipe::push(const void *src, size_t srcSize, int timeoutMs) {
     size_t result = 0;
     size_t size = std::min(srcSize, elementSize_);
 
-    // Check the write pointer before acquiring a lock, so we know which lock
-    // to acquire. That does imply that the write pointer must be atomic, since
-    // it can be accessed by multiple threads outside of the lock.
-    // this is a "consume" load because there are no implicit dependencies,
-    // all we need to do is make sure that explicit dependencies aren't
-    // reordered.
-    size_t current = writepos_.load(std::memory_order_consume);
-
-    std::mutex& currentLock = locks_[current % margin_];
-    std::lock_guard<std::mutex> lock(currentLock);
-    {
-      size_t offset = logicalPosToByteOffset(current);
-      unsigned char *dest = data_.get() + offset;
+    unsigned char *dest = src ? acquire(timeoutMs) : nullptr;
+    if (dest) {
       memcpy(dest, src, size);
-      result = size;
-
-      ++current;
+      if (commit(dest)) {
+        result = size;
+      }
+    }
+    return result;
+  }
 
-      writepos_.store(current, std::memory_order_release);
+  unsigned char *ParameterPipe::acquire(int timeoutMs) {
+    unsigned char *result = nullptr;
+    if (lockWriter(timeoutMs)) {
+      result = buffer(back_);
     }
     return result;
   }
 
-  size_t ParameterPipe::pop(void *dest, size_t destSize) {
+  bool ParameterPipe::commit(const void *ptr) {
+    // Only the writer that acquired the back buffer may commit it.
+    // Anything else is a spurious pointer or a double commit.
+    if (!writing_.load(std::memory_order_relaxed) || ptr != buffer(back_)) {
+      return false;
+    }
+
+    // Publish the back buffer and take whatever was in the middle. The
+    // release half of this exchange matches the acquire in pop(), so
+    // the reader sees everything written to the buffer.
+    ++generation_;
+    int published = back_ | kFreshFlag
+                    | static_cast<int>(generation_ << kGenerationShift);
+    back_ = middle_.exchange(published, std::memory_order_acq_rel)
+            & kIndexMask;
+    unlockWriter();
+    return true;
+  }
+
+  size_t ParameterPipe::patch(size_t offset,
+                              const void *src,
+                              size_t srcSize,
+                              int timeoutMs) {
     size_t result = 0;
-    size_t size = std::min(destSize, elementSize_);
-
-    // this read-acquire matches the write-release in push() and ensures
-    // that data is not loaded before the latest value of writepos_ is loaded.
-    size_t read = writepos_.load(std::memory_order_acquire);
-
-    // read position is write - 1; we want the update from just before the
-    // current write pointer, which is very recent yet also very likely safe
-    // to read.
-    read -= 1;
-    std::mutex& currentLock = locks_[read % margin_];
-    bool locked = currentLock.try_lock();
-    std::lock_guard<std::mutex>(currentLock, std::adopt_lock);
-    if (locked) {
-      size_t offset = logicalPosToByteOffset(read);
-      unsigned char *src = data_.get() + offset;
-      std::memcpy(dest, src, size);
-      result = size;
+    if (!src || srcSize == 0 || offset > elementSize_
+        || srcSize > elementSize_ - offset) {
+      return result;
     }
 
+    size_t recordCount = (srcSize + kPatchPayloadSize - 1) / kPatchPayloadSize;
+    const unsigned char *bytes = static_cast<const unsigned char *>(src);
+    size_t copied = 0;
+    auto fill = [&](Patch *records, size_t count) {
+      for (size_t i = 0; i < count; ++i) {
+        size_t chunk = std::min(srcSize - copied, kPatchPayloadSize);
+        records[i].generation = generation_;
+        records[i].offset = static_cast<uint32_t>(offset + copied);
+        records[i].size = static_cast<uint32_t>(chunk);
+        memcpy(records[i].data, bytes + copied, chunk);
+        copied += chunk;
+      }
+    };
+    if (lockWriter(timeoutMs)) {
+      // All or nothing, and published at once, so the reader never applies
+      // part of a patch.
+      size_t queued = patches_.push_n(recordCount, [&](
+          Patch *first, size_t firstCount,
+          Patch *second, size_t secondCount) -> size_t {
+        if (firstCount + secondCount < recordCount) {
+          return 0;
+        }
+        fill(first, firstCount);
+        fill(second, secondCount);
+        return recordCount;
+      });
+      if (queued > 0) {
+        result = srcSize;
+      }
+      unlockWriter();
+    }
     return result;
   }
 
   bool ParameterPipe::pop() {
     bool result = false;
-    size_t popResult = pop(temp_.get(), elementSize_);
-    if (popResult > 0) {
-      cache_.swap(temp_);
+    if (middle_.load(std::memory_order_relaxed) & kFreshFlag) {
+      swapFront();
+      result = true;
+    }
+    if (!patches_.empty()) {
+      applyPatches();
       result = true;
     }
     return result;
   }
 
+  void ParameterPipe::swapFront() {
+    int middle = middle_.exchange(front_, std::memory_order_acq_rel);
+    front_ = middle & kIndexMask;
+    frontGeneration_ = static_cast<uint32_t>(middle) >> kGenerationShift;
+  }
+
+  /**
+   * Apply queued patches to the front buffer, oldest first.
+   *
+   * Generations are compared modulo 2^(32 - kGenerationShift), because
+   * that's all that fits in middle_ alongside the index and flag.
+   */
+  void ParameterPipe::applyPatches() {
+    unsigned char *front = buffer(front_);
+    bool more = true;
+    bool stalled = false;
+    while (more && !stalled) {
+      more = patches_.pop([&](Patch *record) -> bool {
+        int32_t age = static_cast<int32_t>(
+            (record->generation - frontGeneration_) << kGenerationShift);
+        if (age > 0) {
+          // This patch was sent after a block that is already waiting in
+          // the middle. Swap that block in first; the patch applies to it.
+          if (middle_.load(std::memory_order_relaxed) & kFreshFlag) {
+            swapFront();
+            front = buffer(front_);
+          } else {
+            stalled = true;
+          }
+          return false;
+        }
+        if (age == 0) {
+          memcpy(front + record->offset, record->data, record->size);
+        }
+        // Patches older than the front block were superseded by it.
+        return true;
+      });
+    }
+  }
+
   unsigned char *ParameterPipe::top() const {
-    return cache_.get();
+    return buffer(front_);
   }
 
 } // namespace howie
-
@@ -19,62 +19,147 @@
 
 
 #include <atomic>
+#include <cstdint>
 #include <memory>
-#include <mutex>
-#include <vector>
+#include "CacheAligned.h"
+#include "Ringbuffer.h"
+#include "unique_buffer.h"
+
+#ifndef CACHE_ALIGN
+#define CACHE_ALIGN 64
+#endif
 
 namespace howie {
-  class ParameterPipe {
+  /**
+   * Exchanges fixed-size parameter blocks between user threads and the
+   * audio thread using a triple buffer.
+   *
+   * The reader owns one buffer (the front), the writer owns another (the
+   * back), and the third (the middle) sits between them. The writer fills
+   * the back buffer and atomically swaps it with the middle; the reader
+   * atomically swaps its front with the middle whenever the middle holds
+   * a block it hasn't seen. Neither side ever waits for the other, and the
+   * reader never takes a lock or copies data.
+   *
+   * Only one writer can own the back buffer at a time. Concurrent writers
+   * spin (yielding) against each other for up to the requested timeout;
+   * the reader is never involved in that.
+   *
+   * Writers can also send patches, which overwrite a byte range of the
+   * block instead of replacing all of it. Patches travel through a
+   * separate ringbuffer and are applied by the reader, in order, onto its
+   * front buffer during pop(). Each patch carries the generation of the
+   * last full block pushed before it, so a patch is only ever applied on
+   * top of the block it was sent after, and a full block supersedes every
+   * patch sent before it.
+   */
+  class ParameterPipe : public CacheAligned {
   public:
-    ParameterPipe(size_t maxElement, size_t margin);
-
-    // push returns the number of bytes written.
-    size_t push(const void *src, size_t srcSize);
-
-    // pop returns true on success. Failure implies that the
-    // reader found itself in contention with the writer.
+    explicit ParameterPipe(size_t maxElement);
+
+    // Keeps the three buffers in storage, which must be cache line aligned
+    // and at least storageSize(maxElement) bytes, and outlive the pipe.
+    ParameterPipe(size_t maxElement, unsigned char *storage);
+    static size_t storageSize(size_t maxElement);
+
+    // push returns the number of bytes written, which will be zero if
+    // another writer held the pipe for longer than timeoutMs.
+    size_t push(const void *src, size_t srcSize, int timeoutMs = 0);
+
+    // acquire hands the caller the back buffer to write in place, or
+    // nullptr if another writer held the pipe for longer than timeoutMs.
+    // The buffer's previous contents are an older parameter block, so the
+    // caller should write all of it. Every successful acquire must be
+    // followed by exactly one commit, which publishes the buffer.
+    unsigned char *acquire(int timeoutMs = 0);
+    bool commit(const void *ptr);
+
+    // patch queues a write of srcSize bytes at the given offset into the
+    // block. It returns the number of bytes queued, which will be zero if
+    // the range is out of bounds, the patch queue is full, or another
+    // writer held the pipe for longer than timeoutMs.
+    size_t patch(size_t offset, const void *src, size_t srcSize,
+                 int timeoutMs = 0);
+
+    // pop makes the most recently pushed block visible through top().
+    // It never blocks, and returns true if a new block became visible.
+    // Only the audio thread may call pop() and top().
     bool pop();
-    unsigned char * top() const;
 
-    // top returns
+    // top returns the block most recently made visible by pop(), or the
+    // initial block if no block has been pushed yet.
+    unsigned char * top() const;
 
     size_t maxElementSize() const { return elementSize_; }
 
+    // All three buffers, stride() bytes apart. acquire() always returns
+    // one of them, so a caller can map the lot once, such as into a Java
+    // ByteBuffer, and find each acquired buffer by its offset.
+    unsigned char *storage() const { return data_.get(); }
+    size_t storageSize() const { return data_.size(); }
+    size_t stride() const { return stride_; }
 
-  private:
-    // Track the write head. No need to track the read head, as it's
-    // always just behind the write head.
-    std::atomic<size_t> writepos_{0};
+    // Number of times a writer found the pipe held by another writer.
+    unsigned int contentionCount() const {
+      return contentions_.load(std::memory_order_relaxed);
+    }
 
-    // Although this queue is lock-free to readers, writers can
-    // block each other.
-    std::vector<std::mutex> locks_;
+
+  private:
+    // middle_ packs the buffer index, the fresh flag, and the generation
+    // of the block in that buffer.
+    static constexpr int kIndexMask = 0x3;
+    // Set in middle_ when it holds a block the reader hasn't seen yet.
+    static constexpr int kFreshFlag = 0x4;
+    static constexpr int kGenerationShift = 3;
+    static constexpr int kBufferCount = 3;
+
+    // Patches are split into fixed-size records so the queue never
+    // allocates. The payload size makes each record 64 bytes.
+    static constexpr size_t kPatchPayloadSize = 52;
+    static constexpr int kPatchQueueLength = 256;
+    struct Patch {
+      uint32_t generation;
+      uint32_t offset;
+      uint32_t size;
+      unsigned char data[kPatchPayloadSize];
+    };
 
     // Size of each data element
     size_t elementSize_;
 
-    // How many elements are in the queue. This is a margin of safety.
-    // If access to the data were serialized, one element would always
-    // suffice. Since the data is not serialized, there is a chance
-    // that the writer may wrap around and overwrite the reader's position
-    // before the reader is finished. Larger values of margin_ make this
-    // less likely.
-    size_t margin_;
+    // Distance between buffers: elementSize_ rounded up to whole cache
+    // lines, so that the reader's and writer's buffers never share one.
+    size_t stride_;
+
+    // All three buffers, stride_ bytes each.
+    unique_buffer data_;
+
+    // The buffer in the middle, plus the fresh flag. This is the only
+    // state shared by the reader and the writer.
+    alignas(CACHE_ALIGN) std::atomic<int> middle_ {1};
+
+    // Reader side. Only touched by the audio thread.
+    alignas(CACHE_ALIGN) int front_ = 0;
+
+    // Writer side. back_ is only touched by the thread that set writing_.
+    alignas(CACHE_ALIGN) std::atomic<bool> writing_ {false};
+    int back_ = 2;
+    std::atomic<unsigned int> contentions_ {0};
 
-    // The actual data buffer. Its size is elementSize_ * margin_.
-    std::unique_ptr<unsigned char> data_;
+    // Number of full blocks committed so far. Written under writing_.
+    uint32_t generation_ = 0;
 
-    // keep a cached element so that top() can always succeed.
-    std::unique_ptr<unsigned char> cache_;
-    std::unique_ptr<unsigned char> temp_;
+    Ringbuffer<Patch> patches_;
+    uint32_t frontGeneration_ = 0;
 
-    // pop returns the number of bytes read, which will be zero
-    // if contention was detected during the read. In this case,
-    // the operation may be retried.
-    size_t pop (void * dest, size_t size);
+    unsigned char *buffer(int index) const;
 
-    size_t logicalPosToByteOffset(size_t current) const;
+    bool lockWriter(int timeoutMs);
+    void unlockWriter();
 
+    void swapFront();
+    void applyPatches();
   };
 } // namespace howie
 
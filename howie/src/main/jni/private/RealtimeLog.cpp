@@ -0,0 +1,130 @@
+/*
+ * Copyright 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#include "RealtimeLog.h"
+#include "howie-private.h"
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace howie {
+
+  namespace {
+
+    constexpr int kDrainIntervalMs = 200;
+
+    /**
+     * The thread that empties every log. It's created on first use and
+     * deliberately never destroyed, so that logs belonging to streams the
+     * app never cleaned up can be flushed right up to process exit.
+     */
+    class Drain {
+    public:
+      static Drain &get() {
+        static Drain *instance = new Drain();
+        return *instance;
+      }
+
+      void add(RealtimeLog *log) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        logs_.push_back(log);
+      }
+
+      // Once this returns the drain thread won't touch the log again.
+      void remove(RealtimeLog *log) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        logs_.erase(std::remove(logs_.begin(), logs_.end(), log),
+                    logs_.end());
+      }
+
+    private:
+      std::mutex mutex_;
+      std::vector<RealtimeLog *> logs_;
+
+      Drain() {
+        std::thread([this] { threadFn(); }).detach();
+      }
+
+      void threadFn() {
+        while (true) {
+          std::this_thread::sleep_for(std::chrono::milliseconds(kDrainIntervalMs));
+          std::lock_guard<std::mutex> lock(mutex_);
+          for (RealtimeLog *log : logs_) {
+            log->flush();
+          }
+        }
+      }
+    };
+
+  } // namespace
+
+  RealtimeLog::RealtimeLog() : records_(kCapacity) {
+    Drain::get().add(this);
+  }
+
+  RealtimeLog::~RealtimeLog() {
+    Drain::get().remove(this);
+    flush();
+  }
+
+  void RealtimeLog::write(int priority, const char *format, const char *where,
+                          long long a0, long long a1, long long a2) {
+    bool written = records_.push([&](Record *record) -> bool {
+      record->format = format;
+      record->where = where;
+      record->args[0] = a0;
+      record->args[1] = a1;
+      record->args[2] = a2;
+      record->priority = priority;
+      return true;
+    });
+    if (!written) {
+      dropped_.fetch_add(1, std::memory_order_relaxed);
+    }
+  }
+
+  void RealtimeLog::flush() {
+    // Print the records where they are, and hand each batch back to the
+    // writer in one go.
+    auto print = [](const Record *records, size_t count) {
+      for (size_t i = 0; i < count; ++i) {
+        const Record &record = records[i];
+        __android_log_print(record.priority, kLibName, record.format,
+                            record.where, record.args[0], record.args[1],
+                            record.args[2]);
+      }
+    };
+    while (records_.pop_n(kCapacity, [&](Record *first, size_t firstCount,
+                                         Record *second,
+                                         size_t secondCount) -> size_t {
+      print(first, firstCount);
+      print(second, secondCount);
+      return firstCount + secondCount;
+    }) > 0) {
+    }
+    unsigned int dropped = dropped_.load(std::memory_order_relaxed);
+    if (dropped != reportedDropped_) {
+      __android_log_print(ANDROID_LOG_WARN, kLibName,
+                          "Dropped %u realtime log records",
+                          dropped - reportedDropped_);
+      reportedDropped_ = dropped;
+    }
+  }
+
+} // namespace howie
@@ -0,0 +1,75 @@
+/*
+ * Copyright 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#ifndef HOWIE_REALTIMELOG_H
+#define HOWIE_REALTIMELOG_H
+
+#include <atomic>
+#include "Ringbuffer.h"
+
+namespace howie {
+
+  /**
+   * Lets an audio thread log without calling into logd.
+   *
+   * write() copies a fixed-size record into a preallocated ring and never
+   * blocks; if the ring is full the record is dropped and counted. A
+   * shared drain thread wakes up a few times a second, formats whatever
+   * every registered log holds, and sends it to logcat.
+   *
+   * Each log has a single writer at a time: the audio thread of the
+   * stream that owns it, or for a shared output stream, whichever thread
+   * rendered it that period.
+   */
+  class RealtimeLog {
+  public:
+    // Records are formatted as
+    //   __android_log_print(priority, tag, format, where, a0, a1, a2)
+    // so format must start with a %s conversion for where, and the
+    // arguments after it must be long long (%lld).
+    struct Record {
+      const char *format;
+      const char *where;
+      long long args[3];
+      int priority;
+    };
+
+    static constexpr int kCapacity = 64;
+
+    RealtimeLog();
+    ~RealtimeLog();
+
+    RealtimeLog(const RealtimeLog &) = delete;
+    RealtimeLog &operator=(const RealtimeLog &) = delete;
+
+    // Wait-free. format and where must outlive the log, so in practice
+    // they are string literals and __func__.
+    void write(int priority, const char *format, const char *where,
+               long long a0 = 0, long long a1 = 0, long long a2 = 0);
+
+    // Send everything written so far to logcat. Drain thread only, or the
+    // destructor once the writer is gone.
+    void flush();
+
+  private:
+    Ringbuffer<Record> records_;
+    std::atomic<unsigned int> dropped_ {0};
+    unsigned int reportedDropped_ = 0;
+  };
+
+} // namespace howie
+
+#endif // HOWIE_REALTIMELOG_H
@@ -0,0 +1,161 @@
+/*
+ * Copyright 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#include "RealtimePool.h"
+#include "howie-private.h"
+#include <algorithm>
+#include <climits>
+#include <cstring>
+#include <pthread.h>
+#include "futex.h"
+#include "AudioThread.h"
+
+namespace {
+  inline void cpuRelax() {
+#if defined(__aarch64__) || defined(__arm__)
+    asm volatile("yield");
+#elif defined(__i386__) || defined(__x86_64__)
+    asm volatile("pause");
+#endif
+  }
+} // namespace
+
+namespace howie {
+
+  RealtimePool::RealtimePool(int threadCount)
+      : threadIds_(std::max(threadCount, 0), 0) {
+    memset(&param_, 0, sizeof(param_));
+    for (int i = 0; i < threadCount; ++i) {
+      threads_.push_back(std::thread([this, i] { threadFn(i); }));
+    }
+    while (started_.load(std::memory_order_acquire) < threadCount) {
+      std::this_thread::yield();
+    }
+  }
+
+  RealtimePool::~RealtimePool() {
+    cancelled_.store(true, std::memory_order_relaxed);
+    generation_.fetch_add(1, std::memory_order_release);
+    futexWake(&generation_, INT_MAX);
+    for (auto &thread : threads_) {
+      thread.join();
+    }
+  }
+
+  void RealtimePool::run(job_fn fn, void *context, int count) {
+    HOWIE_TRACE_FN(HOWIE_TRACE_LEVEL_REALTIME);
+    if (!priorityCaptured_) {
+      // This is the audio thread; give the pool the same priority.
+      policy_ = sched_getscheduler(0);
+      sched_getparam(0, &param_);
+      priorityVersion_.fetch_add(1, std::memory_order_relaxed);
+      priorityCaptured_ = true;
+    }
+
+    fn_ = fn;
+    context_ = context;
+    count_ = count;
+    unfinished_.store(count, std::memory_order_relaxed);
+    // The release here publishes fn_, context_ and count_ to any thread
+    // that successfully claims a job.
+    unclaimed_.store(count, std::memory_order_release);
+    generation_.fetch_add(1, std::memory_order_release);
+    futexWake(&generation_, INT_MAX);
+
+    runJobs();
+
+    // Barrier: spin, then sleep until the last job finishes.
+    int spins = 0;
+    int unfinished;
+    while ((unfinished = unfinished_.load(std::memory_order_acquire)) > 0) {
+      if (++spins < kSpinCount) {
+        cpuRelax();
+      } else {
+        futexWait(&unfinished_, unfinished);
+      }
+    }
+  }
+
+  void RealtimePool::runJobs() {
+    int claimed;
+    while ((claimed = unclaimed_.fetch_sub(1, std::memory_order_acq_rel)) > 0) {
+      fn_(context_, count_ - claimed);
+      if (unfinished_.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        futexWake(&unfinished_, 1);
+      }
+    }
+  }
+
+  void RealtimePool::threadFn(int index) {
+    threadIds_[index] = gettid();
+    started_.fetch_add(1, std::memory_order_release);
+
+    // Pin to a CPU of our own, counting down from the highest-numbered
+    // performance core.
+    const cpu_set_t &fast = AudioThread::performanceCpus();
+    int fastCount = CPU_COUNT(&fast);
+    if (fastCount > 1) {
+      int skip = index % fastCount;
+      for (int cpu = CPU_SETSIZE - 1; cpu >= 0; --cpu) {
+        if (CPU_ISSET(cpu, &fast) && skip-- == 0) {
+          cpu_set_t cpus;
+          CPU_ZERO(&cpus);
+          CPU_SET(cpu, &cpus);
+          sched_setaffinity(0, sizeof(cpus), &cpus);
+          break;
+        }
+      }
+    }
+
+    int seen = generation_.load(std::memory_order_acquire);
+    int appliedPriority = 0;
+    while (true) {
+      int spins = 0;
+      int generation;
+      while ((generation = generation_.load(std::memory_order_acquire))
+             == seen) {
+        if (++spins < kSpinCount) {
+          cpuRelax();
+        } else {
+          futexWait(&generation_, seen);
+        }
+      }
+      seen = generation;
+
+      if (cancelled_.load(std::memory_order_relaxed)) {
+        break;
+      }
+
+      int priorityVersion = priorityVersion_.load(std::memory_order_relaxed);
+      if (priorityVersion != appliedPriority) {
+        applyPriority(index);
+        appliedPriority = priorityVersion;
+      }
+
+      runJobs();
+    }
+  }
+
+  void RealtimePool::applyPriority(int index) {
+    int result = pthread_setschedparam(pthread_self(), policy_, &param_);
+    if (result != 0) {
+      __android_log_print(ANDROID_LOG_WARN, kLibName,
+                          "Pool thread %d could not match the audio "
+                          "thread's priority (error %d)", index, result);
+    }
+  }
+
+} // namespace howie
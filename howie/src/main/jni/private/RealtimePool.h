@@ -0,0 +1,106 @@
+/*
+ * Copyright 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#ifndef HOWIE_REALTIMEPOOL_H
+#define HOWIE_REALTIMEPOOL_H
+
+#include <atomic>
+#include <sched.h>
+#include <sys/types.h>
+#include <thread>
+#include <vector>
+#include "CacheAligned.h"
+
+#ifndef CACHE_ALIGN
+#define CACHE_ALIGN 64
+#endif
+
+namespace howie {
+
+  /**
+   * A small pool of threads that helps the audio thread get through one
+   * period's worth of independent jobs.
+   *
+   * run() publishes a batch of jobs, wakes the pool, works on the batch
+   * itself, and returns once every job has finished. Jobs are claimed from
+   * a single atomic counter, so whichever thread is free takes the next
+   * one. Idle threads, and the caller at the barrier, spin briefly before
+   * sleeping on a futex, so a pool that's kept busy every period never
+   * enters the kernel except to wake up.
+   *
+   * Pool threads copy the scheduling policy and priority of the thread
+   * that calls run(), so they run at the same priority as the OpenSL
+   * callback thread. Each pool thread is pinned to its own CPU, starting
+   * from the highest-numbered of the performance cores.
+   */
+  class RealtimePool : public CacheAligned {
+  public:
+    typedef void (*job_fn)(void *context, int index);
+
+    explicit RealtimePool(int threadCount);
+    ~RealtimePool();
+
+    // Runs fn(context, i) for every i in [0, count), returning once all of
+    // them have finished. Only one thread may call run() at a time. Does
+    // not allocate or lock.
+    void run(job_fn fn, void *context, int count);
+
+    int threadCount() const { return static_cast<int>(threads_.size()); }
+
+    // The kernel thread IDs of the pool threads, which are all running by
+    // the time the constructor returns.
+    const pid_t *threadIds() const { return threadIds_.data(); }
+
+  private:
+    // Number of times to poll before sleeping on a futex. Roughly tens of
+    // microseconds on current hardware.
+    static constexpr int kSpinCount = 4000;
+
+    std::vector<std::thread> threads_;
+    std::vector<pid_t> threadIds_;
+    std::atomic<int> started_ {0};
+
+    // Bumped once per run(); the pool threads sleep on it.
+    alignas(CACHE_ALIGN) std::atomic<int> generation_ {0};
+
+    // Jobs not yet claimed. Claiming decrements it, and the value before
+    // the decrement identifies the job. It goes negative once every job is
+    // claimed, so late arrivals can tell there's nothing left.
+    alignas(CACHE_ALIGN) std::atomic<int> unclaimed_ {0};
+
+    // Jobs not yet finished. run() sleeps on it at the barrier.
+    alignas(CACHE_ALIGN) std::atomic<int> unfinished_ {0};
+
+    job_fn fn_ = nullptr;
+    void *context_ = nullptr;
+    int count_ = 0;
+
+    std::atomic<bool> cancelled_ {false};
+
+    // Scheduling parameters captured from the first caller of run().
+    bool priorityCaptured_ = false;
+    int policy_ = SCHED_OTHER;
+    sched_param param_;
+    std::atomic<int> priorityVersion_ {0};
+
+    void threadFn(int index);
+    void runJobs();
+    void applyPriority(int index);
+  };
+
+} // namespace howie
+
+#endif // HOWIE_REALTIMEPOOL_H
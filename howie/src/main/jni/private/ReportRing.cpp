@@ -0,0 +1,82 @@
+/*
+ * Copyright 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#include "ReportRing.h"
+#include <algorithm>
+#include <cstring>
+
+namespace {
+  size_t roundUpToPowerOfTwo(size_t n) {
+    size_t result = 1;
+    while (result < n) {
+      result <<= 1;
+    }
+    return result;
+  }
+
+  constexpr size_t kSlotAlign = 16;
+} // namespace
+
+namespace howie {
+
+  ReportRing::ReportRing(size_t reportSize, size_t length)
+      : reportSize_(reportSize),
+        stride_((reportSize + kSlotAlign - 1) & ~(kSlotAlign - 1)),
+        mask_(roundUpToPowerOfTwo(length) - 1),
+        data_(stride_ * (mask_ + 1)) {
+    data_.clear();
+  }
+
+  unsigned char *ReportRing::slot(size_t pos) const {
+    return data_.get() + (pos & mask_) * stride_;
+  }
+
+  unsigned char *ReportRing::acquire() {
+    size_t writePos = writePos_.load(std::memory_order_relaxed);
+    size_t readPos = readPos_.load(std::memory_order_acquire);
+    if (writePos - readPos > mask_) {
+      return nullptr;
+    }
+    return slot(writePos);
+  }
+
+  bool ReportRing::commit(const void *ptr) {
+    size_t writePos = writePos_.load(std::memory_order_relaxed);
+    size_t readPos = readPos_.load(std::memory_order_relaxed);
+    if (!ptr || ptr != slot(writePos) || writePos - readPos > mask_) {
+      return false;
+    }
+    writePos_.store(writePos + 1, std::memory_order_release);
+    return true;
+  }
+
+  size_t ReportRing::read(void *dest, size_t maxReports) {
+    size_t readPos = readPos_.load(std::memory_order_relaxed);
+    size_t available = writePos_.load(std::memory_order_acquire) - readPos;
+    size_t count = std::min(available, maxReports);
+
+    unsigned char *bytes = static_cast<unsigned char *>(dest);
+    for (size_t i = 0; i < count; ++i) {
+      memcpy(bytes + i * reportSize_, slot(readPos + i), reportSize_);
+    }
+
+    // Release, so the audio thread doesn't reuse the slots until we've
+    // finished copying out of them.
+    readPos_.store(readPos + count, std::memory_order_release);
+    return count;
+  }
+
+} // namespace howie
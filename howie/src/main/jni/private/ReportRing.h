@@ -0,0 +1,76 @@
+/*
+ * Copyright 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#ifndef HOWIE_REPORTRING_H
+#define HOWIE_REPORTRING_H
+
+#include <atomic>
+#include <stddef.h>
+#include "CacheAligned.h"
+#include "unique_buffer.h"
+
+#ifndef CACHE_ALIGN
+#define CACHE_ALIGN 64
+#endif
+
+namespace howie {
+
+  /**
+   * Carries fixed-size reports, such as meter readings or analysis frames,
+   * from the audio thread back to a single user thread.
+   *
+   * The audio thread builds each report in place, in the next free slot,
+   * and publishes it with one release store; neither side ever waits for
+   * the other. If the user thread falls behind and every slot is full, new
+   * reports are refused rather than overwriting ones it hasn't read.
+   */
+  class ReportRing : public CacheAligned {
+  public:
+    // The length is rounded up to a power of two.
+    ReportRing(size_t reportSize, size_t length);
+
+    // Audio thread only. Returns the next free slot, or nullptr if the ring
+    // is full. Until it's committed, acquiring again returns the same slot.
+    unsigned char *acquire();
+
+    // Audio thread only. Publishes the slot returned by acquire(), and
+    // returns false for any other pointer.
+    bool commit(const void *slot);
+
+    // Consumer thread only. Copies up to maxReports of the oldest reports,
+    // back to back, into dest, and returns the number copied.
+    size_t read(void *dest, size_t maxReports);
+
+    size_t reportSize() const { return reportSize_; }
+
+  private:
+    const size_t reportSize_;
+
+    // reportSize_ rounded up so that every slot is suitably aligned for
+    // float and double members.
+    const size_t stride_;
+    const size_t mask_;
+    unique_buffer data_;
+
+    alignas(CACHE_ALIGN) std::atomic<size_t> readPos_ {0};
+    alignas(CACHE_ALIGN) std::atomic<size_t> writePos_ {0};
+
+    unsigned char *slot(size_t pos) const;
+  };
+
+} // namespace howie
+
+#endif // HOWIE_REPORTRING_H
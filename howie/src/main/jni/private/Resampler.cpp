@@ -0,0 +1,233 @@
+/*
+ * Copyright 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#include "Resampler.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include "../howie_dsp.h"
+
+namespace howie {
+
+  namespace {
+    // Passband edge, as a fraction of the lower of the two Nyquist rates,
+    // and the window's shape. Together they give around 80 dB rejection
+    // of images and aliases, flat to about 18 kHz at 44.1 kHz.
+    constexpr double kCutoff = 0.9;
+    constexpr double kBeta = 8.0;
+
+    // Floats per NEON vector; history rows start on one.
+    constexpr size_t kFloatsPerVector = 4;
+
+    uint32_t gcd(uint32_t a, uint32_t b) {
+      while (b != 0) {
+        uint32_t r = a % b;
+        a = b;
+        b = r;
+      }
+      return a;
+    }
+
+    // Zeroth order modified Bessel function of the first kind, for the
+    // Kaiser window.
+    double besselI0(double x) {
+      double sum = 1.0;
+      double term = 1.0;
+      for (int k = 1; k < 50 && term > 1e-12 * sum; ++k) {
+        double factor = x / (2.0 * k);
+        term *= factor * factor;
+        sum += term;
+      }
+      return sum;
+    }
+  } // namespace
+
+  constexpr int Resampler::kMinRate;
+  constexpr int Resampler::kMaxRate;
+  constexpr int Resampler::kMaxDownsampling;
+  constexpr size_t Resampler::kHalfTaps;
+  constexpr unsigned int Resampler::kMaxPhases;
+
+  bool Resampler::supported(int inputRate, int outputRate) {
+    return inputRate >= kMinRate && inputRate <= kMaxRate
+           && outputRate >= kMinRate && outputRate <= kMaxRate
+           && inputRate <= outputRate * kMaxDownsampling;
+  }
+
+  /**
+   * How big everything is. Output frame n of a period starting at phase p
+   * is filtered from the window of frames starting at history index
+   * floor((p + n * step) / den), so the period needs history up to the
+   * last window's start plus the tap count. After the period, history is
+   * shifted down so the next window starts at zero, leaving at least
+   * tapCount - step / den - 1 frames; that bounds the input needed.
+   */
+  Resampler::Geometry Resampler::geometry(int inputRate,
+                                          int outputRate,
+                                          size_t outputFrames) {
+    Geometry g;
+    uint32_t divisor = gcd(static_cast<uint32_t>(inputRate),
+                           static_cast<uint32_t>(outputRate));
+    g.step = static_cast<uint32_t>(inputRate) / divisor;
+    g.den = static_cast<uint32_t>(outputRate) / divisor;
+    g.phaseCount = std::min<uint32_t>(g.den, kMaxPhases);
+    size_t downsampling = (g.step + g.den - 1) / g.den;
+    g.tapCount = 2 * kHalfTaps * std::max<size_t>(downsampling, 1);
+
+    uint64_t lastWindow = (static_cast<uint64_t>(g.den) - 1
+                           + static_cast<uint64_t>(outputFrames - 1) * g.step)
+                          / g.den;
+    g.maxInputFrames = static_cast<size_t>(lastWindow) + g.step / g.den + 1;
+
+    size_t historyFrames = g.tapCount + g.maxInputFrames;
+    g.historyStride = (historyFrames + kFloatsPerVector - 1)
+                      & ~(kFloatsPerVector - 1);
+    return g;
+  }
+
+  size_t Resampler::storageSize(int inputRate,
+                                int outputRate,
+                                size_t outputFrames,
+                                size_t channelCount) {
+    Geometry g = geometry(inputRate, outputRate, outputFrames);
+    return (g.phaseCount * g.tapCount
+            + channelCount * g.historyStride
+            + channelCount * g.maxInputFrames) * sizeof(float);
+  }
+
+  Resampler::Resampler(int inputRate,
+                       int outputRate,
+                       size_t outputFrames,
+                       size_t channelCount,
+                       unsigned char *storage)
+      : inputRate_(inputRate),
+        geometry_(geometry(inputRate, outputRate, outputFrames)),
+        outputFrames_(outputFrames),
+        channelCount_(channelCount),
+        phaseScale_((static_cast<uint64_t>(geometry_.phaseCount) << 32)
+                    / geometry_.den),
+        appendAt_(new float *[channelCount]) {
+    coefficients_ = reinterpret_cast<float *>(storage);
+    history_ = coefficients_ + geometry_.phaseCount * geometry_.tapCount;
+    input_ = history_ + channelCount * geometry_.historyStride;
+    designFilter(inputRate, outputRate);
+
+    // Start with a window's worth of silence, less the frame the first
+    // output needs.
+    filled_ = geometry_.tapCount - 1;
+    std::fill(history_, input_, 0.f);
+    std::fill(input_, input_ + channelCount * geometry_.maxInputFrames, 0.f);
+  }
+
+  /**
+   * Row j of the bank is the filter for output frames that fall j /
+   * phaseCount of the way between the two frames at the centre of the
+   * window, normalized so every row has unity gain at DC.
+   */
+  void Resampler::designFilter(int inputRate, int outputRate) {
+    const size_t tapCount = geometry_.tapCount;
+    const double centre = tapCount / 2.0 - 1.0;
+    const double halfWidth = tapCount / 2.0;
+    const double cutoff = kCutoff * std::min(
+        1.0, static_cast<double>(outputRate) / inputRate);
+    const double windowScale = 1.0 / besselI0(kBeta);
+
+    for (uint32_t j = 0; j < geometry_.phaseCount; ++j) {
+      double fraction = static_cast<double>(j) / geometry_.phaseCount;
+      float *row = coefficients_ + j * tapCount;
+      double sum = 0.0;
+      for (size_t k = 0; k < tapCount; ++k) {
+        double x = k - centre - fraction;
+        double arg = M_PI * cutoff * x;
+        double sinc = arg == 0.0 ? 1.0 : std::sin(arg) / arg;
+        double r = x / halfWidth;
+        double window = r > -1.0 && r < 1.0
+                        ? besselI0(kBeta * std::sqrt(1.0 - r * r))
+                          * windowScale
+                        : 0.0;
+        double tap = sinc * window;
+        row[k] = static_cast<float>(tap);
+        sum += tap;
+      }
+      float gain = static_cast<float>(1.0 / sum);
+      for (size_t k = 0; k < tapCount; ++k) {
+        row[k] *= gain;
+      }
+    }
+  }
+
+  size_t Resampler::beginPeriod() {
+    uint64_t lastWindow = (phase_
+                           + static_cast<uint64_t>(outputFrames_ - 1)
+                             * geometry_.step)
+                          / geometry_.den;
+    size_t end = static_cast<size_t>(lastWindow) + geometry_.tapCount;
+    needed_ = end > filled_ ? end - filled_ : 0;
+    return needed_;
+  }
+
+  void Resampler::process(float *dest) {
+    // Append the new input to each channel's history.
+    for (size_t c = 0; c < channelCount_; ++c) {
+      appendAt_[c] = history(c) + filled_;
+    }
+    HowieDspDeinterleave(input_, appendAt_.get(), channelCount_, needed_);
+    filled_ += needed_;
+
+    const uint32_t wholeStep = geometry_.step / geometry_.den;
+    const uint32_t fractionStep = geometry_.step % geometry_.den;
+    const size_t tapCount = geometry_.tapCount;
+    uint32_t phase = phase_;
+    size_t window = 0;
+    for (size_t n = 0; n < outputFrames_; ++n) {
+      const float *row = taps(phase);
+      float *frame = dest + n * channelCount_;
+      for (size_t c = 0; c < channelCount_; ++c) {
+        frame[c] = HowieDspDotProduct(row, history(c) + window, tapCount);
+      }
+      window += wholeStep;
+      phase += fractionStep;
+      if (phase >= geometry_.den) {
+        phase -= geometry_.den;
+        ++window;
+      }
+    }
+    phase_ = phase;
+
+    // Shift the history down so the next period's first window starts at
+    // zero.
+    for (size_t c = 0; c < channelCount_; ++c) {
+      memmove(history(c), history(c) + window,
+              (filled_ - window) * sizeof(float));
+    }
+    filled_ -= window;
+    silent_ = false;
+  }
+
+  void Resampler::skipPeriod() {
+    // The same steps as process(), taken at once.
+    uint64_t end = phase_
+                   + static_cast<uint64_t>(outputFrames_) * geometry_.step;
+    size_t window = static_cast<size_t>(end / geometry_.den);
+    phase_ = static_cast<uint32_t>(end % geometry_.den);
+    filled_ = filled_ + needed_ - window;
+    if (!silent_) {
+      std::fill(history_, input_, 0.f);
+      silent_ = true;
+    }
+  }
+
+} // namespace howie
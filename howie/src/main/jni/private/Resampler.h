@@ -0,0 +1,147 @@
+/*
+ * Copyright 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#ifndef HOWIE_RESAMPLER_H
+#define HOWIE_RESAMPLER_H
+
+#include <memory>
+#include <stddef.h>
+#include <stdint.h>
+
+namespace howie {
+
+  /**
+   * Converts a stream's float frames from the rate the app renders at to
+   * the device's, a device period at a time.
+   *
+   * The filter is a Kaiser windowed sinc, evaluated as a polyphase bank:
+   * one set of taps for each fractional position an output frame can fall
+   * at. The rates are reduced to lowest terms and the position is kept as
+   * an exact fraction, so there's no drift, and for the usual rate pairs
+   * (44.1 to 48 kHz is 147 to 160) every position has taps of its own.
+   * Only for unusual pairs, with more than kMaxPhases positions, do the
+   * positions get rounded to the nearest of kMaxPhases.
+   *
+   * Each device period takes a varying number of input frames, depending
+   * on where the last one left off. beginPeriod() says how many; the
+   * caller renders them into input(), and process() turns them into a
+   * period of output. Nothing is allocated after construction.
+   */
+  class Resampler {
+  public:
+    static constexpr int kMinRate = 8000;
+    static constexpr int kMaxRate = 192000;
+
+    // Downsampling narrows the filter, which then needs more taps for the
+    // same quality, so the input can't be more than this much faster.
+    static constexpr int kMaxDownsampling = 4;
+
+    static bool supported(int inputRate, int outputRate);
+
+    // The storage a resampler needs for the coefficient bank, the filter
+    // history and the input.
+    static size_t storageSize(int inputRate,
+                              int outputRate,
+                              size_t outputFrames,
+                              size_t channelCount);
+
+    // storage must be at least storageSize() bytes, and outlive the
+    // resampler. The rates must be supported().
+    Resampler(int inputRate,
+              int outputRate,
+              size_t outputFrames,
+              size_t channelCount,
+              unsigned char *storage);
+
+    int inputRate() const { return inputRate_; }
+
+    // The most input frames any period will need.
+    size_t maxInputFrames() const { return geometry_.maxInputFrames; }
+    static size_t maxInputFrames(int inputRate,
+                                 int outputRate,
+                                 size_t outputFrames) {
+      return geometry(inputRate, outputRate, outputFrames).maxInputFrames;
+    }
+
+    // Audio thread only. Returns the number of interleaved frames the
+    // caller has to write into input() before calling process().
+    size_t beginPeriod();
+    float *input() const { return input_; }
+
+    // Audio thread only. Writes outputFrames interleaved frames to dest.
+    void process(float *dest);
+
+    // Audio thread only: instead of process(), account for a period of
+    // silent input, without filtering it or writing any output. The
+    // history is then silent, so process() picks up cleanly afterwards.
+    void skipPeriod();
+
+  private:
+    // Half the taps, at unity ratio; the zero crossings either side of
+    // the centre that the window covers.
+    static constexpr size_t kHalfTaps = 32;
+    static constexpr unsigned int kMaxPhases = 512;
+
+    struct Geometry {
+      // The rates in lowest terms: each output frame steps step / den
+      // input frames.
+      uint32_t step;
+      uint32_t den;
+      uint32_t phaseCount;
+      size_t tapCount;
+      size_t maxInputFrames;
+      // Floats per channel of history, rounded up to whole vectors.
+      size_t historyStride;
+    };
+    static Geometry geometry(int inputRate, int outputRate,
+                             size_t outputFrames);
+
+    void designFilter(int inputRate, int outputRate);
+    const float *taps(uint32_t phase) const {
+      uint32_t index = static_cast<uint32_t>((phase * phaseScale_) >> 32);
+      return coefficients_ + index * geometry_.tapCount;
+    }
+    float *history(size_t channel) const {
+      return history_ + channel * geometry_.historyStride;
+    }
+
+    const int inputRate_;
+    const Geometry geometry_;
+    const size_t outputFrames_;
+    const size_t channelCount_;
+
+    // Maps a position, in units of 1 / den, to its row of the bank, in
+    // 32.32 fixed point: exactly 1.0 when every position has its own row.
+    const uint64_t phaseScale_;
+
+    float *coefficients_;
+    float *history_;
+    float *input_;
+    std::unique_ptr<float *[]> appendAt_;
+
+    // The position of the next output frame: history index 0 plus
+    // phase_ / den. Every channel's history holds filled_ frames.
+    uint32_t phase_ = 0;
+    size_t filled_;
+    size_t needed_ = 0;
+
+    // Set by skipPeriod() once it has cleared the history.
+    bool silent_ = false;
+  };
+
+} // namespace howie
+
+#endif // HOWIE_RESAMPLER_H
@@ -1,8 +1,11 @@
 #ifndef COMMANDQUEUE_H
 #define COMMANDQUEUE_H
 
+#include <algorithm>
 #include <atomic>
 #include <cassert>
+#include <cstddef>
+#include <cstdint>
 #include <memory>
 #include <limits>
 
@@ -10,21 +13,38 @@
 #define CACHE_ALIGN 64
 #endif
 
+// A single producer, single consumer ring of T.
+//
+// Positions never need a divide to turn into indices. With a power of two
+// capacity they run freely and are masked; otherwise they run from zero to
+// twice the capacity and wrap there, which still tells a full ring from an
+// empty one.
+//
+// Each side keeps its own copy of the other side's position, and only
+// reloads it when that copy says the ring is full (or empty), so the
+// producer and consumer mostly stay off each other's cache line.
 template <typename T>
 class Ringbuffer {
 public:
-  explicit Ringbuffer(int size)
-      : Ringbuffer(size, new T[size]) {}
+  // With roundUpToPowerOfTwo, the capacity is rounded up to a power of two
+  // for the cheaper indexing. Capacities that already are one get it
+  // regardless.
+  explicit Ringbuffer(int size, bool roundUpToPowerOfTwo = false)
+      : Ringbuffer(roundUpToPowerOfTwo ? powerOfTwoAtLeast(size) : size,
+                   nullptr) {}
 
-
-  explicit Ringbuffer(int size, T* buffer)
-      : size_(size), buffer_(buffer) {
-
-    // This is necessary because we depend on twos-complement wraparound
-    // to take care of overflow conditions.
-    assert(size < std::numeric_limits<int>::max());
+  // Takes ownership of buffer, which must come from new T[size], or
+  // allocates one if buffer is null.
+  Ringbuffer(int size, T* buffer)
+      : size_(static_cast<uint32_t>(size)),
+        powerOfTwo_((size & (size - 1)) == 0),
+        buffer_(buffer ? buffer : new T[size]) {
+    // Positions go up to twice the capacity.
+    assert(size > 0 && size <= std::numeric_limits<int>::max() / 2);
   }
 
+  uint32_t capacity() const { return size_; }
+
   bool push(const T& item) {
     return push([&](T* ptr) -> bool {*ptr = item; return true; });
   }
@@ -67,24 +87,50 @@ public:
   // of push() changed its mind while writing (e.g. ran out of bytes)
   template<typename F>
   bool push(const F& writer) {
-    bool result = false;
-    int readptr = read_.load(std::memory_order_acquire);
-    int writeptr = write_.load(std::memory_order_relaxed);
-
-    // note that while readptr and writeptr will eventually
-    // wrap around, taking their difference is still valid as
-    // long as size_ < MAXINT.
-    int space = size_ - (int)(writeptr - readptr);
-    if (space >= 1) {
-      result = true;
-
-      // writer
-      if (writer(buffer_.get() + (writeptr % size_))) {
-        ++writeptr;
-        write_.store(writeptr, std::memory_order_release);
-      }
+    uint32_t writeptr = write_.load(std::memory_order_relaxed);
+    if (freeSpace(writeptr) < 1) {
+      return false;
     }
-    return result;
+    if (writer(&buffer_[index(writeptr)])) {
+      write_.store(advance(writeptr, 1), std::memory_order_release);
+    }
+    return true;
+  }
+
+  // Offers writer up to maxCount free slots, as one or two contiguous
+  // runs in ring order:
+  //   size_t writer(T *first, size_t firstCount,
+  //                 T *second, size_t secondCount)
+  // The writer fills as many as it likes, from the start of first, and
+  // returns how many; those are published together. It isn't called if
+  // the ring is full. Returns the number of elements pushed.
+  template<typename F>
+  size_t push_n(size_t maxCount, const F& writer) {
+    uint32_t writeptr = write_.load(std::memory_order_relaxed);
+    size_t count = std::min<size_t>(maxCount, freeSpace(writeptr, maxCount));
+    if (count == 0) {
+      return 0;
+    }
+    uint32_t start = index(writeptr);
+    size_t first = std::min<size_t>(count, size_ - start);
+    size_t written = writer(&buffer_[start], first,
+                            &buffer_[0], count - first);
+    assert(written <= count);
+    if (written > 0) {
+      write_.store(advance(writeptr, static_cast<uint32_t>(written)),
+                   std::memory_order_release);
+    }
+    return written;
+  }
+
+  // Copies in as much of src as fits.
+  size_t push_n(const T* src, size_t count) {
+    return push_n(count, [&](T* first, size_t firstCount,
+                             T* second, size_t secondCount) -> size_t {
+      std::copy(src, src + firstCount, first);
+      std::copy(src + firstCount, src + firstCount + secondCount, second);
+      return firstCount + secondCount;
+    });
   }
 
   bool pop(T* out_item) {
@@ -93,54 +139,124 @@ public:
 
   template<typename F>
   bool pop(const F& reader) {
-    bool result = false;
-
-    int writeptr = write_.load(std::memory_order_acquire);
-    int readptr = read_.load(std::memory_order_relaxed);
-
-    // As above, wraparound is ok
-    int available = (int)(writeptr - readptr);
-    if (available >= 1) {
-      result = true;
-      if (reader(buffer_.get() + (readptr % size_))) {
-        ++readptr;
-        read_.store(readptr, std::memory_order_release);
+    uint32_t readptr = read_.load(std::memory_order_relaxed);
+    if (available(readptr) < 1) {
+      return false;
+    }
+    if (reader(&buffer_[index(readptr)])) {
+      read_.store(advance(readptr, 1), std::memory_order_release);
+    }
+    return true;
+  }
 
-      }
+  // The consumer's side of push_n: reader sees up to maxCount elements, in
+  // one or two contiguous runs, and returns how many it consumed from the
+  // start of first. They stay in place, so the reader can work on them
+  // directly.
+  template<typename F>
+  size_t pop_n(size_t maxCount, const F& reader) {
+    uint32_t readptr = read_.load(std::memory_order_relaxed);
+    size_t count = std::min<size_t>(maxCount, available(readptr, maxCount));
+    if (count == 0) {
+      return 0;
+    }
+    uint32_t start = index(readptr);
+    size_t first = std::min<size_t>(count, size_ - start);
+    size_t consumed = reader(&buffer_[start], first,
+                             &buffer_[0], count - first);
+    assert(consumed <= count);
+    if (consumed > 0) {
+      read_.store(advance(readptr, static_cast<uint32_t>(consumed)),
+                  std::memory_order_release);
     }
+    return consumed;
+  }
 
-    return result;
+  // Copies out up to maxCount elements.
+  size_t pop_n(T* dest, size_t maxCount) {
+    return pop_n(maxCount, [&](T* first, size_t firstCount,
+                               T* second, size_t secondCount) -> size_t {
+      std::copy(first, first + firstCount, dest);
+      std::copy(second, second + secondCount, dest + firstCount);
+      return firstCount + secondCount;
+    });
   }
 
   uint32_t size(void) {
-    int writeptr = write_.load(std::memory_order_acquire);
-    int readptr = read_.load(std::memory_order_relaxed);
-
-#if 0
-    // As above, wraparound is ok
-    int32_t count = (writeptr - readptr);
-    if( count < 0 ) {
-        count = size_ + count;
-    }
-    return (uint32_t )count;
-#else
-    return (uint32_t)(writeptr - readptr);
-#endif
+    uint32_t writeptr = write_.load(std::memory_order_acquire);
+    uint32_t readptr = read_.load(std::memory_order_relaxed);
+    return distance(readptr, writeptr);
   }
 
   bool empty(void) {
      return (size() == 0 );
   }
 private:
-  int size_;
-  std::unique_ptr<T> buffer_;
+  static int powerOfTwoAtLeast(int n) {
+    int result = 1;
+    while (result < n) {
+      result <<= 1;
+    }
+    return result;
+  }
+
+  uint32_t index(uint32_t pos) const {
+    if (powerOfTwo_) {
+      return pos & (size_ - 1);
+    }
+    return pos < size_ ? pos : pos - size_;
+  }
+
+  uint32_t advance(uint32_t pos, uint32_t count) const {
+    pos += count;
+    if (!powerOfTwo_ && pos >= 2 * size_) {
+      pos -= 2 * size_;
+    }
+    return pos;
+  }
+
+  // The number of elements from one position up to another.
+  uint32_t distance(uint32_t from, uint32_t to) const {
+    if (powerOfTwo_ || to >= from) {
+      return to - from;
+    }
+    return to + 2 * size_ - from;
+  }
+
+  // Producer side: the free space, going by the cached read position
+  // unless that's too little.
+  uint32_t freeSpace(uint32_t writeptr, size_t wanted = 1) {
+    uint32_t space = size_ - distance(cachedRead_, writeptr);
+    if (space < wanted) {
+      cachedRead_ = read_.load(std::memory_order_acquire);
+      space = size_ - distance(cachedRead_, writeptr);
+    }
+    return space;
+  }
+
+  // Consumer side, likewise.
+  uint32_t available(uint32_t readptr, size_t wanted = 1) {
+    uint32_t count = distance(readptr, cachedWrite_);
+    if (count < wanted) {
+      cachedWrite_ = write_.load(std::memory_order_acquire);
+      count = distance(readptr, cachedWrite_);
+    }
+    return count;
+  }
+
+  const uint32_t size_;
+  const bool powerOfTwo_;
+  std::unique_ptr<T[]> buffer_;
 
   // forcing cache line alignment to eliminate false sharing of the
   // frequently-updated read and write pointers. The object is to never
   // let these get into the "shared" state where they'd cause a cache miss
-  // for every write.
-  alignas(CACHE_ALIGN) std::atomic<int> read_ { 0 };
-  alignas(CACHE_ALIGN) std::atomic<int> write_ { 0 };
+  // for every write. Each side's copy of the other's position lives on its
+  // own line.
+  alignas(CACHE_ALIGN) std::atomic<uint32_t> read_ { 0 };
+  uint32_t cachedWrite_ = 0;
+  alignas(CACHE_ALIGN) std::atomic<uint32_t> write_ { 0 };
+  uint32_t cachedRead_ = 0;
 };
 
 #endif // COMMANDQUEUE_H
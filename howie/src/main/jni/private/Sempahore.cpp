@@ -3,6 +3,7 @@
 //
 
 #include "Sempahore.h"
+#include <algorithm>
 #include "howie-private.h"
 
 void Sempahore::wait() {
@@ -14,20 +15,31 @@ void Sempahore::wait() {
   // if the previous value of the available count was zero or less, that
   // means it's at most -1 now. We'll need to wait.
   if (available <= 0) {
+    // wakeups_ covers a signal that lands before we reach the wait.
     std::unique_lock<std::mutex> lock(mu_);
-    cond_.wait(lock);
+    cond_.wait(lock, [this] { return wakeups_ > 0; });
+    --wakeups_;
   }
 }
 
-void Sempahore::signal() {
+void Sempahore::signal(int count) {
   // Release semantics used here because we assume the order of
   // operations is
   // 1. do something
   // 2. signal
-  int available = count_.fetch_add(1, std::memory_order_release);
+  int available = count_.fetch_add(count, std::memory_order_release);
 
   // If the available count was less than zero, there's somebody waiting.
-  if (available < 0) {
-    cond_.notify_one();
+  int waiting = std::min(count, -available);
+  if (waiting > 0) {
+    {
+      std::lock_guard<std::mutex> lock(mu_);
+      wakeups_ += waiting;
+    }
+    if (waiting == 1) {
+      cond_.notify_one();
+    } else {
+      cond_.notify_all();
+    }
   }
 }
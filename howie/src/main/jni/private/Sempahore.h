@@ -7,14 +7,18 @@
 
 
 #include <atomic>
+#include <condition_variable>
 #include <mutex>
 
 class Sempahore {
 public:
   void wait();
-  void signal();
+  // Releases count waiters, or lets the next count calls to wait() through.
+  void signal(int count = 1);
 private:
   std::atomic<int> count_ {0};
+  // The number of waiters signalled but not yet woken. Guarded by mu_.
+  int wakeups_ = 0;
   std::mutex mu_;
   std::condition_variable cond_;
 };
@@ -0,0 +1,45 @@
+/*
+ * Copyright 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#include "StreamArena.h"
+#include <cstdlib>
+#include <cstring>
+#include <sys/mman.h>
+
+namespace howie {
+
+  StreamArena::StreamArena(const Plan &plan) : plan_(plan) {
+    for (int i = 0; i < kMaxRegions; ++i) {
+      offsets_[i] = size_;
+      size_ += roundUp(plan_.sizes[i]);
+    }
+    void *base = nullptr;
+    if (size_ > 0 && posix_memalign(&base, CACHE_ALIGN, size_) == 0) {
+      base_ = static_cast<unsigned char *>(base);
+      memset(base_, 0, size_);
+      // Best effort: the memlock limit is often too small for this.
+      locked_ = mlock(base_, size_) == 0;
+    }
+  }
+
+  StreamArena::~StreamArena() {
+    if (locked_) {
+      munlock(base_, size_);
+    }
+    free(base_);
+  }
+
+} // namespace howie
@@ -0,0 +1,74 @@
+/*
+ * Copyright 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#ifndef HOWIE_STREAMARENA_H
+#define HOWIE_STREAMARENA_H
+
+#include <stddef.h>
+
+#ifndef CACHE_ALIGN
+#define CACHE_ALIGN 64
+#endif
+
+namespace howie {
+
+  /**
+   * All of a stream's buffers, carved from a single allocation.
+   *
+   * Every region starts on a cache line of its own, so buffers written by
+   * the audio thread never share a line with buffers written by user
+   * threads. The memory is zeroed, and with it faulted in, when the arena
+   * is created, and locked into RAM if the process is allowed to, so the
+   * first callbacks don't take page faults.
+   */
+  class StreamArena {
+  public:
+    static constexpr int kMaxRegions = 10;
+
+    // The size of each region. Regions can be empty.
+    struct Plan {
+      size_t sizes[kMaxRegions];
+    };
+
+    explicit StreamArena(const Plan &plan);
+    ~StreamArena();
+
+    StreamArena(const StreamArena &) = delete;
+    StreamArena &operator=(const StreamArena &) = delete;
+
+    // Both are zero if the allocation failed.
+    unsigned char *region(int index) const {
+      return base_ ? base_ + offsets_[index] : nullptr;
+    }
+    size_t regionSize(int index) const {
+      return base_ ? plan_.sizes[index] : 0;
+    }
+
+    static size_t roundUp(size_t size) {
+      return (size + CACHE_ALIGN - 1) & ~static_cast<size_t>(CACHE_ALIGN - 1);
+    }
+
+  private:
+    Plan plan_;
+    size_t offsets_[kMaxRegions];
+    size_t size_ = 0;
+    unsigned char *base_ = nullptr;
+    bool locked_ = false;
+  };
+
+} // namespace howie
+
+#endif // HOWIE_STREAMARENA_H
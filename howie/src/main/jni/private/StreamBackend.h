@@ -0,0 +1,131 @@
+/*
+ * Copyright 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#ifndef HOWIE_STREAMBACKEND_H
+#define HOWIE_STREAMBACKEND_H
+
+#include "../howie.h"
+#include "unique_buffer.h"
+
+namespace howie {
+  class RealtimeLog;
+  class StreamStatistics;
+
+  // The buffers a backend can ask its client for. The client keeps them
+  // in its arena, so they're allocated and prefaulted with the stream.
+  enum BackendBuffer {
+    kInputBuffer,
+    kOutputBuffer,
+    kFloatInputBuffer,
+    kFloatOutputBuffer,
+    kRecordFloatBuffer,
+    kSyncedInputBuffer,
+    kBackendBufferCount
+  };
+
+  /**
+   * The audio API underneath a stream: it opens the device, runs the
+   * stream's periods on its own audio thread, and starts and stops.
+   * Everything the app sees (parameters, events, capture, statistics) is
+   * the stream's business, on top of whichever backend is running it.
+   */
+  class StreamBackend {
+  public:
+    struct Config {
+      HowieDirection direction;
+      HowieSampleFormat sampleFormat;
+
+      // The playback queue depth, in periods, and the most it may adapt
+      // up to, with the defaults already filled in. maxPlaybackBufferCount
+      // is never less than playbackBufferCount, and the queue only adapts
+      // if it's more.
+      unsigned int playbackBufferCount;
+      unsigned int maxPlaybackBufferCount;
+      int latencyStableWindowMs;
+    };
+
+    // The stream a backend runs.
+    class Client {
+    public:
+      // Run one period, on the backend's audio thread. The buffers are in
+      // the format described by the characteristics open() returned, and
+      // hold one period each; a direction the stream doesn't have gets an
+      // empty buffer.
+      virtual HowieError onPeriod(const HowieBuffer *in,
+                                  const HowieBuffer *out) = 0;
+
+      // The stream's counters and audio thread log, for the backend to
+      // fill in from its audio thread.
+      virtual StreamStatistics &statistics() = 0;
+      virtual RealtimeLog &realtimeLog() = 0;
+
+      // Point buffer at size bytes of the stream's preallocated memory, or
+      // at a new allocation if the stream didn't plan for that much.
+      virtual void useBuffer(unique_buffer *buffer,
+                             BackendBuffer which,
+                             size_t size) = 0;
+
+    protected:
+      ~Client() {}
+    };
+
+    // Destroying a backend closes the device, and waits for any period in
+    // progress to finish.
+    virtual ~StreamBackend() {}
+
+    // Worker thread only. On the way in, *characteristics are the device's;
+    // on success they describe what the client's periods will see. The
+    // stream is left stopped. A backend that fails to open can be destroyed
+    // and another one tried.
+    virtual HowieError open(const Config &config,
+                            Client *client,
+                            HowieDeviceCharacteristics *characteristics) = 0;
+    virtual HowieError start() = 0;
+    virtual HowieError stop() = 0;
+
+    // Run frameCount frames through the client on the calling thread, for
+    // a backend that has no audio thread of its own. See
+    // HowieStreamRender.
+    virtual HowieError render(size_t /* frameCount */,
+                              const HowieBuffer * /* in */,
+                              const HowieBuffer * /* out */) {
+      return HOWIE_ERROR_UNSUPPORTED;
+    }
+
+    // Fill in the fields of dest that only the backend knows.
+    virtual void getStatistics(HowieStreamStatistics *dest) const = 0;
+
+    // For logging.
+    virtual const char *name() const = 0;
+
+    // Switch characteristics over to float samples.
+    static void useFloatCharacteristics(
+        HowieDeviceCharacteristics *characteristics) {
+      characteristics->bitsPerSample = 32;
+      characteristics->bytesPerSample = sizeof(float);
+      characteristics->sampleMask = static_cast<int>(0xffffffff);
+      characteristics->floatingPoint = true;
+    }
+
+    static int64_t periodNs(const HowieDeviceCharacteristics &c) {
+      return static_cast<int64_t>(c.framesPerPeriod) * 1000000000LL
+             / c.sampleRate;
+    }
+  };
+
+} // namespace howie
+
+#endif // HOWIE_STREAMBACKEND_H
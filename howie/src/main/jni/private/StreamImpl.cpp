@@ -17,8 +17,13 @@
 #include "StreamImpl.h"
 #include "howie-private.h"
 #include "EngineImpl.h"
+#include "Mixer.h"
+#include "OpenSLBackend.h"
+#include "../howie_dsp.h"
+#include <algorithm>
 #include <thread>
 #include <cstring>
+#include <vector>
 
 /**
  * Implements the C accessor for device characteristics
@@ -32,6 +37,39 @@ HowieError HowieGetDeviceCharacteristics(HowieDeviceCharacteristics *dest) {
          sizeof(HowieDeviceCharacteristics));
 }
 
+/**
+ * Implements the C interface for configuring the shared output
+ */
+HowieError HowieSetSharedOutputThreadCount(int threadCount) {
+  HOWIE_TRACE_FN(HOWIE_TRACE_LEVEL_CALLS)
+  HOWIE_CHECK_ENGINE_INITIALIZED();
+  return howie::EngineImpl::get()->setSharedOutputThreadCount(threadCount);
+}
+
+/**
+ * Implements the C interface for configuring the stream pool
+ */
+HowieError HowieConfigureStreamPool(const HowieStreamPoolParams *params) {
+  HOWIE_TRACE_FN(HOWIE_TRACE_LEVEL_CALLS)
+  HOWIE_CHECK_ENGINE_INITIALIZED();
+  HOWIE_CHECK_NOT_NULL(params);
+  HOWIE_CHECK(howie::checkCast<const HowieStreamPoolParams*>(params));
+
+  return howie::EngineImpl::get()->configureStreamPool(*params);
+}
+
+/**
+ * Implements the C interface for configuring audio threads
+ */
+HowieError HowieConfigureAudioThreads(const HowieAudioThreadParams *params) {
+  HOWIE_TRACE_FN(HOWIE_TRACE_LEVEL_CALLS)
+  HOWIE_CHECK_ENGINE_INITIALIZED();
+  HOWIE_CHECK_NOT_NULL(params);
+  HOWIE_CHECK(howie::checkCast<const HowieAudioThreadParams*>(params));
+
+  return howie::EngineImpl::get()->configureAudioThreads(*params);
+}
+
 /**
  * Implements the C interface for stream creation
  */
@@ -57,8 +95,8 @@ HowieError HowieStreamDestroy(HowieStream *stream) {
   HOWIE_CHECK(howie::checkCast<const howie::StreamImpl*>(stream));
 
 
-  howie::EngineImpl::get()->DoAsync([=]{
-    delete(reinterpret_cast<howie::StreamImpl*>(stream));});
+  return howie::EngineImpl::get()->DoAsync([=]{
+    delete(static_cast<howie::StreamImpl*>(stream));});
 }
 
 /**
@@ -76,15 +114,314 @@ HowieError HowieStreamSendParameters(
   HOWIE_CHECK(howie::checkCast<const howie::StreamImpl*>(stream));
 
 
-  howie::StreamImpl *pStream = reinterpret_cast<howie::StreamImpl *>(stream);
+  howie::StreamImpl *pStream = static_cast<howie::StreamImpl *>(stream);
+
+  if (!pStream->PushParameterBlock(parameters, size, timeoutMs)) {
+    result = HOWIE_ERROR_AGAIN;
+  }
+  HOWIE_CHECK(result);
+  return result;
+}
+
+/**
+ * Implements the C interface for patching part of the parameter block
+ */
+HowieError HowieStreamPatchParameters(
+    HowieStream *stream,
+    size_t offset,
+    const void *data,
+    size_t size,
+    int timeoutMs) {
+  HOWIE_TRACE_FN(HOWIE_TRACE_LEVEL_CALLS)
+  HowieError result = HOWIE_SUCCESS;
+  HOWIE_CHECK_ENGINE_INITIALIZED();
+  HOWIE_CHECK_NOT_NULL(stream);
+  HOWIE_CHECK_NOT_NULL(data);
+  HOWIE_CHECK(howie::checkCast<const howie::StreamImpl*>(stream));
+
+
+  howie::StreamImpl *pStream = static_cast<howie::StreamImpl *>(stream);
+
+  if (offset > pStream->parameterBlockSize()
+      || size > pStream->parameterBlockSize() - offset) {
+    result = HOWIE_ERROR_INVALID_PARAMETER;
+  } else if (!pStream->PatchParameterBlock(offset, data, size, timeoutMs)) {
+    result = HOWIE_ERROR_AGAIN;
+  }
+  HOWIE_CHECK(result);
+  return result;
+}
+
+/**
+ * Implements the C interface for writing parameters in place
+ */
+HowieError HowieStreamAcquireParameterSlot(
+    HowieStream *stream,
+    void **slot,
+    size_t *size,
+    int timeoutMs) {
+  HOWIE_TRACE_FN(HOWIE_TRACE_LEVEL_CALLS)
+  HowieError result = HOWIE_SUCCESS;
+  HOWIE_CHECK_ENGINE_INITIALIZED();
+  HOWIE_CHECK_NOT_NULL(stream);
+  HOWIE_CHECK_NOT_NULL(slot);
+  HOWIE_CHECK(howie::checkCast<const howie::StreamImpl*>(stream));
+
+
+  howie::StreamImpl *pStream = static_cast<howie::StreamImpl *>(stream);
+
+  *slot = pStream->AcquireParameterSlot(timeoutMs);
+  if (!*slot) {
+    result = HOWIE_ERROR_AGAIN;
+  } else if (size) {
+    *size = pStream->parameterBlockSize();
+  }
+  HOWIE_CHECK(result);
+  return result;
+}
+
+HowieError HowieStreamCommitParameters(HowieStream *stream, void *slot) {
+  HOWIE_TRACE_FN(HOWIE_TRACE_LEVEL_CALLS)
+  HowieError result = HOWIE_SUCCESS;
+  HOWIE_CHECK_ENGINE_INITIALIZED();
+  HOWIE_CHECK_NOT_NULL(stream);
+  HOWIE_CHECK_NOT_NULL(slot);
+  HOWIE_CHECK(howie::checkCast<const howie::StreamImpl*>(stream));
+
+
+  howie::StreamImpl *pStream = static_cast<howie::StreamImpl *>(stream);
+
+  if (!pStream->CommitParameterSlot(slot)) {
+    result = HOWIE_ERROR_INVALID_PARAMETER;
+  }
+  HOWIE_CHECK(result);
+  return result;
+}
+
+/**
+ * Implements the C interface for reading callback timing statistics
+ */
+HowieError HowieStreamGetStatistics(
+    HowieStream *stream,
+    HowieStreamStatistics *dest) {
+  HOWIE_TRACE_FN(HOWIE_TRACE_LEVEL_CALLS)
+  HOWIE_CHECK_ENGINE_INITIALIZED();
+  HOWIE_CHECK_NOT_NULL(stream);
+  HOWIE_CHECK_NOT_NULL(dest);
+  HOWIE_CHECK(howie::checkCast<const howie::StreamImpl*>(stream));
+  HOWIE_CHECK(howie::checkCast<const HowieStreamStatistics*>(dest));
+
+  static_cast<howie::StreamImpl *>(stream)->getStatistics(dest);
+  return HOWIE_SUCCESS;
+}
+
+/**
+ * Implements the C interface for draining captured input
+ */
+HowieError HowieStreamReadCaptured(
+    HowieStream *stream,
+    void *dest,
+    size_t size,
+    size_t *bytesRead,
+    int timeoutMs) {
+  HOWIE_TRACE_FN(HOWIE_TRACE_LEVEL_CALLS)
+  HOWIE_CHECK_ENGINE_INITIALIZED();
+  HOWIE_CHECK_NOT_NULL(stream);
+  HOWIE_CHECK_NOT_NULL(dest);
+  HOWIE_CHECK(howie::checkCast<const howie::StreamImpl*>(stream));
+
+
+  howie::StreamImpl *pStream = static_cast<howie::StreamImpl *>(stream);
+  if (!pStream->hasCaptureRing()) {
+    HOWIE_CHECK(HOWIE_ERROR_INVALID_PARAMETER);
+  }
+
+  size_t result = pStream->ReadCaptured(dest, size, timeoutMs);
+  if (bytesRead) {
+    *bytesRead = result;
+  }
+  // Not worth logging: running out of input is routine for a reader.
+  return result > 0 ? HOWIE_SUCCESS : HOWIE_ERROR_AGAIN;
+}
+
+/**
+ * Implements the C interface for offline rendering
+ */
+HowieError HowieStreamRender(HowieStream *stream,
+                             size_t frameCount,
+                             const HowieBuffer *in,
+                             const HowieBuffer *out) {
+  HOWIE_TRACE_FN(HOWIE_TRACE_LEVEL_CALLS)
+  HOWIE_CHECK_ENGINE_INITIALIZED();
+  HOWIE_CHECK_NOT_NULL(stream);
+  HOWIE_CHECK(howie::checkCast<const howie::StreamImpl*>(stream));
+  if (in) {
+    HOWIE_CHECK(howie::checkCast<const HowieBuffer*>(in));
+  }
+  if (out) {
+    HOWIE_CHECK(howie::checkCast<const HowieBuffer*>(out));
+  }
+
+  howie::StreamImpl *pStream = static_cast<howie::StreamImpl *>(stream);
+  return pStream->Render(frameCount, in, out);
+}
+
+/**
+ * Implements the C interface for timestamped events
+ */
+HowieError HowieStreamGetFrameTime(HowieStream *stream, int64_t *frameTime) {
+  HOWIE_TRACE_FN(HOWIE_TRACE_LEVEL_CALLS)
+  HOWIE_CHECK_ENGINE_INITIALIZED();
+  HOWIE_CHECK_NOT_NULL(stream);
+  HOWIE_CHECK_NOT_NULL(frameTime);
+  HOWIE_CHECK(howie::checkCast<const howie::StreamImpl*>(stream));
+
+  *frameTime = static_cast<howie::StreamImpl *>(stream)->frameTime();
+  return HOWIE_SUCCESS;
+}
+
+HowieError HowieStreamScheduleEvent(HowieStream *stream,
+                                    int64_t frameTime,
+                                    const void *data,
+                                    size_t size) {
+  HOWIE_TRACE_FN(HOWIE_TRACE_LEVEL_CALLS)
+  HowieError result = HOWIE_SUCCESS;
+  HOWIE_CHECK_ENGINE_INITIALIZED();
+  HOWIE_CHECK_NOT_NULL(stream);
+  HOWIE_CHECK(howie::checkCast<const howie::StreamImpl*>(stream));
 
-  if (!pStream->PushParameterBlock(parameters, size)) {
+  howie::StreamImpl *pStream = static_cast<howie::StreamImpl *>(stream);
+  if (!pStream->hasEventQueue() || size > HOWIE_EVENT_MAX_SIZE
+      || (size > 0 && !data)) {
+    result = HOWIE_ERROR_INVALID_PARAMETER;
+  } else if (!pStream->ScheduleEvent(frameTime, data, size)) {
     result = HOWIE_ERROR_AGAIN;
   }
   HOWIE_CHECK(result);
   return result;
 }
 
+/**
+ * Called from the process callback, so this mustn't log.
+ */
+HowieError HowieStreamGetEvents(const HowieStream *stream,
+                                const HowieEvent **events,
+                                size_t *count) {
+  HOWIE_TRACE_FN(HOWIE_TRACE_LEVEL_REALTIME)
+  if (!stream || !events || !count) {
+    return HOWIE_ERROR_NULL;
+  }
+  HowieError result = howie::checkCast<const howie::StreamImpl*>(stream);
+  if (HOWIE_SUCCEEDED(result)) {
+    static_cast<const howie::StreamImpl *>(stream)->getEvents(events,
+                                                                   count);
+  }
+  return result;
+}
+
+/**
+ * Implements the C interface for idle mode. Like the report functions, it
+ * casts away const, since the audio thread owns the idle state, and it
+ * mustn't log.
+ */
+HowieError HowieStreamSetIdle(const HowieStream *stream) {
+  HOWIE_TRACE_FN(HOWIE_TRACE_LEVEL_REALTIME)
+  if (!stream) {
+    return HOWIE_ERROR_NULL;
+  }
+  HowieError result = howie::checkCast<const howie::StreamImpl*>(stream);
+  if (HOWIE_SUCCEEDED(result)) {
+    result = const_cast<howie::StreamImpl *>(
+        static_cast<const howie::StreamImpl *>(stream))->requestIdle();
+  }
+  return result;
+}
+
+/**
+ * Implements the C interface for reports. The process callback only has a
+ * const stream, but the audio thread owns the writing side of the report
+ * ring, so the first two cast that away. Neither may log.
+ */
+HowieError HowieStreamAcquireReport(const HowieStream *stream, void **report) {
+  HOWIE_TRACE_FN(HOWIE_TRACE_LEVEL_REALTIME)
+  if (!stream || !report) {
+    return HOWIE_ERROR_NULL;
+  }
+  HowieError result = howie::checkCast<const howie::StreamImpl*>(stream);
+  if (HOWIE_SUCCEEDED(result)) {
+    howie::StreamImpl *pStream = const_cast<howie::StreamImpl *>(
+        static_cast<const howie::StreamImpl *>(stream));
+    if (!pStream->hasReportRing()) {
+      result = HOWIE_ERROR_INVALID_PARAMETER;
+    } else {
+      *report = pStream->AcquireReport();
+      result = *report ? HOWIE_SUCCESS : HOWIE_ERROR_AGAIN;
+    }
+  }
+  return result;
+}
+
+HowieError HowieStreamCommitReport(const HowieStream *stream,
+                                   const void *report) {
+  HOWIE_TRACE_FN(HOWIE_TRACE_LEVEL_REALTIME)
+  if (!stream || !report) {
+    return HOWIE_ERROR_NULL;
+  }
+  HowieError result = howie::checkCast<const howie::StreamImpl*>(stream);
+  if (HOWIE_SUCCEEDED(result)) {
+    howie::StreamImpl *pStream = const_cast<howie::StreamImpl *>(
+        static_cast<const howie::StreamImpl *>(stream));
+    if (!pStream->hasReportRing() || !pStream->CommitReport(report)) {
+      result = HOWIE_ERROR_INVALID_PARAMETER;
+    }
+  }
+  return result;
+}
+
+HowieError HowieStreamReceiveReports(HowieStream *stream,
+                                     void *dest,
+                                     size_t size,
+                                     size_t *reportCount) {
+  HOWIE_TRACE_FN(HOWIE_TRACE_LEVEL_CALLS)
+  HOWIE_CHECK_ENGINE_INITIALIZED();
+  HOWIE_CHECK_NOT_NULL(stream);
+  HOWIE_CHECK_NOT_NULL(dest);
+  HOWIE_CHECK(howie::checkCast<const howie::StreamImpl*>(stream));
+
+  howie::StreamImpl *pStream = static_cast<howie::StreamImpl *>(stream);
+  if (!pStream->hasReportRing()) {
+    HOWIE_CHECK(HOWIE_ERROR_INVALID_PARAMETER);
+  }
+
+  size_t result = pStream->ReceiveReports(dest, size);
+  if (reportCount) {
+    *reportCount = result;
+  }
+  // Like HowieStreamReadCaptured, an empty ring is routine.
+  return result > 0 ? HOWIE_SUCCESS : HOWIE_ERROR_AGAIN;
+}
+
+namespace {
+  /**
+   * The worker task that puts a stream into newState, or an empty task if
+   * newState isn't one.
+   */
+  Worker::work_item_t stateChange(howie::StreamImpl *pStream,
+                                  HowieStreamState newState) {
+    switch (newState) {
+      case HOWIE_STREAM_STATE_PLAYING:
+        return [=] {
+          pStream->commandCompleted(pStream->run());
+        };
+      case HOWIE_STREAM_STATE_STOPPED:
+        return [=] {
+          pStream->commandCompleted(pStream->stop());
+        };
+    }
+    return Worker::work_item_t();
+  }
+} // namespace
+
 HowieError HowieStreamSetState(HowieStream *stream,
                                HowieStreamState newState) {
   HOWIE_TRACE_FN(HOWIE_TRACE_LEVEL_CALLS)
@@ -94,24 +431,63 @@ HowieError HowieStreamSetState(HowieStream *stream,
   HOWIE_CHECK(howie::checkCast<const howie::StreamImpl*>(stream));
 
 
-  howie::StreamImpl *pStream = reinterpret_cast<howie::StreamImpl *>(stream);
+  howie::StreamImpl *pStream = static_cast<howie::StreamImpl *>(stream);
 
-  switch (newState) {
-    case HOWIE_STREAM_STATE_PLAYING:
-      result = howie::EngineImpl::get()->DoAsync([=] {
-          pStream->run();
-      });
-      break;
-    case HOWIE_STREAM_STATE_STOPPED:
-      result = howie::EngineImpl::get()->DoAsync([=] {
-        pStream->stop();
-      });
-      break;
+  Worker::work_item_t task = stateChange(pStream, newState);
+  if (!task) {
+    result = HOWIE_ERROR_INVALID_PARAMETER;
+  } else {
+    result = howie::EngineImpl::get()->DoAsync(std::move(task));
   }
   HOWIE_CHECK(result);
   return result;
 }
 
+HowieError HowieStreamSetStates(HowieStream *const *streams,
+                                const HowieStreamState *states,
+                                size_t count) {
+  HOWIE_TRACE_FN(HOWIE_TRACE_LEVEL_CALLS)
+  HOWIE_CHECK_ENGINE_INITIALIZED();
+  HOWIE_CHECK_NOT_NULL(streams);
+  HOWIE_CHECK_NOT_NULL(states);
+
+  std::vector<Worker::work_item_t> tasks(count);
+  for (size_t i = 0; i < count; ++i) {
+    HOWIE_CHECK_NOT_NULL(streams[i]);
+    HOWIE_CHECK(howie::checkCast<const howie::StreamImpl*>(streams[i]));
+    tasks[i] = stateChange(static_cast<howie::StreamImpl *>(streams[i]),
+                           states[i]);
+    if (!tasks[i]) {
+      HOWIE_CHECK(HOWIE_ERROR_INVALID_PARAMETER);
+    }
+  }
+  HOWIE_CHECK(howie::EngineImpl::get()->DoAsync(tasks.data(), count));
+  return HOWIE_SUCCESS;
+}
+
+/**
+ * Implements the C interface for waiting on queued commands
+ */
+HowieError HowieGetCompletionToken(HowieCompletionToken *token) {
+  HOWIE_TRACE_FN(HOWIE_TRACE_LEVEL_CALLS)
+  HOWIE_CHECK_ENGINE_INITIALIZED();
+  HOWIE_CHECK_NOT_NULL(token);
+  *token = howie::EngineImpl::get()->lastTicket();
+  return HOWIE_SUCCESS;
+}
+
+HowieError HowieWaitForCompletion(HowieCompletionToken token, int timeoutMs) {
+  HOWIE_TRACE_FN(HOWIE_TRACE_LEVEL_CALLS)
+  HOWIE_CHECK_ENGINE_INITIALIZED();
+  // Timing out is the caller's business, so only log real failures.
+  HowieError result = howie::EngineImpl::get()->waitForCompletion(token,
+                                                                  timeoutMs);
+  if (result != HOWIE_ERROR_AGAIN) {
+    HOWIE_CHECK(result);
+  }
+  return result;
+}
+
 HowieError HowieStreamGetState(HowieStream *stream, HowieStreamState *state) {
   HOWIE_TRACE_FN(HOWIE_TRACE_LEVEL_CALLS)
   HowieError result = HOWIE_SUCCESS;
@@ -121,7 +497,7 @@ HowieError HowieStreamGetState(HowieStream *stream, HowieStreamState *state) {
   HOWIE_CHECK(howie::checkCast<const howie::StreamImpl*>(stream));
 
 
-  howie::StreamImpl *pStream = reinterpret_cast<howie::StreamImpl *>(stream);
+  howie::StreamImpl *pStream = static_cast<howie::StreamImpl *>(stream);
   *state = pStream->getState();
 
   HOWIE_CHECK(result);
@@ -129,16 +505,19 @@ HowieError HowieStreamGetState(HowieStream *stream, HowieStreamState *state) {
 }
 
 namespace howie {
-  HowieError StreamImpl::lastPlaybackError_ = HOWIE_SUCCESS;
-  HowieError StreamImpl::lastRecordError_ = HOWIE_SUCCESS;
 
   StreamImpl::~StreamImpl() {
     HOWIE_TRACE_FN(HOWIE_TRACE_LEVEL_CALLS)
+    if (mixer_) {
+      // Wait for the shared output to let go of this stream before
+      // anything is torn down.
+      mixer_->detach(this);
+    }
     cleanupObjects();
   }
 
   /**
-   * Delete SL Recorder and Player objects
+   * Stop the stream, let the app clean up, and close the backend.
    */
   HowieError StreamImpl::cleanupObjects(void) {
     HOWIE_TRACE_FN(HOWIE_TRACE_LEVEL_CALLS)
@@ -148,338 +527,642 @@ namespace howie {
       HOWIE_CHECK(cleanupCallback_(this, &state));
     }
 
-    if (direction_ & HOWIE_STREAM_DIRECTION_RECORD) {
-      (*recorderObject_)->Destroy(recorderObject_);
-    }
-    if (direction_ & HOWIE_STREAM_DIRECTION_PLAYBACK) {
-      (*playerObject_)->Destroy(playerObject_);
-    }
+    closeBackend();
+    return HOWIE_SUCCESS;
   }
 
   /**
-   * Initialize the OpenSL inputs and outputs for this stream.
+   * Open the device for this stream.
    */
-  HowieError StreamImpl::init(SLEngineItf engineItf,
-       SLObjectItf outputMixObject,
-       const HowieStreamCreationParams &creationParams_) {
+  HowieError StreamImpl::init(StreamBackend *backend,
+                              const HowieStreamCreationParams &creationParams_) {
     HOWIE_TRACE_FN(HOWIE_TRACE_LEVEL_CALLS)
-    SLresult result;
-
-
-    // Compute the buffer quantum
-    bufferQuantum_ = deviceCharacteristics.framesPerPeriod
-                     * deviceCharacteristics.bytesPerSample
-                     * deviceCharacteristics.samplesPerFrame;
-
-    // configure the audio source (supply data through a buffer queue in PCM format)
-    SLDataFormat_PCM format_pcm;
-
-    // source format
-    format_pcm.formatType = SL_DATAFORMAT_PCM;
-    format_pcm.numChannels = deviceCharacteristics.channelCount;
-    format_pcm.samplesPerSec = (SLuint32) deviceCharacteristics.sampleRate *
-                               1000;
-    format_pcm.bitsPerSample = deviceCharacteristics.bitsPerSample;
-    format_pcm.containerSize = deviceCharacteristics.bitsPerSample
-                               * deviceCharacteristics.samplesPerFrame;
-    format_pcm.channelMask = (format_pcm.numChannels == 1) ?
-                             SL_SPEAKER_FRONT_CENTER :
-                             SL_SPEAKER_FRONT_LEFT | SL_SPEAKER_FRONT_RIGHT;
-    format_pcm.endianness = SL_BYTEORDER_LITTLEENDIAN;
-
-
-    if (direction_ & HOWIE_STREAM_DIRECTION_RECORD) {
-      HOWIE_CHECK(initRecording(engineItf, format_pcm));
+    HOWIE_CHECK_NOT_NULL(backend);
+    backend_.reset(backend);
+
+    StreamBackend::Config config = {};
+    config.direction = direction_;
+    config.sampleFormat = sampleFormat_;
+    config.playbackBufferCount = creationParams_.playbackBufferCount > 0
+        ? static_cast<unsigned int>(creationParams_.playbackBufferCount)
+        : kDefaultPlaybackBufferCount;
+    config.maxPlaybackBufferCount = playbackSlotCount(creationParams_);
+    config.latencyStableWindowMs = creationParams_.latencyStableWindowMs > 0
+                                   ? creationParams_.latencyStableWindowMs
+                                   : kDefaultLatencyStableWindowMs;
+
+    // Only take on the backend's characteristics once it's open, so that
+    // another backend can start from the device's if this one fails.
+    HowieDeviceCharacteristics characteristics = deviceCharacteristics;
+    HowieError result = backend_->open(config, this, &characteristics);
+    if (!HOWIE_SUCCEEDED(result)) {
+      closeBackend();
+      HOWIE_CHECK(result);
     }
-
-    if (direction_ & HOWIE_STREAM_DIRECTION_PLAYBACK) {
-      HOWIE_CHECK(initPlayback(engineItf,
-                   outputMixObject,
-                   format_pcm));
+    deviceCharacteristics = characteristics;
+    __android_log_print(ANDROID_LOG_INFO, kLibName, "Stream opened on %s",
+                        backend_->name());
+    result = initResampler(creationParams_);
+    if (HOWIE_SUCCEEDED(result)) {
+      result = initPlanar();
+    }
+    if (!HOWIE_SUCCEEDED(result)) {
+      closeBackend();
+      HOWIE_CHECK(result);
     }
 
+    // Last thing before actually starting the stream: call the
+    // deviceChanged callback
+    notifyDeviceChanged();
+
     if (creationParams_.initialState == HOWIE_STREAM_STATE_PLAYING) {
       run();
     }
+    return HOWIE_SUCCESS;
   }
 
-  HowieError StreamImpl::initRecording(SLEngineItf engineItf,
-                                       SLDataFormat_PCM& format_pcm) {
-    HOWIE_TRACE_FN(HOWIE_TRACE_LEVEL_CALLS)
-    // configure audio source
-    SLDataLocator_IODevice loc_dev = {SL_DATALOCATOR_IODEVICE, SL_IODEVICE_AUDIOINPUT,
-                                      SL_DEFAULTDEVICEID_AUDIOINPUT, NULL};
-    SLDataSource audioSrc = {&loc_dev, NULL};
-
-    // configure record buffer queue
-    SLDataLocator_AndroidSimpleBufferQueue loc_bq = {
-        SL_DATALOCATOR_ANDROIDSIMPLEBUFFERQUEUE, kRecordBufferCount};
-
-    SLDataSink audioSnk = {&loc_bq, &format_pcm};
-
-    // create audio recorder
-    // (requires the RECORD_AUDIO permission)
-    const SLInterfaceID id[1] = {SL_IID_ANDROIDSIMPLEBUFFERQUEUE};
-    const SLboolean req[1] = {SL_BOOLEAN_TRUE};
-    HOWIE_CHECK ((*engineItf)->CreateAudioRecorder(
-        engineItf,
-        &recorderObject_,
-        &audioSrc,
-        &audioSnk,
-        1,
-        id,
-        req));
-
-    // realize the audio recorder
-    HOWIE_CHECK ((*recorderObject_)->Realize(recorderObject_,
-                                             SL_BOOLEAN_FALSE));
-
-    // get the record interface
-    HOWIE_CHECK ((*recorderObject_)->GetInterface(
-        recorderObject_,
-        SL_IID_RECORD,
-        &recorderItf_));
-
-
-    // get the buffer queue interface
-    HOWIE_CHECK ((*recorderObject_)->GetInterface(
-        recorderObject_,
-        SL_IID_ANDROIDSIMPLEBUFFERQUEUE,
-        &recorderBufferQueueItf_));
-
-    // register callback on the buffer queue
-    HOWIE_CHECK ((*recorderBufferQueueItf_)->RegisterCallback(
-        recorderBufferQueueItf_,
-        bqRecorderCallback,
-        this));
-
-    // start recording
-    SLAndroidSimpleBufferQueueState qState;
-    HOWIE_CHECK((*recorderBufferQueueItf_)->GetState(recorderBufferQueueItf_, &qState));
-
-    // Create the recording buffer and submit the first chunk
-    input_.reset(bufferQuantum_ * kRecordBufferCount);
-    input_.clear();
-
-    HOWIE_CHECK(submitRecordBuffer());
-    HOWIE_CHECK((*recorderItf_)->SetRecordState(recorderItf_, SL_RECORDSTATE_PAUSED));
-  }
-
-  HowieError StreamImpl::initPlayback(
-        SLEngineItf engineItf,
-        SLObjectItf outputMixObject,
-        SLDataFormat_PCM &format_pcm)
-  {
+  /**
+   * Initialize a stream that renders into a shared output. There is no
+   * backend; the output buffer is a single period, which the shared
+   * output mixes after calling processShared().
+   */
+  HowieError StreamImpl::initShared(
+      Mixer *mixer,
+      const HowieStreamCreationParams &creationParams_) {
     HOWIE_TRACE_FN(HOWIE_TRACE_LEVEL_CALLS)
-    SLDataLocator_AndroidSimpleBufferQueue locator_bufferqueue_source;
-    SLDataSource audio_source;
-
-    // source location
-    locator_bufferqueue_source.locatorType
-        = SL_DATALOCATOR_ANDROIDSIMPLEBUFFERQUEUE;
-    locator_bufferqueue_source.numBuffers = 1;
-    audio_source.pLocator = &locator_bufferqueue_source;
-    audio_source.pFormat = &format_pcm;
-
-
-    // configure the output: An output mix sink
-    SLDataLocator_OutputMix locator_output_mix;
-    SLDataSink audio_sink;
-
-    locator_output_mix.locatorType = SL_DATALOCATOR_OUTPUTMIX;
-    locator_output_mix.outputMix = outputMixObject;
-
-    audio_sink.pLocator = &locator_output_mix;
-    audio_sink.pFormat = NULL;
+    HOWIE_CHECK_NOT_NULL(mixer);
+    if (direction_ != HOWIE_STREAM_DIRECTION_PLAYBACK) {
+      return HOWIE_ERROR_INVALID_PARAMETER;
+    }
 
-    // create audio player
-    // Note: Adding other output interfaces here will result in your audio being routed using the
-    // normal path NOT the fast path
-    const SLInterfaceID
-        interface_ids[2] = {SL_IID_ANDROIDSIMPLEBUFFERQUEUE, SL_IID_VOLUME};
-    const SLboolean interfaces_required[2] = {SL_BOOLEAN_TRUE, SL_BOOLEAN_TRUE};
+    size_t bytesPerSample = deviceCharacteristics.bytesPerSample;
+    if (sampleFormat_ == HOWIE_SAMPLE_FORMAT_FLOAT) {
+      StreamBackend::useFloatCharacteristics(&deviceCharacteristics);
+      bytesPerSample = sizeof(float);
+    } else if (bytesPerSample != sizeof(int16_t)) {
+      // The shared output only knows how to mix float and 16 bit streams.
+      return HOWIE_ERROR_INVALID_PARAMETER;
+    }
 
-    HOWIE_CHECK((*engineItf)->CreateAudioPlayer(
-        engineItf,
-        &playerObject_,
-        &audio_source,
-        &audio_sink,
-        2, // Number of interfaces
-        interface_ids,
-        interfaces_required
-    ));
+    size_t bufferQuantum = deviceCharacteristics.framesPerPeriod
+                           * bytesPerSample
+                           * deviceCharacteristics.samplesPerFrame;
+    useRegion(&output_, kBackendRegion + kOutputBuffer, bufferQuantum);
+    // The shared output only runs us once its own single buffer is done.
+    stats_.configure(periodNs(), 1);
+    HOWIE_CHECK(initResampler(creationParams_));
+    HOWIE_CHECK(initPlanar());
 
-    // realize the player
-    HOWIE_CHECK((*playerObject_)->Realize(playerObject_, SL_BOOLEAN_FALSE));
+    notifyDeviceChanged();
 
-    // get the play interface
-    HOWIE_CHECK((*playerObject_)->GetInterface(playerObject_, SL_IID_PLAY,
-                                           &playerItf_));
+    HOWIE_CHECK(mixer->attach(this));
+    mixer_ = mixer;
 
+    if (creationParams_.initialState == HOWIE_STREAM_STATE_PLAYING) {
+      run();
+    }
+    return HOWIE_SUCCESS;
+  }
 
-    // get the buffer queue interface
-    HOWIE_CHECK((*playerObject_)->GetInterface(playerObject_, SL_IID_BUFFERQUEUE,
-                                           &playerBufferQueueItf_));
+  unsigned int StreamImpl::playbackSlotCount(
+      const HowieStreamCreationParams &params) {
+    unsigned int count = params.playbackBufferCount > 0
+                         ? static_cast<unsigned int>(params.playbackBufferCount)
+                         : kDefaultPlaybackBufferCount;
+    if (params.direction == HOWIE_STREAM_DIRECTION_PLAYBACK
+        && !params.sharedOutput && params.maxPlaybackBufferCount > count) {
+      count = static_cast<unsigned int>(params.maxPlaybackBufferCount);
+    }
+    return count;
+  }
 
-    // register callback on the buffer queue
-    HOWIE_CHECK((*playerBufferQueueItf_)->RegisterCallback(
-        playerBufferQueueItf_,
-        bqPlayerCallback,
-        reinterpret_cast<void *>(this)));
+  StreamArena::Plan StreamImpl::planArena(
+      const HowieDeviceCharacteristics &deviceCharacteristics,
+      const HowieStreamCreationParams &params) {
+    static_assert(kRegionCount <= StreamArena::kMaxRegions,
+                  "StreamArena needs more regions");
+    StreamArena::Plan plan = {};
+    plan.sizes[kStateRegion] = params.sizeofStateBlock;
+    plan.sizes[kParameterRegion] =
+        ParameterPipe::storageSize(params.sizeofParameterBlock);
+    if (params.sampleRate > 0
+        && params.sampleRate != deviceCharacteristics.sampleRate
+        && Resampler::supported(params.sampleRate,
+                                deviceCharacteristics.sampleRate)) {
+      plan.sizes[kResamplerRegion] = Resampler::storageSize(
+          params.sampleRate, deviceCharacteristics.sampleRate,
+          static_cast<size_t>(deviceCharacteristics.framesPerPeriod),
+          static_cast<size_t>(deviceCharacteristics.samplesPerFrame));
+    }
+    if (params.planar) {
+      size_t channelBytes = planarStride(
+          callbackFrames(deviceCharacteristics, params))
+          * deviceCharacteristics.samplesPerFrame;
+      size_t bufferCount =
+          (params.direction & HOWIE_STREAM_DIRECTION_RECORD ? 1 : 0)
+          + (params.direction & HOWIE_STREAM_DIRECTION_PLAYBACK ? 1 : 0);
+      plan.sizes[kPlanarRegion] = channelBytes * bufferCount;
+    }
 
+    // OpenSL runs in float if it can, and otherwise in the device format.
+    // Other backends need no more than OpenSL does.
+    bool floatSamples = params.sampleFormat == HOWIE_SAMPLE_FORMAT_FLOAT;
+    bool int16Device = deviceCharacteristics.bytesPerSample == sizeof(int16_t);
+    size_t bytesPerSample = deviceCharacteristics.bytesPerSample;
+    if (floatSamples) {
+      bytesPerSample = std::max(bytesPerSample, sizeof(float));
+    }
+    size_t frameCount = deviceCharacteristics.framesPerPeriod;
+    size_t samplesPerFrame = deviceCharacteristics.samplesPerFrame;
+    size_t quantum = frameCount * bytesPerSample * samplesPerFrame;
+    size_t floatQuantum = frameCount * sizeof(float) * samplesPerFrame;
+
+    bool mayConvert = floatSamples && int16Device;
+    bool mayUseDuplex = params.direction == HOWIE_STREAM_DIRECTION_BOTH
+                        && (floatSamples || int16Device);
+    if (params.direction & HOWIE_STREAM_DIRECTION_RECORD) {
+      plan.sizes[kBackendRegion + kInputBuffer] =
+          quantum * OpenSLBackend::kRecordBufferCount;
+      if (mayConvert || mayUseDuplex) {
+        plan.sizes[kBackendRegion + kFloatInputBuffer] = floatQuantum;
+      }
+    }
+    if (params.direction & HOWIE_STREAM_DIRECTION_PLAYBACK) {
+      plan.sizes[kBackendRegion + kOutputBuffer] = quantum * playbackSlotCount(params);
+    }
+    if (mayConvert) {
+      plan.sizes[kBackendRegion + kFloatOutputBuffer] = floatQuantum;
+    }
+    if (mayUseDuplex && int16Device) {
+      plan.sizes[kBackendRegion + kRecordFloatBuffer] = floatQuantum;
+    }
+    if (mayUseDuplex && !floatSamples) {
+      plan.sizes[kBackendRegion + kSyncedInputBuffer] = quantum;
+    }
+    return plan;
+  }
 
-    // Create the buffer
-    output_.reset(bufferQuantum_);
-    output_.clear();
+  void StreamImpl::useRegion(unique_buffer *buffer,
+                             int region,
+                             size_t size) {
+    if (size <= arena_.regionSize(region)) {
+      buffer->reset(arena_.region(region), size);
+    } else {
+      buffer->reset(size);
+    }
+    buffer->clear();
+  }
 
-    // set the player's state to playing
+  HowieError StreamImpl::initResampler(
+      const HowieStreamCreationParams &params) {
+    const int deviceRate = deviceCharacteristics.sampleRate;
+    if (params.sampleRate <= 0 || params.sampleRate == deviceRate) {
+      return HOWIE_SUCCESS;
+    }
+    // The filter only works in float, and only the output is converted.
+    if (sampleFormat_ != HOWIE_SAMPLE_FORMAT_FLOAT
+        || direction_ != HOWIE_STREAM_DIRECTION_PLAYBACK
+        || !Resampler::supported(params.sampleRate, deviceRate)) {
+      return HOWIE_ERROR_INVALID_PARAMETER;
+    }
+    size_t frameCount =
+        static_cast<size_t>(deviceCharacteristics.framesPerPeriod);
+    size_t channelCount =
+        static_cast<size_t>(deviceCharacteristics.samplesPerFrame);
+    useRegion(&resamplerStorage_, kResamplerRegion,
+              Resampler::storageSize(params.sampleRate, deviceRate,
+                                     frameCount, channelCount));
+    resampler_.reset(new Resampler(params.sampleRate, deviceRate, frameCount,
+                                   channelCount, resamplerStorage_.get()));
+    return HOWIE_SUCCESS;
+  }
 
-    // Last thing before actually starting playback: call the deviceChanged
-    // callback
-    HowieBuffer state { sizeof(HowieBuffer), state_.get(), state_.size() };
-    HowieBuffer params { sizeof(HowieBuffer), params_.top(),
-                         params_.maxElementSize()};
-    deviceChangedCallback_(&deviceCharacteristics, &state, &params);
+  size_t StreamImpl::planarStride(size_t frameCount) {
+    return StreamArena::roundUp(frameCount * sizeof(float));
+  }
 
-    // enqueue some silence
-    HOWIE_CHECK((*playerBufferQueueItf_)->Enqueue(
-        playerBufferQueueItf_,
-        output_.get(),
-        output_.size()));
-    HOWIE_CHECK((*playerItf_)->SetPlayState(playerItf_, SL_PLAYSTATE_PAUSED));
+  size_t StreamImpl::callbackFrames(
+      const HowieDeviceCharacteristics &deviceCharacteristics,
+      const HowieStreamCreationParams &params) {
+    size_t frameCount =
+        static_cast<size_t>(deviceCharacteristics.framesPerPeriod);
+    if (params.sampleRate > 0
+        && params.sampleRate != deviceCharacteristics.sampleRate
+        && Resampler::supported(params.sampleRate,
+                                deviceCharacteristics.sampleRate)) {
+      frameCount = Resampler::maxInputFrames(
+          params.sampleRate, deviceCharacteristics.sampleRate, frameCount);
+    }
+    return frameCount;
   }
 
-  HowieError StreamImpl::submitRecordBuffer() {
-    HOWIE_TRACE_FN(HOWIE_TRACE_LEVEL_REALTIME);
-    while(countFreeBuffers() < kRecordBufferCount) {
-      size_t offset = (recordBuffersSubmitted_ % kRecordBufferCount) * bufferQuantum_;
-      ++recordBuffersSubmitted_;
-      HOWIE_CHECK((*recorderBufferQueueItf_)->Enqueue(recorderBufferQueueItf_,
-                                                      input_.get() + offset,
-                                                      bufferQuantum_));
+  HowieError StreamImpl::initPlanar() {
+    if (!planar_) {
+      return HOWIE_SUCCESS;
+    }
+    size_t channelCount =
+        static_cast<size_t>(deviceCharacteristics.samplesPerFrame);
+    if (sampleFormat_ != HOWIE_SAMPLE_FORMAT_FLOAT
+        || channelCount > HOWIE_MAX_CHANNELS) {
+      return HOWIE_ERROR_INVALID_PARAMETER;
+    }
+    size_t frameCount = resampler_
+        ? resampler_->maxInputFrames()
+        : static_cast<size_t>(deviceCharacteristics.framesPerPeriod);
+    size_t bufferBytes = planarStride(frameCount) * channelCount;
+    size_t inBytes = direction_ & HOWIE_STREAM_DIRECTION_RECORD
+                     ? bufferBytes : 0;
+    size_t outBytes = direction_ & HOWIE_STREAM_DIRECTION_PLAYBACK
+                      ? bufferBytes : 0;
+    // Arena regions start on a cache line; a separate allocation has to be
+    // lined up by hand.
+    size_t size = inBytes + outBytes;
+    if (size > arena_.regionSize(kPlanarRegion)) {
+      size += CACHE_ALIGN;
     }
+    useRegion(&planarStorage_, kPlanarRegion, size);
+    uintptr_t address = reinterpret_cast<uintptr_t>(planarStorage_.get());
+    unsigned char *base = planarStorage_.get()
+        + (StreamArena::roundUp(address) - address);
+    if (inBytes > 0) {
+      usePlanar(&planarIn_, base, frameCount);
+    }
+    if (outBytes > 0) {
+      usePlanar(&planarOut_, base + inBytes, frameCount);
+    }
+    return HOWIE_SUCCESS;
   }
 
+  void StreamImpl::usePlanar(HowieMultiBuffer *buffer,
+                             unsigned char *base,
+                             size_t frameCount) {
+    size_t stride = planarStride(frameCount);
+    buffer->buffer.version = sizeof(HowieMultiBuffer);
+    buffer->buffer.data = base;
+    buffer->channelCount =
+        static_cast<size_t>(deviceCharacteristics.samplesPerFrame);
+    for (size_t c = 0; c < buffer->channelCount; ++c) {
+      buffer->channels[c] = reinterpret_cast<float *>(base + c * stride);
+    }
+  }
 
-  void StreamImpl::bqRecorderCallback(SLAndroidSimpleBufferQueueItf itf,
-                                      void *context) {
-    HOWIE_TRACE_FN(HOWIE_TRACE_LEVEL_ALL);
-    if (HOWIE_SUCCEEDED(lastRecordError_)) {
-      lastPlaybackError_ = checkCast<const StreamImpl *>(context);
+  void StreamImpl::notifyDeviceChanged() {
+    HOWIE_TRACE_FN(HOWIE_TRACE_LEVEL_CALLS)
+    if (deviceChangedCallback_) {
+      HowieBuffer state { sizeof(HowieBuffer), state_.get(), state_.size() };
+      HowieBuffer params { sizeof(HowieBuffer), params_.top(),
+                           params_.maxElementSize()};
+      // A resampled stream runs at its own rate, in periods of up to the
+      // most input the resampler can ask for.
+      HowieDeviceCharacteristics characteristics = deviceCharacteristics;
+      if (resampler_) {
+        characteristics.sampleRate = resampler_->inputRate();
+        characteristics.framesPerPeriod =
+            static_cast<int>(resampler_->maxInputFrames());
+      }
+      deviceChangedCallback_(&characteristics, &state, &params);
+      // It may have changed the state block, and so what an idle stream
+      // would render.
+      wakeRequested_.store(true, std::memory_order_relaxed);
     }
+  }
 
-    StreamImpl *pStream = reinterpret_cast<StreamImpl *>(context);
-    if (HOWIE_SUCCEEDED(lastRecordError_)) {
-      pStream->recordBuffersFinished_.fetch_add(1, std::memory_order_release);
+  void StreamImpl::capture(const HowieBuffer &in) {
+    if (capture_ && !capture_->write(in.data, in.byteCount)) {
+      stats_.captureOverflow();
     }
   }
 
+  size_t StreamImpl::ReadCaptured(void *dest, size_t size, int timeoutMs) {
+    HOWIE_TRACE_FN(HOWIE_TRACE_LEVEL_CALLS)
+    // Whole periods go in, so whole frames come out as long as we only
+    // ask for whole frames.
+    return capture_->read(dest, size - size % captureFrameSize_, timeoutMs);
+  }
 
-  // this callback handler is called every time a buffer finishes playing
-  void StreamImpl::bqPlayerCallback(SLAndroidSimpleBufferQueueItf bq, void
-      *context) {
-    HOWIE_TRACE_FN(HOWIE_TRACE_LEVEL_ALL);
+  size_t StreamImpl::captureFrameSize(
+      const HowieDeviceCharacteristics &deviceCharacteristics,
+      const HowieStreamCreationParams &params) {
+    size_t bytesPerSample = params.sampleFormat == HOWIE_SAMPLE_FORMAT_FLOAT
+                            ? sizeof(float)
+                            : deviceCharacteristics.bytesPerSample;
+    return bytesPerSample * deviceCharacteristics.samplesPerFrame;
+  }
 
-    if (HOWIE_SUCCEEDED(lastPlaybackError_)) {
-      lastPlaybackError_ = checkCast<const StreamImpl *>(context);
+  unsigned char *StreamImpl::AcquireReport() {
+    unsigned char *report = reports_->acquire();
+    if (!report) {
+      stats_.reportOverflow();
     }
+    return report;
+  }
 
-    if(HOWIE_SUCCEEDED(lastPlaybackError_)) {
-      lastPlaybackError_ = reinterpret_cast<StreamImpl *>(context)->process(bq);
-    }
+  bool StreamImpl::CommitReport(const void *report) {
+    return reports_->commit(report);
   }
 
+  size_t StreamImpl::ReceiveReports(void *dest, size_t size) {
+    HOWIE_TRACE_FN(HOWIE_TRACE_LEVEL_CALLS)
+    return reports_->read(dest, size / reports_->reportSize());
+  }
 
-  HowieError StreamImpl::process(SLAndroidSimpleBufferQueueItf bq) {
-    HOWIE_CHECK_NOT_NULL(bq);
+  /**
+   * Run one period of a stream attached to a shared output.
+   */
+  HowieError StreamImpl::processShared() {
     HOWIE_TRACE_FN(HOWIE_TRACE_LEVEL_REALTIME);
+    HowieBuffer in { sizeof(HowieBuffer), nullptr, 0 };
+    HowieBuffer out { sizeof(HowieBuffer), output_.get(), output_.size() };
+    HOWIE_CHECK_RT(log_, runCallback(&in, &out));
+    return HOWIE_SUCCESS;
+  }
+
+  /**
+   * Run one period for the backend, on its audio thread.
+   */
+  HowieError StreamImpl::onPeriod(const HowieBuffer *in,
+                                  const HowieBuffer *out) {
+    audioThread_.periodStarted();
+    HowieError result = runCallback(in, out);
+    audioThread_.periodFinished(stats_.lastDurationNs());
+    HOWIE_CHECK_RT(log_, result);
+    capture(*in);
+    return HOWIE_SUCCESS;
+  }
+
+  /**
+   * Hand one period's worth of buffers to render(), along with the state
+   * block and the latest parameters.
+   */
+  HowieError StreamImpl::runCallback(const HowieBuffer *in,
+                                     const HowieBuffer *out) {
+    HowieBuffer state { sizeof(HowieBuffer), state_.get(), state_.size() };
+
+    // Pick up the latest parameter block and any patches sent since, if
+    // there are any. This never blocks, so there's nothing to do if no
+    // new data is available.
+    bool paramsChanged = params_.pop();
+    HowieBuffer params { sizeof(HowieBuffer), params_.top(),
+                         params_.maxElementSize()};
 
-    if (bq != playerBufferQueueItf_) {
-      return HOWIE_ERROR_INVALID_OBJECT;
+    // Every callback is one period. For a resampled stream, that's however
+    // many frames at the app's rate the next device period takes, rendered
+    // into the resampler rather than straight into out.
+    size_t frameCount =
+        static_cast<size_t>(deviceCharacteristics.framesPerPeriod);
+    HowieBuffer appOut = *out;
+    if (resampler_) {
+      frameCount = resampler_->beginPeriod();
+      appOut.data = reinterpret_cast<unsigned char *>(resampler_->input());
+      appOut.byteCount = frameCount * sizeof(float)
+                         * deviceCharacteristics.samplesPerFrame;
+    }
+    int64_t periodStart = frameTime_.load(std::memory_order_relaxed);
+    if (events_) {
+      events_->beginPeriod(periodStart, frameCount);
     }
 
-    HowieBuffer in { sizeof(HowieBuffer), nullptr, 0 };
-    if (direction_ & HOWIE_STREAM_DIRECTION_RECORD) {
-      size_t inputOffset = 0;
-      int recordBuffersFinished = recordBuffersFinished_.load(
-          std::memory_order_acquire);
-
-      int nBuffersAvailable = countFreeBuffers();
-      if (nBuffersAvailable <= 0) {
-        __android_log_write(
-            ANDROID_LOG_WARN,
-            kLibName,
-            "GLITCH: missed a record buffer");
+    // An idle stream just outputs silence, until something could change
+    // what the callback would render.
+    // The stream only goes idle at the start of a period, so idle() is
+    // true exactly when the period skipped the callback.
+    int64_t start = StreamStatistics::now();
+    if (idleRequested_) {
+      idle_ = true;
+      idleRequested_ = false;
+    }
+    if (idle_ && !shouldWake(*in, paramsChanged)) {
+      if (resampler_) {
+        resampler_->skipPeriod();
+      }
+      if (out->data) {
+        memset(out->data, 0, out->byteCount);
       }
-      inputOffset = (recordBuffersFinished % kRecordBufferCount) * bufferQuantum_;
-      in.data = input_.get() + inputOffset;
-      in.byteCount = bufferQuantum_;
+      stats_.periodIdle(start, StreamStatistics::now());
+      if (events_) {
+        events_->endPeriod();
+      }
+      frameTime_.store(periodStart + static_cast<int64_t>(frameCount),
+                       std::memory_order_release);
+      return HOWIE_SUCCESS;
+    }
+    idle_ = false;
+
+    // The resampler counts towards the callback's time, since it comes out
+    // of the same budget.
+    stats_.callbackStarted(start);
+    HowieError result;
+    if (planar_) {
+      result = renderPlanar(in, appOut, &state, &params);
+    } else {
+      result = render(in, &appOut, &state, &params);
+    }
+    if (resampler_) {
+      resampler_->process(reinterpret_cast<float *>(out->data));
+    }
+    int64_t end = StreamStatistics::now();
+    stats_.callbackFinished(start, end);
+    if (idleWhenSilent_) {
+      updateIdle(*in, appOut);
     }
 
-    HowieBuffer out { sizeof(HowieBuffer), output_.get(), output_.size() };
-    HowieBuffer state { sizeof(HowieBuffer), state_.get(), state_.size() };
+    if (events_) {
+      events_->endPeriod();
+    }
+    frameTime_.store(periodStart + static_cast<int64_t>(frameCount),
+                     std::memory_order_release);
+    if (Trace::capturing()) {
+      Trace::setCounter("howie.callbackBudgetPercent",
+                        (end - start) * 100 / periodNs());
+    }
+    return result;
+  }
 
-    if (params_.maxElementSize() == 0 || params_.pop()) {
-      paramsContentionCounter_ = 0;
-    } else {
-      if (++paramsContentionCounter_ > kMaxContentions) {
-        __android_log_print(
-            ANDROID_LOG_WARN,
-            kLibName,
-            "Read thread has missed %d parameter updates in a row. "
-            "This is probably because you are making too many calls to "
-            "HowieStreamSendParameters().");
-      }
+  /**
+   * Run render() on the planar buffers, converting the interleaved input
+   * going in and the output coming out.
+   */
+  HowieError StreamImpl::renderPlanar(const HowieBuffer *in,
+                                      const HowieBuffer &out,
+                                      const HowieBuffer *state,
+                                      const HowieBuffer *params) {
+    const size_t frameBytes = sizeof(float)
+                              * deviceCharacteristics.samplesPerFrame;
+    // Whichever side the stream doesn't have is passed through as it is.
+    const HowieBuffer *planarIn = in;
+    if (in->data && planarIn_.buffer.data) {
+      setFrameCount(&planarIn_, in->byteCount / frameBytes);
+      HowieDspDeinterleave(reinterpret_cast<const float *>(in->data),
+                           planarIn_.channels, planarIn_.channelCount,
+                           planarIn_.frameCount);
+      planarIn = &planarIn_.buffer;
     }
-    HowieBuffer params { sizeof(HowieBuffer), params_.top(),
-                         params_.maxElementSize()};
+    const HowieBuffer *planarOut = &out;
+    if (out.data && planarOut_.buffer.data) {
+      setFrameCount(&planarOut_, out.byteCount / frameBytes);
+      planarOut = &planarOut_.buffer;
+    }
+    HowieError result = render(planarIn, planarOut, state, params);
+    if (planarOut != &out) {
+      HowieDspInterleave(planarOut_.channels,
+                         reinterpret_cast<float *>(out.data),
+                         planarOut_.channelCount, planarOut_.frameCount);
+    }
+    return result;
+  }
 
+  /**
+   * The stride between channels is fixed by the storage, so byteCount
+   * runs from the first channel to the end of the last one's frames.
+   */
+  void StreamImpl::setFrameCount(HowieMultiBuffer *buffer,
+                                 size_t frameCount) {
+    const unsigned char *last = reinterpret_cast<const unsigned char *>(
+        buffer->channels[buffer->channelCount - 1]);
+    buffer->frameCount = frameCount;
+    buffer->buffer.byteCount = static_cast<size_t>(last - buffer->buffer.data)
+                               + frameCount * sizeof(float);
+  }
 
-    HOWIE_CHECK(processCallback_(this, &in, &out, &state, &params));
+  /**
+   * Float samples are compared with the threshold rather than tested for
+   * zero bits, which would miss negative zeros.
+   */
+  bool StreamImpl::isSilent(const HowieBuffer &buffer) const {
+    if (sampleFormat_ == HOWIE_SAMPLE_FORMAT_FLOAT) {
+      return HowieDspPeak(reinterpret_cast<const float *>(buffer.data),
+                          buffer.byteCount / sizeof(float))
+             <= idleThreshold_;
+    }
+    return HowieDspIsZero(buffer.data, buffer.byteCount);
+  }
 
-    if (direction_ & HOWIE_STREAM_DIRECTION_PLAYBACK) {
-      HOWIE_CHECK((*playerBufferQueueItf_)->Enqueue(playerBufferQueueItf_,
-                                                   output_.get(),
-                                                   output_.size()));
+  /**
+   * Whether anything since the stream went idle could make the callback
+   * render something other than silence. Call after the period's
+   * parameters and events have been picked up.
+   */
+  bool StreamImpl::shouldWake(const HowieBuffer &in, bool paramsChanged) {
+    if (wakeRequested_.exchange(false, std::memory_order_relaxed)
+        || paramsChanged) {
+      return true;
     }
+    if (events_ && events_->eventCount() > 0) {
+      return true;
+    }
+    return in.data && !isSilent(in);
+  }
 
-    if (direction_ & HOWIE_STREAM_DIRECTION_RECORD) {
-      HOWIE_CHECK(submitRecordBuffer());
+  /**
+   * Decide, after a callback, whether the next period can skip it. The
+   * output is checked first, since it's the side that usually isn't
+   * silent.
+   */
+  void StreamImpl::updateIdle(const HowieBuffer &in, const HowieBuffer &out) {
+    bool silent = idleSilentPeriods_ > 0
+                  && (!out.data || isSilent(out))
+                  && (!in.data || isSilent(in));
+    silentPeriods_ = silent ? silentPeriods_ + 1 : 0;
+    if (silent && silentPeriods_ >= idleSilentPeriods_) {
+      idleRequested_ = true;
+    }
+    if (idleRequested_) {
+      silentPeriods_ = 0;
     }
+  }
 
+  HowieError StreamImpl::requestIdle() {
+    if (!idleWhenSilent_) {
+      return HOWIE_ERROR_INVALID_PARAMETER;
+    }
+    idleRequested_ = true;
     return HOWIE_SUCCESS;
   }
 
+  HowieError StreamImpl::render(const HowieBuffer *in,
+                                const HowieBuffer *out,
+                                const HowieBuffer *state,
+                                const HowieBuffer *params) {
+    if (!processCallback_) {
+      return HOWIE_SUCCESS;
+    }
+    return processCallback_(this, in, out, state, params);
+  }
 
-  bool StreamImpl::PushParameterBlock(const void *data, size_t size) {
+  bool StreamImpl::PushParameterBlock(const void *data,
+                                      size_t size,
+                                      int timeoutMs) {
     HOWIE_TRACE_FN(HOWIE_TRACE_LEVEL_CALLS)
-    bool result = (params_.push(data, size) > 0);
+    bool result = (params_.push(data, size, timeoutMs) > 0);
     return result;
   }
 
-  /**
-   * Count the number of free (readable) recording buffers.
-   *
-   * NB: this function is only safe to call from the playback thread.
-   *     If called from another thread it will likely give erroneous
-   *     results, because recordBuffersSubmitted_ is not synchronized.
-   */
-  const unsigned int StreamImpl::countFreeBuffers() const {
-    HOWIE_TRACE_FN(HOWIE_TRACE_LEVEL_REALTIME)
-    unsigned int finished = recordBuffersFinished_.load(std::memory_order_acquire);
-    unsigned int result = recordBuffersSubmitted_ - finished;
+  bool StreamImpl::PatchParameterBlock(size_t offset,
+                                       const void *data,
+                                       size_t size,
+                                       int timeoutMs) {
+    HOWIE_TRACE_FN(HOWIE_TRACE_LEVEL_CALLS)
+    bool result = (params_.patch(offset, data, size, timeoutMs) > 0);
     return result;
   }
 
+  unsigned char *StreamImpl::AcquireParameterSlot(int timeoutMs) {
+    HOWIE_TRACE_FN(HOWIE_TRACE_LEVEL_CALLS)
+    return params_.acquire(timeoutMs);
+  }
+
+  bool StreamImpl::CommitParameterSlot(const void *slot) {
+    HOWIE_TRACE_FN(HOWIE_TRACE_LEVEL_CALLS)
+    return params_.commit(slot);
+  }
+
+  bool StreamImpl::ScheduleEvent(int64_t frameTime,
+                                 const void *data,
+                                 size_t size) {
+    HOWIE_TRACE_FN(HOWIE_TRACE_LEVEL_CALLS)
+    return events_->schedule(frameTime, data, size);
+  }
+
+  void StreamImpl::getEvents(const HowieEvent **events, size_t *count) const {
+    *events = events_ ? events_->events() : nullptr;
+    *count = events_ ? events_->eventCount() : 0;
+  }
+
+  void StreamImpl::getStatistics(HowieStreamStatistics *dest) const {
+    stats_.read(dest);
+    dest->parameterContentionCount = params_.contentionCount();
+    dest->inputDriftPpm = 0;
+    dest->inputResyncCount = 0;
+    dest->playbackQueueDepth = 0;
+    if (backend_) {
+      backend_->getStatistics(dest);
+    }
+  }
+
+  int64_t StreamImpl::periodNs() const {
+    return static_cast<int64_t>(deviceCharacteristics.framesPerPeriod)
+           * 1000000000LL / deviceCharacteristics.sampleRate;
+  }
+
+  HowieError StreamImpl::Render(size_t frameCount,
+                                const HowieBuffer *in,
+                                const HowieBuffer *out) {
+    HOWIE_TRACE_FN(HOWIE_TRACE_LEVEL_CALLS)
+    if (!backend_) {
+      return HOWIE_ERROR_UNSUPPORTED;
+    }
+    return backend_->render(frameCount, in, out);
+  }
+
   HowieError StreamImpl::run() {
     HOWIE_TRACE_FN(HOWIE_TRACE_LEVEL_CALLS)
-    if (direction_ & HOWIE_STREAM_DIRECTION_RECORD) {
-      HOWIE_CHECK((*recorderItf_)->SetRecordState(
-          recorderItf_, SL_RECORDSTATE_RECORDING));
+    stats_.reset();
+    wakeRequested_.store(true, std::memory_order_relaxed);
+    if (capture_) {
+      capture_->resume();
     }
-    if (direction_ & HOWIE_STREAM_DIRECTION_PLAYBACK) {
-      HOWIE_CHECK((*playerItf_)->SetPlayState(
-          playerItf_, SL_PLAYSTATE_PLAYING));
+    if (backend_) {
+      HOWIE_CHECK(backend_->start());
     }
     streamState_ = HOWIE_STREAM_STATE_PLAYING;
     return HOWIE_SUCCESS;
@@ -487,22 +1170,27 @@ namespace howie {
 
   HowieError StreamImpl::stop() {
     HOWIE_TRACE_FN(HOWIE_TRACE_LEVEL_CALLS)
-    if (direction_ & HOWIE_STREAM_DIRECTION_RECORD) {
-      HOWIE_CHECK((*recorderItf_)->SetRecordState(
-          recorderItf_, SL_RECORDSTATE_PAUSED));
+    if (backend_) {
+      HOWIE_CHECK(backend_->stop());
     }
-    if (direction_ & HOWIE_STREAM_DIRECTION_PLAYBACK) {
-      HOWIE_CHECK((*playerItf_)->SetPlayState(
-          playerItf_, SL_PLAYSTATE_PAUSED));
+    if (capture_) {
+      // No more input is coming, so don't leave a reader waiting for it.
+      capture_->interrupt();
     }
     streamState_ = HOWIE_STREAM_STATE_STOPPED;
     return HOWIE_SUCCESS;
 
   }
 
+  void StreamImpl::commandCompleted(HowieError result) {
+    HOWIE_TRACE_FN(HOWIE_TRACE_LEVEL_CALLS)
+    if (commandCallback_) {
+      commandCallback_(this, streamState_, result);
+    }
+  }
+
   HowieStreamState_t StreamImpl::getState() {
     HOWIE_TRACE_FN(HOWIE_TRACE_LEVEL_CALLS)
     return streamState_;
   }
 } // namespace howie
-
@@ -18,39 +18,77 @@
 #define HELLOLOWLATENCYOUTPUT_STREAMIMPL_H
 
 
-#include <SLES/OpenSLES_Android.h>
 #include <memory>
 #include <android/log.h>
 #include "../howie.h"
+#include "CacheAligned.h"
 #include "unique_buffer.h"
 #include "ParameterPipe.h"
+#include "StreamStatistics.h"
+#include "RealtimeLog.h"
+#include "CaptureRing.h"
+#include "StreamArena.h"
+#include "EventQueue.h"
+#include "ReportRing.h"
+#include "StreamBackend.h"
+#include "AudioThread.h"
+#include "Resampler.h"
 
 namespace howie {
+  class Mixer;
 
-  class StreamImpl : public HowieStream {
+  class StreamImpl : public HowieStream,
+                     public CacheAligned,
+                     private StreamBackend::Client {
   public:
-    // Defines the size of the parameter pipe ringbuffer. Larger
-    // values reduce the chance of contention between the audio
-    // thread and the rest of the app. Adjust this number higher
-    // if the audio thread seems to be missing a large number of
-    // parameter updates. See the documentation for ParameterPipe
-    // for more information.
-    static constexpr size_t kParameterPipeSafetyMargin = 8;
-    // This is the maximum number of times the parameter pipe read function
-    // can fail before we start to get worried.
-    static constexpr int kMaxContentions = 5;
+    // Number of playback buffers used when the creation params don't
+    // specify one.
+    static constexpr unsigned int kDefaultPlaybackBufferCount = 1;
+
+    // How long an adaptive playback queue has to run cleanly before it
+    // gives back a period, when the creation params don't say.
+    static constexpr int kDefaultLatencyStableWindowMs = 10000;
 
     StreamImpl(
         const HowieDeviceCharacteristics &deviceCharacteristics,
         const HowieStreamCreationParams &params)
         : deviceCharacteristics(deviceCharacteristics),
+          direction_(params.direction),
+          sampleFormat_(params.sampleFormat),
+          arena_(planArena(deviceCharacteristics, params)),
+          state_(arena_.region(kStateRegion), params.sizeofStateBlock),
+          params_(params.sizeofParameterBlock,
+                  arena_.region(kParameterRegion)),
+          captureFrameSize_(captureFrameSize(deviceCharacteristics, params)),
+          planar_(params.planar),
+          idleWhenSilent_(params.idleWhenSilent),
+          idleSilentPeriods_(params.idleSilentPeriods),
+          idleThreshold_(params.idleThreshold),
           deviceChangedCallback_(params.deviceChangedCallback),
           processCallback_(params.processCallback),
           cleanupCallback_(params.cleanupCallback),
-          state_(params.sizeofStateBlock),
-          params_(params.sizeofParameterBlock, kParameterPipeSafetyMargin),
-          direction_(params.direction),
+          commandCallback_(params.commandCallback),
           streamState_(HOWIE_STREAM_STATE_STOPPED) {
+      if (state_.size() < params.sizeofStateBlock) {
+        // The arena couldn't be allocated.
+        state_.reset(params.sizeofStateBlock);
+        state_.clear();
+      }
+      if (params.eventQueueLength > 0) {
+        events_.reset(new EventQueue(params.eventQueueLength));
+      }
+      if (params.sizeofReport > 0 && params.reportQueueLength > 0) {
+        reports_.reset(new ReportRing(params.sizeofReport,
+                                      params.reportQueueLength));
+      }
+      if ((direction_ & HOWIE_STREAM_DIRECTION_RECORD)
+          && params.captureBufferPeriods > 0) {
+        // Created here rather than in init(), which runs asynchronously,
+        // so that the app can start reading as soon as it has the stream.
+        capture_.reset(new CaptureRing(params.captureBufferPeriods
+                                       * deviceCharacteristics.framesPerPeriod
+                                       * captureFrameSize_));
+      }
       __android_log_print(ANDROID_LOG_DEBUG,
                           "HOWIE",
                           "%s %d",
@@ -59,76 +97,248 @@ namespace howie {
       version = sizeof(*this);
     }
 
-    HowieError init(SLEngineItf engineItf,
-         SLObjectItf outputMixObject,
-         const HowieStreamCreationParams &creationParams_);
-    ~StreamImpl();
+    // Open the stream on the given backend, which it takes ownership of.
+    // If that fails, the backend is destroyed and init() can be called
+    // again with another one.
+    HowieError init(StreamBackend *backend,
+                    const HowieStreamCreationParams &creationParams_);
+
+    // Initialize a stream that renders into the given shared output instead
+    // of a backend of its own.
+    HowieError initShared(Mixer *mixer,
+                          const HowieStreamCreationParams &creationParams_);
+    virtual ~StreamImpl();
+
+    // How to schedule the backend's audio thread. Call before init().
+    void configureAudioThread(const HowieAudioThreadParams &params) {
+      audioThread_.configure(params, periodNs());
+    }
+
+    bool PushParameterBlock(const void *data, size_t size, int timeoutMs);
+    bool PatchParameterBlock(size_t offset,
+                             const void *data,
+                             size_t size,
+                             int timeoutMs);
+    unsigned char *AcquireParameterSlot(int timeoutMs);
+    bool CommitParameterSlot(const void *slot);
+    size_t parameterBlockSize() const { return params_.maxElementSize(); }
+
+    // Every buffer AcquireParameterSlot() can return; see ParameterPipe.
+    unsigned char *parameterStorage() const { return params_.storage(); }
+    size_t parameterStorageSize() const { return params_.storageSize(); }
+    size_t parameterStride() const { return params_.stride(); }
+    void getStatistics(HowieStreamStatistics *dest) const;
+
+    // See HowieStreamScheduleEvent and HowieStreamGetEvents.
+    bool hasEventQueue() const { return events_ != nullptr; }
+    bool ScheduleEvent(int64_t frameTime, const void *data, size_t size);
+    void getEvents(const HowieEvent **events, size_t *count) const;
+    int64_t frameTime() const {
+      return frameTime_.load(std::memory_order_acquire);
+    }
+
+    // See HowieStreamAcquireReport and HowieStreamReceiveReports. The
+    // first two are audio thread only.
+    bool hasReportRing() const { return reports_ != nullptr; }
+    unsigned char *AcquireReport();
+    bool CommitReport(const void *report);
+    size_t ReceiveReports(void *dest, size_t size);
+
+    // See HowieStreamSetIdle. Audio thread only, as is idle(), which says
+    // whether the period just run skipped the callback.
+    HowieError requestIdle();
+    bool idle() const { return idle_; }
 
-    bool PushParameterBlock(const void *data, size_t size);
+    // Consumer thread side of the capture ring; see HowieStreamReadCaptured.
+    bool hasCaptureRing() const { return capture_ != nullptr; }
+    size_t ReadCaptured(void *dest, size_t size, int timeoutMs);
+
+    // Offline streams only; see HowieStreamRender.
+    HowieError Render(size_t frameCount,
+                      const HowieBuffer *in,
+                      const HowieBuffer *out);
 
     HowieError run();
     HowieError stop();
     HowieStreamState getState();
 
+    // Report the outcome of a worker command to the app. Call on the
+    // worker thread.
+    void commandCompleted(HowieError result);
+
+    // Called by the shared output on its audio thread: run one period of
+    // this stream into its output buffer.
+    HowieError processShared();
+    const HowieBuffer sharedOutputBuffer() const {
+      return HowieBuffer { sizeof(HowieBuffer), output_.get(), output_.size() };
+    }
+    HowieSampleFormat sampleFormat() const { return sampleFormat_; }
+
+  protected:
+    // Produce one period of audio. By default this hands the buffers to the
+    // app's process callback; the shared output overrides it to mix its
+    // attached streams instead.
+    virtual HowieError render(const HowieBuffer *in,
+                              const HowieBuffer *out,
+                              const HowieBuffer *state,
+                              const HowieBuffer *params);
+
+    // Close the backend, waiting for any period in progress.
+    void closeBackend() { backend_.reset(); }
+
+    AudioThread &audioThread() { return audioThread_; }
+
 
   private:
-    // Defines the number of buffers used for recording. In the absence of
-    // predictably ordered, synchronized I/O, we use three:
-    // one to write, one to read, and one to compensate for i/o
-    // being out of phase.
-    static constexpr unsigned int kRecordBufferCount = 3;
+    // The regions of arena_: the state and parameter blocks, the
+    // resampler's, the planar buffers, then one for each buffer a backend
+    // can ask for.
+    enum ArenaRegion {
+      kStateRegion,
+      kParameterRegion,
+      kResamplerRegion,
+      kPlanarRegion,
+      kBackendRegion,
+      kRegionCount = kBackendRegion + kBackendBufferCount
+    };
+
+    // The number of playback slots the stream needs: its playback buffer
+    // count, or the most it can adapt up to.
+    static unsigned int playbackSlotCount(
+        const HowieStreamCreationParams &params);
+
+    // The largest each buffer can need, given the stream's parameters,
+    // whichever backend runs it. Which buffers are used, and at what size,
+    // is only settled once the backend is open.
+    static StreamArena::Plan planArena(
+        const HowieDeviceCharacteristics &deviceCharacteristics,
+        const HowieStreamCreationParams &params);
+
+    // Point buffer at size bytes of a region, or allocate it separately if
+    // the region is too small.
+    void useRegion(unique_buffer *buffer, int region, size_t size);
+
+    // Set up resampler_ if the app asked for a rate of its own. Call once
+    // the device characteristics are settled.
+    HowieError initResampler(const HowieStreamCreationParams &params);
+
+    // Set up the planar buffers, if the app asked for them. Call after
+    // initResampler().
+    HowieError initPlanar();
+
+    // Bytes from one channel of a planar buffer to the next.
+    static size_t planarStride(size_t frameCount);
+
+    // The most frames a callback can be asked for: a device period, or
+    // whatever the resampler needs for one.
+    static size_t callbackFrames(
+        const HowieDeviceCharacteristics &deviceCharacteristics,
+        const HowieStreamCreationParams &params);
+
+    // StreamBackend::Client
+    HowieError onPeriod(const HowieBuffer *in,
+                        const HowieBuffer *out) override;
+    StreamStatistics &statistics() override { return stats_; }
+    RealtimeLog &realtimeLog() override { return log_; }
+    void useBuffer(unique_buffer *buffer,
+                   BackendBuffer which,
+                   size_t size) override {
+      useRegion(buffer, kBackendRegion + which, size);
+    }
 
+    // The characteristics the backend runs at, which differ from the
+    // device's when the stream runs in float. The app sees these too,
+    // unless the stream is resampled.
     HowieDeviceCharacteristics deviceCharacteristics;
     HowieDirection direction_;
+    HowieSampleFormat sampleFormat_;
 
-    // The smallest size a buffer can be. All of the buffers need to be
-    // multiples of this number.
-    size_t bufferQuantum_ = 0;
-
-    unique_buffer input_;
-    unsigned int recordBuffersSubmitted_ = 0;
-    std::atomic<unsigned int> recordBuffersFinished_ = {0};
+    // Backs the state and parameter blocks and every buffer the audio
+    // thread touches. Declared ahead of them, so it's constructed first.
+    StreamArena arena_;
 
+    // The single period buffer of a stream on the shared output.
     unique_buffer output_;
     unique_buffer state_;
 
     ParameterPipe params_;
-    int paramsContentionCounter_ = 0;
+    StreamStatistics stats_;
+    RealtimeLog log_;
 
+    // Input for a consumer thread, if the app asked for it, in frames of
+    // the format the process callback sees. Fixed at creation, so readers
+    // never look at deviceCharacteristics, which init() rewrites.
+    static size_t captureFrameSize(
+        const HowieDeviceCharacteristics &deviceCharacteristics,
+        const HowieStreamCreationParams &params);
+    const size_t captureFrameSize_;
+    std::unique_ptr<CaptureRing> capture_;
 
-    SLObjectItf playerObject_ = nullptr;
-    SLPlayItf playerItf_ = nullptr;
-    SLAndroidSimpleBufferQueueItf playerBufferQueueItf_ = nullptr;
-    static void bqPlayerCallback(SLAndroidSimpleBufferQueueItf, void *);
+    // Scheduled events, if the app asked for them, and the frame time at
+    // the start of the next period. Only the audio thread writes it.
+    std::unique_ptr<EventQueue> events_;
+    std::atomic<int64_t> frameTime_ {0};
 
-    SLObjectItf recorderObject_ = nullptr;
-    SLRecordItf recorderItf_ = nullptr;
-    SLAndroidSimpleBufferQueueItf recorderBufferQueueItf_ = nullptr;
-    static void bqRecorderCallback(SLAndroidSimpleBufferQueueItf, void*);
+    // Reports from the process callback, if the app asked for them.
+    std::unique_ptr<ReportRing> reports_;
 
-    static HowieError lastPlaybackError_;
-    static HowieError lastRecordError_;
+    // Converts the app's rate to the device's, if they differ. The process
+    // callback renders into its input, and it fills the backend's output.
+    unique_buffer resamplerStorage_;
+    std::unique_ptr<Resampler> resampler_;
+
+    // The process callback's input and output for planar streams, carved
+    // from planarStorage_: the input's channels, then the output's.
+    bool planar_;
+    unique_buffer planarStorage_;
+    HowieMultiBuffer planarIn_ = {};
+    HowieMultiBuffer planarOut_ = {};
+    void usePlanar(HowieMultiBuffer *buffer, unsigned char *base,
+                   size_t frameCount);
+    void setFrameCount(HowieMultiBuffer *buffer, size_t frameCount);
+    HowieError renderPlanar(const HowieBuffer *in,
+                            const HowieBuffer &out,
+                            const HowieBuffer *state,
+                            const HowieBuffer *params);
+
+    // Idle mode, if the app asked for it. All but wakeRequested_ belong to
+    // the audio thread. idleRequested_ takes effect at the start of the
+    // next period; silentPeriods_ counts silent periods in a row.
+    const bool idleWhenSilent_;
+    const size_t idleSilentPeriods_;
+    const float idleThreshold_;
+    bool idle_ = false;
+    bool idleRequested_ = false;
+    size_t silentPeriods_ = 0;
+    std::atomic<bool> wakeRequested_ {false};
+    bool isSilent(const HowieBuffer &buffer) const;
+    bool shouldWake(const HowieBuffer &in, bool paramsChanged);
+    void updateIdle(const HowieBuffer &in, const HowieBuffer &out);
+
+    // The audio API the stream runs on, unless it's on the shared output,
+    // and the thread it calls onPeriod() on.
+    std::unique_ptr<StreamBackend> backend_;
+    AudioThread audioThread_;
 
     HowieDeviceChangedCallback deviceChangedCallback_;
     HowieProcessCallback processCallback_;
     HowieCleanupCallback cleanupCallback_;
+    HowieStreamCommandCallback commandCallback_;
 
-    HowieError process(SLAndroidSimpleBufferQueueItf bq);
-
-    HowieError initPlayback(SLEngineItf engineItf,
-                            SLObjectItf outputMixObject,
-                            SLDataFormat_PCM &format_pcm);
+    void capture(const HowieBuffer &in);
+    HowieError runCallback(const HowieBuffer *in, const HowieBuffer *out);
 
-    HowieError initRecording(
-        SLEngineItf engineItf,
-        SLDataFormat_PCM &pcm);
+    int64_t periodNs() const;
+    void notifyDeviceChanged();
 
-    HowieError submitRecordBuffer();
+    // The shared output this stream is attached to, if any.
+    Mixer *mixer_ = nullptr;
 
     HowieError cleanupObjects(void);
-    const unsigned int countFreeBuffers() const;
 
-    HowieStreamState_t streamState_;
+    // Written on the worker thread; read by the shared output's audio
+    // thread as well as by user threads.
+    std::atomic<HowieStreamState_t> streamState_;
 
   };
 
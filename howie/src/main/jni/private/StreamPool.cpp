@@ -0,0 +1,416 @@
+/*
+ * Copyright 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#include "StreamPool.h"
+#include "howie-private.h"
+#include "StreamImpl.h"
+#include "OpenSLBackend.h"
+#include <thread>
+
+namespace howie {
+
+  void CallbackSlot::bind(slAndroidSimpleBufferQueueCallback callback,
+                          void *context) {
+    callback_.store(callback);
+    context_.store(context);
+  }
+
+  /**
+   * A callback that loaded the old context has already counted itself in
+   * active_, so once active_ drops to zero nothing can be using it.
+   */
+  void CallbackSlot::unbind() {
+    context_.store(nullptr);
+    while (active_.load() != 0) {
+      std::this_thread::yield();
+    }
+  }
+
+  void CallbackSlot::dispatch(SLAndroidSimpleBufferQueueItf bq, void *slot) {
+    CallbackSlot *self = static_cast<CallbackSlot *>(slot);
+    self->active_.fetch_add(1);
+    void *context = self->context_.load();
+    if (context) {
+      self->callback_.load()(bq, context);
+    }
+    self->active_.fetch_sub(1);
+  }
+
+  StreamPool::StreamPool(
+      const HowieDeviceCharacteristics &deviceCharacteristics)
+      : deviceCharacteristics_(deviceCharacteristics) {
+  }
+
+  StreamPool::~StreamPool() {
+    HOWIE_TRACE_FN(HOWIE_TRACE_LEVEL_CALLS)
+    playerCount_ = 0;
+    recorderCount_ = 0;
+    trim();
+  }
+
+  HowieError StreamPool::configure(SLEngineItf engineItf,
+                                   SLObjectItf outputMixObject,
+                                   const HowieStreamPoolParams &params) {
+    HOWIE_TRACE_FN(HOWIE_TRACE_LEVEL_CALLS)
+    unsigned int playbackBufferCount =
+        params.playbackBufferCount > 0
+        ? static_cast<unsigned int>(params.playbackBufferCount)
+        : StreamImpl::kDefaultPlaybackBufferCount;
+    if (params.sampleFormat != sampleFormat_
+        || playbackBufferCount != playbackBufferCount_) {
+      // Nothing already pooled fits the new streams.
+      playerCount_ = 0;
+      recorderCount_ = 0;
+      trim();
+      sampleFormat_ = params.sampleFormat;
+      floatFormat_ = sampleFormat_ == HOWIE_SAMPLE_FORMAT_FLOAT;
+      playbackBufferCount_ = playbackBufferCount;
+    }
+    playerCount_ = params.playerCount;
+    recorderCount_ = params.recorderCount;
+    trim();
+
+    SLDataFormat_PCM pcm;
+    makePcmFormat(deviceCharacteristics_, &pcm);
+    SLAndroidDataFormat_PCM_EX pcmFloat;
+    makeFloatFormat(pcm, &pcmFloat);
+
+    while (players_.size() < playerCount_) {
+      Entry<Player> entry;
+      entry.floatFormat = floatFormat_;
+      entry.bufferCount = playbackBufferCount_;
+      HowieError result = createPlayer(
+          engineItf, outputMixObject,
+          floatFormat_ ? static_cast<void *>(&pcmFloat) : &pcm,
+          playbackBufferCount_, &entry.object);
+      if (!HOWIE_SUCCEEDED(result) && floatFormat_) {
+        // Streams on this device will convert from the device format, so
+        // that's what they'll look for.
+        floatFormat_ = false;
+        continue;
+      }
+      HOWIE_CHECK(result);
+      players_.push_back(entry);
+    }
+
+    while (recorders_.size() < recorderCount_) {
+      Entry<Recorder> entry;
+      entry.floatFormat = floatFormat_;
+      entry.bufferCount = OpenSLBackend::kRecordBufferCount;
+      HowieError result = createRecorder(
+          engineItf,
+          floatFormat_ ? static_cast<void *>(&pcmFloat) : &pcm,
+          OpenSLBackend::kRecordBufferCount, &entry.object);
+      if (!HOWIE_SUCCEEDED(result) && floatFormat_) {
+        floatFormat_ = false;
+        continue;
+      }
+      HOWIE_CHECK(result);
+      recorders_.push_back(entry);
+    }
+    return HOWIE_SUCCESS;
+  }
+
+  /**
+   * Destroy whatever the pool holds beyond its configured size.
+   */
+  void StreamPool::trim() {
+    while (players_.size() > playerCount_) {
+      destroy(players_.back().object);
+      players_.pop_back();
+    }
+    while (recorders_.size() > recorderCount_) {
+      destroy(recorders_.back().object);
+      recorders_.pop_back();
+    }
+  }
+
+  bool StreamPool::takePlayer(bool floatFormat,
+                              unsigned int bufferCount,
+                              Player *dest) {
+    HOWIE_TRACE_FN(HOWIE_TRACE_LEVEL_CALLS)
+    for (auto it = players_.begin(); it != players_.end(); ++it) {
+      if (it->floatFormat == floatFormat && it->bufferCount == bufferCount) {
+        *dest = it->object;
+        players_.erase(it);
+        return true;
+      }
+    }
+    return false;
+  }
+
+  bool StreamPool::takeRecorder(bool floatFormat,
+                                unsigned int bufferCount,
+                                Recorder *dest) {
+    HOWIE_TRACE_FN(HOWIE_TRACE_LEVEL_CALLS)
+    for (auto it = recorders_.begin(); it != recorders_.end(); ++it) {
+      if (it->floatFormat == floatFormat && it->bufferCount == bufferCount) {
+        *dest = it->object;
+        recorders_.erase(it);
+        return true;
+      }
+    }
+    return false;
+  }
+
+  /**
+   * The caller has already unbound the callback slot, so stopping the
+   * player and clearing its queue is all it takes to make it idle again.
+   */
+  bool StreamPool::recyclePlayer(bool floatFormat,
+                                 unsigned int bufferCount,
+                                 const Player &player) {
+    HOWIE_TRACE_FN(HOWIE_TRACE_LEVEL_CALLS)
+    if (players_.size() >= playerCount_ || floatFormat != floatFormat_
+        || bufferCount != playbackBufferCount_) {
+      return false;
+    }
+    if (!HOWIE_SUCCEEDED(check((*player.play)->SetPlayState(
+            player.play, SL_PLAYSTATE_STOPPED)))
+        || !HOWIE_SUCCEEDED(check((*player.queue)->Clear(player.queue)))) {
+      return false;
+    }
+    players_.push_back(Entry<Player> { player, floatFormat, bufferCount });
+    return true;
+  }
+
+  bool StreamPool::recycleRecorder(bool floatFormat,
+                                   unsigned int bufferCount,
+                                   const Recorder &recorder) {
+    HOWIE_TRACE_FN(HOWIE_TRACE_LEVEL_CALLS)
+    if (recorders_.size() >= recorderCount_ || floatFormat != floatFormat_
+        || bufferCount != OpenSLBackend::kRecordBufferCount) {
+      return false;
+    }
+    if (!HOWIE_SUCCEEDED(check((*recorder.record)->SetRecordState(
+            recorder.record, SL_RECORDSTATE_STOPPED)))
+        || !HOWIE_SUCCEEDED(check((*recorder.queue)->Clear(recorder.queue)))) {
+      return false;
+    }
+    recorders_.push_back(
+        Entry<Recorder> { recorder, floatFormat, bufferCount });
+    return true;
+  }
+
+  void StreamPool::makePcmFormat(const HowieDeviceCharacteristics &device,
+                                 SLDataFormat_PCM *dest) {
+    dest->formatType = SL_DATAFORMAT_PCM;
+    dest->numChannels = device.channelCount;
+    dest->samplesPerSec = (SLuint32) device.sampleRate * 1000;
+    dest->bitsPerSample = device.bitsPerSample;
+    // The container holds one sample, not a frame.
+    dest->containerSize = device.bytesPerSample * 8;
+    dest->channelMask = channelMask(dest->numChannels);
+    dest->endianness = SL_BYTEORDER_LITTLEENDIAN;
+  }
+
+  SLuint32 StreamPool::channelMask(SLuint32 channelCount) {
+    const SLuint32 stereo = SL_SPEAKER_FRONT_LEFT | SL_SPEAKER_FRONT_RIGHT;
+    const SLuint32 quad = stereo | SL_SPEAKER_BACK_LEFT
+                          | SL_SPEAKER_BACK_RIGHT;
+    const SLuint32 surround51 = quad | SL_SPEAKER_FRONT_CENTER
+                                | SL_SPEAKER_LOW_FREQUENCY;
+    switch (channelCount) {
+      case 1: return SL_SPEAKER_FRONT_CENTER;
+      case 2: return stereo;
+      case 3: return stereo | SL_SPEAKER_FRONT_CENTER;
+      case 4: return quad;
+      case 5: return quad | SL_SPEAKER_FRONT_CENTER;
+      case 6: return surround51;
+      case 7: return surround51 | SL_SPEAKER_BACK_CENTER;
+      case 8: return surround51 | SL_SPEAKER_SIDE_LEFT
+                     | SL_SPEAKER_SIDE_RIGHT;
+      default: return 0;
+    }
+  }
+
+  void StreamPool::makeFloatFormat(const SLDataFormat_PCM &pcm,
+                                   SLAndroidDataFormat_PCM_EX *dest) {
+    dest->formatType = SL_ANDROID_DATAFORMAT_PCM_EX;
+    dest->numChannels = pcm.numChannels;
+    dest->sampleRate = pcm.samplesPerSec;
+    dest->bitsPerSample = 32;
+    dest->containerSize = 32;
+    dest->channelMask = pcm.channelMask;
+    dest->endianness = SL_BYTEORDER_LITTLEENDIAN;
+    dest->representation = SL_ANDROID_PCM_REPRESENTATION_FLOAT;
+  }
+
+  HowieError StreamPool::createRecorder(SLEngineItf engineItf,
+                                        void *format,
+                                        unsigned int bufferCount,
+                                        Recorder *dest) {
+    HOWIE_TRACE_FN(HOWIE_TRACE_LEVEL_CALLS)
+    Recorder recorder = {};
+
+    // configure audio source
+    SLDataLocator_IODevice loc_dev = {SL_DATALOCATOR_IODEVICE, SL_IODEVICE_AUDIOINPUT,
+                                      SL_DEFAULTDEVICEID_AUDIOINPUT, NULL};
+    SLDataSource audioSrc = {&loc_dev, NULL};
+
+    // configure record buffer queue
+    SLDataLocator_AndroidSimpleBufferQueue loc_bq = {
+        SL_DATALOCATOR_ANDROIDSIMPLEBUFFERQUEUE, bufferCount};
+
+    SLDataSink audioSnk = {&loc_bq, format};
+
+    // create audio recorder
+    // (requires the RECORD_AUDIO permission)
+    const SLInterfaceID id[1] = {SL_IID_ANDROIDSIMPLEBUFFERQUEUE};
+    const SLboolean req[1] = {SL_BOOLEAN_TRUE};
+    HOWIE_CHECK ((*engineItf)->CreateAudioRecorder(
+        engineItf,
+        &recorder.object,
+        &audioSrc,
+        &audioSnk,
+        1,
+        id,
+        req));
+
+    // From here on, failures have an object to clean up.
+    recorder.slot = new CallbackSlot;
+    HowieError result = check((*recorder.object)->Realize(recorder.object,
+                                                          SL_BOOLEAN_FALSE));
+
+    // get the record interface
+    if (HOWIE_SUCCEEDED(result)) {
+      result = check((*recorder.object)->GetInterface(
+          recorder.object,
+          SL_IID_RECORD,
+          &recorder.record));
+    }
+
+    // get the buffer queue interface
+    if (HOWIE_SUCCEEDED(result)) {
+      result = check((*recorder.object)->GetInterface(
+          recorder.object,
+          SL_IID_ANDROIDSIMPLEBUFFERQUEUE,
+          &recorder.queue));
+    }
+
+    // register callback on the buffer queue
+    if (HOWIE_SUCCEEDED(result)) {
+      result = check((*recorder.queue)->RegisterCallback(
+          recorder.queue,
+          CallbackSlot::dispatch,
+          recorder.slot));
+    }
+
+    if (!HOWIE_SUCCEEDED(result)) {
+      destroy(recorder);
+      HOWIE_CHECK(result);
+    }
+    *dest = recorder;
+    return HOWIE_SUCCESS;
+  }
+
+  HowieError StreamPool::createPlayer(SLEngineItf engineItf,
+                                      SLObjectItf outputMixObject,
+                                      void *format,
+                                      unsigned int bufferCount,
+                                      Player *dest) {
+    HOWIE_TRACE_FN(HOWIE_TRACE_LEVEL_CALLS)
+    Player player = {};
+    SLDataLocator_AndroidSimpleBufferQueue locator_bufferqueue_source;
+    SLDataSource audio_source;
+
+    // source location
+    locator_bufferqueue_source.locatorType
+        = SL_DATALOCATOR_ANDROIDSIMPLEBUFFERQUEUE;
+    locator_bufferqueue_source.numBuffers = bufferCount;
+    audio_source.pLocator = &locator_bufferqueue_source;
+    audio_source.pFormat = format;
+
+
+    // configure the output: An output mix sink
+    SLDataLocator_OutputMix locator_output_mix;
+    SLDataSink audio_sink;
+
+    locator_output_mix.locatorType = SL_DATALOCATOR_OUTPUTMIX;
+    locator_output_mix.outputMix = outputMixObject;
+
+    audio_sink.pLocator = &locator_output_mix;
+    audio_sink.pFormat = NULL;
+
+    // create audio player
+    // Note: Adding other output interfaces here will result in your audio being routed using the
+    // normal path NOT the fast path
+    const SLInterfaceID
+        interface_ids[2] = {SL_IID_ANDROIDSIMPLEBUFFERQUEUE, SL_IID_VOLUME};
+    const SLboolean interfaces_required[2] = {SL_BOOLEAN_TRUE, SL_BOOLEAN_TRUE};
+
+    HOWIE_CHECK((*engineItf)->CreateAudioPlayer(
+        engineItf,
+        &player.object,
+        &audio_source,
+        &audio_sink,
+        2, // Number of interfaces
+        interface_ids,
+        interfaces_required
+    ));
+
+    // From here on, failures have an object to clean up.
+    player.slot = new CallbackSlot;
+
+    // realize the player
+    HowieError result = check((*player.object)->Realize(player.object,
+                                                        SL_BOOLEAN_FALSE));
+
+    // get the play interface
+    if (HOWIE_SUCCEEDED(result)) {
+      result = check((*player.object)->GetInterface(player.object,
+                                                    SL_IID_PLAY,
+                                                    &player.play));
+    }
+
+    // get the buffer queue interface
+    if (HOWIE_SUCCEEDED(result)) {
+      result = check((*player.object)->GetInterface(player.object,
+                                                    SL_IID_BUFFERQUEUE,
+                                                    &player.queue));
+    }
+
+    // register callback on the buffer queue
+    if (HOWIE_SUCCEEDED(result)) {
+      result = check((*player.queue)->RegisterCallback(
+          player.queue,
+          CallbackSlot::dispatch,
+          player.slot));
+    }
+
+    if (!HOWIE_SUCCEEDED(result)) {
+      destroy(player);
+      HOWIE_CHECK(result);
+    }
+    *dest = player;
+    return HOWIE_SUCCESS;
+  }
+
+  /**
+   * Destroying an OpenSL object waits for its callbacks to finish, so the
+   * slot can go after it.
+   */
+  void StreamPool::destroy(const Player &player) {
+    (*player.object)->Destroy(player.object);
+    delete player.slot;
+  }
+
+  void StreamPool::destroy(const Recorder &recorder) {
+    (*recorder.object)->Destroy(recorder.object);
+    delete recorder.slot;
+  }
+
+} // namespace howie
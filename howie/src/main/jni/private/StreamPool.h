@@ -0,0 +1,151 @@
+/*
+ * Copyright 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#ifndef HOWIE_STREAMPOOL_H
+#define HOWIE_STREAMPOOL_H
+
+#include <SLES/OpenSLES_Android.h>
+#include <atomic>
+#include <vector>
+#include "../howie.h"
+
+namespace howie {
+
+  /**
+   * OpenSL buffer queue callbacks go through one of these rather than
+   * straight to a stream. An object can then move from one stream to the
+   * next without a late callback for the old stream reaching the new one,
+   * or reaching a stream that has been deleted.
+   */
+  class CallbackSlot {
+  public:
+    // Point the slot's callbacks at context.
+    void bind(slAndroidSimpleBufferQueueCallback callback, void *context);
+
+    // Stop passing callbacks on, and wait for any callback in progress.
+    void unbind();
+
+    // The callback registered with OpenSL, with the slot as its context.
+    static void dispatch(SLAndroidSimpleBufferQueueItf bq, void *slot);
+
+  private:
+    std::atomic<slAndroidSimpleBufferQueueCallback> callback_ {nullptr};
+    std::atomic<void *> context_ {nullptr};
+    std::atomic<int> active_ {0};
+  };
+
+  /**
+   * Idle OpenSL players and recorders, realized ahead of time. Creating
+   * and realizing an OpenSL object takes tens of milliseconds, so streams
+   * take one from here when they can and hand it back when they're
+   * destroyed.
+   *
+   * Pooled objects are stopped, have an empty buffer queue and an unbound
+   * callback slot. Everything here runs on the worker thread, so nothing is
+   * locked.
+   */
+  class StreamPool {
+  public:
+    struct Player {
+      SLObjectItf object;
+      SLPlayItf play;
+      SLAndroidSimpleBufferQueueItf queue;
+      CallbackSlot *slot;
+    };
+
+    struct Recorder {
+      SLObjectItf object;
+      SLRecordItf record;
+      SLAndroidSimpleBufferQueueItf queue;
+      CallbackSlot *slot;
+    };
+
+    explicit StreamPool(const HowieDeviceCharacteristics &deviceCharacteristics);
+    ~StreamPool();
+
+    // Sets the number of idle objects to keep, creating or destroying
+    // objects to match.
+    HowieError configure(SLEngineItf engineItf,
+                         SLObjectItf outputMixObject,
+                         const HowieStreamPoolParams &params);
+
+    // Take an idle object built with the given format and buffer count.
+    // Return false if there isn't one.
+    bool takePlayer(bool floatFormat, unsigned int bufferCount, Player *dest);
+    bool takeRecorder(bool floatFormat, unsigned int bufferCount,
+                      Recorder *dest);
+
+    // Offer an object back to the pool. Returns false if the pool doesn't
+    // want it, in which case the caller still owns it.
+    bool recyclePlayer(bool floatFormat, unsigned int bufferCount,
+                       const Player &player);
+    bool recycleRecorder(bool floatFormat, unsigned int bufferCount,
+                         const Recorder &recorder);
+
+    // Object creation and destruction, shared with streams that miss the
+    // pool. Created objects have a callback slot registered, but not bound.
+    static HowieError createPlayer(SLEngineItf engineItf,
+                                   SLObjectItf outputMixObject,
+                                   void *format,
+                                   unsigned int bufferCount,
+                                   Player *dest);
+    static HowieError createRecorder(SLEngineItf engineItf,
+                                     void *format,
+                                     unsigned int bufferCount,
+                                     Recorder *dest);
+    static void destroy(const Player &player);
+    static void destroy(const Recorder &recorder);
+
+    // The OpenSL formats matching the device, in its own sample format or
+    // in float.
+    static void makePcmFormat(const HowieDeviceCharacteristics &device,
+                              SLDataFormat_PCM *dest);
+    static void makeFloatFormat(const SLDataFormat_PCM &pcm,
+                                SLAndroidDataFormat_PCM_EX *dest);
+
+    // The speaker layout Android assumes for a channel count, such as 5.1
+    // for six channels, or zero if it doesn't have one.
+    static SLuint32 channelMask(SLuint32 channelCount);
+
+  private:
+    template <typename T>
+    struct Entry {
+      T object;
+      bool floatFormat;
+      unsigned int bufferCount;
+    };
+
+    HowieDeviceCharacteristics deviceCharacteristics_;
+
+    // What the pool is filled with, and how many of each to keep.
+    HowieSampleFormat sampleFormat_ = HOWIE_SAMPLE_FORMAT_DEVICE;
+    unsigned int playbackBufferCount_ = 0;
+    size_t playerCount_ = 0;
+    size_t recorderCount_ = 0;
+
+    std::vector<Entry<Player>> players_;
+    std::vector<Entry<Recorder>> recorders_;
+
+    // Whether newly pooled objects are built in float. This can differ
+    // from sampleFormat_ if the device turns float down.
+    bool floatFormat_ = false;
+
+    void trim();
+  };
+
+} // namespace howie
+
+#endif // HOWIE_STREAMPOOL_H
@@ -0,0 +1,103 @@
+/*
+ * Copyright 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#include "StreamStatistics.h"
+#include <algorithm>
+
+namespace howie {
+
+  StreamStatistics::StreamStatistics() {
+    for (auto &count : durationHistogram_) {
+      count.store(0, std::memory_order_relaxed);
+    }
+    for (auto &count : intervalHistogram_) {
+      count.store(0, std::memory_order_relaxed);
+    }
+  }
+
+  void StreamStatistics::configure(int64_t periodNs,
+                                   unsigned int queuedPeriods) {
+    periodNs_.store(periodNs, std::memory_order_relaxed);
+    bucketWidthNs_ = static_cast<uint32_t>(
+        std::max<int64_t>(1, periodNs / HOWIE_STATISTICS_BUCKETS_PER_PERIOD));
+    setQueuedPeriods(queuedPeriods);
+  }
+
+  void StreamStatistics::setQueuedPeriods(unsigned int queuedPeriods) {
+    // Allow half a period of slack before calling it an underrun.
+    int64_t periodNs = periodNs_.load(std::memory_order_relaxed);
+    underrunThresholdNs_ = periodNs * queuedPeriods + periodNs / 2;
+  }
+
+  unsigned int StreamStatistics::bucket(int64_t ns) const {
+    // Clamp before dividing so the division is 32 bit; a 64 bit divide
+    // is a library call on armv7.
+    const int64_t limit = static_cast<int64_t>(bucketWidthNs_)
+                          * (HOWIE_STATISTICS_BUCKET_COUNT - 1);
+    if (ns >= limit) {
+      return HOWIE_STATISTICS_BUCKET_COUNT - 1;
+    }
+    return static_cast<uint32_t>(std::max<int64_t>(ns, 0)) / bucketWidthNs_;
+  }
+
+  void StreamStatistics::callbackStarted(int64_t startNs) {
+    int64_t last = lastCallbackNs_.load(std::memory_order_relaxed);
+    lastCallbackNs_.store(startNs, std::memory_order_relaxed);
+    lastIntervalNs_ = 0;
+    if (last != 0) {
+      int64_t interval = startNs - last;
+      lastIntervalNs_ = interval;
+      increment(intervalHistogram_[bucket(interval)]);
+      if (interval > underrunThresholdNs_) {
+        increment(underruns_);
+      }
+    }
+  }
+
+  void StreamStatistics::callbackFinished(int64_t startNs, int64_t endNs) {
+    int64_t duration = endNs - startNs;
+    lastDurationNs_ = duration;
+    increment(durationHistogram_[bucket(duration)]);
+    increment(callbackCount_);
+    if (duration > maxCallbackDurationNs_.load(std::memory_order_relaxed)) {
+      maxCallbackDurationNs_.store(duration, std::memory_order_relaxed);
+    }
+  }
+
+  void StreamStatistics::read(HowieStreamStatistics *dest) const {
+    dest->version = sizeof(HowieStreamStatistics);
+    dest->periodNs = periodNs_.load(std::memory_order_relaxed);
+    dest->lastCallbackTimeNs = lastCallbackNs_.load(std::memory_order_relaxed);
+    dest->callbackCount = callbackCount_.load(std::memory_order_relaxed);
+    dest->maxCallbackDurationNs =
+        maxCallbackDurationNs_.load(std::memory_order_relaxed);
+    for (int i = 0; i < HOWIE_STATISTICS_BUCKET_COUNT; ++i) {
+      dest->callbackDurationHistogram[i] =
+          durationHistogram_[i].load(std::memory_order_relaxed);
+      dest->callbackIntervalHistogram[i] =
+          intervalHistogram_[i].load(std::memory_order_relaxed);
+    }
+    dest->underrunCount = underruns_.load(std::memory_order_relaxed);
+    dest->missedRecordBufferCount =
+        missedRecordBuffers_.load(std::memory_order_relaxed);
+    dest->captureOverflowCount =
+        captureOverflows_.load(std::memory_order_relaxed);
+    dest->reportOverflowCount =
+        reportOverflows_.load(std::memory_order_relaxed);
+    dest->idlePeriodCount = idlePeriods_.load(std::memory_order_relaxed);
+  }
+
+} // namespace howie
@@ -0,0 +1,122 @@
+/*
+ * Copyright 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#ifndef HOWIE_STREAMSTATISTICS_H
+#define HOWIE_STREAMSTATISTICS_H
+
+#include <atomic>
+#include <stdint.h>
+#include <time.h>
+#include "../howie.h"
+
+namespace howie {
+
+  /**
+   * Callback timing and glitch counters for one stream.
+   *
+   * Everything is written only by the audio thread, so the counters are
+   * plain relaxed loads and stores rather than read-modify-write
+   * operations. Readers on other threads get
+   * a consistent value for each field, but not necessarily a consistent
+   * snapshot across fields.
+   */
+  class StreamStatistics {
+  public:
+    StreamStatistics();
+
+    static int64_t now() {
+      timespec ts;
+      clock_gettime(CLOCK_MONOTONIC, &ts);
+      return static_cast<int64_t>(ts.tv_sec) * 1000000000LL + ts.tv_nsec;
+    }
+
+    // Set the nominal period and the number of periods of output queued
+    // ahead of the callback. An interval longer than the queue means the
+    // output ran dry.
+    void configure(int64_t periodNs, unsigned int queuedPeriods);
+
+    // Audio thread only: the queue has changed depth since configure().
+    void setQueuedPeriods(unsigned int queuedPeriods);
+
+    // Forget the previous callback time, so that the gap across a stop and
+    // restart isn't counted as an underrun. Only call while the stream is
+    // not running.
+    void reset() { lastCallbackNs_.store(0, std::memory_order_relaxed); }
+
+    // Audio thread only.
+    void callbackStarted(int64_t startNs);
+    void callbackFinished(int64_t startNs, int64_t endNs);
+    void missedRecordBuffer() { increment(missedRecordBuffers_); }
+    void captureOverflow() { increment(captureOverflows_); }
+    void reportOverflow() { increment(reportOverflows_); }
+
+    // Audio thread only: a callback that produced nothing, so it isn't
+    // counted, but the next interval should still be measured from it.
+    void callbackSkipped(int64_t nowNs) {
+      lastCallbackNs_.store(nowNs, std::memory_order_relaxed);
+    }
+
+    // Audio thread only: a period that skipped the callback because the
+    // stream was idle. It isn't a callback either, but its duration is
+    // what the audio thread's performance hints should see.
+    void periodIdle(int64_t startNs, int64_t endNs) {
+      callbackSkipped(startNs);
+      lastDurationNs_ = endNs - startNs;
+      increment(idlePeriods_);
+    }
+
+    // Audio thread only. The interval is zero for the first callback after
+    // a reset.
+    uint32_t underrunCount() const {
+      return underruns_.load(std::memory_order_relaxed);
+    }
+    int64_t lastIntervalNs() const { return lastIntervalNs_; }
+    int64_t lastDurationNs() const { return lastDurationNs_; }
+
+    // Fills in everything except parameterContentionCount, which the
+    // parameter pipe keeps, and the duplex synchronizer's fields.
+    void read(HowieStreamStatistics *dest) const;
+
+  private:
+    std::atomic<int64_t> periodNs_ {0};
+    uint32_t bucketWidthNs_ = 1;
+    int64_t underrunThresholdNs_ = 0;
+
+    std::atomic<int64_t> lastCallbackNs_ {0};
+    int64_t lastIntervalNs_ = 0;
+    int64_t lastDurationNs_ = 0;
+    std::atomic<uint64_t> callbackCount_ {0};
+    std::atomic<int64_t> maxCallbackDurationNs_ {0};
+    std::atomic<uint32_t> durationHistogram_[HOWIE_STATISTICS_BUCKET_COUNT];
+    std::atomic<uint32_t> intervalHistogram_[HOWIE_STATISTICS_BUCKET_COUNT];
+    std::atomic<uint32_t> underruns_ {0};
+    std::atomic<uint32_t> missedRecordBuffers_ {0};
+    std::atomic<uint32_t> captureOverflows_ {0};
+    std::atomic<uint32_t> reportOverflows_ {0};
+    std::atomic<uint64_t> idlePeriods_ {0};
+
+    template <typename T>
+    static void increment(std::atomic<T> &counter) {
+      counter.store(counter.load(std::memory_order_relaxed) + 1,
+                    std::memory_order_relaxed);
+    }
+
+    unsigned int bucket(int64_t ns) const;
+  };
+
+} // namespace howie
+
+#endif // HOWIE_STREAMSTATISTICS_H
@@ -0,0 +1,378 @@
+/*
+ * Copyright 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#include "StreamingSource.h"
+#include <algorithm>
+#include <climits>
+#include <cstring>
+#include <errno.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <android/log.h>
+#include "futex.h"
+#include "howie-private.h"
+
+namespace {
+  size_t ringFrames(const HowieSourceParams &params) {
+    return params.prefetchFrames > 0
+           ? params.prefetchFrames
+           : howie::StreamingSource::kDefaultPrefetchFrames;
+  }
+
+  size_t chunkFrames(const HowieSourceParams &params) {
+    return std::max<size_t>(ringFrames(params) / 4, 1);
+  }
+
+  // The prefetch thread leaves up to a chunk of the ring empty, so a
+  // window bigger than the rest would never fill.
+  size_t seekPrefetchFrames(const HowieSourceParams &params) {
+    size_t limit = ringFrames(params) - chunkFrames(params);
+    return params.seekPrefetchFrames > 0
+           ? std::min(params.seekPrefetchFrames, limit)
+           : std::min(ringFrames(params) / 4, limit);
+  }
+} // namespace
+
+/**
+ * Implements the C interface for streaming sources
+ */
+HowieError HowieSourceCreate(const HowieSourceParams *params,
+                             HowieSource **source) {
+  HOWIE_TRACE_FN(HOWIE_TRACE_LEVEL_CALLS)
+  HOWIE_CHECK_NOT_NULL(params);
+  HOWIE_CHECK_NOT_NULL(source);
+  *source = nullptr;
+
+  // The ring is indexed with int, and needs headroom to tell full from
+  // empty.
+  if (params->fd < 0 || params->offset < 0 || params->bytesPerFrame == 0
+      || params->length < static_cast<int64_t>(params->bytesPerFrame)
+      || ringFrames(*params) > INT_MAX / 2 / params->bytesPerFrame) {
+    HOWIE_CHECK(HOWIE_ERROR_INVALID_PARAMETER);
+  }
+
+  howie::StreamingSource *pSource = new howie::StreamingSource(*params);
+  HowieError result = pSource->open(*params);
+  if (!HOWIE_SUCCEEDED(result)) {
+    delete pSource;
+    HOWIE_CHECK(result);
+  }
+  *source = pSource;
+  return HOWIE_SUCCESS;
+}
+
+HowieError HowieSourceDestroy(HowieSource *source) {
+  HOWIE_TRACE_FN(HOWIE_TRACE_LEVEL_CALLS)
+  HOWIE_CHECK(howie::checkCast<const howie::StreamingSource*>(source));
+  delete static_cast<howie::StreamingSource *>(source);
+  return HOWIE_SUCCESS;
+}
+
+HowieError HowieSourceRead(HowieSource *source,
+                           void *dest,
+                           size_t frameCount,
+                           size_t *framesRead) {
+  HOWIE_TRACE_FN(HOWIE_TRACE_LEVEL_REALTIME)
+  if (!source || !dest || !framesRead) {
+    return HOWIE_ERROR_NULL;
+  }
+  HowieError result = howie::checkCast<const howie::StreamingSource*>(source);
+  if (HOWIE_SUCCEEDED(result)) {
+    *framesRead = static_cast<howie::StreamingSource *>(source)->read(
+        dest, frameCount);
+    if (*framesRead < frameCount) {
+      result = HOWIE_ERROR_AGAIN;
+    }
+  }
+  return result;
+}
+
+HowieError HowieSourceSeek(HowieSource *source, int64_t frame) {
+  HOWIE_TRACE_FN(HOWIE_TRACE_LEVEL_CALLS)
+  HOWIE_CHECK(howie::checkCast<const howie::StreamingSource*>(source));
+  if (frame < 0) {
+    HOWIE_CHECK(HOWIE_ERROR_INVALID_PARAMETER);
+  }
+  static_cast<howie::StreamingSource *>(source)->seek(frame);
+  return HOWIE_SUCCESS;
+}
+
+HowieError HowieSourceGetStatus(const HowieSource *source,
+                                HowieSourceStatus *status) {
+  HOWIE_TRACE_FN(HOWIE_TRACE_LEVEL_CALLS)
+  HOWIE_CHECK_NOT_NULL(status);
+  HOWIE_CHECK(howie::checkCast<const howie::StreamingSource*>(source));
+  static_cast<const howie::StreamingSource *>(source)->getStatus(status);
+  return HOWIE_SUCCESS;
+}
+
+namespace howie {
+
+  constexpr size_t StreamingSource::kDefaultPrefetchFrames;
+
+  StreamingSource::StreamingSource(const HowieSourceParams &params)
+      : bytesPerFrame_(params.bytesPerFrame),
+        frameCount_(params.length
+                    / static_cast<int64_t>(params.bytesPerFrame)),
+        ring_(static_cast<int>(ringFrames(params) * params.bytesPerFrame)),
+        seekPrefetchBytes_(seekPrefetchFrames(params) * params.bytesPerFrame),
+        chunkBytes_(chunkFrames(params) * params.bytesPerFrame) {
+    version = sizeof(*this);
+  }
+
+  StreamingSource::~StreamingSource() {
+    if (thread_) {
+      cancelled_.store(true, std::memory_order_relaxed);
+      wake(true);
+      thread_->join();
+    }
+    if (map_) {
+      munmap(map_, mapLength_);
+    }
+    if (fd_ >= 0) {
+      close(fd_);
+    }
+  }
+
+  HowieError StreamingSource::open(const HowieSourceParams &params) {
+    fd_ = dup(params.fd);
+    if (fd_ < 0) {
+      __android_log_print(ANDROID_LOG_WARN, kLibName,
+                          "%s: dup failed: %s", __func__, strerror(errno));
+      return HOWIE_ERROR_IO;
+    }
+    offset_ = params.offset;
+    length_ = frameCount_ * static_cast<int64_t>(bytesPerFrame_);
+
+    // Touching a mapping past the end of the file raises SIGBUS, so only
+    // map data that's all there; pread reports the shortfall instead.
+    struct stat64 fileStat;
+    if (params.useMmap && fstat64(fd_, &fileStat) == 0
+        && fileStat.st_size >= offset_ + length_) {
+      // Mappings start on a page boundary, which the data may not.
+      int64_t page = sysconf(_SC_PAGESIZE);
+      int64_t start = offset_ - offset_ % page;
+      mapLength_ = static_cast<size_t>(offset_ - start + length_);
+      map_ = mmap64(nullptr, mapLength_, PROT_READ, MAP_PRIVATE, fd_, start);
+      if (map_ == MAP_FAILED) {
+        // Not fatal: pread works on anything mmap does.
+        __android_log_print(ANDROID_LOG_WARN, kLibName,
+                            "%s: mmap failed, using pread: %s",
+                            __func__, strerror(errno));
+        map_ = nullptr;
+      } else {
+        madvise(map_, mapLength_, MADV_SEQUENTIAL);
+        mappedData_ = static_cast<const unsigned char *>(map_)
+                      + (offset_ - start);
+      }
+    }
+
+    thread_.reset(new std::thread([this] { threadFn(); }));
+    return HOWIE_SUCCESS;
+  }
+
+  size_t StreamingSource::read(void *dest, size_t frameCount) {
+    unsigned char *bytes = static_cast<unsigned char *>(dest);
+    size_t wanted = frameCount * bytesPerFrame_;
+    size_t copied = 0;
+
+    // The acquire pairs with the prefetch thread's release, after its last
+    // push for the old generation, so discarding catches all of that.
+    uint32_t generation = fetchGeneration_.load(std::memory_order_acquire);
+    if (generation != readGeneration_) {
+      discardRing();
+      readGeneration_ = generation;
+      position_.store(fetchFrame_.load(std::memory_order_relaxed),
+                      std::memory_order_relaxed);
+      endOfSource_.store(false, std::memory_order_relaxed);
+      filling_ = true;
+      ackGeneration_.store(generation, std::memory_order_release);
+      wake(true);
+    }
+
+    // Loaded before taking anything out, so that a short read with this
+    // set really did reach the end.
+    bool ended = endGeneration_.load(std::memory_order_acquire)
+                 == readGeneration_;
+    if (filling_ && (ended || ring_.size() >= seekPrefetchBytes_)) {
+      filling_ = false;
+    }
+    if (!filling_) {
+      copied = ring_.pop_n(wanted, [&](
+          unsigned char *first, size_t firstCount,
+          unsigned char *second, size_t secondCount) -> size_t {
+        memcpy(bytes, first, firstCount);
+        memcpy(bytes + firstCount, second, secondCount);
+        return firstCount + secondCount;
+      });
+      position_.store(position_.load(std::memory_order_relaxed)
+                      + static_cast<int64_t>(copied / bytesPerFrame_),
+                      std::memory_order_relaxed);
+      if (copied < wanted) {
+        if (ended) {
+          endOfSource_.store(true, std::memory_order_relaxed);
+        } else {
+          underruns_.fetch_add(1, std::memory_order_relaxed);
+        }
+      }
+      wake(false);
+    }
+    memset(bytes + copied, 0, wanted - copied);
+    return copied / bytesPerFrame_;
+  }
+
+  void StreamingSource::seek(int64_t frame) {
+    seekFrame_.store(frame, std::memory_order_relaxed);
+    seekGeneration_.fetch_add(1, std::memory_order_release);
+    wake(true);
+  }
+
+  void StreamingSource::getStatus(HowieSourceStatus *status) const {
+    status->version = sizeof(*status);
+    status->position = position_.load(std::memory_order_relaxed);
+    status->frameCount = frameCount_;
+    status->underrunCount = underruns_.load(std::memory_order_relaxed);
+    status->endOfSource = endOfSource_.load(std::memory_order_relaxed);
+    status->ioError = ioError_.load(std::memory_order_relaxed);
+  }
+
+  void StreamingSource::threadFn() {
+    uint32_t generation = 0;
+    bool acknowledged = true;
+    int64_t next = 0;
+
+    for (;;) {
+      // Read before looking for work, cancellation included, so a wake-up
+      // that comes after the look makes the sleep below return at once.
+      int wakeups = wakeups_.load(std::memory_order_seq_cst);
+      if (cancelled_.load(std::memory_order_relaxed)) {
+        break;
+      }
+
+      uint32_t seekGeneration = seekGeneration_.load(std::memory_order_acquire);
+      if (seekGeneration != generation) {
+        generation = seekGeneration;
+        int64_t frame = std::min(seekFrame_.load(std::memory_order_relaxed),
+                                 frameCount_);
+        next = frame * static_cast<int64_t>(bytesPerFrame_);
+        fetchFrame_.store(frame, std::memory_order_relaxed);
+        fetchGeneration_.store(generation, std::memory_order_release);
+        acknowledged = false;
+      }
+      if (!acknowledged) {
+        // Anything pushed now could be thrown away with the old data.
+        acknowledged = ackGeneration_.load(std::memory_order_acquire)
+                       == generation;
+        if (!acknowledged) {
+          sleep(wakeups);
+          continue;
+        }
+      }
+
+      int64_t remaining = length_ - next;
+      if (remaining <= 0) {
+        endGeneration_.store(generation, std::memory_order_release);
+        sleep(wakeups);
+        continue;
+      }
+
+      // Only read once there's room for a whole chunk, or the rest of the
+      // data, so the reads stay large.
+      size_t want = static_cast<size_t>(
+          std::min<int64_t>(remaining, static_cast<int64_t>(chunkBytes_)));
+      bool failed = false;
+      size_t pushed = ring_.push_n(want, [&](
+          unsigned char *first, size_t firstCount,
+          unsigned char *second, size_t secondCount) -> size_t {
+        if (firstCount + secondCount < want) {
+          return 0;
+        }
+        size_t got = fetch(first, firstCount, next);
+        if (got == firstCount && secondCount > 0) {
+          got += fetch(second, secondCount, next + firstCount);
+        }
+        failed = got < want;
+        return got - got % bytesPerFrame_;
+      });
+      next += static_cast<int64_t>(pushed);
+      if (failed) {
+        // Whatever was read is in; the data ends here from now on.
+        length_ = next;
+      } else if (pushed == 0) {
+        sleep(wakeups);
+      }
+    }
+  }
+
+  size_t StreamingSource::fetch(unsigned char *dest,
+                                size_t size,
+                                int64_t position) {
+    if (mappedData_) {
+      memcpy(dest, mappedData_ + position, size);
+      return size;
+    }
+    size_t done = 0;
+    while (done < size) {
+      ssize_t count = pread64(fd_, dest + done, size - done,
+                              offset_ + position
+                              + static_cast<int64_t>(done));
+      if (count < 0 && errno == EINTR) {
+        continue;
+      }
+      if (count <= 0) {
+        // An error, or the file is shorter than the source was told.
+        __android_log_print(ANDROID_LOG_WARN, kLibName,
+                            "%s: read failed at %lld: %s", __func__,
+                            static_cast<long long>(position + done),
+                            count < 0 ? strerror(errno) : "end of file");
+        ioError_.store(true, std::memory_order_relaxed);
+        break;
+      }
+      done += static_cast<size_t>(count);
+    }
+    return done;
+  }
+
+  void StreamingSource::sleep(int wakeups) {
+    fetcherWaiting_.store(true, std::memory_order_seq_cst);
+    futexWait(&wakeups_, wakeups);
+    fetcherWaiting_.store(false, std::memory_order_relaxed);
+  }
+
+  /**
+   * Always counts a wake-up, which is cheap, but only makes the syscall if
+   * the prefetch thread is asleep and, unless always is set, there's room
+   * for it to read a whole chunk. Both sides are seq_cst, so either the
+   * thread sees the new count before it waits, or this sees it waiting.
+   */
+  void StreamingSource::wake(bool always) {
+    wakeups_.fetch_add(1, std::memory_order_seq_cst);
+    if (fetcherWaiting_.load(std::memory_order_seq_cst)
+        && (always || ring_.capacity() - ring_.size() >= chunkBytes_)) {
+      futexWake(&wakeups_, 1);
+    }
+  }
+
+  void StreamingSource::discardRing() {
+    ring_.pop_n(ring_.capacity(), [](
+        unsigned char *, size_t firstCount,
+        unsigned char *, size_t secondCount) -> size_t {
+      return firstCount + secondCount;
+    });
+  }
+
+} // namespace howie
@@ -0,0 +1,125 @@
+/*
+ * Copyright 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#ifndef HOWIE_STREAMINGSOURCE_H
+#define HOWIE_STREAMINGSOURCE_H
+
+#include <atomic>
+#include <memory>
+#include <stdint.h>
+#include <thread>
+#include "../howie.h"
+#include "CacheAligned.h"
+#include "Ringbuffer.h"
+
+namespace howie {
+
+  /**
+   * Plays sample data from a file descriptor through a byte ring.
+   *
+   * A prefetch thread of the source's own keeps the ring topped up, with
+   * pread() or by copying out of a mapping. The audio thread takes frames
+   * out with read(), which only ever copies out of the ring. The prefetch
+   * thread sleeps on a futex when the ring is full, and the reader only
+   * makes the wake-up syscall once there's a good chunk of room and the
+   * thread is actually asleep.
+   *
+   * Seeking is a handshake, because only the reader can empty the ring.
+   * seek() bumps a generation. The prefetch thread stops reading for the
+   * old position and publishes the generation it's switched to. The
+   * reader then drops everything in the ring, which can only be data for
+   * the old position, and acknowledges. Only then does the prefetch thread
+   * start filling from the new one.
+   */
+  class StreamingSource : public HowieSource, public CacheAligned {
+  public:
+    static constexpr size_t kDefaultPrefetchFrames = 32768;
+
+    // Doesn't touch the file; open() does.
+    explicit StreamingSource(const HowieSourceParams &params);
+    ~StreamingSource();
+
+    // Dups the descriptor, maps the data if asked to, and starts the
+    // prefetch thread.
+    HowieError open(const HowieSourceParams &params);
+
+    // Audio thread only. Returns the number of frames copied, and zeroes
+    // the rest of dest.
+    size_t read(void *dest, size_t frameCount);
+
+    // Any thread.
+    void seek(int64_t frame);
+    void getStatus(HowieSourceStatus *status) const;
+
+  private:
+    const size_t bytesPerFrame_;
+    const int64_t frameCount_;
+    Ringbuffer<unsigned char> ring_;
+    const size_t seekPrefetchBytes_;
+
+    // The prefetch thread reads in chunks of this, and the reader wakes it
+    // once there's this much room.
+    const size_t chunkBytes_;
+
+    int fd_ = -1;
+    int64_t offset_ = 0;
+    int64_t length_ = 0;
+
+    // The mapping, if there is one, and where the data starts in it.
+    void *map_ = nullptr;
+    size_t mapLength_ = 0;
+    const unsigned char *mappedData_ = nullptr;
+
+    std::unique_ptr<std::thread> thread_;
+    std::atomic<bool> cancelled_ {false};
+
+    // Seek requests, from any thread.
+    std::atomic<int64_t> seekFrame_ {0};
+    std::atomic<uint32_t> seekGeneration_ {0};
+
+    // The prefetch thread's side of the handshake: the generation it's
+    // reading for, the frame that generation started at, and the last
+    // generation it read to the end of the data.
+    std::atomic<uint32_t> fetchGeneration_ {0};
+    std::atomic<int64_t> fetchFrame_ {0};
+    std::atomic<uint32_t> endGeneration_ {~0u};
+    std::atomic<bool> ioError_ {false};
+
+    // The reader's side. readGeneration_ is its own copy of ackGeneration_.
+    std::atomic<uint32_t> ackGeneration_ {0};
+    uint32_t readGeneration_ = 0;
+    bool filling_ = true;
+
+    // Futex word for the prefetch thread's sleeps, bumped by everything
+    // that might give it work.
+    alignas(CACHE_ALIGN) std::atomic<int> wakeups_ {0};
+    std::atomic<bool> fetcherWaiting_ {false};
+
+    // For getStatus.
+    std::atomic<int64_t> position_ {0};
+    std::atomic<uint32_t> underruns_ {0};
+    std::atomic<bool> endOfSource_ {false};
+
+    void threadFn();
+    size_t fetch(unsigned char *dest, size_t size, int64_t position);
+    void sleep(int wakeups);
+    void wake(bool always);
+    void discardRing();
+  };
+
+} // namespace howie
+
+#endif // HOWIE_STREAMINGSOURCE_H
@@ -0,0 +1,84 @@
+/*
+ * Copyright 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#include "Trace.h"
+#include <dlfcn.h>
+#include <mutex>
+#include <android/log.h>
+#include "howie-private.h"
+
+/**
+ * Implements the C interface for selecting a trace backend
+ */
+HowieError HowieSetTraceBackend(HowieTraceBackend backend) {
+  if (backend != HOWIE_TRACE_BACKEND_NONE
+      && backend != HOWIE_TRACE_BACKEND_ATRACE) {
+    return HOWIE_ERROR_INVALID_PARAMETER;
+  }
+  return howie::Trace::setBackend(backend) ? HOWIE_SUCCESS
+                                           : HOWIE_ERROR_UNSUPPORTED;
+}
+
+namespace howie {
+
+  std::atomic<bool> Trace::active_ {false};
+  void (*Trace::beginSection_)(const char *) = nullptr;
+  void (*Trace::endSection_)() = nullptr;
+  bool (*Trace::isEnabled_)() = nullptr;
+  void (*Trace::setCounter_)(const char *, int64_t) = nullptr;
+
+  /**
+   * Look up the ATrace entry points. libandroid is never closed, so the
+   * pointers stay valid for the life of the process once they're set.
+   */
+  bool Trace::load() {
+    static std::once_flag once;
+    static bool loaded = false;
+    std::call_once(once, [] {
+      void *lib = dlopen("libandroid.so", RTLD_NOW | RTLD_LOCAL);
+      if (!lib) {
+        __android_log_print(ANDROID_LOG_WARN, kLibName,
+                            "ATrace unavailable: %s", dlerror());
+        return;
+      }
+      beginSection_ = reinterpret_cast<void (*)(const char *)>(
+          dlsym(lib, "ATrace_beginSection"));
+      endSection_ = reinterpret_cast<void (*)()>(
+          dlsym(lib, "ATrace_endSection"));
+      isEnabled_ = reinterpret_cast<bool (*)()>(
+          dlsym(lib, "ATrace_isEnabled"));
+      // Only present from API 29 on.
+      setCounter_ = reinterpret_cast<void (*)(const char *, int64_t)>(
+          dlsym(lib, "ATrace_setCounter"));
+      loaded = beginSection_ && endSection_ && isEnabled_;
+      if (!loaded) {
+        __android_log_write(ANDROID_LOG_WARN, kLibName,
+                            "ATrace unavailable on this API level");
+      }
+    });
+    return loaded;
+  }
+
+  bool Trace::setBackend(HowieTraceBackend backend) {
+    if (backend == HOWIE_TRACE_BACKEND_ATRACE && !load()) {
+      return false;
+    }
+    active_.store(backend == HOWIE_TRACE_BACKEND_ATRACE,
+                  std::memory_order_release);
+    return true;
+  }
+
+} // namespace howie
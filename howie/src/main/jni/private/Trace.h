@@ -0,0 +1,104 @@
+/*
+ * Copyright 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#ifndef HOWIE_TRACE_H
+#define HOWIE_TRACE_H
+
+#include <atomic>
+#include <stdint.h>
+#include "../howie.h"
+
+namespace howie {
+
+  /**
+   * Emits systrace sections and counters through ATrace, so that the audio
+   * thread shows up in Perfetto and systrace captures.
+   *
+   * The ATrace functions were only added to the NDK in API 23 (counters in
+   * API 29), so they are looked up in libandroid at runtime rather than
+   * linked. Until the backend is selected, every trace point is a single
+   * relaxed load and a branch.
+   */
+  class Trace {
+  public:
+    // Not realtime safe: may dlopen libandroid. Returns false if ATrace
+    // isn't available on this device.
+    static bool setBackend(HowieTraceBackend backend);
+
+    static bool enabled() {
+      return active_.load(std::memory_order_acquire);
+    }
+
+    // True if a capture is actually running, which is the time to go to
+    // any trouble computing a counter value.
+    static bool capturing() {
+      return enabled() && isEnabled_();
+    }
+
+    // Returns true if a section was begun, in which case the caller must
+    // end it, even if the backend has been switched off in the meantime.
+    static bool beginSection(const char *name) {
+      if (!enabled()) {
+        return false;
+      }
+      beginSection_(name);
+      return true;
+    }
+
+    static void endSection() { endSection_(); }
+
+    static void setCounter(const char *name, int64_t value) {
+      if (enabled() && setCounter_) {
+        setCounter_(name, value);
+      }
+    }
+
+  private:
+    static std::atomic<bool> active_;
+    static void (*beginSection_)(const char *);
+    static void (*endSection_)();
+    static bool (*isEnabled_)();
+    static void (*setCounter_)(const char *, int64_t);
+
+    static bool load();
+  };
+
+  /**
+   * Traces the enclosing scope as a section. The section is only ended if
+   * it was begun, so switching the backend mid-scope can't unbalance the
+   * trace.
+   */
+  class TraceScope {
+  public:
+    explicit TraceScope(const char *name)
+        : active_(Trace::beginSection(name)) {}
+
+    ~TraceScope() {
+      if (active_) {
+        Trace::endSection();
+      }
+    }
+
+    TraceScope(const TraceScope &) = delete;
+    TraceScope &operator=(const TraceScope &) = delete;
+
+  private:
+    const bool active_;
+  };
+
+} // namespace howie
+
+#endif // HOWIE_TRACE_H
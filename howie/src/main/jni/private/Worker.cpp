@@ -3,27 +3,118 @@
 //
 
 #include "Worker.h"
+#include <algorithm>
+#include <chrono>
 
-Worker::Worker(int queueLength) : queue_(queueLength){
+void Task::take(Task &other) {
+  if (other.invoke_) {
+    other.relocate_(storage_, other.storage_);
+    invoke_ = other.invoke_;
+    relocate_ = other.relocate_;
+    other.invoke_ = nullptr;
+    other.relocate_ = nullptr;
+  }
+}
+
+void Task::reset() {
+  if (invoke_) {
+    relocate_(nullptr, storage_);
+    invoke_ = nullptr;
+    relocate_ = nullptr;
+  }
+}
+
+Worker::Worker(size_t initialLength, size_t maxLength)
+    : queue_(std::max<size_t>(initialLength, 1)),
+      maxLength_(std::max(initialLength, maxLength)) {
   thread_.reset(new std::thread([this]{threadFn();}));
+  threadId_ = thread_->get_id();
 }
 
 Worker::~Worker() {
+  // The cancel task can't be turned away for lack of space, because the
+  // queue is allowed to grow past its limit for it.
+  {
+    std::lock_guard<std::mutex> lock(mu_);
+    maxLength_ = std::max(maxLength_, count_ + 1);
+  }
   push_work([this]{cancelled_ = true;});
+  thread_->join();
 }
 
-bool Worker::push_work(const Worker::work_item_t &item) {
-  bool result = queue_.push(item);
-  if (result) {
-    sem_.signal();
+/**
+ * Make room for needed tasks in total. Call with mu_ held.
+ */
+bool Worker::grow(size_t needed) {
+  if (needed <= queue_.size()) {
+    return true;
   }
-  return result;
+  if (needed > maxLength_) {
+    return false;
+  }
+  size_t length = queue_.size();
+  while (length < needed) {
+    length *= 2;
+  }
+  std::vector<work_item_t> queue(std::min(length, maxLength_));
+  for (size_t i = 0; i < count_; ++i) {
+    queue[i] = std::move(queue_[(head_ + i) % queue_.size()]);
+  }
+  queue_.swap(queue);
+  head_ = 0;
+  return true;
+}
+
+bool Worker::push_work(Worker::work_item_t item, ticket_t *ticket) {
+  return push_work(&item, 1, ticket);
+}
+
+bool Worker::push_work(Worker::work_item_t *items,
+                       size_t count,
+                       ticket_t *ticket) {
+  {
+    std::lock_guard<std::mutex> lock(mu_);
+    if (!grow(count_ + count)) {
+      return false;
+    }
+    for (size_t i = 0; i < count; ++i) {
+      queue_[(head_ + count_) % queue_.size()] = std::move(items[i]);
+      ++count_;
+    }
+    submitted_ += count;
+    if (ticket) {
+      *ticket = submitted_;
+    }
+  }
+  sem_.signal(static_cast<int>(count));
+  return true;
+}
+
+Worker::ticket_t Worker::lastTicket() {
+  std::lock_guard<std::mutex> lock(mu_);
+  return submitted_;
+}
+
+bool Worker::wait(ticket_t ticket, int timeoutMs) {
+  std::unique_lock<std::mutex> lock(mu_);
+  auto done = [&] { return completed_ >= ticket; };
+  if (timeoutMs < 0) {
+    done_.wait(lock, done);
+    return true;
+  }
+  return done_.wait_for(lock, std::chrono::milliseconds(timeoutMs), done);
 }
 
 bool Worker::pop_work(Worker::work_item_t *out_item) {
   bool result = false;
   sem_.wait();
-  result = queue_.pop(out_item);
+  std::lock_guard<std::mutex> lock(mu_);
+  if (count_ > 0) {
+    *out_item = std::move(queue_[head_]);
+    head_ = (head_ + 1) % queue_.size();
+    --count_;
+    result = true;
+  }
   return result;
 }
 
@@ -32,6 +123,11 @@ void Worker::threadFn() {
     work_item_t item;
     if (pop_work(&item)) {
       item();
+      {
+        std::lock_guard<std::mutex> lock(mu_);
+        ++completed_;
+      }
+      done_.notify_all();
     }
   }
 }
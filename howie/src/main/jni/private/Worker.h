@@ -6,26 +6,129 @@
 #define HPA_WORKQUEUE_H
 
 
-#include <functional>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <new>
 #include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
 #include "Sempahore.h"
-#include "Ringbuffer.h"
 
+// A callable stored inline. Unlike std::function, creating one never
+// allocates; a callable that doesn't fit is a compile error.
+class Task {
+public:
+  // Big enough for the stream creation tasks in EngineImpl, which capture
+  // a HowieStreamCreationParams by value plus the engine and stream
+  // pointers: on 64-bit ABIs that's 160 + 16 bytes, with the rest left for
+  // new creation parameters. A capture that outgrows it fails the
+  // static_assert below rather than allocating.
+  static constexpr size_t kCapacity = 192;
+
+  Task() {}
+
+  template <typename F,
+            typename = typename std::enable_if<
+                !std::is_same<typename std::decay<F>::type, Task>::value
+            >::type>
+  Task(F fn) {
+    static_assert(sizeof(F) <= kCapacity, "Task capture is too big");
+    static_assert(alignof(F) <= alignof(std::max_align_t),
+                  "Task capture is overaligned");
+    new (storage_) F(std::move(fn));
+    invoke_ = [](void *f) { (*static_cast<F *>(f))(); };
+    relocate_ = [](void *dest, void *src) {
+      F *f = static_cast<F *>(src);
+      if (dest) {
+        new (dest) F(std::move(*f));
+      }
+      f->~F();
+    };
+  }
+
+  Task(Task &&other) { take(other); }
+  Task &operator=(Task &&other) {
+    if (this != &other) {
+      reset();
+      take(other);
+    }
+    return *this;
+  }
+  Task(const Task &) = delete;
+  Task &operator=(const Task &) = delete;
+
+  ~Task() { reset(); }
+
+  void operator()() { invoke_(storage_); }
+  explicit operator bool() const { return invoke_ != nullptr; }
+
+private:
+  alignas(std::max_align_t) unsigned char storage_[kCapacity];
+  void (*invoke_)(void *) = nullptr;
+  // Moves the callable from src to dest, or just destroys it if dest is
+  // null.
+  void (*relocate_)(void *dest, void *src) = nullptr;
+
+  void take(Task &other);
+  void reset();
+};
+
+// Runs tasks in order on a thread of its own.
+//
+// Any number of threads can submit tasks. The queue starts out
+// initialLength tasks long and doubles whenever it fills up, to at most
+// maxLength; that only allocates while it grows. Every task gets a ticket,
+// numbered in the order the tasks will run, which can be waited on.
 class Worker {
 public:
-  Worker(int queueLength);
+  typedef uint64_t ticket_t;
+
+  Worker(size_t initialLength, size_t maxLength);
   ~Worker();
 
-  typedef std::function<void ()> work_item_t;
+  typedef Task work_item_t;
+
+  // Queues a task, or all of count tasks at once, waking the worker once.
+  // Returns false if the queue is full, in which case nothing is queued.
+  // On success, *ticket (if given) is the ticket of the last task queued.
+  bool push_work(work_item_t item, ticket_t *ticket = nullptr);
+  bool push_work(work_item_t *items, size_t count, ticket_t *ticket = nullptr);
 
-  bool push_work(const work_item_t& item);
+  // The ticket of the most recently queued task; the first task queued
+  // gets ticket 1.
+  ticket_t lastTicket();
+
+  // Blocks until the task with the given ticket, and everything before it,
+  // has run. Returns false on timeout; a negative timeout waits forever.
+  bool wait(ticket_t ticket, int timeoutMs);
+
+  // True on the worker's own thread, where waiting on a ticket would never
+  // return.
+  bool isWorkerThread() const {
+    return std::this_thread::get_id() == threadId_;
+  }
 
 private:
-  Ringbuffer<work_item_t> queue_;
+  std::mutex mu_;
+  std::vector<work_item_t> queue_;
+  size_t head_ = 0;
+  size_t count_ = 0;
+  size_t maxLength_;
+  ticket_t submitted_ = 0;
+
+  // completed_ only changes under mu_, so waiters can use done_.
+  ticket_t completed_ = 0;
+  std::condition_variable done_;
+
   Sempahore sem_;
   std::unique_ptr<std::thread> thread_;
-  std::atomic<bool> cancelled_ {false};
+  std::thread::id threadId_;
+  bool cancelled_ = false;
 
+  bool grow(size_t needed);
   bool pop_work(work_item_t* out_item);
   void threadFn();
 };
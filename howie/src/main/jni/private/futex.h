@@ -0,0 +1,45 @@
+/*
+ * Copyright 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#ifndef HOWIE_FUTEX_H
+#define HOWIE_FUTEX_H
+
+#include <atomic>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+namespace howie {
+
+  // Sleep until word is woken, unless it no longer holds expected. A null
+  // timeout waits forever. Spurious wake-ups are possible, so callers
+  // re-check their condition in a loop.
+  inline void futexWait(std::atomic<int> *word, int expected,
+                        const timespec *timeout = nullptr) {
+    syscall(__NR_futex, reinterpret_cast<int *>(word), FUTEX_WAIT_PRIVATE,
+            expected, timeout, nullptr, 0);
+  }
+
+  // Never blocks, so it's safe to call from an audio thread.
+  inline void futexWake(std::atomic<int> *word, int count) {
+    syscall(__NR_futex, reinterpret_cast<int *>(word), FUTEX_WAKE_PRIVATE,
+            count, nullptr, nullptr, 0);
+  }
+
+} // namespace howie
+
+#endif // HOWIE_FUTEX_H
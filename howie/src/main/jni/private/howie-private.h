@@ -20,6 +20,8 @@
 #include <type_traits>
 #include "../howie.h"
 #include <android/log.h>
+#include "Trace.h"
+#include "RealtimeLog.h"
 
 constexpr const char * kLibName = "HOWIE";
 
@@ -50,6 +52,25 @@ constexpr const char * kLibName = "HOWIE";
   }                                             \
 }
 
+// Versions of the above for code running on an audio thread, which report
+// failures through a RealtimeLog instead of calling into logd.
+#define HOWIE_CHECK_RT(log, op) {     \
+  auto op_result = howie::check((op));\
+  if (!HOWIE_SUCCEEDED(op_result)) {  \
+      (log).write(ANDROID_LOG_VERBOSE, "%s failed with code %lld", \
+                  __func__, op_result); \
+      return op_result;                 \
+  }                                   \
+}
+
+#define HOWIE_CHECK_NOT_NULL_RT(log, o) {   \
+  if(!(o)) { \
+      (log).write(ANDROID_LOG_VERBOSE, "%s failed null check at line %lld", \
+                  __func__, __LINE__); \
+    return HOWIE_ERROR_NULL; \
+  }\
+}
+
 #define HOWIE_TRACE_LEVEL_NONE        0
 #define HOWIE_TRACE_LEVEL_CALLS       1
 #define HOWIE_TRACE_LEVEL_DIAGNOSTIC  2
@@ -60,30 +81,41 @@ constexpr const char * kLibName = "HOWIE";
 #define HOWIE_TRACE_LEVEL 0
 #endif
 
+// HOWIE_TRACE_LEVEL selects, at compile time, which functions log their
+// name on entry. Logging blocks, so levels from HOWIE_TRACE_LEVEL_REALTIME
+// up will cause glitches. Independently of that, every HOWIE_TRACE_FN is
+// an ATrace section once HowieSetTraceBackend() selects ATrace.
 #if HOWIE_TRACE_LEVEL > HOWIE_TRACE_LEVEL_NONE
 
 #define HOWIE_TRACE(L, S, ...) if (L <= HOWIE_TRACE_LEVEL) { \
   __android_log_print( ANDROID_LOG_VERBOSE, kLibName, \
                     "In %s line %d: " S, __FILE__, __LINE__, __VA_ARGS__)}
 
-#define HOWIE_TRACE_FN(L) if (L <= HOWIE_TRACE_LEVEL) { \
+#define HOWIE_LOG_FN(L) if (L <= HOWIE_TRACE_LEVEL) { \
   __android_log_print( \
   ANDROID_LOG_VERBOSE, kLibName, __func__); }
 #else
 #define HOWIE_TRACE(L, S, ...)
-#define HOWIE_TRACE_FN(L)
+#define HOWIE_LOG_FN(L)
 #endif
 
+#define HOWIE_TRACE_FN(L) \
+  howie::TraceScope howie_trace_scope_(__func__); \
+  HOWIE_LOG_FN(L)
+
 namespace howie {
   HowieError check(SLresult code);
   HowieError check(HowieError err);
 
-  template<typename derived_t>
-  HowieError checkCast(const void* obj) {
+  // obj is converted with static_cast, so that a public base such as
+  // HowieStream is adjusted to the start of the derived object; StreamImpl
+  // is polymorphic, so its HowieStream doesn't start at offset zero.
+  template<typename derived_t, typename base_t>
+  HowieError checkCast(const base_t* obj) {
     HowieError result = HOWIE_SUCCESS;
     if (!obj) {
       result = HOWIE_ERROR_NULL;
-    } else if (reinterpret_cast<derived_t>(obj)->version
+    } else if (static_cast<derived_t>(obj)->version
                != sizeof(typename std::remove_pointer<derived_t>::type)) {
       result = HOWIE_ERROR_INVALID_OBJECT;
     }
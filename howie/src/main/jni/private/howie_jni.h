@@ -43,6 +43,67 @@ Java_com_example_android_howie_HowieEngine_destroy(JNIEnv *env,
                                                    jclass type,
                                                    jlong engine);
 
+// Fills scalars with periodNs, lastCallbackTimeNs, callbackCount,
+// maxCallbackDurationNs, underrunCount, missedRecordBufferCount,
+// parameterContentionCount, captureOverflowCount, inputDriftPpm,
+// inputResyncCount, reportOverflowCount, playbackQueueDepth and
+// idlePeriodCount, in that order. The histogram arrays need
+// HOWIE_STATISTICS_BUCKET_COUNT elements.
+JNIEXPORT jboolean JNICALL
+Java_com_example_android_howie_HowieEngine_getStreamStatistics(
+    JNIEnv *env,
+    jclass type,
+    jlong stream,
+    jlongArray scalars,
+    jintArray durationHistogram,
+    jintArray intervalHistogram);
+
+// Fills the direct ByteBuffer dest, from its start, with as many reports
+// as fit, and returns the number copied. Returns -1 if the stream or the
+// buffer isn't valid.
+JNIEXPORT jint JNICALL
+Java_com_example_android_howie_HowieEngine_receiveReports(
+    JNIEnv *env,
+    jclass type,
+    jlong stream,
+    jobject dest);
+
+// Registers HowieStream's slot methods, which are @CriticalNative where
+// critical is true and ordinary JNI methods otherwise.
+JNIEXPORT jboolean JNICALL
+Java_com_example_android_howie_HowieStream_registerNatives(
+    JNIEnv *env,
+    jclass type,
+    jboolean critical);
+
+// Returns a direct ByteBuffer over all of the stream's parameter slots, or
+// null if the stream isn't valid or has no parameter block.
+JNIEXPORT jobject JNICALL
+Java_com_example_android_howie_HowieStream_parameterStorage(
+    JNIEnv *env,
+    jclass type,
+    jlong stream);
+
+// The distance between slots in parameterStorage, and the size of the
+// parameter block in each; zero if the stream isn't valid.
+JNIEXPORT jint JNICALL
+Java_com_example_android_howie_HowieStream_parameterStride(
+    JNIEnv *env,
+    jclass type,
+    jlong stream);
+JNIEXPORT jint JNICALL
+Java_com_example_android_howie_HowieStream_parameterBlockSize(
+    JNIEnv *env,
+    jclass type,
+    jlong stream);
+
+// The address of a direct ByteBuffer, for passing to @CriticalNative
+// methods, which can't take objects.
+JNIEXPORT jlong JNICALL
+Java_com_example_android_howie_HowieStream_bufferAddress(
+    JNIEnv *env,
+    jclass type,
+    jobject buffer);
 
 #ifdef __cplusplus
 } // extern "C"
@@ -16,8 +16,10 @@
  */
 #include "unique_buffer.h"
 #include <algorithm>
+#include <cstring>
 
 void unique_buffer::reset(size_t size) {
+  external_ = nullptr;
   size_ = size;
   if (size_ > 0) {
     buffer_.reset(new unsigned char[size_]);
@@ -26,16 +28,22 @@ void unique_buffer::reset(size_t size) {
   }
 }
 
+void unique_buffer::reset(unsigned char *external, size_t size) {
+  buffer_.reset(nullptr);
+  external_ = external;
+  size_ = external ? size : 0;
+}
+
 void unique_buffer::clear(unsigned char clear_value) {
-  if (buffer_.get())
-    memset(buffer_.get(), clear_value, size_);
+  if (get())
+    memset(get(), clear_value, size_);
 }
 
 size_t unique_buffer::copy_from(const void *src, size_t size) {
   if (!src) return 0;
 
   size_t actualSize = std::min(size, size_);
-  memcpy(buffer_.get(), src, actualSize);
+  memcpy(get(), src, actualSize);
   return actualSize;
 }
 
@@ -43,7 +51,7 @@ size_t unique_buffer::copy_to(void *dest, size_t size) {
   if (!dest) return 0;
 
   size_t actualSize = std::min(size, size_);
-  memcpy(dest, buffer_.get(), actualSize);
+  memcpy(dest, get(), actualSize);
   return actualSize;
 }
 
@@ -24,14 +24,21 @@ class unique_buffer {
 public:
   unique_buffer() { reset(0); }
   unique_buffer(size_t size) { reset(size); }
+  unique_buffer(unsigned char *external, size_t size) {
+    reset(external, size);
+  }
 
-  unsigned char *get() const { return buffer_.get(); }
+  unsigned char *get() const { return external_ ? external_ : buffer_.get(); }
   size_t size() const { return size_; }
 
   // deletes the previous buffer, if any, and allocates a new one of
   // the specified size.
   void reset(size_t size);
 
+  // deletes the previous buffer, if any, and refers to memory owned by
+  // someone else instead, such as a StreamArena.
+  void reset(unsigned char *external, size_t size);
+
   // Sets every byte in the buffer to the specified value.
   void clear(unsigned char clear_value = 0);
 
@@ -44,7 +51,8 @@ public:
   size_t copy_from(const unique_buffer& other);
 
 private:
-  std::unique_ptr<unsigned char> buffer_;
+  std::unique_ptr<unsigned char[]> buffer_;
+  unsigned char *external_ = nullptr;
   size_t size_;
 };
 
@@ -0,0 +1,99 @@
+/*
+ * Copyright 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#include "CaptureRing.h"
+#include <gtest/gtest.h>
+#include <thread>
+#include <vector>
+
+namespace {
+
+  using howie::CaptureRing;
+
+  TEST(CaptureRingTest, ReadsBackWhatWasWritten) {
+    CaptureRing ring(64);
+    unsigned char src[40];
+    for (size_t i = 0; i < sizeof(src); ++i) {
+      src[i] = static_cast<unsigned char>(i);
+    }
+    ASSERT_TRUE(ring.write(src, sizeof(src)));
+    unsigned char dest[64] = {};
+    ASSERT_EQ(sizeof(src), ring.read(dest, sizeof(dest), 0));
+    EXPECT_EQ(0, memcmp(src, dest, sizeof(src)));
+    EXPECT_EQ(0u, ring.read(dest, sizeof(dest), 0));
+  }
+
+  TEST(CaptureRingTest, DropsWritesThatDontFit) {
+    // Rounded up to 64.
+    CaptureRing ring(48);
+    unsigned char src[40] = {};
+    EXPECT_TRUE(ring.write(src, sizeof(src)));
+    EXPECT_FALSE(ring.write(src, sizeof(src)));
+    EXPECT_TRUE(ring.write(src, 24));
+    unsigned char dest[128];
+    EXPECT_EQ(64u, ring.read(dest, sizeof(dest), 0));
+  }
+
+  TEST(CaptureRingTest, WrapsAround) {
+    CaptureRing ring(64);
+    unsigned char src[24];
+    unsigned char dest[24];
+    for (int round = 0; round < 20; ++round) {
+      memset(src, round, sizeof(src));
+      ASSERT_TRUE(ring.write(src, sizeof(src)));
+      ASSERT_EQ(sizeof(dest), ring.read(dest, sizeof(dest), 0));
+      ASSERT_EQ(0, memcmp(src, dest, sizeof(src)));
+    }
+  }
+
+  TEST(CaptureRingTest, ReadWaitsForData) {
+    CaptureRing ring(1024);
+    std::thread writer([&ring] {
+      std::this_thread::sleep_for(std::chrono::milliseconds(20));
+      int value = 7;
+      ring.write(&value, sizeof(value));
+    });
+    int value = 0;
+    EXPECT_EQ(sizeof(value), ring.read(&value, sizeof(value), -1));
+    EXPECT_EQ(7, value);
+    writer.join();
+  }
+
+  TEST(CaptureRingTest, ReadTimesOut) {
+    CaptureRing ring(1024);
+    int value;
+    EXPECT_EQ(0u, ring.read(&value, sizeof(value), 10));
+  }
+
+  TEST(CaptureRingTest, InterruptReleasesABlockedReader) {
+    CaptureRing ring(1024);
+    size_t result = 1;
+    std::thread reader([&] {
+      int value;
+      result = ring.read(&value, sizeof(value), -1);
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    ring.interrupt();
+    reader.join();
+    EXPECT_EQ(0u, result);
+
+    int value = 0;
+    EXPECT_EQ(0u, ring.read(&value, sizeof(value), -1));
+    ring.resume();
+    EXPECT_EQ(0u, ring.read(&value, sizeof(value), 10));
+  }
+
+} // namespace
@@ -0,0 +1,190 @@
+/*
+ * Copyright 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#include "howie_dsp.h"
+#include <gtest/gtest.h>
+#include <cfloat>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+namespace {
+
+  // Odd lengths throughout, so that both the vector loops and the scalar
+  // tails get used.
+  constexpr size_t kCount = 37;
+
+  std::vector<float> ramp(size_t count, float from, float to) {
+    std::vector<float> samples(count);
+    for (size_t i = 0; i < count; ++i) {
+      samples[i] = from + (to - from) * i / (count - 1);
+    }
+    return samples;
+  }
+
+  TEST(DspTest, Int16RoundTrips) {
+    std::vector<int16_t> src(kCount);
+    for (size_t i = 0; i < kCount; ++i) {
+      src[i] = static_cast<int16_t>(-32768 + static_cast<int>(i) * 1771);
+    }
+    std::vector<float> floats(kCount);
+    std::vector<int16_t> dest(kCount);
+    HowieDspInt16ToFloat(src.data(), floats.data(), kCount);
+    EXPECT_FLOAT_EQ(-1.f, floats[0]);
+    HowieDspFloatToInt16(floats.data(), dest.data(), kCount);
+    EXPECT_EQ(src, dest);
+  }
+
+  TEST(DspTest, Int24RoundTrips) {
+    std::vector<uint8_t> src(kCount * 3);
+    for (size_t i = 0; i < src.size(); ++i) {
+      src[i] = static_cast<uint8_t>(i * 29 + 3);
+    }
+    std::vector<float> floats(kCount);
+    std::vector<uint8_t> dest(kCount * 3);
+    HowieDspInt24ToFloat(src.data(), floats.data(), kCount);
+    HowieDspFloatToInt24(floats.data(), dest.data(), kCount);
+    EXPECT_EQ(src, dest);
+  }
+
+  TEST(DspTest, Int32Converts) {
+    std::vector<int32_t> src(kCount);
+    for (size_t i = 0; i < kCount; ++i) {
+      src[i] = static_cast<int32_t>(i) << 24;
+    }
+    std::vector<float> floats(kCount);
+    std::vector<int32_t> dest(kCount);
+    HowieDspInt32ToFloat(src.data(), floats.data(), kCount);
+    EXPECT_FLOAT_EQ(1.f / 128, floats[1]);
+    HowieDspFloatToInt32(floats.data(), dest.data(), kCount);
+    EXPECT_EQ(src, dest);
+  }
+
+  TEST(DspTest, ConversionsSaturate) {
+    std::vector<float> src = ramp(kCount, -2.f, 2.f);
+    std::vector<int16_t> int16(kCount);
+    std::vector<int32_t> int32(kCount);
+    HowieDspFloatToInt16(src.data(), int16.data(), kCount);
+    HowieDspFloatToInt32(src.data(), int32.data(), kCount);
+    EXPECT_EQ(-32768, int16.front());
+    EXPECT_EQ(32767, int16.back());
+    EXPECT_EQ(std::numeric_limits<int32_t>::min(), int32.front());
+    EXPECT_EQ(std::numeric_limits<int32_t>::max(), int32.back());
+  }
+
+  TEST(DspTest, GainClamps) {
+    std::vector<float> src = ramp(kCount, -1.f, 1.f);
+    std::vector<float> dest(kCount);
+    HowieDspGain(src.data(), dest.data(), 0.5f, kCount);
+    for (size_t i = 0; i < kCount; ++i) {
+      EXPECT_FLOAT_EQ(src[i] * 0.5f, dest[i]);
+    }
+    HowieDspGain(src.data(), dest.data(), 4.f, kCount);
+    EXPECT_FLOAT_EQ(-1.f, dest.front());
+    EXPECT_FLOAT_EQ(1.f, dest.back());
+  }
+
+  TEST(DspTest, MixAccumulates) {
+    std::vector<float> src = ramp(kCount, -1.f, 1.f);
+    std::vector<float> dest(kCount, 0.25f);
+    HowieDspMixAccumulate(src.data(), dest.data(), 0.5f, kCount);
+    for (size_t i = 0; i < kCount; ++i) {
+      EXPECT_FLOAT_EQ(0.25f + src[i] * 0.5f, dest[i]);
+    }
+  }
+
+  TEST(DspTest, Peak) {
+    std::vector<float> src(kCount, 0.f);
+    EXPECT_EQ(0.f, HowieDspPeak(src.data(), 0));
+    src[3] = -0.f;
+    EXPECT_EQ(0.f, HowieDspPeak(src.data(), kCount));
+    src[kCount - 1] = -0.75f;
+    src[5] = 0.5f;
+    EXPECT_FLOAT_EQ(0.75f, HowieDspPeak(src.data(), kCount));
+  }
+
+  TEST(DspTest, IsZero) {
+    std::vector<unsigned char> bytes(kCount * 4, 0);
+    EXPECT_TRUE(HowieDspIsZero(bytes.data(), bytes.size()));
+    bytes.back() = 1;
+    EXPECT_FALSE(HowieDspIsZero(bytes.data(), bytes.size()));
+    EXPECT_TRUE(HowieDspIsZero(bytes.data(), bytes.size() - 1));
+  }
+
+  TEST(DspTest, InterleaveRoundTrips) {
+    const size_t channels = 3;
+    std::vector<float> left = ramp(kCount, 0.f, 1.f);
+    std::vector<float> centre = ramp(kCount, -1.f, 0.f);
+    std::vector<float> right = ramp(kCount, 1.f, -1.f);
+    const float *src[channels] = { left.data(), centre.data(), right.data() };
+    std::vector<float> interleaved(kCount * channels);
+    HowieDspInterleave(src, interleaved.data(), channels, kCount);
+    for (size_t f = 0; f < kCount; ++f) {
+      EXPECT_EQ(left[f], interleaved[f * channels]);
+      EXPECT_EQ(centre[f], interleaved[f * channels + 1]);
+      EXPECT_EQ(right[f], interleaved[f * channels + 2]);
+    }
+    std::vector<float> a(kCount), b(kCount), c(kCount);
+    float *dest[channels] = { a.data(), b.data(), c.data() };
+    HowieDspDeinterleave(interleaved.data(), dest, channels, kCount);
+    EXPECT_EQ(left, a);
+    EXPECT_EQ(centre, b);
+    EXPECT_EQ(right, c);
+  }
+
+  TEST(DspTest, DotProduct) {
+    std::vector<float> a = ramp(kCount, -1.f, 1.f);
+    std::vector<float> b = ramp(kCount, 0.5f, -0.5f);
+    double expected = 0;
+    for (size_t i = 0; i < kCount; ++i) {
+      expected += a[i] * b[i];
+    }
+    EXPECT_NEAR(expected, HowieDspDotProduct(a.data(), b.data(), kCount),
+                1e-5);
+  }
+
+  TEST(DspTest, ResampleCubicIsExactAtWholeFrames) {
+    std::vector<float> src = ramp(kCount, -1.f, 1.f);
+    std::vector<float> dest(kCount - 3);
+    HowieDspResampleCubic(src.data(), dest.data(), 1, dest.size(), 1.0, 1.0);
+    for (size_t i = 0; i < dest.size(); ++i) {
+      EXPECT_NEAR(src[i + 1], dest[i], 1e-6);
+    }
+  }
+
+  TEST(DspTest, ResampleCubicFollowsALine) {
+    std::vector<float> src = ramp(kCount, -1.f, 1.f);
+    std::vector<float> dest(20);
+    HowieDspResampleCubic(src.data(), dest.data(), 1, dest.size(), 1.5, 1.25);
+    float slope = src[1] - src[0];
+    for (size_t i = 0; i < dest.size(); ++i) {
+      double position = 1.5 + i * 1.25;
+      EXPECT_NEAR(src[0] + slope * position, dest[i], 1e-5);
+    }
+  }
+
+  TEST(DspTest, FlushDenormals) {
+    std::vector<float> samples(kCount, FLT_MIN / 4);
+    samples[0] = 0.5f;
+    samples[kCount - 1] = -FLT_MIN / 2;
+    HowieDspFlushDenormals(samples.data(), kCount);
+    EXPECT_EQ(0.5f, samples[0]);
+    for (size_t i = 1; i < kCount; ++i) {
+      EXPECT_EQ(0.f, samples[i]);
+    }
+  }
+
+} // namespace
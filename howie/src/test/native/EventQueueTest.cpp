@@ -0,0 +1,103 @@
+/*
+ * Copyright 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#include "EventQueue.h"
+#include <gtest/gtest.h>
+#include <cstring>
+
+namespace {
+
+  using howie::EventQueue;
+
+  int valueOf(const HowieEvent &event) {
+    int value;
+    memcpy(&value, event.data, sizeof(value));
+    return value;
+  }
+
+  void schedule(EventQueue *queue, int64_t frameTime, int value) {
+    ASSERT_TRUE(queue->schedule(frameTime, &value, sizeof(value)));
+  }
+
+  TEST(EventQueueTest, DeliversEventsInTheirPeriod) {
+    EventQueue queue(16);
+    schedule(&queue, 300, 3);
+    schedule(&queue, 100, 1);
+    schedule(&queue, 150, 2);
+
+    queue.beginPeriod(0, 128);
+    ASSERT_EQ(1u, queue.eventCount());
+    EXPECT_EQ(1, valueOf(queue.events()[0]));
+    EXPECT_EQ(100, queue.events()[0].frameOffset);
+    queue.endPeriod();
+
+    queue.beginPeriod(128, 128);
+    ASSERT_EQ(1u, queue.eventCount());
+    EXPECT_EQ(2, valueOf(queue.events()[0]));
+    EXPECT_EQ(22, queue.events()[0].frameOffset);
+    queue.endPeriod();
+
+    queue.beginPeriod(256, 128);
+    ASSERT_EQ(1u, queue.eventCount());
+    EXPECT_EQ(3, valueOf(queue.events()[0]));
+    queue.endPeriod();
+
+    queue.beginPeriod(384, 128);
+    EXPECT_EQ(0u, queue.eventCount());
+    queue.endPeriod();
+  }
+
+  TEST(EventQueueTest, EqualTimesKeepTheirOrder) {
+    EventQueue queue(16);
+    for (int i = 0; i < 5; ++i) {
+      schedule(&queue, 10, i);
+    }
+    queue.beginPeriod(0, 64);
+    ASSERT_EQ(5u, queue.eventCount());
+    for (int i = 0; i < 5; ++i) {
+      EXPECT_EQ(i, valueOf(queue.events()[i]));
+    }
+    queue.endPeriod();
+  }
+
+  TEST(EventQueueTest, LateEventsStartThePeriod) {
+    EventQueue queue(16);
+    schedule(&queue, 5, 1);
+    queue.beginPeriod(64, 64);
+    ASSERT_EQ(1u, queue.eventCount());
+    EXPECT_EQ(0, queue.events()[0].frameOffset);
+    queue.endPeriod();
+  }
+
+  TEST(EventQueueTest, RefusesOversizedEvents) {
+    EventQueue queue(16);
+    unsigned char data[HOWIE_EVENT_MAX_SIZE + 1] = {};
+    EXPECT_TRUE(queue.schedule(0, data, HOWIE_EVENT_MAX_SIZE));
+    EXPECT_FALSE(queue.schedule(0, data, sizeof(data)));
+  }
+
+  TEST(EventQueueTest, RefusesEventsWhenFull) {
+    EventQueue queue(4);
+    int value = 0;
+    size_t accepted = 0;
+    while (accepted < 64 && queue.schedule(1000, &value, sizeof(value))) {
+      ++accepted;
+    }
+    EXPECT_GE(accepted, 4u);
+    EXPECT_LT(accepted, 64u);
+  }
+
+} // namespace
@@ -0,0 +1,144 @@
+/*
+ * Copyright 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#include "ParameterPipe.h"
+#include <gtest/gtest.h>
+#include <cstring>
+#include <memory>
+#include <thread>
+
+namespace {
+
+  using howie::ParameterPipe;
+
+  struct Block {
+    uint32_t sequence;
+    uint32_t values[15];
+  };
+
+  TEST(ParameterPipeTest, PopSeesTheLatestPush) {
+    ParameterPipe pipe(sizeof(Block));
+    EXPECT_FALSE(pipe.pop());
+    for (uint32_t i = 1; i <= 3; ++i) {
+      Block block = {};
+      block.sequence = i;
+      EXPECT_EQ(sizeof(block), pipe.push(&block, sizeof(block)));
+    }
+    EXPECT_TRUE(pipe.pop());
+    Block seen;
+    memcpy(&seen, pipe.top(), sizeof(seen));
+    EXPECT_EQ(3u, seen.sequence);
+    EXPECT_FALSE(pipe.pop());
+  }
+
+  TEST(ParameterPipeTest, AcquireAndCommitInPlace) {
+    ParameterPipe pipe(sizeof(Block));
+    unsigned char *slot = pipe.acquire();
+    ASSERT_NE(nullptr, slot);
+    // Only one writer at a time.
+    EXPECT_EQ(nullptr, pipe.acquire());
+    EXPECT_FALSE(pipe.commit(slot + 1));
+    reinterpret_cast<Block *>(slot)->sequence = 42;
+    EXPECT_TRUE(pipe.commit(slot));
+    EXPECT_FALSE(pipe.commit(slot));
+    ASSERT_TRUE(pipe.pop());
+    EXPECT_EQ(42u, reinterpret_cast<const Block *>(pipe.top())->sequence);
+    EXPECT_EQ(1u, pipe.contentionCount());
+  }
+
+  TEST(ParameterPipeTest, SlotsLieInStorage) {
+    ParameterPipe pipe(sizeof(Block));
+    for (int i = 0; i < 6; ++i) {
+      unsigned char *slot = pipe.acquire();
+      ASSERT_NE(nullptr, slot);
+      size_t offset = static_cast<size_t>(slot - pipe.storage());
+      EXPECT_EQ(0u, offset % pipe.stride());
+      EXPECT_LT(offset, pipe.storageSize());
+      ASSERT_TRUE(pipe.commit(slot));
+      pipe.pop();
+    }
+  }
+
+  TEST(ParameterPipeTest, PatchesApplyOnTopOfTheirBlock) {
+    ParameterPipe pipe(sizeof(Block));
+    Block block = {};
+    block.sequence = 1;
+    pipe.push(&block, sizeof(block));
+    uint32_t value = 99;
+    EXPECT_EQ(sizeof(value),
+              pipe.patch(offsetof(Block, values), &value, sizeof(value)));
+    ASSERT_TRUE(pipe.pop());
+    const Block *seen = reinterpret_cast<const Block *>(pipe.top());
+    EXPECT_EQ(1u, seen->sequence);
+    EXPECT_EQ(99u, seen->values[0]);
+
+    // A patch sent before a block is superseded by it.
+    pipe.patch(offsetof(Block, values), &value, sizeof(value));
+    block.sequence = 2;
+    pipe.push(&block, sizeof(block));
+    ASSERT_TRUE(pipe.pop());
+    seen = reinterpret_cast<const Block *>(pipe.top());
+    EXPECT_EQ(2u, seen->sequence);
+    EXPECT_EQ(0u, seen->values[0]);
+  }
+
+  TEST(ParameterPipeTest, PatchOutOfRangeIsRefused) {
+    ParameterPipe pipe(sizeof(Block));
+    uint32_t value = 1;
+    EXPECT_EQ(0u, pipe.patch(sizeof(Block) - 2, &value, sizeof(value)));
+    EXPECT_EQ(0u, pipe.patch(sizeof(Block) + 1, &value, 1));
+  }
+
+  TEST(ParameterPipeTest, HeapAllocationIsCacheAligned) {
+    for (int i = 0; i < 8; ++i) {
+      std::unique_ptr<ParameterPipe> pipe(new ParameterPipe(sizeof(Block)));
+      ASSERT_NE(nullptr, pipe.get());
+      EXPECT_EQ(0u, reinterpret_cast<uintptr_t>(pipe.get()) % CACHE_ALIGN);
+    }
+  }
+
+  // The reader must never see a block torn between two pushes.
+  TEST(ParameterPipeTest, ConcurrentReaderSeesWholeBlocks) {
+    ParameterPipe pipe(sizeof(Block));
+    std::atomic<bool> done {false};
+    std::thread writer([&] {
+      Block block;
+      for (uint32_t i = 1; i <= 20000; ++i) {
+        block.sequence = i;
+        for (uint32_t &v : block.values) {
+          v = i;
+        }
+        pipe.push(&block, sizeof(block), 100);
+      }
+      done.store(true);
+    });
+    uint32_t last = 0;
+    while (!done.load()) {
+      if (pipe.pop()) {
+        const Block *seen = reinterpret_cast<const Block *>(pipe.top());
+        ASSERT_GT(seen->sequence, last);
+        for (uint32_t v : seen->values) {
+          ASSERT_EQ(seen->sequence, v);
+        }
+        last = seen->sequence;
+      } else {
+        std::this_thread::yield();
+      }
+    }
+    writer.join();
+  }
+
+} // namespace
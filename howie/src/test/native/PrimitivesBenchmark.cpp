@@ -0,0 +1,190 @@
+/*
+ * Copyright 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#include "ParameterPipe.h"
+#include "Ringbuffer.h"
+#include "SimulatedBackend.h"
+#include "StreamStatistics.h"
+#include "TestClient.h"
+#include "Worker.h"
+#include "howie_dsp.h"
+#include <benchmark/benchmark.h>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+namespace {
+
+  using howie::StreamStatistics;
+
+  constexpr int kRingbufferLength = 1024;
+
+  // Parameter blocks are sent no faster than this, so that the reader
+  // sees each one by itself rather than only the latest of several.
+  constexpr int64_t kParameterIntervalNs = 20000;
+
+  /**
+   * One thread pushes, the other pops, and both spin when the ring is
+   * full or empty, which keeps the read and write positions bouncing
+   * between cores as much as they ever will.
+   */
+  void BM_RingbufferThroughput(benchmark::State &state) {
+    Ringbuffer<uint32_t> ring(kRingbufferLength);
+    std::atomic<bool> running {true};
+    std::thread consumer([&] {
+      uint32_t value;
+      while (running.load(std::memory_order_relaxed)) {
+        ring.pop(&value);
+      }
+    });
+    uint32_t next = 0;
+    for (auto _ : state) {
+      while (!ring.push(next)) {
+      }
+      ++next;
+    }
+    running.store(false, std::memory_order_relaxed);
+    consumer.join();
+    state.SetItemsProcessed(state.iterations());
+  }
+  BENCHMARK(BM_RingbufferThroughput);
+
+  /**
+   * The writer stamps each block with the time it was sent, and the
+   * reader, spinning on pop() the way an audio thread would poll once per
+   * period, records how long the block took to become visible. Each
+   * iteration is one block, timed manually from send to seen.
+   */
+  void BM_ParameterLatency(benchmark::State &state) {
+    size_t blockSize = static_cast<size_t>(state.range(0));
+    howie::ParameterPipe pipe(blockSize);
+    std::vector<unsigned char> block(blockSize);
+    std::atomic<bool> running {true};
+    std::atomic<int64_t> seenNs {0};
+
+    std::thread reader([&] {
+      while (running.load(std::memory_order_relaxed)) {
+        if (pipe.pop()) {
+          seenNs.store(StreamStatistics::now(), std::memory_order_release);
+        }
+      }
+    });
+
+    for (auto _ : state) {
+      seenNs.store(0, std::memory_order_relaxed);
+      int64_t sent = StreamStatistics::now();
+      memcpy(block.data(), &sent, sizeof(sent));
+      pipe.push(block.data(), block.size(), 100);
+      int64_t seen;
+      while ((seen = seenNs.load(std::memory_order_acquire)) == 0) {
+      }
+      state.SetIterationTime((seen - sent) * 1e-9);
+      while (StreamStatistics::now() < sent + kParameterIntervalNs) {
+      }
+    }
+    running.store(false, std::memory_order_relaxed);
+    reader.join();
+    state.SetBytesProcessed(state.iterations() * state.range(0));
+  }
+  BENCHMARK(BM_ParameterLatency)->Arg(64)->Arg(1024)->UseManualTime();
+
+  // From queueing a task to the worker starting to run it.
+  void BM_WorkerDispatch(benchmark::State &state) {
+    Worker worker(16, 1024);
+    for (auto _ : state) {
+      int64_t queued = StreamStatistics::now();
+      int64_t started = 0;
+      Worker::ticket_t ticket;
+      if (worker.push_work([&] { started = StreamStatistics::now(); },
+                           &ticket)
+          && worker.wait(ticket, -1)) {
+        state.SetIterationTime((started - queued) * 1e-9);
+      }
+    }
+  }
+  BENCHMARK(BM_WorkerDispatch)->UseManualTime();
+
+  /**
+   * A playback stream on the simulated device while the benchmark loop
+   * pushes parameter blocks at it as fast as it can: the counters show
+   * how long each period took and whether any ran late.
+   */
+  void BM_SimulatedStream(benchmark::State &state) {
+    const size_t kBlockSize = 64;
+    howie::TestClient client(kBlockSize);
+    howie::SimulatedBackend backend(state.range(0) * 1000);
+    HowieDeviceCharacteristics device = howie::testDevice();
+    if (!HOWIE_SUCCEEDED(backend.open(
+            howie::testConfig(HOWIE_STREAM_DIRECTION_PLAYBACK),
+            &client, &device))
+        || !HOWIE_SUCCEEDED(backend.start())) {
+      state.SkipWithError("couldn't start the simulated stream");
+      return;
+    }
+    std::vector<unsigned char> block(kBlockSize);
+    uint32_t i = 0;
+    for (auto _ : state) {
+      memset(block.data(), i++ & 0xff, block.size());
+      client.parameters().push(block.data(), block.size(), 0);
+    }
+    backend.stop();
+
+    HowieStreamStatistics stats;
+    memset(&stats, 0, sizeof(stats));
+    stats.version = sizeof(stats);
+    client.statistics().read(&stats);
+    state.counters["periods"] = static_cast<double>(client.periods());
+    state.counters["periodMeanNs"] = static_cast<double>(backend.meanPeriodNs());
+    state.counters["periodMaxNs"] = static_cast<double>(backend.maxPeriodNs());
+    state.counters["underruns"] = stats.underrunCount;
+  }
+  BENCHMARK(BM_SimulatedStream)->Arg(0)->Arg(200)->MinTime(1.0);
+
+  // A period's worth of stereo samples at 48 kHz.
+  constexpr size_t kKernelSamples = 2 * 192;
+
+  void BM_DspFloatToInt16(benchmark::State &state) {
+    std::vector<float> src(kKernelSamples, 0.25f);
+    std::vector<int16_t> dest(kKernelSamples);
+    for (auto _ : state) {
+      HowieDspFloatToInt16(src.data(), dest.data(), kKernelSamples);
+      benchmark::DoNotOptimize(dest.data());
+    }
+    state.SetItemsProcessed(state.iterations() * kKernelSamples);
+  }
+  BENCHMARK(BM_DspFloatToInt16);
+
+  void BM_DspMixAccumulate(benchmark::State &state) {
+    std::vector<float> src(kKernelSamples, 0.25f);
+    std::vector<float> dest(kKernelSamples);
+    for (auto _ : state) {
+      HowieDspMixAccumulate(src.data(), dest.data(), 0.5f, kKernelSamples);
+      benchmark::DoNotOptimize(dest.data());
+    }
+    state.SetItemsProcessed(state.iterations() * kKernelSamples);
+  }
+  BENCHMARK(BM_DspMixAccumulate);
+
+  void BM_DspDotProduct(benchmark::State &state) {
+    std::vector<float> a(64, 0.25f);
+    std::vector<float> b(64, 0.5f);
+    for (auto _ : state) {
+      benchmark::DoNotOptimize(HowieDspDotProduct(a.data(), b.data(), 64));
+    }
+  }
+  BENCHMARK(BM_DspDotProduct);
+
+} // namespace
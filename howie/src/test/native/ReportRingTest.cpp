@@ -0,0 +1,105 @@
+/*
+ * Copyright 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#include "ReportRing.h"
+#include <gtest/gtest.h>
+#include <thread>
+
+namespace {
+
+  using howie::ReportRing;
+
+  struct Report {
+    uint32_t sequence;
+    float level;
+  };
+
+  bool send(ReportRing *ring, uint32_t sequence) {
+    unsigned char *slot = ring->acquire();
+    if (!slot) {
+      return false;
+    }
+    Report report = { sequence, 0.5f };
+    memcpy(slot, &report, sizeof(report));
+    return ring->commit(slot);
+  }
+
+  TEST(ReportRingTest, ReadsReportsInOrder) {
+    ReportRing ring(sizeof(Report), 8);
+    EXPECT_EQ(sizeof(Report), ring.reportSize());
+    for (uint32_t i = 0; i < 5; ++i) {
+      ASSERT_TRUE(send(&ring, i));
+    }
+    Report reports[8];
+    ASSERT_EQ(3u, ring.read(reports, 3));
+    ASSERT_EQ(2u, ring.read(reports + 3, 8));
+    for (uint32_t i = 0; i < 5; ++i) {
+      EXPECT_EQ(i, reports[i].sequence);
+    }
+    EXPECT_EQ(0u, ring.read(reports, 8));
+  }
+
+  TEST(ReportRingTest, RefusesReportsWhenFull) {
+    // Rounded up to 8.
+    ReportRing ring(sizeof(Report), 5);
+    uint32_t sent = 0;
+    while (sent < 32 && send(&ring, sent)) {
+      ++sent;
+    }
+    EXPECT_EQ(8u, sent);
+    Report report;
+    ASSERT_EQ(1u, ring.read(&report, 1));
+    EXPECT_EQ(0u, report.sequence);
+    EXPECT_TRUE(send(&ring, sent));
+  }
+
+  TEST(ReportRingTest, AcquireReturnsTheSameSlotUntilCommitted) {
+    ReportRing ring(sizeof(Report), 4);
+    unsigned char *slot = ring.acquire();
+    ASSERT_NE(nullptr, slot);
+    EXPECT_EQ(slot, ring.acquire());
+    EXPECT_FALSE(ring.commit(slot + 1));
+    EXPECT_TRUE(ring.commit(slot));
+    EXPECT_NE(slot, ring.acquire());
+  }
+
+  TEST(ReportRingTest, OneWriterOneReader) {
+    ReportRing ring(sizeof(Report), 16);
+    const uint32_t kCount = 100000;
+    std::thread writer([&ring] {
+      for (uint32_t i = 0; i < kCount;) {
+        if (send(&ring, i)) {
+          ++i;
+        } else {
+          std::this_thread::yield();
+        }
+      }
+    });
+    uint32_t expected = 0;
+    Report reports[16];
+    while (expected < kCount) {
+      size_t count = ring.read(reports, 16);
+      if (count == 0) {
+        std::this_thread::yield();
+      }
+      for (size_t i = 0; i < count; ++i) {
+        ASSERT_EQ(expected++, reports[i].sequence);
+      }
+    }
+    writer.join();
+  }
+
+} // namespace
@@ -0,0 +1,148 @@
+/*
+ * Copyright 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#include "Resampler.h"
+#include <gtest/gtest.h>
+#include <cmath>
+#include <vector>
+
+namespace {
+
+  using howie::Resampler;
+
+  constexpr double kPi = 3.14159265358979323846;
+
+  // Float storage, so that the coefficients are aligned.
+  std::vector<float> storageFor(int in, int out, size_t frames, size_t ch) {
+    size_t bytes = Resampler::storageSize(in, out, frames, ch);
+    return std::vector<float>((bytes + sizeof(float) - 1) / sizeof(float));
+  }
+
+  unsigned char *bytes(std::vector<float> *storage) {
+    return reinterpret_cast<unsigned char *>(storage->data());
+  }
+
+  TEST(ResamplerTest, SupportedRates) {
+    EXPECT_TRUE(Resampler::supported(44100, 48000));
+    EXPECT_TRUE(Resampler::supported(48000, 44100));
+    EXPECT_TRUE(Resampler::supported(8000, 48000));
+    EXPECT_FALSE(Resampler::supported(Resampler::kMinRate - 1, 48000));
+    EXPECT_FALSE(Resampler::supported(48000, Resampler::kMaxRate + 1));
+    EXPECT_FALSE(Resampler::supported(
+        48000 * (Resampler::kMaxDownsampling + 1), 48000));
+  }
+
+  // A sine through the resampler should come out as the same sine at the
+  // new rate, once the filter's delay is allowed for.
+  void checkSine(int in, int out, double freq, size_t frames, size_t ch,
+                 double minSnrDb) {
+    std::vector<float> storage = storageFor(in, out, frames, ch);
+    Resampler resampler(in, out, frames, ch, bytes(&storage));
+    std::vector<float> output(frames * ch);
+    double delay = 64.0 * std::max(1, (in + out - 1) / out) / 2;
+    int64_t inPos = 0;
+    int64_t outPos = 0;
+    double signal = 0;
+    double error = 0;
+    for (int period = 0; period < 500; ++period) {
+      size_t needed = resampler.beginPeriod();
+      ASSERT_LE(needed, resampler.maxInputFrames());
+      for (size_t f = 0; f < needed; ++f, ++inPos) {
+        for (size_t c = 0; c < ch; ++c) {
+          resampler.input()[f * ch + c] = static_cast<float>(
+              0.5 * sin(2 * kPi * freq * inPos / in + c));
+        }
+      }
+      resampler.process(output.data());
+      for (size_t f = 0; f < frames; ++f, ++outPos) {
+        if (period < 10) {
+          continue;
+        }
+        double t = static_cast<double>(outPos) * in / out - delay;
+        for (size_t c = 0; c < ch; ++c) {
+          double ideal = 0.5 * sin(2 * kPi * freq * t / in + c);
+          double diff = output[f * ch + c] - ideal;
+          signal += ideal * ideal;
+          error += diff * diff;
+        }
+      }
+    }
+    EXPECT_GT(10 * log10(signal / error), minSnrDb)
+        << in << " to " << out << " at " << freq << " Hz";
+  }
+
+  TEST(ResamplerTest, PreservesASine) {
+    checkSine(44100, 48000, 1000, 192, 2, 80);
+    checkSine(48000, 44100, 1000, 192, 2, 80);
+    checkSine(22050, 48000, 1000, 240, 1, 80);
+    checkSine(96000, 48000, 1000, 192, 2, 80);
+    // More than kMaxPhases positions, so they're rounded.
+    checkSine(44100, 48001, 1000, 192, 2, 60);
+  }
+
+  TEST(ResamplerTest, TakesTheRightNumberOfFrames) {
+    const int in = 44100;
+    const int out = 48000;
+    const size_t frames = 192;
+    std::vector<float> storage = storageFor(in, out, frames, 1);
+    Resampler resampler(in, out, frames, 1, bytes(&storage));
+    std::vector<float> output(frames);
+    int64_t total = 0;
+    const int periods = 1000;
+    for (int i = 0; i < periods; ++i) {
+      size_t needed = resampler.beginPeriod();
+      std::fill(resampler.input(), resampler.input() + needed, 0.f);
+      resampler.process(output.data());
+      total += static_cast<int64_t>(needed);
+    }
+    // No drift: the input consumed tracks the exact ratio.
+    double expected = static_cast<double>(periods) * frames * in / out;
+    EXPECT_NEAR(expected, static_cast<double>(total), 64);
+  }
+
+  TEST(ResamplerTest, SkipPeriodMatchesProcessingSilence) {
+    const int in = 44100;
+    const int out = 48000;
+    const size_t frames = 192;
+    const size_t ch = 2;
+    std::vector<float> storageA = storageFor(in, out, frames, ch);
+    std::vector<float> storageB = storageFor(in, out, frames, ch);
+    Resampler a(in, out, frames, ch, bytes(&storageA));
+    Resampler b(in, out, frames, ch, bytes(&storageB));
+    std::vector<float> outputA(frames * ch);
+    std::vector<float> outputB(frames * ch);
+    for (int period = 0; period < 300; ++period) {
+      size_t neededA = a.beginPeriod();
+      size_t neededB = b.beginPeriod();
+      ASSERT_EQ(neededA, neededB);
+      bool live = period < 3 || period >= 200;
+      for (size_t i = 0; i < neededA * ch; ++i) {
+        a.input()[i] = live ? 0.5f * ((i * 7) % 13 - 6.f) / 6.f : 0.f;
+        b.input()[i] = a.input()[i];
+      }
+      a.process(outputA.data());
+      if (period >= 100 && period < 200) {
+        b.skipPeriod();
+      } else {
+        b.process(outputB.data());
+      }
+      if (period >= 200) {
+        ASSERT_EQ(outputA, outputB) << "period " << period;
+      }
+    }
+  }
+
+} // namespace
@@ -0,0 +1,103 @@
+/*
+ * Copyright 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#include "Ringbuffer.h"
+#include <gtest/gtest.h>
+#include <thread>
+#include <vector>
+
+namespace {
+
+  // Both sizes, since a power of two takes the masked indexing path and
+  // anything else the compare-and-subtract one.
+  class RingbufferTest : public ::testing::TestWithParam<int> {};
+
+  TEST_P(RingbufferTest, FillsToCapacityAndDrainsInOrder) {
+    Ringbuffer<int> ring(GetParam());
+    for (int i = 0; i < GetParam(); ++i) {
+      EXPECT_TRUE(ring.push(i));
+    }
+    EXPECT_FALSE(ring.push(-1));
+    EXPECT_EQ(static_cast<uint32_t>(GetParam()), ring.size());
+    for (int i = 0; i < GetParam(); ++i) {
+      int value = -1;
+      ASSERT_TRUE(ring.pop(&value));
+      EXPECT_EQ(i, value);
+    }
+    int value;
+    EXPECT_FALSE(ring.pop(&value));
+    EXPECT_TRUE(ring.empty());
+  }
+
+  TEST_P(RingbufferTest, BulkTransfersWrapAround) {
+    const int capacity = GetParam();
+    Ringbuffer<int> ring(capacity);
+    std::vector<int> src(capacity);
+    std::vector<int> dest(capacity);
+    int next = 0;
+    int expected = 0;
+    // Odd sized chunks, so the runs land across the end of the storage.
+    for (int round = 0; round < 50; ++round) {
+      size_t chunk = static_cast<size_t>(round % 3 + 1) * capacity / 4 + 1;
+      for (size_t i = 0; i < chunk; ++i) {
+        src[i] = next + static_cast<int>(i);
+      }
+      size_t pushed = ring.push_n(src.data(), chunk);
+      next += static_cast<int>(pushed);
+      size_t popped = ring.pop_n(dest.data(), static_cast<size_t>(capacity));
+      for (size_t i = 0; i < popped; ++i) {
+        ASSERT_EQ(expected++, dest[i]);
+      }
+    }
+    EXPECT_EQ(next, expected);
+  }
+
+  TEST_P(RingbufferTest, PushNTakesOnlyWhatFits) {
+    Ringbuffer<int> ring(GetParam());
+    std::vector<int> src(GetParam() * 2, 7);
+    EXPECT_EQ(static_cast<size_t>(GetParam()),
+              ring.push_n(src.data(), src.size()));
+    EXPECT_EQ(0u, ring.push_n(src.data(), 1));
+  }
+
+  TEST_P(RingbufferTest, OneProducerOneConsumer) {
+    Ringbuffer<uint32_t> ring(GetParam());
+    const uint32_t kCount = 100000;
+    std::thread producer([&] {
+      for (uint32_t i = 0; i < kCount;) {
+        if (ring.push(i)) {
+          ++i;
+        } else {
+          std::this_thread::yield();
+        }
+      }
+    });
+    uint32_t expected = 0;
+    while (expected < kCount) {
+      uint32_t value;
+      if (ring.pop(&value)) {
+        ASSERT_EQ(expected, value);
+        ++expected;
+      } else {
+        std::this_thread::yield();
+      }
+    }
+    producer.join();
+  }
+
+  INSTANTIATE_TEST_SUITE_P(Sizes, RingbufferTest, ::testing::Values(16, 24));
+
+} // namespace
@@ -0,0 +1,112 @@
+/*
+ * Copyright 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#include "SimulatedBackend.h"
+#include "howie-private.h"
+#include "StreamStatistics.h"
+#include <chrono>
+#include <random>
+
+namespace howie {
+
+  SimulatedBackend::~SimulatedBackend() {
+    stop();
+  }
+
+  HowieError SimulatedBackend::open(
+      const Config &config,
+      Client *client,
+      HowieDeviceCharacteristics *characteristics) {
+    HOWIE_TRACE_FN(HOWIE_TRACE_LEVEL_CALLS)
+    HOWIE_CHECK_NOT_NULL(client);
+    HOWIE_CHECK_NOT_NULL(characteristics);
+    if (config.sampleFormat == HOWIE_SAMPLE_FORMAT_FLOAT) {
+      useFloatCharacteristics(characteristics);
+    }
+    client_ = client;
+    direction_ = config.direction;
+    periodNs_ = periodNs(*characteristics);
+
+    size_t periodBytes = characteristics->framesPerPeriod
+                         * characteristics->samplesPerFrame
+                         * characteristics->bytesPerSample;
+    if (direction_ & HOWIE_STREAM_DIRECTION_RECORD) {
+      client_->useBuffer(&input_, kInputBuffer, periodBytes);
+      input_.clear();
+    }
+    if (direction_ & HOWIE_STREAM_DIRECTION_PLAYBACK) {
+      client_->useBuffer(&output_, kOutputBuffer, periodBytes);
+    }
+    client_->statistics().configure(periodNs_, config.playbackBufferCount);
+    return HOWIE_SUCCESS;
+  }
+
+  HowieError SimulatedBackend::start() {
+    HOWIE_TRACE_FN(HOWIE_TRACE_LEVEL_CALLS)
+    if (!thread_) {
+      running_.store(true, std::memory_order_relaxed);
+      thread_.reset(new std::thread([this] { threadFn(); }));
+    }
+    return HOWIE_SUCCESS;
+  }
+
+  HowieError SimulatedBackend::stop() {
+    HOWIE_TRACE_FN(HOWIE_TRACE_LEVEL_CALLS)
+    if (thread_) {
+      running_.store(false, std::memory_order_relaxed);
+      thread_->join();
+      thread_.reset();
+    }
+    return HOWIE_SUCCESS;
+  }
+
+  int64_t SimulatedBackend::meanPeriodNs() const {
+    return periodCount_ > 0
+           ? totalPeriodNs_ / static_cast<int64_t>(periodCount_) : 0;
+  }
+
+  /**
+   * Deadlines advance by exactly one period, as a device's would, so
+   * jitter delays a callback without pushing back the ones after it.
+   */
+  void SimulatedBackend::threadFn() {
+    std::minstd_rand random;
+    std::uniform_int_distribution<int64_t> jitter(0, jitterNs_);
+    auto deadline = std::chrono::steady_clock::now();
+    HowieBuffer in { sizeof(HowieBuffer), input_.get(), input_.size() };
+    HowieBuffer out { sizeof(HowieBuffer), output_.get(), output_.size() };
+
+    while (running_.load(std::memory_order_relaxed)) {
+      deadline += std::chrono::nanoseconds(periodNs_);
+      std::this_thread::sleep_until(
+          deadline + std::chrono::nanoseconds(jitterNs_ > 0
+                                              ? jitter(random) : 0));
+
+      int64_t start = StreamStatistics::now();
+      HowieError result = client_->onPeriod(&in, &out);
+      int64_t duration = StreamStatistics::now() - start;
+      if (!HOWIE_SUCCEEDED(result)) {
+        break;
+      }
+      ++periodCount_;
+      totalPeriodNs_ += duration;
+      if (duration > maxPeriodNs_) {
+        maxPeriodNs_ = duration;
+      }
+    }
+  }
+
+} // namespace howie
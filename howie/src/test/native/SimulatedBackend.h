@@ -0,0 +1,78 @@
+/*
+ * Copyright 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#ifndef HOWIE_SIMULATEDBACKEND_H
+#define HOWIE_SIMULATEDBACKEND_H
+
+#include <atomic>
+#include <memory>
+#include <stdint.h>
+#include <thread>
+#include "StreamBackend.h"
+
+namespace howie {
+
+  /**
+   * Runs a stream on a thread of its own that pretends to be a device's
+   * buffer queue: it calls the client once per period, each call late by
+   * a random amount up to the configured jitter. Host tests and benchmarks
+   * use it to run a period loop, and time it, without any audio hardware.
+   *
+   * The thread runs at whatever priority it is created with, and periods
+   * are timed by sleeping, so this is no guide to how a real device
+   * schedules callbacks.
+   */
+  class SimulatedBackend : public StreamBackend {
+  public:
+    explicit SimulatedBackend(int64_t jitterNs) : jitterNs_(jitterNs) {}
+    ~SimulatedBackend();
+
+    HowieError open(const Config &config,
+                    Client *client,
+                    HowieDeviceCharacteristics *characteristics) override;
+    HowieError start() override;
+    HowieError stop() override;
+    void getStatistics(HowieStreamStatistics * /* dest */) const override {}
+    const char *name() const override { return "simulated"; }
+
+    // The time each call into the stream took, including its process
+    // callback. Read once the backend is stopped.
+    int64_t meanPeriodNs() const;
+    int64_t maxPeriodNs() const { return maxPeriodNs_; }
+
+  private:
+    const int64_t jitterNs_;
+    Client *client_ = nullptr;
+    HowieDirection direction_ = HOWIE_STREAM_DIRECTION_PLAYBACK;
+    int64_t periodNs_ = 0;
+
+    unique_buffer input_;
+    unique_buffer output_;
+
+    std::unique_ptr<std::thread> thread_;
+    std::atomic<bool> running_ {false};
+
+    // Written by the thread, read after it has been joined.
+    uint64_t periodCount_ = 0;
+    int64_t totalPeriodNs_ = 0;
+    int64_t maxPeriodNs_ = 0;
+
+    void threadFn();
+  };
+
+} // namespace howie
+
+#endif // HOWIE_SIMULATEDBACKEND_H
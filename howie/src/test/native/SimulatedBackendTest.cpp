@@ -0,0 +1,101 @@
+/*
+ * Copyright 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#include "SimulatedBackend.h"
+#include "TestClient.h"
+#include <gtest/gtest.h>
+#include <thread>
+
+namespace {
+
+  using howie::SimulatedBackend;
+  using howie::TestClient;
+
+  bool waitForPeriods(const TestClient &client, uint64_t count) {
+    for (int i = 0; i < 1000 && client.periods() < count; ++i) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return client.periods() >= count;
+  }
+
+  TEST(SimulatedBackendTest, OpensWithFloatSamples) {
+    TestClient client(16);
+    SimulatedBackend backend(0);
+    HowieDeviceCharacteristics device = howie::testDevice();
+    ASSERT_EQ(HOWIE_SUCCESS,
+              backend.open(howie::testConfig(HOWIE_STREAM_DIRECTION_PLAYBACK),
+                           &client, &device));
+    EXPECT_TRUE(device.floatingPoint);
+    EXPECT_EQ(static_cast<int>(sizeof(float)), device.bytesPerSample);
+    EXPECT_STREQ("simulated", backend.name());
+  }
+
+  TEST(SimulatedBackendTest, RunsPeriodsUntilStopped) {
+    TestClient client(16);
+    SimulatedBackend backend(0);
+    HowieDeviceCharacteristics device = howie::testDevice();
+    ASSERT_EQ(HOWIE_SUCCESS,
+              backend.open(howie::testConfig(HOWIE_STREAM_DIRECTION_PLAYBACK),
+                           &client, &device));
+    EXPECT_EQ(0u, client.periods());
+    ASSERT_EQ(HOWIE_SUCCESS, backend.start());
+    EXPECT_TRUE(waitForPeriods(client, 10));
+    ASSERT_EQ(HOWIE_SUCCESS, backend.stop());
+
+    uint64_t periods = client.periods();
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    EXPECT_EQ(periods, client.periods());
+    EXPECT_GT(backend.meanPeriodNs(), 0);
+    EXPECT_GE(backend.maxPeriodNs(), backend.meanPeriodNs());
+    // Playback only, so no input.
+    EXPECT_EQ(0u, client.inputBytes());
+  }
+
+  TEST(SimulatedBackendTest, DuplexGetsAnInputBuffer) {
+    TestClient client(16);
+    SimulatedBackend backend(200000);
+    HowieDeviceCharacteristics device = howie::testDevice();
+    ASSERT_EQ(HOWIE_SUCCESS,
+              backend.open(howie::testConfig(HOWIE_STREAM_DIRECTION_BOTH),
+                           &client, &device));
+    ASSERT_EQ(HOWIE_SUCCESS, backend.start());
+    EXPECT_TRUE(waitForPeriods(client, 5));
+    ASSERT_EQ(HOWIE_SUCCESS, backend.stop());
+    EXPECT_EQ(static_cast<size_t>(device.framesPerPeriod
+                                  * device.samplesPerFrame * sizeof(float)),
+              client.inputBytes());
+  }
+
+  TEST(SimulatedBackendTest, ClientSeesParameterBlocks) {
+    TestClient client(16);
+    SimulatedBackend backend(0);
+    HowieDeviceCharacteristics device = howie::testDevice();
+    ASSERT_EQ(HOWIE_SUCCESS,
+              backend.open(howie::testConfig(HOWIE_STREAM_DIRECTION_PLAYBACK),
+                           &client, &device));
+    ASSERT_EQ(HOWIE_SUCCESS, backend.start());
+    unsigned char block[16] = {};
+    for (int i = 0; i < 5; ++i) {
+      uint64_t periods = client.periods();
+      block[0] = static_cast<unsigned char>(i);
+      ASSERT_EQ(sizeof(block), client.parameters().push(block, sizeof(block)));
+      ASSERT_TRUE(waitForPeriods(client, periods + 2));
+    }
+    ASSERT_EQ(HOWIE_SUCCESS, backend.stop());
+    EXPECT_EQ(5u, client.blocksSeen());
+  }
+
+} // namespace
@@ -0,0 +1,109 @@
+/*
+ * Copyright 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#ifndef HOWIE_TESTCLIENT_H
+#define HOWIE_TESTCLIENT_H
+
+#include "ParameterPipe.h"
+#include "RealtimeLog.h"
+#include "StreamBackend.h"
+#include "StreamStatistics.h"
+#include <atomic>
+#include <cstring>
+
+namespace howie {
+
+  /**
+   * The least a backend needs to run periods: a client that allocates its
+   * buffers on demand and, each period, picks up the latest parameter
+   * block and writes silence, much as a stream would with a trivial
+   * process callback.
+   */
+  class TestClient : public StreamBackend::Client {
+  public:
+    explicit TestClient(size_t parameterBlockSize)
+        : parameters_(parameterBlockSize) {}
+
+    HowieError onPeriod(const HowieBuffer *in,
+                        const HowieBuffer *out) override {
+      int64_t start = StreamStatistics::now();
+      statistics_.callbackStarted(start);
+      if (parameters_.pop()) {
+        blocksSeen_.fetch_add(1, std::memory_order_relaxed);
+      }
+      inputBytes_ = in->byteCount;
+      memset(out->data, 0, out->byteCount);
+      periods_.fetch_add(1, std::memory_order_release);
+      statistics_.callbackFinished(start, StreamStatistics::now());
+      return HOWIE_SUCCESS;
+    }
+
+    StreamStatistics &statistics() override { return statistics_; }
+    RealtimeLog &realtimeLog() override { return log_; }
+
+    void useBuffer(unique_buffer *buffer,
+                   BackendBuffer /* which */,
+                   size_t size) override {
+      buffer->reset(size);
+    }
+
+    ParameterPipe &parameters() { return parameters_; }
+    uint64_t periods() const {
+      return periods_.load(std::memory_order_acquire);
+    }
+    uint64_t blocksSeen() const {
+      return blocksSeen_.load(std::memory_order_relaxed);
+    }
+    size_t inputBytes() const { return inputBytes_; }
+
+  private:
+    ParameterPipe parameters_;
+    StreamStatistics statistics_;
+    RealtimeLog log_;
+    std::atomic<uint64_t> periods_ {0};
+    std::atomic<uint64_t> blocksSeen_ {0};
+    size_t inputBytes_ = 0;
+  };
+
+  // A stereo 16 bit device at 48 kHz, with millisecond periods.
+  inline HowieDeviceCharacteristics testDevice() {
+    HowieDeviceCharacteristics device;
+    memset(&device, 0, sizeof(device));
+    device.version = sizeof(device);
+    device.sampleRate = 48000;
+    device.bitsPerSample = 16;
+    device.bytesPerSample = 2;
+    device.sampleMask = 0xffff;
+    device.floatingPoint = false;
+    device.channelCount = 2;
+    device.samplesPerFrame = 2;
+    device.framesPerPeriod = 48;
+    return device;
+  }
+
+  inline StreamBackend::Config testConfig(HowieDirection direction) {
+    StreamBackend::Config config;
+    config.direction = direction;
+    config.sampleFormat = HOWIE_SAMPLE_FORMAT_FLOAT;
+    config.playbackBufferCount = 2;
+    config.maxPlaybackBufferCount = 2;
+    config.latencyStableWindowMs = 0;
+    return config;
+  }
+
+} // namespace howie
+
+#endif // HOWIE_TESTCLIENT_H
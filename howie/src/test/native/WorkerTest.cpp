@@ -0,0 +1,88 @@
+/*
+ * Copyright 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#include "Worker.h"
+#include <gtest/gtest.h>
+#include <atomic>
+#include <vector>
+
+namespace {
+
+  TEST(WorkerTest, RunsTasksInOrder) {
+    Worker worker(4, 64);
+    std::vector<int> order;
+    Worker::ticket_t ticket = 0;
+    for (int i = 0; i < 32; ++i) {
+      ASSERT_TRUE(worker.push_work([&order, i] { order.push_back(i); },
+                                   &ticket));
+    }
+    ASSERT_TRUE(worker.wait(ticket, -1));
+    ASSERT_EQ(32u, order.size());
+    for (int i = 0; i < 32; ++i) {
+      EXPECT_EQ(i, order[i]);
+    }
+  }
+
+  TEST(WorkerTest, TicketsIncrease) {
+    Worker worker(4, 64);
+    Worker::ticket_t first;
+    Worker::ticket_t second;
+    ASSERT_TRUE(worker.push_work([] {}, &first));
+    ASSERT_TRUE(worker.push_work([] {}, &second));
+    EXPECT_LT(first, second);
+    EXPECT_TRUE(worker.wait(second, -1));
+    EXPECT_GE(worker.lastTicket(), second);
+  }
+
+  TEST(WorkerTest, WaitTimesOut) {
+    Worker worker(4, 64);
+    std::atomic<bool> release {false};
+    Worker::ticket_t ticket;
+    ASSERT_TRUE(worker.push_work([&release] {
+      while (!release.load()) {
+        std::this_thread::yield();
+      }
+    }, &ticket));
+    EXPECT_FALSE(worker.wait(ticket, 10));
+    release.store(true);
+    EXPECT_TRUE(worker.wait(ticket, -1));
+  }
+
+  TEST(WorkerTest, TasksRunOnTheWorkerThread) {
+    Worker worker(4, 64);
+    EXPECT_FALSE(worker.isWorkerThread());
+    bool onWorker = false;
+    Worker::ticket_t ticket;
+    ASSERT_TRUE(worker.push_work([&] { onWorker = worker.isWorkerThread(); },
+                                 &ticket));
+    ASSERT_TRUE(worker.wait(ticket, -1));
+    EXPECT_TRUE(onWorker);
+  }
+
+  TEST(WorkerTest, TaskMovesItsCapture) {
+    std::shared_ptr<int> shared = std::make_shared<int>(3);
+    Task task([shared] { ++*shared; });
+    Task moved(std::move(task));
+    EXPECT_FALSE(static_cast<bool>(task));
+    ASSERT_TRUE(static_cast<bool>(moved));
+    moved();
+    EXPECT_EQ(4, *shared);
+    EXPECT_EQ(2, shared.use_count());
+    moved = Task();
+    EXPECT_EQ(1, shared.use_count());
+  }
+
+} // namespace
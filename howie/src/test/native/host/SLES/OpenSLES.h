@@ -0,0 +1,30 @@
+/*
+ * Copyright 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#ifndef HOWIE_HOST_OPENSLES_H
+#define HOWIE_HOST_OPENSLES_H
+
+// Host stand-in for <SLES/OpenSLES.h>, with just the types the platform
+// independent sources see through howie-private.h.
+
+#include <stdint.h>
+
+typedef uint32_t SLuint32;
+typedef SLuint32 SLresult;
+
+#define SL_RESULT_SUCCESS ((SLuint32) 0x00000000)
+
+#endif // HOWIE_HOST_OPENSLES_H
@@ -0,0 +1,42 @@
+/*
+ * Copyright 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#include <android/log.h>
+#include <stdarg.h>
+#include <stdio.h>
+
+// Verbose and debug messages would drown out test output.
+static const int kMinPriority = ANDROID_LOG_INFO;
+
+int __android_log_write(int prio, const char *tag, const char *text) {
+  if (prio < kMinPriority) {
+    return 0;
+  }
+  return fprintf(stderr, "%s: %s\n", tag, text);
+}
+
+int __android_log_print(int prio, const char *tag, const char *fmt, ...) {
+  if (prio < kMinPriority) {
+    return 0;
+  }
+  va_list args;
+  va_start(args, fmt);
+  int result = fprintf(stderr, "%s: ", tag);
+  result += vfprintf(stderr, fmt, args);
+  result += fprintf(stderr, "\n");
+  va_end(args);
+  return result;
+}
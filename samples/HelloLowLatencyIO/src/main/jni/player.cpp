@@ -90,8 +90,10 @@ HowieError onProcess(
   Params *pParams = reinterpret_cast<Params *>(params->data);
 
 
-  short *input_samples = reinterpret_cast<short *>(in->data);
-  short *output_samples = reinterpret_cast<short *>(out->data);
+  // The stream is created in float mode, so howie takes care of
+  // converting to and from the device format.
+  const float *input_samples = reinterpret_cast<const float *>(in->data);
+  float *output_samples = reinterpret_cast<float *>(out->data);
 
   // alias all the struct members for convenience
   float (&A)[2][2] = pParams->A;
@@ -99,9 +101,9 @@ HowieError onProcess(
   float (&C)[3] = pParams->C;
   float (&y)[2] = pState->y;
 
-  for (int i = 0; i < in->byteCount /2; ++i) {
+  for (int i = 0; i < in->byteCount / sizeof(float); ++i) {
     // y[n+1] = A*y[n] + B * x[n]
-    float x = (float)input_samples[i] / 32767.f;
+    float x = input_samples[i];
     float next_y[2] = {
         A[0][0] * y[0] + A[0][1] * y[1] + B[0] * x,
         A[1][0] * y[0] + A[1][1] * y[1] + B[1] * x
@@ -112,9 +114,7 @@ HowieError onProcess(
     y[0] = next_y[0];
     y[1] = next_y[1];
     out_n *= pParams->gain;
-    // clamp
-    out_n = std::max(-1.0f, std::min(1.0f, out_n));
-    output_samples[i] = (short)(out_n * 32767.f);
+    output_samples[i] = out_n;
   }
   return HOWIE_SUCCESS;
 }
@@ -136,7 +136,9 @@ Java_com_example_ilewis_hellolowlatencyio_MainActivity_initStream(
       onCleanup,
       sizeof(State),
       sizeof(Params),
-      HOWIE_STREAM_STATE_PLAYING};
+      HOWIE_STREAM_STATE_PLAYING,
+      0, // default playback buffer count
+      HOWIE_SAMPLE_FORMAT_FLOAT};
 
   HowieStream *pStream = nullptr;
   HowieStreamCreate(&hscp, &pStream);
@@ -152,8 +154,15 @@ Java_com_example_ilewis_hellolowlatencyio_MainActivity_setParams(
     jfloat resonance,
     jfloat gain) {
   HowieStream *pStream = reinterpret_cast<HowieStream *>(stream);
-  Params params;
-  CookParameters(frequency, resonance, &params);
-  params.gain = gain;
-  HowieStreamSendParameters(pStream, &params, sizeof(params), 1);
+
+  // Cook the parameters directly into the stream's parameter slot, so
+  // they don't have to be copied on their way to the audio thread.
+  void *slot = nullptr;
+  if (HOWIE_SUCCEEDED(HowieStreamAcquireParameterSlot(pStream, &slot,
+                                                      nullptr, 1))) {
+    Params *params = reinterpret_cast<Params *>(slot);
+    CookParameters(frequency, resonance, params);
+    params->gain = gain;
+    HowieStreamCommitParameters(pStream, slot);
+  }
 }
\ No newline at end of file
@@ -19,12 +19,21 @@ package com.google.sample.audio_echo;
 import android.support.v7.app.AppCompatActivity;
 import android.os.Bundle;
 import android.util.Log;
+import android.view.View;
+import android.widget.Button;
 import android.widget.CompoundButton;
+import android.widget.TextView;
 import android.widget.ToggleButton;
 
+import com.example.android.howie.HowieEngine;
+
 public class EchoMainActivity extends AppCompatActivity {
     private   long streamId;
     private   ToggleButton toggle;
+    private   Button benchmarkButton;
+    private   TextView benchmarkResult;
+
+    private static final int BENCHMARK_DURATION_MS = 10000;
     @Override
     protected void onCreate(Bundle savedInstanceState) {
 
@@ -32,6 +41,7 @@ public class EchoMainActivity extends AppCompatActivity {
         setContentView(R.layout.activity_echo_main);
 
         System.loadLibrary("audio-echo");
+        HowieEngine.init(this);
 
         toggle = (ToggleButton) findViewById(R.id.toggleEcho);
         toggle.setOnCheckedChangeListener(new CompoundButton.OnCheckedChangeListener() {
@@ -39,6 +49,32 @@ public class EchoMainActivity extends AppCompatActivity {
                 startEcho(streamId, isChecked ? true : false);
             }
         });
+
+        benchmarkResult = (TextView) findViewById(R.id.benchmarkResult);
+        benchmarkButton = (Button) findViewById(R.id.runBenchmark);
+        benchmarkButton.setOnClickListener(new View.OnClickListener() {
+            public void onClick(View v) {
+                startBenchmark();
+            }
+        });
+    }
+
+    // The benchmark blocks for its whole run, so it gets a thread of its own.
+    private void startBenchmark() {
+        toggle.setChecked(false);
+        benchmarkButton.setEnabled(false);
+        benchmarkResult.setText(R.string.benchmark_running);
+        new Thread(new Runnable() {
+            public void run() {
+                final String summary = runLatencyBenchmark(BENCHMARK_DURATION_MS);
+                runOnUiThread(new Runnable() {
+                    public void run() {
+                        benchmarkResult.setText(summary);
+                        benchmarkButton.setEnabled(true);
+                    }
+                });
+            }
+        }).start();
     }
 
     @Override
@@ -57,4 +93,5 @@ public class EchoMainActivity extends AppCompatActivity {
     native public long createStream();
     native public void destroyStream(long streamId);
     native public void startEcho(long stream, boolean start);
+    native public String runLatencyBenchmark(int durationMs);
 }
@@ -15,6 +15,8 @@
  *
  */
 #include <android/log.h>
+#include <cstdio>
+#include <howie.h>
 #include "echo_main.h"
 
 
@@ -52,3 +54,39 @@ Java_com_google_sample_audio_1echo_EchoMainActivity_startEcho(
                         (start? "start" : "stop"),
                         streamId);
 }
+
+JNIEXPORT jstring JNICALL
+Java_com_google_sample_audio_1echo_EchoMainActivity_runLatencyBenchmark(
+        JNIEnv *env,
+        jobject instance,
+        jint durationMs) {
+    HowieLatencyBenchmarkParams params = {};
+    params.version = sizeof(params);
+    params.durationMs = durationMs;
+    HowieLatencyBenchmarkResult result = {};
+    result.version = sizeof(result);
+
+    char summary[256];
+    HowieError error = HowieRunLatencyBenchmark(&params, &result);
+    if (error != HOWIE_SUCCESS) {
+        snprintf(summary, sizeof(summary), "Benchmark failed: %d", error);
+    } else if (result.detectedCount == 0) {
+        snprintf(summary, sizeof(summary),
+                 "No pulses detected in %d.\n"
+                 "Turn up the volume, or use a loopback adapter.",
+                 result.pulseCount);
+    } else {
+        snprintf(summary, sizeof(summary),
+                 "Round trip latency: %.1f ms (%.1f - %.1f)\n"
+                 "Jitter: %.2f ms\n"
+                 "Pulses detected: %d of %d\n"
+                 "Underruns: %d, missed input: %d, input resyncs: %d",
+                 result.meanLatencyMs, result.minLatencyMs,
+                 result.maxLatencyMs, result.jitterMs,
+                 result.detectedCount, result.pulseCount,
+                 result.underrunCount, result.missedRecordBufferCount,
+                 result.inputResyncCount);
+    }
+    __android_log_print(ANDROID_LOG_INFO, MODULE_NAME, "%s", summary);
+    return env->NewStringUTF(summary);
+}
@@ -35,6 +35,11 @@ JNIEXPORT void JNICALL
         jobject instance,
         jlong stream,
         jboolean start);
+JNIEXPORT jstring JNICALL
+        Java_com_google_sample_audio_1echo_EchoMainActivity_runLatencyBenchmark(
+        JNIEnv *env,
+        jobject instance,
+        jint durationMs);
 }
 
 #endif //AUDIO_ECHO_ECHO_MAIN_H